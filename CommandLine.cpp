@@ -0,0 +1,102 @@
+#include "CommandLine.h"
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/**
+ * @brief Characters that mean something to GlobMatcher
+ */
+bool isGlobSpecial(char c) {
+    switch (c) {
+        case '\\': case '*': case '?': case '[': case ']': case '{': case '}': case ',':
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+void CommandLine::appendQuoted(char c) {
+    storage += c;
+    if (isGlobSpecial(c)) {
+        patterns += '\\';
+    }
+    patterns += c;
+}
+
+void CommandLine::parse(string_view line) {
+    storage.clear();
+    words.clear();
+    patterns.clear();
+    patternWords.clear();
+    // Unquoting only ever shrinks text, so this is all the room a line needs;
+    // re-escaping at most doubles it
+    storage.reserve(line.size());
+    patterns.reserve(2 * line.size());
+
+    size_t i = 0;
+    while (true) {
+        while (i < line.size() && isBlank(line[i])) {
+            ++i;
+        }
+        if (i == line.size() || line[i] == '#') {
+            return;
+        }
+
+        size_t start = storage.size();
+        size_t patternStart = patterns.size();
+        while (i < line.size() && !isBlank(line[i])) {
+            char c = line[i++];
+            if (c == '\\') {
+                if (i == line.size()) {
+                    throw runtime_error("Trailing backslash");
+                }
+                appendQuoted(line[i++]);
+            } else if (c == '\'') {
+                size_t close = line.find('\'', i);
+                if (close == string_view::npos) {
+                    throw runtime_error("Unterminated ' quote");
+                }
+                for (; i < close; ++i) {
+                    appendQuoted(line[i]);
+                }
+                i = close + 1;
+            } else if (c == '"') {
+                while (i < line.size() && line[i] != '"') {
+                    if (line[i] == '\\' && i + 1 < line.size() && (line[i + 1] == '"' || line[i + 1] == '\\')) {
+                        ++i;
+                    }
+                    appendQuoted(line[i++]);
+                }
+                if (i == line.size()) {
+                    throw runtime_error("Unterminated \" quote");
+                }
+                ++i;
+            } else {
+                storage += c;
+                patterns += c;
+            }
+        }
+        words.emplace_back(static_cast<uint32_t>(start), static_cast<uint32_t>(storage.size() - start));
+        patternWords.emplace_back(static_cast<uint32_t>(patternStart),
+                                  static_cast<uint32_t>(patterns.size() - patternStart));
+    }
+}
+
+string CommandLine::join(size_t first) const {
+    string text;
+    for (size_t i = first; i < size(); ++i) {
+        if (i > first) {
+            text += ' ';
+        }
+        text += (*this)[i];
+    }
+    return text;
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief One command split into words, with shell-style quoting
+ *
+ * Words are separated by blanks. Inside single quotes every character is
+ * literal; inside double quotes a backslash escapes '"' and '\'; outside
+ * quotes a backslash escapes any character. Adjacent quoted and unquoted
+ * parts join into one word ("a b"'c' is the word a bc), "" is an empty
+ * word, and a '#' that starts a word comments out the rest of the line.
+ *
+ * Quoting also makes glob metacharacters literal: pattern() gives each
+ * word with its quoted or backslash-escaped '*', '?', '[', '{' (and the
+ * like) escaped again with a backslash, the form GlobMatcher understands, so
+ * rm "x[1].log" names that one file instead of matching x1.log.
+ *
+ * Unquoted text is copied into a buffer owned by the object, with words
+ * kept as offsets into it. Parsing line after line into the same object
+ * reuses that storage, so once it has grown to the longest line no
+ * further allocation happens. Because words are offsets, a copy of a
+ * CommandLine is independent of the original.
+ */
+class CommandLine {
+public:
+    CommandLine() = default;
+
+    /**
+     * @brief Parse a line, replacing the previous words
+     * @throws std::runtime_error on an unterminated quote or a trailing backslash
+     */
+    void parse(std::string_view line);
+
+    size_t size() const { return words.size(); }
+    bool empty() const { return words.empty(); }
+
+    /**
+     * @brief Word i (valid until the next parse())
+     */
+    std::string_view operator[](size_t i) const {
+        return std::string_view(storage.data() + words[i].first, words[i].second);
+    }
+
+    /**
+     * @brief Word i as a string, for APIs that take one
+     */
+    std::string str(size_t i) const { return std::string((*this)[i]); }
+
+    /**
+     * @brief Word i as a glob pattern: metacharacters that were quoted or escaped come back escaped
+     */
+    std::string pattern(size_t i) const {
+        return std::string(patterns.data() + patternWords[i].first, patternWords[i].second);
+    }
+
+    /**
+     * @brief Join words [first, size()) with single spaces
+     */
+    std::string join(size_t first) const;
+
+    /**
+     * @brief Forget the last word (a trailing "&" once it has been acted on)
+     */
+    void dropLast() {
+        words.pop_back();
+        patternWords.pop_back();
+    }
+
+private:
+    std::string storage;                                ///< Unquoted text of every word, back to back
+    std::vector<std::pair<uint32_t, uint32_t>> words;   ///< (offset, length) into storage
+    std::string patterns;                               ///< Every word again, quoted metacharacters escaped
+    std::vector<std::pair<uint32_t, uint32_t>> patternWords;  ///< (offset, length) into patterns
+
+    /**
+     * @brief Add a character that was quoted or escaped
+     */
+    void appendQuoted(char c);
+};
+
+#endif // COMMAND_LINE_H
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "ContentSearcher.h"
+#include "ParallelWalker.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CONTENT_SEARCH_X86 1
+#endif
+
+using namespace std;
+
+namespace {
+
+/// Files are read this much at a time; a file that fits is read with one pread
+constexpr size_t READ_CHUNK_SIZE = 1024 * 1024;
+
+/// Bytes inspected for NUL when deciding whether a file is binary
+constexpr size_t BINARY_PROBE_SIZE = 8192;
+
+using FindFunction = const char* (*)(const char*, size_t, const char*, size_t);
+
+const char* findScalar(const char* haystack, size_t length, const char* needle, size_t needleLength) {
+    return static_cast<const char*>(memmem(haystack, length, needle, needleLength));
+}
+
+#ifdef CONTENT_SEARCH_X86
+
+/**
+ * @brief SSE2 first/last byte filter: compare 16 candidate start positions per step
+ */
+const char* findSse2(const char* haystack, size_t length, const char* needle, size_t needleLength) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+    size_t i = 0;
+    for (; i + needleLength - 1 + 16 <= length; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + needleLength - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst),
+                                                        _mm_cmpeq_epi8(last, blockLast)));
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, needleLength - 2) == 0) {
+                return haystack + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(haystack + i, length - i, needle, needleLength);
+}
+
+/**
+ * @brief AVX2 variant of findSse2, 32 candidate positions per step
+ */
+__attribute__((target("avx2")))
+const char* findAvx2(const char* haystack, size_t length, const char* needle, size_t needleLength) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needleLength - 1]);
+    size_t i = 0;
+    for (; i + needleLength - 1 + 32 <= length; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+        __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + needleLength - 1));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast))));
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, needleLength - 2) == 0) {
+                return haystack + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(haystack + i, length - i, needle, needleLength);
+}
+
+#endif // CONTENT_SEARCH_X86
+
+/**
+ * @brief Pick the widest implementation the running CPU supports
+ */
+FindFunction selectFind() {
+#ifdef CONTENT_SEARCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return findAvx2;
+    }
+    return findSse2;
+#else
+    return findScalar;
+#endif
+}
+
+const FindFunction findImpl = selectFind();
+
+struct FdGuard {
+    int fd;
+    ~FdGuard() { if (fd >= 0) ::close(fd); }
+};
+
+} // namespace
+
+ContentSearcher::ContentSearcher(const string& needle, unsigned threads)
+    : needle(needle), threads(threads) {
+    if (needle.empty()) {
+        throw runtime_error("Search string must not be empty");
+    }
+}
+
+const char* ContentSearcher::find(const char* haystack, size_t length,
+                                  const char* needle, size_t needleLength) {
+    if (needleLength == 0 || length < needleLength) {
+        return nullptr;
+    }
+    if (needleLength == 1) {
+        return static_cast<const char*>(memchr(haystack, needle[0], length));
+    }
+    return findImpl(haystack, length, needle, needleLength);
+}
+
+void ContentSearcher::scanBuffer(const char* data, size_t size, string_view path,
+                                 vector<ContentMatch>& out) const {
+    scanLines(data, size, path, out, 1, 0, nullptr);
+}
+
+void ContentSearcher::scanLines(const char* data, size_t size, string_view path, vector<ContentMatch>& out,
+                                size_t line, size_t base, size_t* endLine) const {
+    size_t counted = 0;  // newlines before this offset are already in 'line'
+    size_t pos = 0;
+
+    while (pos < size) {
+        const char* hit = find(data + pos, size - pos, needle.data(), needle.size());
+        if (!hit) {
+            break;
+        }
+        size_t offset = hit - data;
+        line += count(data + counted, data + offset, '\n');
+        counted = offset;
+        out.push_back({string(path), line, base + offset});
+
+        // One hit per line, like grep: resume after the end of this line
+        const void* eol = memchr(hit, '\n', size - offset);
+        if (!eol) {
+            break;
+        }
+        pos = static_cast<const char*>(eol) - data + 1;
+    }
+    if (endLine) {
+        *endLine = line + count(data + counted, data + size, '\n');
+    }
+}
+
+void ContentSearcher::scanFile(int dirFd, const char* name, string_view path,
+                               vector<char>& buffer, vector<ContentMatch>& out) const {
+    FdGuard file{::openat(dirFd, name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW)};
+    FE_COUNT_SYSCALL(Open, 1);
+    if (file.fd < 0) {
+        return;  // Skip files we can't open
+    }
+    struct stat st;
+    if (fstat(file.fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        return;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+
+    // Each read is scanned up to its last newline; the partial line after it
+    // moves to the front of the buffer to be completed by the next read. A
+    // line longer than a chunk is scanned as it comes, keeping only enough of
+    // its end for a match across the cut. A file that shrinks while it is
+    // read just comes up short.
+    size_t line = 1;
+    size_t base = 0;            // File offset of buffer[0]
+    size_t carry = 0;           // Bytes kept at the front of buffer, never holding a newline
+    size_t offset = 0;          // File offset of the next read
+    bool lineReported = false;  // The line being carried already has its hit
+    while (true) {
+        size_t want = min(size - offset, READ_CHUNK_SIZE);  // Never 0: offset < size here
+        if (buffer.size() < carry + want) {
+            buffer.resize(carry + want);
+        }
+        ssize_t got = pread(file.fd, buffer.data() + carry, want, static_cast<off_t>(offset));
+        FE_COUNT_SYSCALL(Read, 1);
+        if (got < 0) {
+            return;
+        }
+        FE_COUNT_BYTES_READ(static_cast<uint64_t>(got));
+        if (offset == 0 && memchr(buffer.data(), '\0', min(static_cast<size_t>(got), BINARY_PROBE_SIZE))) {
+            return;  // Binary file
+        }
+        offset += static_cast<size_t>(got);
+        const char* data = buffer.data();
+        size_t filled = carry + static_cast<size_t>(got);
+        bool last = got == 0 || offset >= size;
+
+        size_t start = 0;
+        if (lineReported) {
+            // Skip the rest of a long line that already has its hit
+            const void* eol = memchr(data + carry, '\n', static_cast<size_t>(got));
+            start = eol ? static_cast<const char*>(eol) - data + 1 : filled;
+            line += eol ? 1 : 0;
+            lineReported = !eol;
+        }
+        if (last) {
+            scanLines(data + start, filled - start, path, out, line, base + start, nullptr);
+            return;
+        }
+
+        size_t from = max(carry, start);
+        const void* eol = memrchr(data + from, '\n', filled - from);
+        size_t complete = start;
+        if (eol) {
+            complete = static_cast<const char*>(eol) - data + 1;
+            scanLines(data + start, complete - start, path, out, line, base + start, &line);
+        } else if (filled - start >= READ_CHUNK_SIZE) {
+            size_t before = out.size();
+            scanLines(data + start, filled - start, path, out, line, base + start, nullptr);
+            lineReported = out.size() > before;
+            complete = filled - (lineReported ? 0 : min(needle.size() - 1, filled - start));
+        }
+        carry = filled - complete;
+        memmove(buffer.data(), data + complete, carry);
+        base += complete;
+    }
+}
+
+vector<ContentMatch> ContentSearcher::searchTree(const string& root, const GlobMatcher& filePattern) const {
+    ParallelWalker walker(threads);
+    // Each worker scans the files it discovers into its own result list and buffer
+    vector<vector<ContentMatch>> perWorker(walker.threadCount());
+    vector<vector<char>> buffers(walker.threadCount(), vector<char>(64 * 1024));
+
+    walker.walk(root, [&](const WalkEntry& entry) {
+        if (entry.type == DT_DIR) {
+            return true;
+        }
+        if (entry.type == DT_REG && filePattern.matches(entry.name, strlen(entry.name))) {
+            scanFile(entry.dirFd, entry.name, entry.fullPath, buffers[entry.worker], perWorker[entry.worker]);
+        }
+        return false;
+    });
+
+    vector<ContentMatch> matches;
+    for (auto& list : perWorker) {
+        matches.insert(matches.end(), make_move_iterator(list.begin()), make_move_iterator(list.end()));
+    }
+    sort(matches.begin(), matches.end(), [](const ContentMatch& a, const ContentMatch& b) {
+        return a.path != b.path ? a.path < b.path : a.offset < b.offset;
+    });
+    return matches;
+}
\ No newline at end of file
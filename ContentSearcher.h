@@ -0,0 +1,83 @@
+#ifndef CONTENT_SEARCHER_H
+#define CONTENT_SEARCHER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include "GlobMatcher.h"
+
+/**
+ * @brief One occurrence of the search string inside a file
+ */
+struct ContentMatch {
+    std::string path;  ///< Full path of the file
+    size_t line;       ///< 1-based line number
+    size_t offset;     ///< Byte offset of the match from the start of the file
+};
+
+/**
+ * @brief Parallel grep-style content search over a directory tree
+ *
+ * Files are scanned by the ParallelWalker workers that discover them.
+ * Files are read with pread into a per-worker buffer, whole when they are
+ * small and in line-aligned chunks otherwise; they are never mmap()ed, so
+ * a file truncated during the search cannot raise SIGBUS. Candidates are located with a SIMD first/last
+ * byte filter (AVX2 when the CPU has it, SSE2 otherwise) and then verified
+ * with memcmp. Files with a NUL byte in their first block are treated as
+ * binary and skipped. Only the first match on each line is reported.
+ */
+class ContentSearcher {
+public:
+    /**
+     * @brief Construct a searcher
+     * @param needle String to search for
+     * @param threads Worker thread count (0 = hardware concurrency)
+     * @throws std::runtime_error if needle is empty
+     */
+    explicit ContentSearcher(const std::string& needle, unsigned threads = 0);
+
+    /**
+     * @brief Search every regular file below root whose name matches filePattern
+     * @param root Directory to search
+     * @param filePattern Compiled pattern file names must match
+     * @return Matches sorted by path and offset
+     * @throws std::runtime_error if root cannot be opened
+     */
+    std::vector<ContentMatch> searchTree(const std::string& root, const GlobMatcher& filePattern) const;
+
+    /**
+     * @brief Scan an in-memory buffer, appending matches for the given path
+     */
+    void scanBuffer(const char* data, size_t size, std::string_view path,
+                    std::vector<ContentMatch>& out) const;
+
+    /**
+     * @brief Locate the first occurrence of needle in a buffer
+     * @return Pointer to the match, or nullptr
+     */
+    static const char* find(const char* haystack, size_t length,
+                            const char* needle, size_t needleLength);
+
+private:
+    /**
+     * @brief Scan a run of whole lines taken from a file
+     * @param line Line number of data[0]
+     * @param base File offset of data[0]
+     * @param endLine If not null, receives the line number just past data[size - 1]
+     */
+    void scanLines(const char* data, size_t size, std::string_view path, std::vector<ContentMatch>& out,
+                   size_t line, size_t base, size_t* endLine) const;
+
+    /**
+     * @brief Open, classify and scan one file
+     * @param path Only copied if the file matches
+     */
+    void scanFile(int dirFd, const char* name, std::string_view path,
+                  std::vector<char>& buffer, std::vector<ContentMatch>& out) const;
+
+    std::string needle;  ///< String being searched for
+    unsigned threads;    ///< Worker thread count
+};
+
+#endif // CONTENT_SEARCHER_H
\ No newline at end of file
@@ -0,0 +1,341 @@
+#include "DirectoryCache.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+using namespace std;
+
+namespace {
+
+/// Events that change what a listing shows
+constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE |
+                                IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+/// Events that change a subdirectory's own row: entries coming and going move its mtime and size
+constexpr uint32_t CHILD_WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                      IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+/// More changed names than this in one round and the directory is re-read instead
+constexpr size_t MAX_PATCHED_NAMES = 256;
+
+} // namespace
+
+DirectoryCache::DirectoryCache(unsigned fields, size_t limitBytes)
+    : reader(fields), limitBytes(limitBytes),
+      inotifyFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)), childFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {}
+
+DirectoryCache::~DirectoryCache() {
+    // Closing an instance drops every watch on it
+    if (inotifyFd >= 0) {
+        ::close(inotifyFd);
+    }
+    if (childFd >= 0) {
+        ::close(childFd);
+    }
+}
+
+const FileInfoBatch* DirectoryCache::find(const string& dirPath) {
+    processEvents();
+    abandonPending();
+
+    struct stat st;
+    if (inotifyFd < 0 || childFd < 0 || ::stat(dirPath.c_str(), &st) != 0) {
+        counters.misses++;
+        return nullptr;
+    }
+    Key key{st.st_dev, st.st_ino};
+    auto it = entries.find(key);
+    if (it != entries.end() && it->second.path == dirPath) {
+        recency.splice(recency.begin(), recency, it->second.lru);
+        counters.hits++;
+        return &it->second.files;
+    }
+
+    // A listing carries the path it was read through, so another route to a cached directory is a miss too.
+    // Watch before the caller reads, so changes made during the read are noticed.
+    counters.misses++;
+    int watch = inotify_add_watch(inotifyFd, dirPath.c_str(), WATCH_MASK);
+    if (watch >= 0) {
+        pending = PendingRead{dirPath, key, watch, false};
+    }
+    return nullptr;
+}
+
+void DirectoryCache::insert(const string& dirPath, FileInfoBatch files) {
+    processEvents();
+    if (pending.watch < 0 || pending.path != dirPath) {
+        return;  // No watch was in place while this listing was read
+    }
+    files.shrinkToFit();  // Kept until evicted, so spare capacity would be dead weight
+    size_t bytes = files.memoryUsage();
+    if (pending.dirty || bytes > limitBytes) {
+        abandonPending();  // Changed while being read, or too big to ever fit
+        return;
+    }
+
+    PendingRead read = pending;
+    pending = PendingRead();
+    auto existing = entries.find(read.key);
+    if (existing != entries.end()) {
+        erase(existing, existing->second.watch != read.watch);
+    }
+    recency.push_front(read.key);
+    totalBytes += bytes;
+    totalEntries += files.size();
+    auto added = entries.emplace(read.key, Entry{dirPath, std::move(files), read.watch, bytes, recency.begin(), {}}).first;
+    watches[read.watch] = read.key;
+    if (!watchChildren(added->second)) {
+        erase(added, true);
+        return;
+    }
+    enforceLimit();
+}
+
+void DirectoryCache::abandonPending() {
+    if (pending.watch >= 0 && watches.find(pending.watch) == watches.end()) {
+        inotify_rm_watch(inotifyFd, pending.watch);
+    }
+    pending = PendingRead();
+}
+
+void DirectoryCache::clear() {
+    abandonPending();
+    while (!entries.empty()) {
+        erase(entries.begin(), true);
+    }
+}
+
+DirectoryCacheStats DirectoryCache::stats() const {
+    DirectoryCacheStats stats = counters;
+    stats.directories = entries.size();
+    stats.entries = totalEntries;
+    stats.bytes = totalBytes;
+    stats.limitBytes = limitBytes;
+    return stats;
+}
+
+void DirectoryCache::processEvents() {
+    if (inotifyFd < 0 || (entries.empty() && pending.watch < 0)) {
+        return;
+    }
+
+    alignas(inotify_event) char buffer[64 * 1024];
+    unordered_map<int, unordered_set<string>> changed;  // By the watch of the cached directory
+    unordered_map<int, bool> gone;  // Watch descriptor -> whether the kernel still holds the watch
+    bool overflow = false;
+
+    auto drain = [&](int fd, auto&& handle) {
+        while (true) {
+            ssize_t bytes = ::read(fd, buffer, sizeof(buffer));
+            if (bytes <= 0) {
+                break;  // EAGAIN: queue drained
+            }
+            for (ssize_t offset = 0; offset < bytes;) {
+                auto* event = reinterpret_cast<inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    overflow = true;
+                } else {
+                    handle(*event);
+                }
+            }
+        }
+    };
+    auto noteChange = [&changed](int wd, const char* name) {
+        auto& names = changed[wd];
+        if (names.size() <= MAX_PATCHED_NAMES) {
+            names.insert(name);
+        }
+    };
+
+    drain(inotifyFd, [&](const inotify_event& event) {
+        if (event.wd == pending.watch) {
+            pending.dirty = true;
+        }
+        if (event.mask & (IN_DELETE_SELF | IN_IGNORED)) {
+            gone[event.wd] = false;  // The kernel has dropped the watch itself
+        } else if (event.mask & (IN_MOVE_SELF | IN_UNMOUNT)) {
+            gone.emplace(event.wd, true);  // Still watched under its new name: ours to remove
+        } else if (event.len > 0) {
+            noteChange(event.wd, event.name);
+        }
+    });
+    drain(childFd, [&](const inotify_event& event) {
+        auto child = childWatches.find(event.wd);
+        if (child == childWatches.end()) {
+            return;  // Already let go of
+        }
+        auto parent = entries.find(child->second.parent);
+        if (parent == entries.end()) {
+            return;
+        }
+        // Whatever happened in or to the subdirectory, its row needs a fresh look
+        noteChange(parent->second.watch, child->second.name.c_str());
+        if (event.mask & (IN_DELETE_SELF | IN_IGNORED | IN_MOVE_SELF | IN_UNMOUNT)) {
+            if (event.mask & (IN_MOVE_SELF | IN_UNMOUNT)) {
+                inotify_rm_watch(childFd, event.wd);
+            }
+            parent->second.children.erase(child->second.name);
+            childWatches.erase(child);
+        }
+    });
+
+    if (overflow) {
+        // Events were lost, so nothing cached can be trusted
+        counters.invalidations += entries.size();
+        clear();
+        return;
+    }
+
+    for (const auto& [wd, watched] : gone) {
+        auto watch = watches.find(wd);
+        if (watch != watches.end()) {
+            auto it = entries.find(watch->second);
+            if (it != entries.end() && it->second.watch == wd) {
+                counters.invalidations++;
+                erase(it, watched);
+            }
+        }
+    }
+    for (auto& change : changed) {
+        auto watch = watches.find(change.first);
+        if (watch == watches.end()) {
+            continue;
+        }
+        auto it = entries.find(watch->second);
+        if (it == entries.end() || it->second.watch != change.first) {
+            continue;
+        }
+        if (change.second.size() > MAX_PATCHED_NAMES || !patch(it->second, std::move(change.second))) {
+            counters.invalidations++;
+            erase(it, true);
+        }
+    }
+    enforceLimit();
+}
+
+bool DirectoryCache::patch(Entry& entry, unordered_set<string> names) {
+    FileInfoBatch& files = entry.files;
+    const size_t countBefore = files.size();
+    FileInfoBatch fresh(files.fields());
+
+    // The names stay put in their set, so views of them can be matched against the arena
+    unordered_set<string_view> wanted(names.begin(), names.end());
+    vector<pair<string_view, bool>> rows;  // Each name and whether it is now a subdirectory
+
+    // One pass updates or removes entries that already exist
+    for (size_t i = 0; i < files.size() && !wanted.empty();) {
+        auto name = wanted.find(files.name(i));
+        if (name == wanted.end()) {
+            ++i;
+            continue;
+        }
+        string_view found = *name;
+        wanted.erase(name);
+        counters.patches++;
+        fresh.clear();
+        if (reader.readEntry(entry.path, string(found), fresh)) {
+            files.copyMetadata(i, fresh, 0);
+            rows.emplace_back(found, files.type(i) == DT_DIR);
+            ++i;
+        } else {
+            files.removeSwap(i);
+            rows.emplace_back(found, false);
+        }
+    }
+    // Whatever is left was created (or renamed in)
+    for (string_view name : wanted) {
+        bool added = reader.readEntry(entry.path, string(name), files);
+        if (added) {
+            counters.patches++;
+        }
+        rows.emplace_back(name, added && files.type(files.size() - 1) == DT_DIR);
+    }
+
+    size_t bytes = files.memoryUsage();
+    totalEntries = totalEntries - countBefore + files.size();
+    totalBytes = totalBytes - entry.bytes + bytes;
+    entry.bytes = bytes;
+
+    for (const auto& [name, isDirectory] : rows) {
+        if (!updateChild(entry, string(name), isDirectory)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DirectoryCache::updateChild(Entry& entry, const string& name, bool isDirectory) {
+    auto child = entry.children.find(name);
+    if (!isDirectory) {
+        if (child != entry.children.end()) {
+            inotify_rm_watch(childFd, child->second);
+            childWatches.erase(child->second);
+            entry.children.erase(child);
+        }
+        return true;
+    }
+    if (child != entry.children.end()) {
+        return true;
+    }
+    string path = entry.path.back() == '/' ? entry.path + name : entry.path + "/" + name;
+    int wd = inotify_add_watch(childFd, path.c_str(), CHILD_WATCH_MASK);
+    if (wd < 0) {
+        // Gone again already: the parent's own events will patch its row
+        return errno == ENOENT || errno == ENOTDIR;
+    }
+    if (!childWatches.emplace(wd, ChildWatch{*entry.lru, name}).second) {
+        return false;  // Already watched for another listing (a directory mounted twice); can't share
+    }
+    entry.children.emplace(name, wd);
+    return true;
+}
+
+bool DirectoryCache::watchChildren(Entry& entry) {
+    FileInfoBatch& files = entry.files;
+    FileInfoBatch fresh(files.fields());
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (files.type(i) != DT_DIR) {
+            continue;
+        }
+        string name(files.name(i));
+        if (!updateChild(entry, name, true)) {
+            return false;
+        }
+        // The listing was read before this watch existed: catch up on changes made in between
+        fresh.clear();
+        if (reader.readEntry(entry.path, name, fresh)) {
+            files.copyMetadata(i, fresh, 0);
+        }
+    }
+    return true;
+}
+
+void DirectoryCache::erase(EntryMap::iterator it, bool removeWatch) {
+    Entry& entry = it->second;
+    if (removeWatch) {
+        inotify_rm_watch(inotifyFd, entry.watch);
+    }
+    for (const auto& child : entry.children) {
+        inotify_rm_watch(childFd, child.second);
+        childWatches.erase(child.second);
+    }
+    watches.erase(entry.watch);
+    recency.erase(entry.lru);
+    totalBytes -= entry.bytes;
+    totalEntries -= entry.files.size();
+    entries.erase(it);
+}
+
+void DirectoryCache::enforceLimit() {
+    while (totalBytes > limitBytes && !recency.empty()) {
+        auto it = entries.find(recency.back());
+        counters.evictions++;
+        erase(it, true);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,188 @@
+#ifndef DIRECTORY_CACHE_H
+#define DIRECTORY_CACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <sys/types.h>
+#include "FileInfoBatch.h"
+#include "DirectoryReader.h"
+
+/**
+ * @brief Counters describing directory cache effectiveness
+ */
+struct DirectoryCacheStats {
+    uint64_t hits = 0;           ///< Listings served from memory
+    uint64_t misses = 0;         ///< Listings that had to be read from disk
+    uint64_t evictions = 0;      ///< Directories dropped to stay under the memory cap
+    uint64_t invalidations = 0;  ///< Directories dropped because they changed too much or went away
+    uint64_t patches = 0;        ///< Entries updated in place from inotify events
+    size_t directories = 0;      ///< Directories currently cached
+    size_t entries = 0;          ///< Entries currently cached
+    size_t bytes = 0;            ///< Memory held by cached entries
+    size_t limitBytes = 0;       ///< Memory cap
+};
+
+/**
+ * @brief In-memory cache of directory listings kept current with inotify
+ *
+ * Listings are keyed by the directory's (device, inode), so the same
+ * directory reached through a different path is still one entry. Every
+ * cached directory has an inotify watch; pending events are applied
+ * before each lookup, re-reading just the entries that were created,
+ * deleted, renamed or modified. A directory that receives a flood of
+ * events, or is itself removed, is simply dropped. Changes inside a
+ * subdirectory don't reach the parent's watch, yet they move the
+ * subdirectory's mtime, so every subdirectory of a cached listing is
+ * watched too, on a second inotify instance, for entries coming and going;
+ * such an event re-reads just that subdirectory's row. A hit itself makes
+ * no system calls beyond the stat() that identifies the directory.
+ *
+ * Memory use is measured per listing and capped; the least recently used
+ * directories are evicted first.
+ */
+class DirectoryCache {
+public:
+    /// Default memory cap
+    static constexpr size_t DEFAULT_LIMIT_BYTES = 64 * 1024 * 1024;
+
+    /**
+     * @brief Create a cache
+     * @param fields ListField mask the cached listings were read with (used to patch entries)
+     * @param limitBytes Memory cap for cached entries
+     */
+    explicit DirectoryCache(unsigned fields, size_t limitBytes = DEFAULT_LIMIT_BYTES);
+    ~DirectoryCache();
+
+    /**
+     * @brief Look up a directory's listing
+     *
+     * On a miss the directory is watched straight away, so a listing the
+     * caller reads next and passes to insert() can't miss concurrent changes.
+     * @param dirPath Absolute path of the directory
+     * @return The cached entries, or null on a miss; valid until the next non-const call
+     */
+    const FileInfoBatch* find(const std::string& dirPath);
+
+    /**
+     * @brief Cache a complete listing of a directory
+     *
+     * Only a listing read right after a find() miss for the same path is
+     * kept, and only if the directory didn't change while it was read. It
+     * is also dropped if the directory or one of its subdirectories
+     * couldn't be watched (e.g. the inotify watch limit is reached) or it
+     * alone exceeds the memory cap.
+     * @param dirPath Absolute path of the directory
+     * @param files Every entry of the directory
+     */
+    void insert(const std::string& dirPath, FileInfoBatch files);
+
+    /**
+     * @brief Drop every cached listing
+     */
+    void clear();
+
+    /**
+     * @brief Current counters
+     */
+    DirectoryCacheStats stats() const;
+
+    DirectoryCache(const DirectoryCache&) = delete;
+    DirectoryCache& operator=(const DirectoryCache&) = delete;
+
+private:
+    struct Key {
+        dev_t device;
+        ino_t inode;
+        bool operator==(const Key& other) const { return device == other.device && inode == other.inode; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return std::hash<uint64_t>()(key.inode * 31 + key.device); }
+    };
+
+    struct Entry {
+        std::string path;              ///< Path the listing was read through
+        FileInfoBatch files;
+        int watch;                     ///< inotify watch descriptor
+        size_t bytes;                  ///< Memory used by files
+        std::list<Key>::iterator lru;  ///< Position in the recency list; *lru is this entry's key
+        std::unordered_map<std::string, int> children;  ///< Watches on subdirectories, by name
+    };
+
+    /**
+     * @brief What a watch on the second inotify instance is for
+     */
+    struct ChildWatch {
+        Key parent;        ///< Cached directory holding the subdirectory
+        std::string name;  ///< Its name there
+    };
+
+    using EntryMap = std::unordered_map<Key, Entry, KeyHash>;
+
+    /**
+     * @brief A directory watched by a find() miss and not yet inserted
+     */
+    struct PendingRead {
+        std::string path;
+        Key key{0, 0};
+        int watch = -1;
+        bool dirty = false;  ///< Events arrived while the caller was reading
+    };
+
+    /**
+     * @brief Apply every queued inotify event
+     */
+    void processEvents();
+
+    /**
+     * @brief Forget the pending read, removing its watch unless a cached entry shares it
+     */
+    void abandonPending();
+
+    /**
+     * @brief Re-read the named entries of a cached directory, and watch the subdirectories among them
+     * @return false if a subdirectory couldn't be watched, so the entry can't be kept
+     */
+    bool patch(Entry& entry, std::unordered_set<std::string> names);
+
+    /**
+     * @brief Start or stop watching a subdirectory to match its row
+     * @return false if it needed a watch and couldn't get one
+     */
+    bool updateChild(Entry& entry, const std::string& name, bool isDirectory);
+
+    /**
+     * @brief Watch every subdirectory of a newly cached listing and refresh their rows once
+     * @return false if one couldn't be watched
+     */
+    bool watchChildren(Entry& entry);
+
+    /**
+     * @brief Remove a directory from the cache (and its watch, unless the kernel already dropped it)
+     */
+    void erase(EntryMap::iterator it, bool removeWatch);
+
+    /**
+     * @brief Evict least recently used directories until under the cap
+     */
+    void enforceLimit();
+
+    DirectoryReader reader;                          ///< Re-reads patched entries
+    size_t limitBytes;                               ///< Memory cap
+    size_t totalBytes = 0;                           ///< Sum of Entry::bytes
+    size_t totalEntries = 0;                         ///< Sum of Entry::files sizes
+    int inotifyFd;                                   ///< Non-blocking inotify instance (-1 if unavailable)
+    int childFd;                                     ///< Second instance, for subdirectories of cached listings
+    EntryMap entries;                                ///< Cached directories
+    std::unordered_map<int, Key> watches;            ///< Watch descriptor to directory
+    std::unordered_map<int, ChildWatch> childWatches;  ///< childFd watch descriptor to subdirectory
+    std::list<Key> recency;                          ///< Most recently used first
+    PendingRead pending;                             ///< Miss whose listing is being read
+    DirectoryCacheStats counters;                    ///< hits/misses/evictions/invalidations/patches
+};
+
+#endif // DIRECTORY_CACHE_H
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "DirectoryReader.h"
+#include "IoBackend.h"
+#include "Metrics.h"
+#include "PathArena.h"
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <cstddef>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+namespace {
+
+/// Layout of the records returned by getdents64 (not exported by glibc)
+struct linux_dirent64 {
+    ino64_t        d_ino;
+    off64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+/// Size of the getdents64 buffer; large enough to pull hundreds of entries per call
+constexpr size_t DIRENT_BUFFER_SIZE = 64 * 1024;
+
+/**
+ * @brief Small RAII wrapper so the directory fd is closed on every exit path
+ */
+struct FdGuard {
+    int fd;
+    ~FdGuard() { if (fd >= 0) ::close(fd); }
+};
+
+/**
+ * @brief Hand a finished batch to the consumer and empty it for the next buffer
+ */
+size_t deliver(FileInfoBatch& entries, const ListingHandler& onBatch) {
+    size_t count = entries.size();
+    if (count > 0) {
+        onBatch(entries);
+        entries.clear();
+    }
+    return count;
+}
+
+} // namespace
+
+DirectoryReader::DirectoryReader(unsigned fields) : fields(fields) {}
+
+unsigned DirectoryReader::statxMask() const {
+    unsigned mask = 0;
+    if (fields & LIST_SIZE)  mask |= STATX_SIZE | STATX_TYPE;
+    if (fields & LIST_MODE)  mask |= STATX_MODE | STATX_TYPE;
+    if (fields & LIST_OWNER) mask |= STATX_UID;
+    if (fields & LIST_GROUP) mask |= STATX_GID;
+    if (fields & LIST_MTIME) mask |= STATX_MTIME;
+    if (fields & LIST_INODE) mask |= STATX_INO;
+    return mask;
+}
+
+FileInfoBatch DirectoryReader::read(const string& dirPath, const GlobMatcher* filter) const {
+    FileInfoBatch all(fields, dirPath);
+    read(dirPath, [&all](const FileInfoBatch& batch) {
+        all.append(batch);
+    }, filter);
+    return all;
+}
+
+size_t DirectoryReader::read(const string& dirPath, const ListingHandler& onBatch,
+                             const GlobMatcher* filter) const {
+    FdGuard dir{::open(dirPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    FE_COUNT_SYSCALL(Open, 1);
+    if (dir.fd < 0) {
+        throw runtime_error("Cannot open directory: " + dirPath + ": " + strerror(errno));
+    }
+
+    const unsigned mask = statxMask();
+    FileInfoBatch entries(fields, dirPath);
+    alignas(linux_dirent64) char buffer[DIRENT_BUFFER_SIZE];
+
+    shared_ptr<IoBackend> backend = IoBackend::current();
+    vector<IoRequest> pending;
+    vector<struct statx> results;
+    vector<size_t> owners;  // row of entries for each pending request
+    size_t delivered = 0;
+
+    while (true) {
+        long bytes;
+        {
+            FE_TIME_PHASE(Metadata);
+            bytes = syscall(SYS_getdents64, dir.fd, buffer, sizeof(buffer));
+            FE_COUNT_SYSCALL(Getdents, 1);
+        }
+        if (bytes < 0) {
+            throw runtime_error("Cannot read directory: " + dirPath + ": " + strerror(errno));
+        }
+        if (bytes == 0) {
+            break;
+        }
+
+        // Pass 1: decode names and queue one statx per entry that needs it
+        pending.clear();
+        owners.clear();
+        for (long offset = 0; offset < bytes;) {
+            auto* d = reinterpret_cast<linux_dirent64*>(buffer + offset);
+            offset += d->d_reclen;
+
+            const char* name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            if (filter && !filter->matches(name, strlen(name))) {
+                continue;
+            }
+
+            // d_type answers "is directory" for free on most filesystems;
+            // only fall back to statx when it is unknown or more fields are wanted.
+            bool typeKnown = d->d_type != DT_UNKNOWN;
+            size_t row = entries.append(name, d->d_type);
+            entries.setInode(row, d->d_ino);
+
+            unsigned want = mask;
+            if ((fields & LIST_TYPE) && (!typeKnown || d->d_type == DT_LNK)) {
+                want |= STATX_TYPE;
+            }
+            if (want != 0) {
+                IoRequest request{IoOp::Statx};
+                request.dirFd = dir.fd;
+                request.path = name;  // points into buffer, valid until the next getdents64
+                request.flags = AT_NO_AUTOMOUNT;
+                request.mask = want;
+                pending.push_back(request);
+                owners.push_back(row);
+            }
+        }
+        if (pending.empty()) {
+            delivered += deliver(entries, onBatch);
+            continue;
+        }
+
+        // Pass 2: one batched submission for the whole getdents64 buffer
+        results.resize(pending.size());
+        for (size_t i = 0; i < pending.size(); ++i) {
+            pending[i].statxBuf = &results[i];
+        }
+        {
+            FE_TIME_PHASE(Metadata);
+            backend->submit(pending.data(), pending.size());
+        }
+
+        for (size_t i = 0; i < pending.size(); ++i) {
+            struct statx& stx = results[i];
+            if (pending[i].result < 0) {
+                // Dangling symlink: describe the link itself; otherwise the
+                // entry vanished or is unreadable, so keep what getdents told us
+                pending[i].flags |= AT_SYMLINK_NOFOLLOW;
+                IoBackend::executeSync(pending[i]);
+                if (pending[i].result < 0) {
+                    continue;
+                }
+            }
+
+            fill(entries, owners[i], stx);
+        }
+        delivered += deliver(entries, onBatch);
+    }
+
+    return delivered;
+}
+
+bool DirectoryReader::readEntry(const string& dirPath, const string& name, FileInfoBatch& into) const {
+    thread_local PathBuffer path;
+    path.assign(dirPath);
+    path.push(name);
+
+    struct statx stx;
+    unsigned mask = statxMask() | STATX_TYPE;
+    FE_TIME_PHASE(Metadata);
+    FE_COUNT_SYSCALL(Stat, 1);
+    if (statx(AT_FDCWD, path.c_str(), AT_NO_AUTOMOUNT, mask, &stx) != 0 &&
+        statx(AT_FDCWD, path.c_str(), AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW, mask, &stx) != 0) {
+        return false;
+    }
+    fill(into, into.append(name, DT_UNKNOWN), stx);
+    return true;
+}
+
+void DirectoryReader::fill(FileInfoBatch& batch, size_t row, const struct statx& stx) const {
+    if (stx.stx_mask & STATX_TYPE) {
+        batch.setType(row, IFTODT(stx.stx_mode));
+    }
+    if (fields & LIST_SIZE) {
+        batch.setFileSize(row, batch.isDirectory(row) ? 0 : stx.stx_size);
+    }
+    if (fields & LIST_MODE) {
+        batch.setMode(row, stx.stx_mode);
+    }
+    if (fields & LIST_MTIME) {
+        batch.setModifiedTime(row, static_cast<time_t>(stx.stx_mtime.tv_sec));
+    }
+    if (fields & LIST_OWNER) {
+        batch.setUid(row, stx.stx_uid);
+    }
+    if (fields & LIST_GROUP) {
+        batch.setGid(row, stx.stx_gid);
+    }
+    if ((fields & LIST_INODE) && (stx.stx_mask & STATX_INO)) {
+        batch.setInode(row, stx.stx_ino);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "DiskUsage.h"
+#include "ParallelWalker.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <string_view>
+#include <unordered_map>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+/// Unit of st_blocks
+constexpr uint64_t STAT_BLOCK_SIZE = 512;
+
+/**
+ * @brief A file with several links, counted once after the walk
+ */
+struct LinkedFile {
+    dev_t device;
+    ino_t inode;
+    uint64_t apparentBytes;
+    uint64_t allocatedBytes;
+    size_t directory;  ///< Index into the finding worker's directories
+};
+
+/**
+ * @brief Everything one worker accumulates during the walk
+ *
+ * Aligned to a cache line so workers updating their own totals never
+ * contend with each other.
+ */
+struct alignas(64) WorkerUsage {
+    vector<DiskUsageEntry> directories;  ///< Finished directories (own entries only)
+    DiskUsageEntry current;              ///< Directory being read
+    bool open = false;                   ///< current has been started
+    vector<LinkedFile> linked;
+    uint64_t mountPointsSkipped = 0;
+    uint64_t errors = 0;
+};
+
+/**
+ * @brief Parent directory of a path ("/a/b" -> "/a", "/a" -> "/")
+ */
+string_view parentOf(string_view path) {
+    size_t slash = path.rfind('/');
+    if (slash == string_view::npos) {
+        return string_view();
+    }
+    return slash == 0 ? path.substr(0, 1) : path.substr(0, slash);
+}
+
+} // namespace
+
+DiskUsageScanner::DiskUsageScanner(unsigned threads, bool oneFileSystem)
+    : threads(threads), oneFileSystem(oneFileSystem) {}
+
+DiskUsageReport DiskUsageScanner::scan(const string& rootPath, size_t top) const {
+    auto start = chrono::steady_clock::now();
+    string root = rootPath;
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    struct stat rootStat;
+    if (::stat(root.c_str(), &rootStat) != 0) {
+        throw runtime_error("Cannot access: " + root + ": " + strerror(errno));
+    }
+    const dev_t rootDevice = rootStat.st_dev;
+
+    ParallelWalker walker(threads);
+    vector<WorkerUsage> workers(walker.threadCount());
+
+    auto begin = [&workers](unsigned worker, const string& dirPath) -> WorkerUsage& {
+        WorkerUsage& usage = workers[worker];
+        if (!usage.open) {
+            usage.current = DiskUsageEntry();
+            usage.current.path = dirPath;
+            usage.open = true;
+        }
+        return usage;
+    };
+
+    walker.walk(root, [&](const WalkEntry& entry) {
+        WorkerUsage& usage = begin(entry.worker, entry.dirPath);
+        if (entry.type == DT_DIR && !oneFileSystem) {
+            return true;  // Its own size is taken when it is read
+        }
+
+        struct stat st;
+        if (fstatat(entry.dirFd, entry.name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            usage.errors++;
+            return false;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            if (st.st_dev != rootDevice) {
+                usage.mountPointsSkipped++;
+                return false;
+            }
+            return true;
+        }
+
+        uint64_t allocated = static_cast<uint64_t>(st.st_blocks) * STAT_BLOCK_SIZE;
+        if (st.st_nlink > 1) {
+            usage.linked.push_back(LinkedFile{st.st_dev, st.st_ino, static_cast<uint64_t>(st.st_size),
+                                              allocated, usage.directories.size()});
+            return false;
+        }
+        usage.current.apparentBytes += static_cast<uint64_t>(st.st_size);
+        usage.current.allocatedBytes += allocated;
+        usage.current.files++;
+        return false;
+    }, ParallelWalker::ResultHandler(), [&](int dirFd, const string& dirPath, unsigned worker) {
+        // The directory's own inode counts towards its own total, as with du
+        WorkerUsage& usage = begin(worker, dirPath);
+        struct stat st;
+        if (fstat(dirFd, &st) == 0) {
+            usage.current.apparentBytes += static_cast<uint64_t>(st.st_size);
+            usage.current.allocatedBytes += static_cast<uint64_t>(st.st_blocks) * STAT_BLOCK_SIZE;
+        }
+        usage.current.directories++;
+        usage.directories.push_back(std::move(usage.current));
+        usage.open = false;
+    });
+
+    // Gather every worker's directories, remembering where each worker's start
+    DiskUsageReport report;
+    vector<DiskUsageEntry> directories;
+    vector<LinkedFile> linked;
+    for (WorkerUsage& usage : workers) {
+        size_t offset = directories.size();
+        for (LinkedFile& file : usage.linked) {
+            file.directory += offset;
+            linked.push_back(file);
+        }
+        move(usage.directories.begin(), usage.directories.end(), back_inserter(directories));
+        report.mountPointsSkipped += usage.mountPointsSkipped;
+        report.errors += usage.errors;
+    }
+    report.unreadableDirectories = walker.unreadableDirectories();
+    report.firstError = walker.firstError();
+
+    // Each (device, inode) counts once, in the first directory it was found in
+    sort(linked.begin(), linked.end(), [](const LinkedFile& a, const LinkedFile& b) {
+        return a.device != b.device ? a.device < b.device : a.inode < b.inode;
+    });
+    for (size_t i = 0; i < linked.size(); ++i) {
+        if (i > 0 && linked[i].device == linked[i - 1].device && linked[i].inode == linked[i - 1].inode) {
+            report.hardLinksSkipped++;
+            continue;
+        }
+        DiskUsageEntry& dir = directories[linked[i].directory];
+        dir.apparentBytes += linked[i].apparentBytes;
+        dir.allocatedBytes += linked[i].allocatedBytes;
+        dir.files++;
+    }
+
+    // Roll totals up into parents, deepest first
+    unordered_map<string_view, size_t> byPath;
+    byPath.reserve(directories.size());
+    for (size_t i = 0; i < directories.size(); ++i) {
+        byPath.emplace(directories[i].path, i);
+    }
+    vector<size_t> order(directories.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&directories](size_t a, size_t b) {
+        return directories[a].path.size() > directories[b].path.size();
+    });
+    size_t rootIndex = directories.size();
+    for (size_t i : order) {
+        const DiskUsageEntry& child = directories[i];
+        if (child.path == root) {
+            rootIndex = i;
+            continue;
+        }
+        auto parent = byPath.find(parentOf(child.path));
+        if (parent == byPath.end()) {
+            continue;
+        }
+        DiskUsageEntry& into = directories[parent->second];
+        into.apparentBytes += child.apparentBytes;
+        into.allocatedBytes += child.allocatedBytes;
+        into.files += child.files;
+        into.directories += child.directories;
+    }
+    if (rootIndex < directories.size()) {
+        report.total = directories[rootIndex];
+    } else {
+        report.total.path = root;
+    }
+
+    // Largest subtrees below the root
+    order.erase(remove(order.begin(), order.end(), rootIndex), order.end());
+    size_t count = min(top, order.size());
+    partial_sort(order.begin(), order.begin() + count, order.end(), [&directories](size_t a, size_t b) {
+        return directories[a].allocatedBytes > directories[b].allocatedBytes;
+    });
+    for (size_t i = 0; i < count; ++i) {
+        report.largest.push_back(std::move(directories[order[i]]));
+    }
+
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return report;
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef DISK_USAGE_H
+#define DISK_USAGE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Space used by one directory tree
+ */
+struct DiskUsageEntry {
+    std::string path;             ///< Directory
+    uint64_t apparentBytes = 0;   ///< Sum of file sizes (st_size)
+    uint64_t allocatedBytes = 0;  ///< Space actually allocated (st_blocks * 512)
+    uint64_t files = 0;           ///< Non-directory entries
+    uint64_t directories = 0;     ///< Directories, including this one
+};
+
+/**
+ * @brief Result of a disk usage scan
+ */
+struct DiskUsageReport {
+    DiskUsageEntry total;                  ///< The whole tree
+    std::vector<DiskUsageEntry> largest;   ///< Largest subtrees by allocated size, largest first
+    uint64_t hardLinksSkipped = 0;         ///< Extra links to files already counted
+    uint64_t mountPointsSkipped = 0;       ///< Directories on another file system, not entered
+    uint64_t errors = 0;                   ///< Entries that could not be stat()ed
+    uint64_t unreadableDirectories = 0;    ///< Directories that could not be opened or read
+    std::string firstError;                ///< First of them, as "path: reason"
+    double seconds = 0.0;                  ///< Wall time
+};
+
+/**
+ * @brief Parallel recursive disk usage (du) on top of ParallelWalker
+ *
+ * Every entry is stat()ed relative to its directory's descriptor by the
+ * worker that reads the directory, and its size is added to that
+ * directory's own totals in the worker's private accumulator, so the walk
+ * takes no locks beyond the walker's own. Files with more than one link
+ * are set aside per worker and counted once per (device, inode) after the
+ * walk. Directory totals are then rolled up into their parents, deepest
+ * first: a child's path is always longer than its parent's, so sorting by
+ * path length is enough.
+ */
+class DiskUsageScanner {
+public:
+    /**
+     * @brief Construct a scanner
+     * @param threads Walker threads (0 = hardware concurrency)
+     * @param oneFileSystem Don't descend into directories on other file systems
+     */
+    explicit DiskUsageScanner(unsigned threads = 0, bool oneFileSystem = true);
+
+    /**
+     * @brief Measure a directory tree
+     * @param root Directory to measure
+     * @param top Number of largest subtrees to report
+     * @return Totals and the largest subtrees; per-entry failures are counted, not thrown
+     * @throws std::runtime_error if root cannot be opened
+     */
+    DiskUsageReport scan(const std::string& root, size_t top = 10) const;
+
+private:
+    unsigned threads;    ///< Walker threads
+    bool oneFileSystem;  ///< Stay on the root's file system
+};
+
+#endif // DISK_USAGE_H
\ No newline at end of file
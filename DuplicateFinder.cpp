@@ -0,0 +1,490 @@
+#include "DuplicateFinder.h"
+#include "ParallelWalker.h"
+#include "ThreadPool.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+/// Chunk size of streaming reads (full hash, byte compare)
+constexpr size_t READ_CHUNK = 1024 * 1024;
+
+// ==================== XXH64 ====================
+
+constexpr uint64_t PRIME1 = 11400714785074694791ull;
+constexpr uint64_t PRIME2 = 14029467366897019727ull;
+constexpr uint64_t PRIME3 = 1609587929392839161ull;
+constexpr uint64_t PRIME4 = 9650029242287828579ull;
+constexpr uint64_t PRIME5 = 2870177450012600261ull;
+
+uint64_t rotl(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+uint64_t read64(const unsigned char* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+uint32_t read32(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    return rotl(acc, 31) * PRIME1;
+}
+
+uint64_t mergeRound(uint64_t acc, uint64_t value) {
+    acc ^= round64(0, value);
+    return acc * PRIME1 + PRIME4;
+}
+
+/**
+ * @brief Streaming XXH64, so a file can be hashed in pieces
+ */
+class Xxh64 {
+public:
+    explicit Xxh64(uint64_t seed = 0)
+        : lanes{seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1}, seed(seed) {}
+
+    void update(const void* data, size_t length) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        const unsigned char* end = p + length;
+        total += length;
+
+        if (buffered + length < sizeof(buffer)) {
+            memcpy(buffer + buffered, p, length);
+            buffered += length;
+            return;
+        }
+        if (buffered > 0) {
+            size_t fill = sizeof(buffer) - buffered;
+            memcpy(buffer + buffered, p, fill);
+            consume(buffer);
+            p += fill;
+            buffered = 0;
+        }
+        for (; end - p >= 32; p += 32) {
+            consume(p);
+        }
+        buffered = static_cast<size_t>(end - p);
+        memcpy(buffer, p, buffered);
+    }
+
+    uint64_t digest() const {
+        uint64_t h;
+        if (total >= 32) {
+            h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+            for (uint64_t lane : lanes) {
+                h = mergeRound(h, lane);
+            }
+        } else {
+            h = seed + PRIME5;
+        }
+        h += total;
+
+        const unsigned char* p = buffer;
+        const unsigned char* end = buffer + buffered;
+        for (; end - p >= 8; p += 8) {
+            h ^= round64(0, read64(p));
+            h = rotl(h, 27) * PRIME1 + PRIME4;
+        }
+        if (end - p >= 4) {
+            h ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+            h = rotl(h, 23) * PRIME2 + PRIME3;
+            p += 4;
+        }
+        for (; p < end; ++p) {
+            h ^= *p * PRIME5;
+            h = rotl(h, 11) * PRIME1;
+        }
+
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        h ^= h >> 32;
+        return h;
+    }
+
+private:
+    void consume(const unsigned char* stripe) {
+        for (int i = 0; i < 4; ++i) {
+            lanes[i] = round64(lanes[i], read64(stripe + 8 * i));
+        }
+    }
+
+    uint64_t lanes[4];
+    uint64_t seed;
+    uint64_t total = 0;
+    unsigned char buffer[32];
+    size_t buffered = 0;
+};
+
+// ==================== Candidates ====================
+
+/**
+ * @brief A file that may have a duplicate
+ */
+struct Candidate {
+    string path;
+    uint64_t size;
+    dev_t device;
+    ino_t inode;
+    uint64_t key = 0;       ///< Hash from the latest stage
+    bool readable = true;   ///< Cleared when a stage fails to read the file
+};
+
+struct FdGuard {
+    int fd;
+    ~FdGuard() { if (fd >= 0) ::close(fd); }
+};
+
+/**
+ * @brief pread exactly length bytes, retrying short reads
+ * @return false on error or if the file ended early (it changed under us)
+ */
+bool readFully(int fd, void* into, size_t length, uint64_t offset) {
+    char* out = static_cast<char*>(into);
+    while (length > 0) {
+        ssize_t got = pread(fd, out, length, static_cast<off_t>(offset));
+        FE_COUNT_SYSCALL(Read, 1);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        FE_COUNT_BYTES_READ(static_cast<uint64_t>(got));
+        out += got;
+        length -= static_cast<size_t>(got);
+        offset += static_cast<uint64_t>(got);
+    }
+    return true;
+}
+
+int openFile(const string& path) {
+    FE_COUNT_SYSCALL(Open, 1);
+    return ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+}
+
+/**
+ * @brief Hash the first and last EDGE_SIZE bytes (the whole file if that covers it)
+ */
+bool hashEdges(Candidate& file, vector<char>& buffer, uint64_t& bytesRead) {
+    FdGuard fd{openFile(file.path)};
+    if (fd.fd < 0) {
+        return false;
+    }
+    const size_t edge = DuplicateFinder::EDGE_SIZE;
+    size_t length = static_cast<size_t>(min<uint64_t>(file.size, 2 * edge));
+    buffer.resize(max(buffer.size(), length));
+    if (file.size <= 2 * edge) {
+        if (!readFully(fd.fd, buffer.data(), length, 0)) {
+            return false;
+        }
+    } else if (!readFully(fd.fd, buffer.data(), edge, 0) ||
+               !readFully(fd.fd, buffer.data() + edge, edge, file.size - edge)) {
+        return false;
+    }
+    bytesRead += length;
+    file.key = DuplicateFinder::hash64(buffer.data(), length);
+    return true;
+}
+
+/**
+ * @brief Hash the whole file, streamed in chunks
+ *
+ * Reading rather than mmap() keeps a file that shrinks mid-hash from
+ * killing the process with SIGBUS; the read fails and the file is skipped.
+ */
+bool hashContents(Candidate& file, vector<char>& buffer, uint64_t& bytesRead) {
+    FdGuard fd{openFile(file.path)};
+    if (fd.fd < 0) {
+        return false;
+    }
+    size_t size = static_cast<size_t>(file.size);
+    struct stat st;
+    if (fstat(fd.fd, &st) != 0 || static_cast<uint64_t>(st.st_size) != file.size) {
+        return false;  // Changed since the walk
+    }
+
+    buffer.resize(max(buffer.size(), min(size, READ_CHUNK)));
+    Xxh64 state;
+    for (uint64_t offset = 0; offset < size;) {
+        size_t length = static_cast<size_t>(min<uint64_t>(size - offset, READ_CHUNK));
+        if (!readFully(fd.fd, buffer.data(), length, offset)) {
+            return false;
+        }
+        state.update(buffer.data(), length);
+        offset += length;
+    }
+    bytesRead += size;
+    file.key = state.digest();
+    return true;
+}
+
+/**
+ * @brief Compare two files of the given size byte by byte
+ * @return 1 if identical, 0 if different, -1 if either can't be read
+ */
+int compareContents(const string& a, const string& b, uint64_t size,
+                    vector<char>& bufferA, vector<char>& bufferB, uint64_t& bytesRead) {
+    FdGuard fdA{openFile(a)};
+    FdGuard fdB{openFile(b)};
+    if (fdA.fd < 0 || fdB.fd < 0) {
+        return -1;
+    }
+    size_t chunk = static_cast<size_t>(min<uint64_t>(size, READ_CHUNK));
+    bufferA.resize(max(bufferA.size(), chunk));
+    bufferB.resize(max(bufferB.size(), chunk));
+    for (uint64_t offset = 0; offset < size;) {
+        size_t length = static_cast<size_t>(min<uint64_t>(size - offset, READ_CHUNK));
+        if (!readFully(fdA.fd, bufferA.data(), length, offset) ||
+            !readFully(fdB.fd, bufferB.data(), length, offset)) {
+            return -1;
+        }
+        bytesRead += 2 * length;
+        if (memcmp(bufferA.data(), bufferB.data(), length) != 0) {
+            return 0;
+        }
+        offset += length;
+    }
+    return 1;
+}
+
+/**
+ * @brief [begin, end) ranges of candidates with equal size and key
+ */
+vector<pair<size_t, size_t>> groupsOf(const vector<Candidate>& files) {
+    vector<pair<size_t, size_t>> groups;
+    for (size_t begin = 0; begin < files.size();) {
+        size_t end = begin + 1;
+        while (end < files.size() && files[end].size == files[begin].size && files[end].key == files[begin].key) {
+            ++end;
+        }
+        if (end - begin > 1) {
+            groups.emplace_back(begin, end);
+        }
+        begin = end;
+    }
+    return groups;
+}
+
+/**
+ * @brief Drop unreadable files, then every file whose (size, key) is unique
+ * @return Number of files kept
+ */
+size_t keepGroups(vector<Candidate>& files, uint64_t& unreadable) {
+    size_t before = files.size();
+    files.erase(remove_if(files.begin(), files.end(), [](const Candidate& file) { return !file.readable; }),
+                files.end());
+    unreadable += before - files.size();
+
+    sort(files.begin(), files.end(), [](const Candidate& a, const Candidate& b) {
+        return a.size != b.size ? a.size < b.size : a.key < b.key;
+    });
+    vector<Candidate> kept;
+    for (const auto& group : groupsOf(files)) {
+        move(files.begin() + group.first, files.begin() + group.second, back_inserter(kept));
+    }
+    files.swap(kept);
+    return files.size();
+}
+
+} // namespace
+
+DuplicateFinder::DuplicateFinder(unsigned threads, bool verify, uint64_t minSize)
+    : threads(threads != 0 ? threads : max(1u, thread::hardware_concurrency())),
+      verify(verify), minSize(max<uint64_t>(minSize, 1)) {}
+
+uint64_t DuplicateFinder::hash64(const void* data, size_t length, uint64_t seed) {
+    Xxh64 state(seed);
+    state.update(data, length);
+    return state.digest();
+}
+
+DuplicateReport DuplicateFinder::find(const string& rootPath) const {
+    auto start = chrono::steady_clock::now();
+    string root = rootPath;
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    struct stat rootStat;
+    if (::stat(root.c_str(), &rootStat) != 0) {
+        throw runtime_error("Cannot access: " + root + ": " + strerror(errno));
+    }
+    if (!S_ISDIR(rootStat.st_mode)) {
+        throw runtime_error("Not a directory: " + root);
+    }
+    DuplicateReport report;
+    DuplicateStats& stats = report.stats;
+
+    // Stage 1: every regular file with its size and identity
+    ParallelWalker walker(threads);
+    vector<vector<Candidate>> perWorker(walker.threadCount());
+    walker.walk(root, [&](const WalkEntry& entry) {
+        if (entry.type == DT_DIR) {
+            return true;
+        }
+        if (entry.type != DT_REG) {
+            return false;  // Symlinks and special files are never duplicates
+        }
+        struct stat st;
+        if (fstatat(entry.dirFd, entry.name, &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(st.st_mode)) {
+            return false;
+        }
+        uint64_t size = static_cast<uint64_t>(st.st_size);
+        if (size >= minSize) {
+            perWorker[entry.worker].push_back(Candidate{entry.path(), size, st.st_dev, st.st_ino});
+        }
+        return false;
+    });
+
+    stats.unreadableDirectories = walker.unreadableDirectories();
+    stats.firstError = walker.firstError();
+
+    vector<Candidate> files;
+    for (vector<Candidate>& found : perWorker) {
+        move(found.begin(), found.end(), back_inserter(files));
+        found = vector<Candidate>();
+    }
+    stats.filesScanned = files.size();
+
+    // Hard links share their contents by definition: keep one name per inode
+    sort(files.begin(), files.end(), [](const Candidate& a, const Candidate& b) {
+        if (a.size != b.size) return a.size < b.size;
+        if (a.device != b.device) return a.device < b.device;
+        if (a.inode != b.inode) return a.inode < b.inode;
+        return a.path < b.path;
+    });
+    auto sameInode = [](const Candidate& a, const Candidate& b) {
+        return a.device == b.device && a.inode == b.inode;
+    };
+    size_t before = files.size();
+    files.erase(unique(files.begin(), files.end(), sameInode), files.end());
+    stats.hardLinksSkipped = before - files.size();
+    stats.sameSize = keepGroups(files, stats.unreadable);
+
+    // Hashing runs on a pool; each thread reuses its own buffers
+    atomic<uint64_t> bytesRead{0};
+    auto forEachFile = [this, &bytesRead](size_t count, const function<void(size_t, vector<char>&, uint64_t&)>& fn) {
+        auto work = [&](size_t i) {
+            thread_local vector<char> buffer;
+            uint64_t read = 0;
+            fn(i, buffer, read);
+            bytesRead += read;
+        };
+        if (threads < 2 || count < 2) {
+            for (size_t i = 0; i < count; ++i) work(i);
+            return;
+        }
+        ThreadPool pool(threads - 1);  // The calling thread is the last worker
+        pool.parallelFor(count, work);
+    };
+
+    // Stage 2: first and last 4 KB
+    forEachFile(files.size(), [&files](size_t i, vector<char>& buffer, uint64_t& read) {
+        files[i].readable = hashEdges(files[i], buffer, read);
+    });
+    stats.sameEdges = keepGroups(files, stats.unreadable);
+
+    // Stage 3: full contents, for files the edges didn't cover
+    forEachFile(files.size(), [&files](size_t i, vector<char>& buffer, uint64_t& read) {
+        if (files[i].size > 2 * EDGE_SIZE) {
+            files[i].readable = hashContents(files[i], buffer, read);
+        }
+    });
+    stats.sameHash = keepGroups(files, stats.unreadable);
+
+    // Each (size, hash) run is one group
+    vector<vector<size_t>> groups;
+    for (const auto& run : groupsOf(files)) {
+        vector<size_t> members(run.second - run.first);
+        for (size_t i = run.first; i < run.second; ++i) {
+            members[i - run.first] = i;
+        }
+        groups.push_back(std::move(members));
+    }
+
+    // Stage 4: split groups into files that really are byte-identical
+    if (verify) {
+        vector<vector<vector<size_t>>> split(groups.size());
+        atomic<uint64_t> unreadable{0};
+        forEachFile(groups.size(), [&](size_t g, vector<char>& buffer, uint64_t& read) {
+            thread_local vector<char> other;
+            vector<vector<size_t>>& classes = split[g];
+            for (size_t member : groups[g]) {
+                bool placed = false;
+                for (vector<size_t>& same : classes) {
+                    int result = compareContents(files[same.front()].path, files[member].path,
+                                                 files[member].size, buffer, other, read);
+                    if (result < 0) {
+                        unreadable++;
+                        placed = true;  // Leave it out
+                        break;
+                    }
+                    if (result == 1) {
+                        same.push_back(member);
+                        placed = true;
+                        break;
+                    }
+                }
+                if (!placed) {
+                    classes.push_back({member});
+                }
+            }
+        });
+        groups.clear();
+        for (auto& classes : split) {
+            for (auto& same : classes) {
+                stats.verified += same.size();
+                if (same.size() > 1) {
+                    groups.push_back(std::move(same));
+                }
+            }
+        }
+        stats.unreadable += unreadable;
+    }
+    stats.bytesRead = bytesRead;
+
+    for (const vector<size_t>& members : groups) {
+        DuplicateGroup group;
+        group.size = files[members.front()].size;
+        for (size_t i : members) {
+            group.paths.push_back(std::move(files[i].path));
+        }
+        sort(group.paths.begin(), group.paths.end());
+        report.groups.push_back(std::move(group));
+    }
+    sort(report.groups.begin(), report.groups.end(), [](const DuplicateGroup& a, const DuplicateGroup& b) {
+        if (a.wastedBytes() != b.wastedBytes()) return a.wastedBytes() > b.wastedBytes();
+        return a.paths.front() < b.paths.front();
+    });
+
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return report;
+}
\ No newline at end of file
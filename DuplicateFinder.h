@@ -0,0 +1,93 @@
+#ifndef DUPLICATE_FINDER_H
+#define DUPLICATE_FINDER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Files with identical contents
+ */
+struct DuplicateGroup {
+    uint64_t size = 0;               ///< Size of each file
+    std::vector<std::string> paths;  ///< Every copy, sorted
+
+    /**
+     * @brief Bytes that could be reclaimed by keeping a single copy
+     */
+    uint64_t wastedBytes() const { return paths.empty() ? 0 : size * (paths.size() - 1); }
+};
+
+/**
+ * @brief How many files survived each stage of a duplicate search
+ */
+struct DuplicateStats {
+    uint64_t filesScanned = 0;     ///< Regular files found by the walk
+    uint64_t hardLinksSkipped = 0; ///< Extra names of a file already seen
+    uint64_t sameSize = 0;         ///< Files sharing their size with another file
+    uint64_t sameEdges = 0;        ///< ... and their first and last 4 KB
+    uint64_t sameHash = 0;         ///< ... and their full-content hash
+    uint64_t verified = 0;         ///< Files compared byte by byte (0 unless verifying)
+    uint64_t unreadable = 0;       ///< Candidates that could not be read
+    uint64_t unreadableDirectories = 0; ///< Directories the walk could not open or read
+    std::string firstError;        ///< First of them, as "path: reason"
+    uint64_t bytesRead = 0;        ///< File data read by the hashing stages
+    double seconds = 0.0;          ///< Wall time
+};
+
+/**
+ * @brief Result of a duplicate search
+ */
+struct DuplicateReport {
+    std::vector<DuplicateGroup> groups;  ///< Largest waste first
+    DuplicateStats stats;
+};
+
+/**
+ * @brief Finds files with identical contents in a directory tree
+ *
+ * The search is a pipeline in which every stage only looks at what the
+ * previous one could not tell apart:
+ *   1. a ParallelWalker collects regular files and groups them by size;
+ *   2. files sharing a size are told apart by a hash of their first and
+ *      last 4 KB, which settles small files completely;
+ *   3. the survivors get a full-content XXH64, computed over large
+ *      streaming reads;
+ *   4. optionally, every file of a group is compared byte by byte with
+ *      the group's first file.
+ * Stages 2-4 spread their files over a ThreadPool.
+ */
+class DuplicateFinder {
+public:
+    /// Bytes hashed at each end of a file in stage 2
+    static constexpr size_t EDGE_SIZE = 4096;
+
+    /**
+     * @brief Construct a finder
+     * @param threads Worker threads for the walk and the hashing (0 = hardware concurrency)
+     * @param verify Compare the contents of every group byte by byte
+     * @param minSize Ignore files smaller than this (empty files are all "identical")
+     */
+    explicit DuplicateFinder(unsigned threads = 0, bool verify = false, uint64_t minSize = 1);
+
+    /**
+     * @brief Search a tree for duplicate files
+     * @param root Directory to search
+     * @return Groups of identical files and per-stage counters
+     * @throws std::runtime_error if root cannot be opened
+     */
+    DuplicateReport find(const std::string& root) const;
+
+    /**
+     * @brief XXH64 of a memory block
+     */
+    static uint64_t hash64(const void* data, size_t length, uint64_t seed = 0);
+
+private:
+    unsigned threads;  ///< Walker and hashing threads
+    bool verify;       ///< Run the byte-compare stage
+    uint64_t minSize;  ///< Smallest file considered
+};
+
+#endif // DUPLICATE_FINDER_H
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "FileCopier.h"
+#include "Metrics.h"
+#include "JobControl.h"
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+using namespace std;
+
+namespace {
+
+/// Buffer size for the read/write fallback
+constexpr size_t COPY_BUFFER_SIZE = 1024 * 1024;
+
+/// Largest chunk handed to copy_file_range/sendfile in one call
+constexpr size_t KERNEL_CHUNK_SIZE = 1u << 30;
+
+/// Largest chunk for a job, so cancellation and progress come a few times per second
+constexpr size_t JOB_CHUNK_SIZE = 64u << 20;
+
+struct FdGuard {
+    int fd;
+    ~FdGuard() { if (fd >= 0) ::close(fd); }
+};
+
+/**
+ * @brief Errors meaning "this strategy can't be used here", as opposed to real I/O failures
+ */
+bool strategyUnsupported(int err) {
+    return err == EXDEV || err == EINVAL || err == ENOSYS || err == EOPNOTSUPP ||
+           err == ENOTSUP || err == EBADF || err == ETXTBSY || err == EPERM;
+}
+
+runtime_error copyError(const char* what) {
+    return runtime_error(string(what) + ": " + strerror(errno));
+}
+
+/**
+ * @brief Write a whole buffer with pwrite, retrying short writes
+ */
+void writeAll(int fd, const char* data, size_t length, off_t offset) {
+    while (length > 0) {
+        ssize_t n = pwrite(fd, data, length, offset);
+        FE_COUNT_SYSCALL(Write, 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw copyError("write failed");
+        }
+        data += n;
+        length -= n;
+        offset += n;
+    }
+}
+
+/**
+ * @brief Copy [offset, offset + length) with the current strategy, degrading as needed
+ * @param control Job to report progress to and stop for, or null
+ */
+void copyRange(int srcFd, int dstFd, off_t offset, uint64_t length,
+               CopyStrategy& strategy, unique_ptr<char[]>& buffer, JobControl* control) {
+    off_t inOff = offset;
+    off_t outOff = offset;
+
+    while (length > 0) {
+        size_t chunk = static_cast<size_t>(min<uint64_t>(length, control ? JOB_CHUNK_SIZE : KERNEL_CHUNK_SIZE));
+        if (control) {
+            control->checkpoint();
+        }
+        ssize_t n = 0;
+
+        switch (strategy) {
+            case CopyStrategy::Reflink:
+            case CopyStrategy::CopyFileRange:
+                strategy = CopyStrategy::CopyFileRange;
+                n = copy_file_range(srcFd, &inOff, dstFd, &outOff, chunk, 0);
+                FE_COUNT_SYSCALL(Copy, 1);
+                if (n < 0 && strategyUnsupported(errno)) {
+                    strategy = CopyStrategy::Sendfile;
+                    continue;
+                }
+                break;
+
+            case CopyStrategy::Sendfile:
+                if (lseek(dstFd, outOff, SEEK_SET) < 0) {
+                    throw copyError("seek failed");
+                }
+                n = sendfile(dstFd, srcFd, &inOff, chunk);
+                FE_COUNT_SYSCALL(Copy, 1);
+                if (n < 0 && strategyUnsupported(errno)) {
+                    strategy = CopyStrategy::ReadWrite;
+                    continue;
+                }
+                if (n > 0) outOff += n;
+                break;
+
+            case CopyStrategy::ReadWrite:
+                if (!buffer) {
+                    buffer.reset(new char[COPY_BUFFER_SIZE]);
+                }
+                n = pread(srcFd, buffer.get(), min(chunk, COPY_BUFFER_SIZE), inOff);
+                FE_COUNT_SYSCALL(Read, 1);
+                if (n > 0) {
+                    writeAll(dstFd, buffer.get(), n, outOff);
+                    inOff += n;
+                    outOff += n;
+                }
+                break;
+        }
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw copyError("copy failed");
+        }
+        if (n == 0) {
+            break;  // Source shrank underneath us
+        }
+        FE_COUNT_BYTES_READ(n);
+        FE_COUNT_BYTES_WRITTEN(n);
+        if (control) {
+            control->addDone(static_cast<uint64_t>(n), 0);
+        }
+        length -= n;
+    }
+}
+
+} // namespace
+
+double CopyResult::throughputMBps() const {
+    return seconds > 0 ? (bytes / (1024.0 * 1024.0)) / seconds : 0.0;
+}
+
+const char* FileCopier::strategyName(CopyStrategy strategy) {
+    switch (strategy) {
+        case CopyStrategy::Reflink:       return "reflink";
+        case CopyStrategy::CopyFileRange: return "copy_file_range";
+        case CopyStrategy::Sendfile:      return "sendfile";
+        case CopyStrategy::ReadWrite:     return "read/write";
+    }
+    return "unknown";
+}
+
+CopyResult FileCopier::copyFd(int srcFd, int dstFd, uint64_t size, bool sparse) {
+    auto start = chrono::steady_clock::now();
+    CopyResult result{CopyStrategy::Reflink, size, 0.0, false};
+    JobControl* control = JobControl::current();
+
+    // A reflink shares extents (holes included) and costs one ioctl either way
+    FE_COUNT_SYSCALL(Copy, 1);
+    if (ioctl(dstFd, FICLONE, srcFd) == 0) {
+        if (control) {
+            control->addDone(size, 0);
+        }
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    posix_fadvise(srcFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    CopyStrategy strategy = CopyStrategy::CopyFileRange;
+    unique_ptr<char[]> buffer;
+
+    if (sparse) {
+        off_t pos = 0;
+        while (static_cast<uint64_t>(pos) < size) {
+            off_t data = lseek(srcFd, pos, SEEK_DATA);
+            if (data < 0) {
+                if (errno == ENXIO) {
+                    break;  // Only a hole remains
+                }
+                // No SEEK_DATA support: copy the rest densely
+                copyRange(srcFd, dstFd, pos, size - pos, strategy, buffer, control);
+                pos = size;
+                break;
+            }
+            off_t hole = lseek(srcFd, data, SEEK_HOLE);
+            if (hole < 0 || static_cast<uint64_t>(hole) > size) {
+                hole = size;
+            }
+            if (control) {
+                control->addDone(static_cast<uint64_t>(data - pos), 0);  // Holes count as done
+            }
+            copyRange(srcFd, dstFd, data, hole - data, strategy, buffer, control);
+            pos = hole;
+        }
+        if (control) {
+            control->addDone(size - static_cast<uint64_t>(pos), 0);
+        }
+        // Extend over any trailing hole
+        if (ftruncate(dstFd, size) != 0) {
+            throw copyError("truncate failed");
+        }
+        result.sparse = true;
+    } else {
+        copyRange(srcFd, dstFd, 0, size, strategy, buffer, control);
+    }
+
+    result.strategy = strategy;
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+CopyResult FileCopier::copy(const string& source, const string& destination) {
+    FdGuard src{::open(source.c_str(), O_RDONLY | O_CLOEXEC)};
+    FE_COUNT_SYSCALL(Open, 1);
+    if (src.fd < 0) {
+        throw runtime_error("Cannot open source: " + source + ": " + strerror(errno));
+    }
+    struct stat srcStat;
+    if (fstat(src.fd, &srcStat) != 0) {
+        throw runtime_error("Cannot stat source: " + source + ": " + strerror(errno));
+    }
+    if (!S_ISREG(srcStat.st_mode)) {
+        throw runtime_error("Not a regular file: " + source);
+    }
+
+    // O_TRUNC on the source itself would destroy it
+    struct stat dstStat;
+    if (stat(destination.c_str(), &dstStat) == 0 &&
+        dstStat.st_dev == srcStat.st_dev && dstStat.st_ino == srcStat.st_ino) {
+        throw runtime_error("Source and destination are the same file: " + source);
+    }
+
+    mode_t mode = srcStat.st_mode & 07777;
+    FdGuard dst{::open(destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode)};
+    FE_COUNT_SYSCALL(Open, 1);
+    if (dst.fd < 0) {
+        throw runtime_error("Cannot open destination: " + destination + ": " + strerror(errno));
+    }
+    fchmod(dst.fd, mode);  // not subject to the umask, unlike open()
+
+    uint64_t size = static_cast<uint64_t>(srcStat.st_size);
+    bool sparse = static_cast<uint64_t>(srcStat.st_blocks) * 512 < size;
+    JobControl* control = JobControl::current();
+    if (!control) {
+        return copyFd(src.fd, dst.fd, size, sparse);
+    }
+    control->addTotal(size, 1);
+    try {
+        CopyResult result = copyFd(src.fd, dst.fd, size, sparse);
+        control->addDone(0, 1);
+        return result;
+    } catch (const JobCancelled&) {
+        ::unlink(destination.c_str());  // Don't leave a truncated copy behind
+        throw;
+    }
+}
\ No newline at end of file
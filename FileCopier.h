@@ -0,0 +1,75 @@
+#ifndef FILE_COPIER_H
+#define FILE_COPIER_H
+
+#include <string>
+#include <cstdint>
+
+/**
+ * @brief Data path used to copy a file
+ */
+enum class CopyStrategy {
+    Reflink,        ///< FICLONE: extents shared, no data moved
+    CopyFileRange,  ///< copy_file_range: in-kernel copy (may offload to the device)
+    Sendfile,       ///< sendfile: in-kernel copy through the page cache
+    ReadWrite       ///< Userspace read/write loop with a large buffer
+};
+
+/**
+ * @brief Outcome of a single file copy
+ */
+struct CopyResult {
+    CopyStrategy strategy;  ///< Strategy that moved the data
+    uint64_t bytes;         ///< Logical file size copied
+    double seconds;         ///< Wall time spent
+    bool sparse;            ///< True if holes were preserved
+
+    /**
+     * @brief Throughput in MB/s (logical bytes over wall time)
+     */
+    double throughputMBps() const;
+};
+
+/**
+ * @brief Kernel-accelerated copy of regular files
+ *
+ * Strategies are tried from cheapest to most general: a FICLONE reflink
+ * (instant on btrfs/xfs, fails fast elsewhere), copy_file_range,
+ * sendfile, and finally a read/write loop with posix_fadvise hints. A
+ * strategy is only abandoned if it fails before moving any data. Sparse
+ * sources are copied segment by segment using SEEK_DATA/SEEK_HOLE so the
+ * holes survive.
+ *
+ * On a job's thread (JobControl::current()) data moves in 64 MB chunks,
+ * each counted into the job's progress and preceded by a cancellation point.
+ */
+class FileCopier {
+public:
+    /**
+     * @brief Copy a regular file, replacing the destination if it exists
+     * @param source Source file path
+     * @param destination Destination file path
+     * @return Strategy used, bytes copied and timing
+     * @throws std::runtime_error if the copy fails
+     * @throws JobCancelled if the job was cancelled (the partial destination is removed)
+     */
+    static CopyResult copy(const std::string& source, const std::string& destination);
+
+    /**
+     * @brief Copy between two open descriptors (destination must be empty)
+     * @param srcFd Source descriptor, positioned anywhere
+     * @param dstFd Destination descriptor
+     * @param size Number of bytes to copy
+     * @param sparse If true, preserve holes in the source
+     * @return Strategy used, bytes copied and timing
+     * @throws std::runtime_error if the copy fails
+     * @throws JobCancelled if the job was cancelled
+     */
+    static CopyResult copyFd(int srcFd, int dstFd, uint64_t size, bool sparse);
+
+    /**
+     * @brief Human-readable name of a strategy
+     */
+    static const char* strategyName(CopyStrategy strategy);
+};
+
+#endif // FILE_COPIER_H
\ No newline at end of file
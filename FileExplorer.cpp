@@ -6,38 +6,105 @@ FileExplorer::FileExplorer() {
     // Constructor - nothing to initialize here as fileOps is automatically constructed
 }
 
+FileExplorer::FileExplorer(const string& directory) : fileOps(directory) {}
+
 void FileExplorer::run() {
     // Main loop is handled in main.cpp
 }
 
-void FileExplorer::listDirectory(const string& path) {
-    fileOps.listDirectory(path);
+size_t FileExplorer::listDirectory(const string& path, const ListingHandler& onBatch,
+                                   const SortOptions& sort) {
+    return fileOps.listDirectory(path, onBatch, sort);
 }
 
 void FileExplorer::changeDirectory(const string& path) {
     fileOps.changeDirectory(path);
 }
 
-void FileExplorer::createDirectory(const string& dirName) {
-    fileOps.createDirectory(dirName);
+bool FileExplorer::createDirectory(const string& dirName, bool createParents) {
+    return fileOps.createDirectory(dirName, createParents);
+}
+
+bool FileExplorer::remove(const string& path, bool background) {
+    return fileOps.remove(path, background);
+}
+
+bool FileExplorer::copyFile(const string& source, const string& destination) {
+    return fileOps.copyFile(source, destination);
+}
+
+bool FileExplorer::moveFile(const string& source, const string& destination) {
+    return fileOps.moveFile(source, destination);
+}
+
+PathBatch FileExplorer::expandPaths(const vector<string>& patterns) const {
+    return fileOps.expandPaths(patterns);
 }
 
-void FileExplorer::remove(const string& path) {
-    fileOps.remove(path);
+bool FileExplorer::removePaths(const PathBatch& targets, bool background) {
+    return fileOps.removePaths(targets, background);
 }
 
-void FileExplorer::copyFile(const string& source, const string& destination) {
-    fileOps.copyFile(source, destination);
+bool FileExplorer::movePaths(const PathBatch& sources, const string& destination) {
+    return fileOps.movePaths(sources, destination);
 }
 
-void FileExplorer::moveFile(const string& source, const string& destination) {
-    fileOps.moveFile(source, destination);
+bool FileExplorer::copyPaths(const PathBatch& sources, const string& destination) {
+    return fileOps.copyPaths(sources, destination);
 }
 
 void FileExplorer::searchFile(const string& fileName) {
     fileOps.searchFile(fileName);
 }
 
+vector<string> FileExplorer::findInFiles(const string& searchString, const string& filePattern) {
+    return fileOps.findInFiles(searchString, filePattern);
+}
+
+IndexStats FileExplorer::buildIndex(const string& path) {
+    return fileOps.buildIndex(path);
+}
+
+IndexStats FileExplorer::refreshIndex() {
+    return fileOps.refreshIndex();
+}
+
+IndexStats FileExplorer::indexStats() const {
+    return fileOps.indexStats();
+}
+
+DiskUsageReport FileExplorer::diskUsage(const string& path, size_t top) const {
+    return fileOps.diskUsage(path, top);
+}
+
+unique_ptr<FileViewer> FileExplorer::openViewer(const string& fileName) const {
+    return fileOps.openViewer(fileName);
+}
+
+void FileExplorer::writeFile(const string& fileName, const string& content, const WriteOptions& options) {
+    fileOps.writeFile(fileName, content, options);
+}
+
+DuplicateReport FileExplorer::findDuplicates(const string& path, bool verify) const {
+    return fileOps.findDuplicates(path, verify);
+}
+
+DirectoryCacheStats FileExplorer::directoryCacheStats() const {
+    return fileOps.directoryCacheStats();
+}
+
+void FileExplorer::clearDirectoryCache() {
+    fileOps.clearDirectoryCache();
+}
+
+string FileExplorer::setIoBackend(const string& name) {
+    return fileOps.setIoBackend(name);
+}
+
+void FileExplorer::setInteractive(bool enabled) {
+    fileOps.setInteractive(enabled);
+}
+
 string FileExplorer::getCurrentPath() const {
     return fileOps.getCurrentPath();
 }
\ No newline at end of file
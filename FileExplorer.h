@@ -2,6 +2,7 @@
 #define FILE_EXPLORER_H
 
 #include <string>
+#include <vector>
 #include "FileOperations.h"
 
 using namespace std;
@@ -19,6 +20,12 @@ public:
      */
     FileExplorer();
 
+    /**
+     * @brief Start in a given directory instead of the process's working directory
+     * @param directory Absolute, canonical path (e.g. another explorer's getCurrentPath())
+     */
+    explicit FileExplorer(const string& directory);
+
     /**
      * @brief Main application loop
      */
@@ -27,8 +34,12 @@ public:
     /**
      * @brief List contents of a directory
      * @param path Path to list (defaults to current directory if empty)
+     * @param onBatch Receives entries in batches as the directory is read
+     * @param sort Order of the listing
+     * @return Number of entries listed
      */
-    void listDirectory(const string& path = "");
+    size_t listDirectory(const string& path, const ListingHandler& onBatch,
+                         const SortOptions& sort = SortOptions());
 
     /**
      * @brief Change the current working directory
@@ -40,32 +51,71 @@ public:
     /**
      * @brief Create a new directory
      * @param dirName Name of the directory to create
+     * @param createParents If true, creates parent directories as needed
+     * @return false if a directory of that name already exists
      * @throws runtime_error if the directory cannot be created
      */
-    void createDirectory(const string& dirName);
+    bool createDirectory(const string& dirName, bool createParents = false);
 
     /**
      * @brief Remove a file or directory
      * @param path Path to the file or directory to remove
+     * @param background If true, directories are deleted on a background thread
+     * @return true if the path was removed
      * @throws runtime_error if the path doesn't exist or cannot be removed
      */
-    void remove(const string& path);
+    bool remove(const string& path, bool background = false);
 
     /**
      * @brief Copy a file
      * @param source Source file path
      * @param destination Destination path
+     * @return false if cancelled or some entries could not be copied
      * @throws runtime_error if the operation fails
      */
-    void copyFile(const string& source, const string& destination);
+    bool copyFile(const string& source, const string& destination);
 
     /**
      * @brief Move or rename a file
      * @param source Source file path
      * @param destination Destination path
+     * @return false if the overwrite was cancelled
      * @throws runtime_error if the operation fails
      */
-    void moveFile(const string& source, const string& destination);
+    bool moveFile(const string& source, const string& destination);
+
+    /**
+     * @brief Expand path arguments (globs included) into targets grouped by directory
+     * @param patterns Paths and globs relative to the current directory
+     * @throws runtime_error if a path doesn't exist or a glob matches nothing
+     */
+    PathBatch expandPaths(const vector<string>& patterns) const;
+
+    /**
+     * @brief Remove every target of a batch with no per-entry prompts
+     * @param targets Expanded targets
+     * @param background If true, directories are deleted on background threads
+     * @return false if some targets could not be removed
+     */
+    bool removePaths(const PathBatch& targets, bool background = false);
+
+    /**
+     * @brief Move every target of a batch into a directory
+     * @param sources Expanded targets
+     * @param destination Existing directory (or a new name for a single target)
+     * @return false if cancelled or some targets could not be moved
+     * @throws runtime_error if the destination is not a directory
+     */
+    bool movePaths(const PathBatch& sources, const string& destination);
+
+    /**
+     * @brief Copy every target of a batch into a directory
+     * @param sources Expanded targets
+     * @param destination Existing directory (or a new name for a single target)
+     * @return false if cancelled or some targets could not be copied
+     * @throws runtime_error if the destination is not a directory
+     */
+    bool copyPaths(const PathBatch& sources, const string& destination);
 
     /**
      * @brief Search for files by name in the current directory and subdirectories
@@ -73,6 +123,81 @@ public:
      */
     void searchFile(const string& fileName);
 
+    /**
+     * @brief Search file contents below the current directory
+     * @param searchString String to search for
+     * @param filePattern Glob that file names must match
+     * @return One "path:line:offset" entry per matching line
+     */
+    vector<string> findInFiles(const string& searchString, const string& filePattern = "*");
+
+    /**
+     * @brief Build the filename index for a directory tree
+     * @param path Directory to index (defaults to current directory if empty)
+     * @return Statistics of the new index
+     */
+    IndexStats buildIndex(const string& path = "");
+
+    /**
+     * @brief Refresh the index covering the current directory
+     * @return Statistics of the refreshed index
+     */
+    IndexStats refreshIndex();
+
+    /**
+     * @brief Describe the index covering the current directory
+     */
+    IndexStats indexStats() const;
+
+    /**
+     * @brief Measure the disk space used by a directory tree
+     * @param path Directory to measure (defaults to current directory if empty)
+     * @param top Number of largest subtrees to report
+     */
+    DiskUsageReport diskUsage(const string& path = "", size_t top = 10) const;
+
+    /**
+     * @brief Find files with identical contents in a directory tree
+     * @param path Directory to search (defaults to current directory if empty)
+     * @param verify Also compare candidates byte by byte
+     */
+    DuplicateReport findDuplicates(const string& path = "", bool verify = false) const;
+
+    /**
+     * @brief Open a file for paged reading (view, cat, head, tail)
+     * @param fileName File to open
+     */
+    unique_ptr<FileViewer> openViewer(const string& fileName) const;
+
+    /**
+     * @brief Write content to a file
+     * @param fileName File to write
+     * @param content Content to write
+     * @param options Append, atomic replace, backup, sync
+     */
+    void writeFile(const string& fileName, const string& content, const WriteOptions& options);
+
+    /**
+     * @brief Counters of the directory listing cache
+     */
+    DirectoryCacheStats directoryCacheStats() const;
+
+    /**
+     * @brief Drop every cached directory listing
+     */
+    void clearDirectoryCache();
+
+    /**
+     * @brief Select the batched I/O backend ("auto", "uring", "threads" or "sync")
+     * @return Name of the backend now in use
+     */
+    string setIoBackend(const string& name);
+
+    /**
+     * @brief Turn confirmation prompts on (interactive) or off (batch mode)
+     */
+    void setInteractive(bool enabled);
+
     /**
      * @brief Get the current working directory
      * @return string containing the absolute path of the current directory
@@ -0,0 +1,774 @@
+#include "FileIndex.h"
+#include "GlobMatcher.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <string_view>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+// ==================== On-disk layout ====================
+
+/// Fixed header at offset 0; every section offset is 8-byte aligned
+struct FileIndex::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t directoryCount;
+    uint32_t entryCount;
+    uint32_t trigramCount;
+    int64_t builtAt;
+    uint32_t directoriesRead;
+    uint32_t directoriesReused;
+    uint64_t buildMicros;
+    uint64_t rootOffset, rootLength;
+    uint64_t directoriesOffset;
+    uint64_t restartsOffset;
+    uint64_t pathsOffset, pathsLength;
+    uint64_t entriesOffset;
+    uint64_t namesOffset, namesLength;
+    uint64_t trigramsOffset;
+    uint64_t postingsOffset, postingCount;
+};
+
+struct FileIndex::DirRecord {
+    int64_t mtimeSec;      ///< Directory mtime when it was read
+    uint32_t mtimeNsec;
+    uint32_t parent;       ///< Parent directory id (NO_ID for the root)
+    uint32_t firstEntry;   ///< First of this directory's entries
+    uint32_t entryCount;
+};
+
+struct FileIndex::EntryRecord {
+    uint32_t nameOffset;   ///< Offset into the names section
+    uint32_t directory;    ///< Containing directory id
+    uint32_t child;        ///< Directory id for subdirectories, NO_ID otherwise
+    uint16_t nameLength;
+    uint8_t type;          ///< DT_* type
+    uint8_t reserved;
+};
+
+struct FileIndex::TrigramRecord {
+    uint32_t trigram;      ///< Three name bytes, first byte highest
+    uint32_t count;        ///< Length of the posting list
+    uint64_t first;        ///< Index of the first posting
+};
+
+namespace {
+
+constexpr char INDEX_MAGIC[8] = {'F', 'E', 'I', 'N', 'D', 'E', 'X', '1'};
+constexpr uint32_t INDEX_VERSION = 1;
+constexpr uint32_t NO_ID = UINT32_MAX;
+
+/// Directory paths between two restart points share prefixes with their predecessor
+constexpr size_t PATH_RESTART_INTERVAL = 16;
+
+/// Same buffer size as DirectoryReader and ParallelWalker
+constexpr size_t DIRENT_BUFFER_SIZE = 64 * 1024;
+
+/// Layout of the records returned by getdents64 (not exported by glibc)
+struct linux_dirent64 {
+    ino64_t        d_ino;
+    off64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+struct FdGuard {
+    int fd;
+    ~FdGuard() { if (fd >= 0) ::close(fd); }
+};
+
+/**
+ * @brief One entry of a directory being indexed
+ */
+struct BuildEntry {
+    string name;
+    unsigned char type;
+    uint32_t oldChild;  ///< Directory id of this entry in the previous index
+    uint32_t child;     ///< Directory id in the new index
+};
+
+/**
+ * @brief One directory being indexed
+ */
+struct BuildDir {
+    string relPath;     ///< Path relative to the root ("" for the root)
+    uint32_t parent;
+    uint32_t oldId;     ///< Same directory in the previous index, or NO_ID
+    int64_t mtimeSec = 0;
+    uint32_t mtimeNsec = 0;
+    bool reused = false;
+    vector<BuildEntry> entries;
+};
+
+string joinPath(const string& base, const string& name) {
+    if (base.empty()) return name;
+    if (name.empty()) return base;
+    if (base == "/") return "/" + name;
+    return base + "/" + name;
+}
+
+uint32_t trigramAt(const char* p) {
+    return (uint32_t(uint8_t(p[0])) << 16) | (uint32_t(uint8_t(p[1])) << 8) | uint8_t(p[2]);
+}
+
+void putVarint(string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+uint64_t getVarint(const unsigned char*& p) {
+    uint64_t value = 0;
+    for (unsigned shift = 0;; shift += 7) {
+        unsigned char byte = *p++;
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+}
+
+template <typename T>
+void appendRaw(string& out, const T* data, size_t count) {
+    out.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+}
+
+/**
+ * @brief Pad to 8 bytes and return the offset where the next section starts
+ */
+uint64_t alignSection(string& out) {
+    out.append((8 - out.size() % 8) % 8, '\0');
+    return out.size();
+}
+
+string canonicalRoot(const string& path) {
+    char resolved[PATH_MAX];
+    if (!realpath(path.c_str(), resolved)) {
+        throw runtime_error("Cannot resolve " + path + ": " + strerror(errno));
+    }
+    return resolved;
+}
+
+uint64_t hashPath(const string& path) {
+    uint64_t hash = 1469598103934665603ull;  // FNV-1a
+    for (unsigned char c : path) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace
+
+// ==================== Building ====================
+
+string FileIndex::indexPathFor(const string& root) {
+    string dir;
+    if (const char* cache = getenv("XDG_CACHE_HOME"); cache && *cache) {
+        dir = cache;
+    } else if (const char* home = getenv("HOME"); home && *home) {
+        dir = string(home) + "/.cache";
+    } else {
+        dir = "/tmp";
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "index-%016llx.idx", static_cast<unsigned long long>(hashPath(root)));
+    return dir + "/fileexplorer/" + name;
+}
+
+unique_ptr<FileIndex> FileIndex::build(const string& rootArg, unsigned threads, const FileIndex* previous) {
+    auto start = chrono::steady_clock::now();
+    const string root = canonicalRoot(rootArg);
+    if (previous && previous->rootPath != root) {
+        previous = nullptr;
+    }
+
+    // ---- Walk: one level at a time, each level's directories read in parallel ----
+    vector<BuildDir> dirs;
+    dirs.push_back(BuildDir{"", NO_ID, previous ? 0u : NO_ID, 0, 0, false, {}});
+    ThreadPool pool(threads);
+
+    auto scan = [&](BuildDir& dir) {
+        string full = joinPath(root, dir.relPath);
+        FdGuard guard{::open(full.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC |
+                                            (dir.relPath.empty() ? 0 : O_NOFOLLOW))};
+        struct stat st;
+        if (guard.fd < 0 || fstat(guard.fd, &st) != 0) {
+            return;  // Unreadable directories are indexed as empty
+        }
+        dir.mtimeSec = st.st_mtim.tv_sec;
+        dir.mtimeNsec = static_cast<uint32_t>(st.st_mtim.tv_nsec);
+
+        if (dir.oldId != NO_ID) {
+            const DirRecord& old = previous->directories[dir.oldId];
+            if (old.mtimeSec == dir.mtimeSec && old.mtimeNsec == dir.mtimeNsec) {
+                // Unchanged since the last build: take its entries from the old index
+                dir.entries.reserve(old.entryCount);
+                for (uint32_t i = old.firstEntry; i < old.firstEntry + old.entryCount; ++i) {
+                    const EntryRecord& e = previous->entries[i];
+                    dir.entries.push_back({string(previous->names + e.nameOffset, e.nameLength), e.type, e.child, NO_ID});
+                }
+                dir.reused = true;
+                return;
+            }
+        }
+
+        alignas(linux_dirent64) char buffer[DIRENT_BUFFER_SIZE];
+        while (true) {
+            long bytes = syscall(SYS_getdents64, guard.fd, buffer, sizeof(buffer));
+            if (bytes <= 0) {
+                break;
+            }
+            for (long offset = 0; offset < bytes;) {
+                auto* d = reinterpret_cast<linux_dirent64*>(buffer + offset);
+                offset += d->d_reclen;
+                const char* name = d->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                    continue;
+                }
+                unsigned char type = d->d_type;
+                if (type == DT_UNKNOWN && fstatat(guard.fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+                    type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG
+                         : S_ISLNK(st.st_mode) ? DT_LNK : DT_UNKNOWN;
+                }
+                dir.entries.push_back({name, type, NO_ID, NO_ID});
+            }
+        }
+        sort(dir.entries.begin(), dir.entries.end(),
+             [](const BuildEntry& a, const BuildEntry& b) { return a.name < b.name; });
+
+        // Link subdirectories to their old records so they can be reused in turn
+        if (dir.oldId != NO_ID) {
+            for (auto& entry : dir.entries) {
+                uint32_t old;
+                if (entry.type == DT_DIR &&
+                    previous->findEntry(dir.oldId, entry.name.data(), entry.name.size(), old)) {
+                    entry.oldChild = previous->entries[old].child;
+                }
+            }
+        }
+    };
+
+    for (size_t levelBegin = 0; levelBegin < dirs.size();) {
+        size_t levelEnd = dirs.size();
+        pool.parallelFor(levelEnd - levelBegin, [&](size_t i) { scan(dirs[levelBegin + i]); });
+        for (size_t d = levelBegin; d < levelEnd; ++d) {
+            for (size_t k = 0; k < dirs[d].entries.size(); ++k) {
+                if (dirs[d].entries[k].type != DT_DIR) {
+                    continue;
+                }
+                dirs[d].entries[k].child = static_cast<uint32_t>(dirs.size());
+                BuildDir child{joinPath(dirs[d].relPath, dirs[d].entries[k].name),
+                               static_cast<uint32_t>(d), dirs[d].entries[k].oldChild, 0, 0, false, {}};
+                dirs.push_back(std::move(child));  // may reallocate; nothing above is held across it
+            }
+        }
+        levelBegin = levelEnd;
+    }
+
+    // ---- Flatten entries and names ----
+    Header header{};
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.directoryCount = static_cast<uint32_t>(dirs.size());
+
+    vector<DirRecord> dirRecords(dirs.size());
+    vector<EntryRecord> entryRecords;
+    string namesBlob;
+    for (size_t d = 0; d < dirs.size(); ++d) {
+        BuildDir& dir = dirs[d];
+        dirRecords[d] = {dir.mtimeSec, dir.mtimeNsec, dir.parent,
+                         static_cast<uint32_t>(entryRecords.size()), static_cast<uint32_t>(dir.entries.size())};
+        for (const auto& entry : dir.entries) {
+            entryRecords.push_back({static_cast<uint32_t>(namesBlob.size()), static_cast<uint32_t>(d), entry.child,
+                                    static_cast<uint16_t>(entry.name.size()), entry.type, 0});
+            namesBlob += entry.name;
+        }
+        if (dir.reused) {
+            header.directoriesReused++;
+        } else {
+            header.directoriesRead++;
+        }
+        vector<BuildEntry>().swap(dir.entries);
+    }
+    header.entryCount = static_cast<uint32_t>(entryRecords.size());
+
+    // ---- Front-coded directory paths ----
+    string pathsBlob;
+    vector<uint32_t> restartOffsets;
+    for (size_t d = 0; d < dirs.size(); ++d) {
+        const string& path = dirs[d].relPath;
+        size_t shared = 0;
+        if (d % PATH_RESTART_INTERVAL == 0) {
+            restartOffsets.push_back(static_cast<uint32_t>(pathsBlob.size()));
+        } else {
+            const string& prev = dirs[d - 1].relPath;
+            size_t limit = min(prev.size(), path.size());
+            while (shared < limit && prev[shared] == path[shared]) ++shared;
+        }
+        putVarint(pathsBlob, shared);
+        putVarint(pathsBlob, path.size() - shared);
+        pathsBlob.append(path, shared, string::npos);
+    }
+
+    // ---- Trigram postings: generated per chunk, grouped by leading byte, sorted per group ----
+    const size_t entryCount = entryRecords.size();
+    const size_t chunkCount = max<size_t>(1, min<size_t>(pool.size() * 4, entryCount / 4096 + 1));
+    vector<vector<vector<uint64_t>>> chunkBuckets(chunkCount, vector<vector<uint64_t>>(256));
+    pool.parallelFor(chunkCount, [&](size_t c) {
+        size_t begin = entryCount * c / chunkCount, end = entryCount * (c + 1) / chunkCount;
+        vector<uint32_t> grams;
+        for (size_t id = begin; id < end; ++id) {
+            const EntryRecord& e = entryRecords[id];
+            const char* name = namesBlob.data() + e.nameOffset;
+            grams.clear();
+            for (size_t i = 0; i + 3 <= e.nameLength; ++i) {
+                grams.push_back(trigramAt(name + i));
+            }
+            sort(grams.begin(), grams.end());
+            grams.erase(unique(grams.begin(), grams.end()), grams.end());
+            for (uint32_t gram : grams) {
+                chunkBuckets[c][gram >> 16].push_back((uint64_t(gram) << 32) | id);
+            }
+        }
+    });
+    vector<vector<uint64_t>> buckets(256);
+    pool.parallelFor(256, [&](size_t b) {
+        for (auto& chunk : chunkBuckets) {
+            buckets[b].insert(buckets[b].end(), chunk[b].begin(), chunk[b].end());
+            vector<uint64_t>().swap(chunk[b]);
+        }
+        sort(buckets[b].begin(), buckets[b].end());
+    });
+
+    vector<TrigramRecord> trigramRecords;
+    vector<uint32_t> postingList;
+    for (const auto& bucket : buckets) {
+        for (uint64_t packed : bucket) {
+            uint32_t gram = static_cast<uint32_t>(packed >> 32);
+            if (trigramRecords.empty() || trigramRecords.back().trigram != gram) {
+                trigramRecords.push_back({gram, 0, postingList.size()});
+            }
+            trigramRecords.back().count++;
+            postingList.push_back(static_cast<uint32_t>(packed));
+        }
+    }
+    header.trigramCount = static_cast<uint32_t>(trigramRecords.size());
+    header.postingCount = postingList.size();
+
+    // ---- Serialize and atomically replace the index file ----
+    string out(sizeof(Header), '\0');
+    header.rootOffset = out.size();
+    header.rootLength = root.size();
+    out += root;
+    header.directoriesOffset = alignSection(out);
+    appendRaw(out, dirRecords.data(), dirRecords.size());
+    header.restartsOffset = alignSection(out);
+    appendRaw(out, restartOffsets.data(), restartOffsets.size());
+    header.pathsOffset = alignSection(out);
+    header.pathsLength = pathsBlob.size();
+    out += pathsBlob;
+    header.entriesOffset = alignSection(out);
+    appendRaw(out, entryRecords.data(), entryRecords.size());
+    header.namesOffset = alignSection(out);
+    header.namesLength = namesBlob.size();
+    out += namesBlob;
+    header.trigramsOffset = alignSection(out);
+    appendRaw(out, trigramRecords.data(), trigramRecords.size());
+    header.postingsOffset = alignSection(out);
+    appendRaw(out, postingList.data(), postingList.size());
+
+    header.builtAt = time(nullptr);
+    header.buildMicros = static_cast<uint64_t>(
+        chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count());
+    memcpy(&out[0], &header, sizeof(header));
+
+    string file = indexPathFor(root);
+    string dir = file.substr(0, file.find_last_of('/'));
+    ::mkdir(dir.substr(0, dir.find_last_of('/')).c_str(), 0755);
+    ::mkdir(dir.c_str(), 0755);
+    string temp = file + ".tmp" + to_string(getpid());
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw runtime_error("Cannot write index " + temp + ": " + strerror(errno));
+    }
+    for (size_t written = 0; written < out.size();) {
+        ssize_t n = ::write(fd, out.data() + written, out.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            int err = errno;
+            ::close(fd);
+            ::unlink(temp.c_str());
+            throw runtime_error("Cannot write index " + temp + ": " + strerror(err));
+        }
+        written += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    if (::rename(temp.c_str(), file.c_str()) != 0) {
+        int err = errno;
+        ::unlink(temp.c_str());
+        throw runtime_error("Cannot replace index " + file + ": " + strerror(err));
+    }
+    return load(file);
+}
+
+unique_ptr<FileIndex> FileIndex::refresh(unsigned threads) const {
+    return build(rootPath, threads, this);
+}
+
+// ==================== Loading ====================
+
+unique_ptr<FileIndex> FileIndex::open(const string& root) {
+    string file = indexPathFor(root);
+    if (::access(file.c_str(), R_OK) != 0) {
+        return nullptr;
+    }
+    unique_ptr<FileIndex> index = load(file);
+    return index->rootPath == root ? std::move(index) : nullptr;  // hash collision
+}
+
+unique_ptr<FileIndex> FileIndex::load(const string& file) {
+    FdGuard guard{::open(file.c_str(), O_RDONLY | O_CLOEXEC)};
+    struct stat st;
+    if (guard.fd < 0 || fstat(guard.fd, &st) != 0) {
+        throw runtime_error("Cannot open index " + file + ": " + strerror(errno));
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size < sizeof(Header)) {
+        throw runtime_error("Index file is corrupt: " + file + " (run 'index build')");
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, guard.fd, 0);
+    if (mapping == MAP_FAILED) {
+        throw runtime_error("Cannot map index " + file + ": " + strerror(errno));
+    }
+
+    unique_ptr<FileIndex> index(new FileIndex());
+    index->filePath = file;
+    index->mapping = mapping;
+    index->mappingSize = size;
+    const char* base = static_cast<const char*>(mapping);
+    const Header* h = reinterpret_cast<const Header*>(base);
+    index->header = h;
+
+    auto fits = [size](uint64_t offset, uint64_t bytes) { return offset <= size && bytes <= size - offset; };
+    if (memcmp(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || h->version != INDEX_VERSION ||
+        h->directoryCount == 0 ||
+        !fits(h->rootOffset, h->rootLength) ||
+        !fits(h->directoriesOffset, uint64_t(h->directoryCount) * sizeof(DirRecord)) ||
+        !fits(h->restartsOffset, (uint64_t(h->directoryCount) + PATH_RESTART_INTERVAL - 1) / PATH_RESTART_INTERVAL * 4) ||
+        !fits(h->pathsOffset, h->pathsLength) ||
+        !fits(h->entriesOffset, uint64_t(h->entryCount) * sizeof(EntryRecord)) ||
+        !fits(h->namesOffset, h->namesLength) ||
+        !fits(h->trigramsOffset, uint64_t(h->trigramCount) * sizeof(TrigramRecord)) ||
+        !fits(h->postingsOffset, h->postingCount * sizeof(uint32_t))) {
+        throw runtime_error("Index file is corrupt: " + file + " (run 'index build')");
+    }
+
+    index->rootPath.assign(base + h->rootOffset, h->rootLength);
+    index->directories = reinterpret_cast<const DirRecord*>(base + h->directoriesOffset);
+    index->restarts = reinterpret_cast<const uint32_t*>(base + h->restartsOffset);
+    index->paths = reinterpret_cast<const unsigned char*>(base + h->pathsOffset);
+    index->entries = reinterpret_cast<const EntryRecord*>(base + h->entriesOffset);
+    index->names = base + h->namesOffset;
+    index->trigrams = reinterpret_cast<const TrigramRecord*>(base + h->trigramsOffset);
+    index->postings = reinterpret_cast<const uint32_t*>(base + h->postingsOffset);
+    if (!index->recordsValid()) {
+        throw runtime_error("Index file is corrupt: " + file + " (run 'index build')");
+    }
+    return index;
+}
+
+bool FileIndex::recordsValid() const {
+    const Header& h = *header;
+    // Parents come first, so a parent id is always below its child's
+    for (uint32_t d = 0; d < h.directoryCount; ++d) {
+        const DirRecord& dir = directories[d];
+        if ((d == 0 ? dir.parent != NO_ID : dir.parent >= d) ||
+            dir.firstEntry > h.entryCount || dir.entryCount > h.entryCount - dir.firstEntry) {
+            return false;
+        }
+    }
+    for (uint32_t id = 0; id < h.entryCount; ++id) {
+        const EntryRecord& e = entries[id];
+        if (e.nameOffset > h.namesLength || e.nameLength > h.namesLength - e.nameOffset ||
+            e.directory >= h.directoryCount || (e.child != NO_ID && e.child >= h.directoryCount)) {
+            return false;
+        }
+    }
+    for (uint32_t t = 0; t < h.trigramCount; ++t) {
+        if (trigrams[t].first > h.postingCount || trigrams[t].count > h.postingCount - trigrams[t].first) {
+            return false;
+        }
+    }
+    for (uint64_t i = 0; i < h.postingCount; ++i) {
+        if (postings[i] >= h.entryCount) {
+            return false;
+        }
+    }
+
+    // Decode every path once with bounds checks; directoryPath() then needs none
+    uint64_t pos = 0;
+    auto varint = [&](uint64_t& value) {
+        value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (pos >= h.pathsLength) {
+                return false;
+            }
+            unsigned char byte = paths[pos++];
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    for (uint32_t d = 0; d < h.directoryCount; ++d) {
+        uint64_t shared, length;
+        if ((d % PATH_RESTART_INTERVAL == 0 && restarts[d / PATH_RESTART_INTERVAL] != pos) ||
+            !varint(shared) || !varint(length) || length > h.pathsLength - pos) {
+            return false;
+        }
+        pos += length;
+    }
+    return true;
+}
+
+FileIndex::~FileIndex() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+}
+
+IndexStats FileIndex::stats() const {
+    IndexStats stats;
+    stats.root = rootPath;
+    stats.file = filePath;
+    stats.fileBytes = mappingSize;
+    stats.directories = header->directoryCount;
+    stats.entries = header->entryCount;
+    stats.trigrams = header->trigramCount;
+    stats.postings = header->postingCount;
+    stats.builtAt = static_cast<time_t>(header->builtAt);
+    stats.directoriesRead = header->directoriesRead;
+    stats.directoriesReused = header->directoriesReused;
+    stats.buildSeconds = header->buildMicros / 1e6;
+    return stats;
+}
+
+// ==================== Queries ====================
+
+bool FileIndex::findEntry(uint32_t dir, const char* name, size_t length, uint32_t& id) const {
+    const DirRecord& record = directories[dir];
+    const EntryRecord* begin = entries + record.firstEntry;
+    const EntryRecord* end = begin + record.entryCount;
+    const EntryRecord* it = lower_bound(begin, end, string_view(name, length),
+        [this](const EntryRecord& e, string_view key) {
+            return string_view(names + e.nameOffset, e.nameLength) < key;
+        });
+    if (it == end || string_view(names + it->nameOffset, it->nameLength) != string_view(name, length)) {
+        return false;
+    }
+    id = static_cast<uint32_t>(it - entries);
+    return true;
+}
+
+bool FileIndex::findDirectory(const string& path, uint32_t& id) const {
+    string_view rest(path);
+    while (rest.size() > 1 && rest.back() == '/') {
+        rest.remove_suffix(1);
+    }
+    if (rest.substr(0, rootPath.size()) != rootPath) {
+        return false;
+    }
+    rest.remove_prefix(rootPath.size());
+    if (!rest.empty() && rest.front() != '/' && rootPath != "/") {
+        return false;  // "/data2" is not below "/data"
+    }
+
+    id = 0;
+    while (!rest.empty()) {
+        size_t skip = rest.find_first_not_of('/');
+        if (skip == string_view::npos) {
+            break;
+        }
+        rest.remove_prefix(skip);
+        string_view component = rest.substr(0, rest.find('/'));
+        rest.remove_prefix(component.size());
+        if (component == ".") {
+            continue;
+        }
+        uint32_t entry;
+        if (component == ".." || !findEntry(id, component.data(), component.size(), entry) ||
+            entries[entry].child == NO_ID) {
+            return false;
+        }
+        id = entries[entry].child;
+    }
+    return true;
+}
+
+uint32_t FileIndex::changedDirectories(const string& scope, unsigned threads) const {
+    uint32_t scopeId;
+    if (!findDirectory(scope, scopeId)) {
+        return 0;
+    }
+    // Directories are stored parents first, so one pass collects the whole subtree
+    vector<uint32_t> subtree{scopeId};
+    vector<char> inScope(header->directoryCount, 0);
+    inScope[scopeId] = 1;
+    for (uint32_t d = scopeId + 1; d < header->directoryCount; ++d) {
+        if (inScope[directories[d].parent]) {
+            inScope[d] = 1;
+            subtree.push_back(d);
+        }
+    }
+
+    atomic<uint32_t> changed{0};
+    ThreadPool pool(threads);
+    pool.parallelFor(subtree.size(), [&](size_t i) {
+        uint32_t d = subtree[i];
+        string path = joinPath(rootPath, directoryPath(d));
+        struct stat st;
+        // The build doesn't follow symlinks below the root, so neither does the check
+        int rc = d == 0 ? ::stat(path.c_str(), &st) : ::lstat(path.c_str(), &st);
+        if (rc != 0 || !S_ISDIR(st.st_mode) || st.st_mtim.tv_sec != directories[d].mtimeSec ||
+            static_cast<uint32_t>(st.st_mtim.tv_nsec) != directories[d].mtimeNsec) {
+            changed.fetch_add(1, memory_order_relaxed);
+        }
+    });
+    return changed.load();
+}
+
+bool FileIndex::covers(const string& path) const {
+    uint32_t id;
+    return findDirectory(path, id);
+}
+
+string FileIndex::directoryPath(uint32_t id) const {
+    const unsigned char* p = paths + restarts[id / PATH_RESTART_INTERVAL];
+    string path;
+    for (uint32_t i = id - id % PATH_RESTART_INTERVAL; i <= id; ++i) {
+        size_t shared = getVarint(p);
+        size_t length = getVarint(p);
+        path.resize(shared);
+        path.append(reinterpret_cast<const char*>(p), length);
+        p += length;
+    }
+    return path;
+}
+
+vector<uint32_t> FileIndex::candidates(const string& literal) const {
+    vector<uint32_t> grams;
+    for (size_t i = 0; i + 3 <= literal.size(); ++i) {
+        grams.push_back(trigramAt(literal.data() + i));
+    }
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+
+    vector<const TrigramRecord*> lists;
+    const TrigramRecord* end = trigrams + header->trigramCount;
+    for (uint32_t gram : grams) {
+        const TrigramRecord* it = lower_bound(trigrams, end, gram,
+            [](const TrigramRecord& r, uint32_t g) { return r.trigram < g; });
+        if (it == end || it->trigram != gram) {
+            return {};  // Some trigram appears in no name at all
+        }
+        lists.push_back(it);
+    }
+    sort(lists.begin(), lists.end(),
+         [](const TrigramRecord* a, const TrigramRecord* b) { return a->count < b->count; });
+
+    // Start from the rarest trigram and narrow down with the others
+    vector<uint32_t> result(postings + lists[0]->first, postings + lists[0]->first + lists[0]->count);
+    for (size_t l = 1; l < lists.size() && !result.empty(); ++l) {
+        const uint32_t* it = postings + lists[l]->first;
+        const uint32_t* last = it + lists[l]->count;
+        size_t kept = 0;
+        for (uint32_t id : result) {
+            it = lower_bound(it, last, id);
+            if (it == last) {
+                break;
+            }
+            if (*it == id) {
+                result[kept++] = id;
+            }
+        }
+        result.resize(kept);
+    }
+    return result;
+}
+
+size_t FileIndex::search(const string& scope, const string& literal,
+                         const function<bool(const char*, size_t)>& match,
+                         const MatchHandler& onMatch) const {
+    uint32_t scopeId;
+    if (!findDirectory(scope, scopeId)) {
+        return 0;
+    }
+
+    // Directories are stored parents first, so one pass marks the whole subtree
+    vector<char> inScope;
+    if (scopeId != 0) {
+        inScope.assign(header->directoryCount, 0);
+        inScope[scopeId] = 1;
+        for (uint32_t d = scopeId + 1; d < header->directoryCount; ++d) {
+            inScope[d] = inScope[directories[d].parent];
+        }
+    }
+
+    uint32_t cachedDir = NO_ID;
+    string cachedPath;
+    size_t found = 0;
+    auto consider = [&](uint32_t id) {
+        const EntryRecord& e = entries[id];
+        if ((scopeId != 0 && !inScope[e.directory]) || !match(names + e.nameOffset, e.nameLength)) {
+            return;
+        }
+        if (e.directory != cachedDir) {
+            cachedDir = e.directory;
+            cachedPath = joinPath(rootPath, directoryPath(cachedDir));
+        }
+        onMatch(joinPath(cachedPath, string(names + e.nameOffset, e.nameLength)), e.type);
+        found++;
+    };
+
+    if (literal.size() >= 3) {
+        for (uint32_t id : candidates(literal)) {
+            consider(id);
+        }
+    } else {
+        uint32_t first = scopeId == 0 ? 0 : directories[scopeId].firstEntry;
+        for (uint32_t id = first; id < header->entryCount; ++id) {
+            consider(id);
+        }
+    }
+    return found;
+}
+
+size_t FileIndex::findSubstring(const string& scope, const string& needle, const MatchHandler& onMatch) const {
+    return search(scope, needle, [&needle](const char* name, size_t length) {
+        return memmem(name, length, needle.data(), needle.size()) != nullptr;
+    }, onMatch);
+}
+
+size_t FileIndex::findGlob(const string& scope, const GlobMatcher& glob, const MatchHandler& onMatch) const {
+    return search(scope, glob.requiredLiteral(), [&glob](const char* name, size_t length) {
+        return glob.matches(name, length);
+    }, onMatch);
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+#ifndef FILE_INDEX_H
+#define FILE_INDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+
+class GlobMatcher;
+
+/**
+ * @brief Summary of an index file and of the build that produced it
+ */
+struct IndexStats {
+    std::string root;                ///< Indexed directory
+    std::string file;                ///< Path of the index file
+    uint64_t fileBytes = 0;          ///< Size of the index file
+    uint32_t directories = 0;        ///< Directories in the index
+    uint32_t entries = 0;            ///< Entries (files, links, directories) in the index
+    uint32_t trigrams = 0;           ///< Distinct name trigrams
+    uint64_t postings = 0;           ///< Total trigram postings
+    time_t builtAt = 0;              ///< When the index was written
+    uint32_t directoriesRead = 0;    ///< Directories read from disk by the last build
+    uint32_t directoriesReused = 0;  ///< Directories copied unchanged from the previous index
+    double buildSeconds = 0.0;       ///< Wall time of the last build
+};
+
+/**
+ * @brief Persistent, memory-mapped filename index (locate style)
+ *
+ * The file holds, for one root directory:
+ *   - a record per directory (mtime, parent, range of its entries)
+ *   - the directory paths, front-coded with a restart point every 16 paths
+ *   - a record per entry, sorted by name within each directory
+ *   - all entry names back to back
+ *   - a sorted trigram table with posting lists of entry ids
+ *
+ * The file is mapped and queried in place. Loading parses nothing, but
+ * range-checks every record once, so a damaged file is reported as
+ * corrupt rather than read out of bounds by a later query.
+ * Name queries intersect the posting lists of the trigrams of a literal
+ * the name must contain, then verify only the surviving candidates.
+ *
+ * Building walks the tree one depth level at a time, reading each level's
+ * directories in parallel. A refresh does the same walk but copies the
+ * entries of every directory whose mtime is unchanged from the previous
+ * index instead of reading it again. changedDirectories() makes the same
+ * comparison without reading anything, so callers can tell before a
+ * query whether the index has gone stale.
+ */
+class FileIndex {
+public:
+    /**
+     * @brief Receives (full path, DT_* type) for every entry a query matches
+     */
+    using MatchHandler = std::function<void(std::string&& path, unsigned char type)>;
+
+    /**
+     * @brief Build an index for a directory tree and write it to disk
+     * @param root Directory to index
+     * @param threads Worker threads (0 = hardware concurrency)
+     * @param previous Earlier index of the same root whose unchanged directories are reused; may be null
+     * @return The newly written index, mapped
+     * @throws std::runtime_error if root cannot be read or the index cannot be written
+     */
+    static std::unique_ptr<FileIndex> build(const std::string& root, unsigned threads,
+                                            const FileIndex* previous = nullptr);
+
+    /**
+     * @brief Map the index stored for a root directory
+     * @return The index, or null if none has been built for this exact root
+     * @throws std::runtime_error if the index file exists but is corrupt
+     */
+    static std::unique_ptr<FileIndex> open(const std::string& root);
+
+    /**
+     * @brief Location of the index file for a root directory
+     *
+     * Index files live in $XDG_CACHE_HOME/fileexplorer (or ~/.cache/fileexplorer),
+     * named after a hash of the root path.
+     */
+    static std::string indexPathFor(const std::string& root);
+
+    ~FileIndex();
+
+    /**
+     * @brief Rebuild this index, re-reading only directories whose mtime changed
+     * @param threads Worker threads (0 = hardware concurrency)
+     * @return The refreshed index; this object stays valid
+     */
+    std::unique_ptr<FileIndex> refresh(unsigned threads) const;
+
+    /**
+     * @brief Count the directories below scope whose mtime no longer matches the index
+     *
+     * Creating, deleting or renaming an entry changes the mtime of its
+     * directory, so zero means queries over scope still give exact answers.
+     * A directory that can't be stat()ed any more counts as changed.
+     * @param scope Directory to check (must be covered by this index)
+     * @param threads Worker threads for the stat() calls (0 = hardware concurrency)
+     */
+    uint32_t changedDirectories(const std::string& scope, unsigned threads) const;
+
+    /**
+     * @brief Check whether a directory is part of this index
+     */
+    bool covers(const std::string& path) const;
+
+    /**
+     * @brief Find entries below a directory whose name contains a substring
+     * @param scope Directory to search in (must be covered by this index)
+     * @param needle Substring to look for
+     * @param onMatch Receives each match
+     * @return Number of matches
+     */
+    size_t findSubstring(const std::string& scope, const std::string& needle, const MatchHandler& onMatch) const;
+
+    /**
+     * @brief Find entries below a directory whose name matches a glob
+     * @param scope Directory to search in (must be covered by this index)
+     * @param glob Compiled pattern; its required literal drives the trigram lookup
+     * @param onMatch Receives each match
+     * @return Number of matches
+     */
+    size_t findGlob(const std::string& scope, const GlobMatcher& glob, const MatchHandler& onMatch) const;
+
+    /**
+     * @brief The indexed root directory
+     */
+    const std::string& root() const { return rootPath; }
+
+    /**
+     * @brief Describe this index
+     */
+    IndexStats stats() const;
+
+    FileIndex(const FileIndex&) = delete;
+    FileIndex& operator=(const FileIndex&) = delete;
+
+private:
+    struct Header;
+    struct DirRecord;
+    struct EntryRecord;
+    struct TrigramRecord;
+
+    FileIndex() = default;
+
+    /**
+     * @brief Map and validate an index file
+     */
+    static std::unique_ptr<FileIndex> load(const std::string& file);
+
+    /**
+     * @brief Whether every id, offset and length in the records stays inside its section
+     */
+    bool recordsValid() const;
+
+    /**
+     * @brief Id of the directory at an absolute path, or false if it isn't indexed
+     */
+    bool findDirectory(const std::string& path, uint32_t& id) const;
+
+    /**
+     * @brief Id of the entry with a given name in a directory, or false if there is none
+     */
+    bool findEntry(uint32_t dir, const char* name, size_t length, uint32_t& id) const;
+
+    /**
+     * @brief Decode the path of a directory relative to the root
+     */
+    std::string directoryPath(uint32_t id) const;
+
+    /**
+     * @brief Shared query loop for findSubstring and findGlob
+     * @param literal Text every match contains (trigram prefilter if 3 or more bytes)
+     * @param match Final check on a candidate's name
+     */
+    size_t search(const std::string& scope, const std::string& literal,
+                  const std::function<bool(const char* name, size_t length)>& match,
+                  const MatchHandler& onMatch) const;
+
+    /**
+     * @brief Entry ids whose names contain every trigram of literal, ascending
+     */
+    std::vector<uint32_t> candidates(const std::string& literal) const;
+
+    std::string rootPath;            ///< Indexed directory
+    std::string filePath;            ///< Index file
+    void* mapping = nullptr;         ///< Whole file, mapped read-only
+    size_t mappingSize = 0;          ///< Size of the mapping
+
+    const Header* header = nullptr;
+    const DirRecord* directories = nullptr;
+    const uint32_t* restarts = nullptr;      ///< Offset into paths of every 16th directory path
+    const unsigned char* paths = nullptr;    ///< Front-coded directory paths
+    const EntryRecord* entries = nullptr;
+    const char* names = nullptr;             ///< Entry names, back to back
+    const TrigramRecord* trigrams = nullptr;
+    const uint32_t* postings = nullptr;      ///< Entry ids, grouped by trigram
+};
+
+#endif // FILE_INDEX_H
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "FileInfoBatch.h"
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+FileInfoBatch::FileInfoBatch(unsigned fields, string directory)
+    : columns(fields), directoryPath(std::move(directory)) {}
+
+template <typename Fn>
+void FileInfoBatch::forEachColumn(Fn fn) {
+    fn(types);
+    if (columns & LIST_SIZE)  fn(sizes);
+    if (columns & LIST_MTIME) fn(mtimes);
+    if (columns & LIST_MODE)  fn(modes);
+    if (columns & LIST_OWNER) fn(uids);
+    if (columns & LIST_GROUP) fn(gids);
+    if (columns & LIST_INODE) fn(inodes);
+}
+
+void FileInfoBatch::clear() {
+    names.clear();
+    garbageBytes = 0;
+    nameOffsets.clear();
+    nameLengths.clear();
+    forEachColumn([](auto& column) { column.clear(); });
+}
+
+size_t FileInfoBatch::append(string_view name, unsigned char type) {
+    nameOffsets.push_back(static_cast<uint32_t>(names.size()));
+    nameLengths.push_back(static_cast<uint8_t>(name.size()));
+    names.append(name.data(), name.size());
+    forEachColumn([](auto& column) { column.emplace_back(); });
+    types.back() = type;
+    return size() - 1;
+}
+
+void FileInfoBatch::appendRow(const FileInfoBatch& other, size_t index) {
+    size_t row = append(other.name(index), other.type(index));
+    copyMetadata(row, other, index);
+}
+
+void FileInfoBatch::append(const FileInfoBatch& other) {
+    if (other.columns != columns || other.garbageBytes > 0) {
+        for (size_t i = 0; i < other.size(); ++i) {
+            appendRow(other, i);
+        }
+        return;
+    }
+    // Same layout: bulk copies, shifting the name offsets past our arena
+    uint32_t base = static_cast<uint32_t>(names.size());
+    names += other.names;
+    for (uint32_t offset : other.nameOffsets) {
+        nameOffsets.push_back(base + offset);
+    }
+    nameLengths.insert(nameLengths.end(), other.nameLengths.begin(), other.nameLengths.end());
+    types.insert(types.end(), other.types.begin(), other.types.end());
+    sizes.insert(sizes.end(), other.sizes.begin(), other.sizes.end());
+    mtimes.insert(mtimes.end(), other.mtimes.begin(), other.mtimes.end());
+    modes.insert(modes.end(), other.modes.begin(), other.modes.end());
+    uids.insert(uids.end(), other.uids.begin(), other.uids.end());
+    gids.insert(gids.end(), other.gids.begin(), other.gids.end());
+    inodes.insert(inodes.end(), other.inodes.begin(), other.inodes.end());
+}
+
+void FileInfoBatch::copyMetadata(size_t index, const FileInfoBatch& other, size_t otherIndex) {
+    types[index] = other.types[otherIndex];
+    setFileSize(index, other.fileSize(otherIndex));
+    setModifiedTime(index, other.modifiedTime(otherIndex));
+    setMode(index, other.mode(otherIndex));
+    setUid(index, other.uid(otherIndex));
+    setGid(index, other.gid(otherIndex));
+    setInode(index, other.inode(otherIndex));
+}
+
+void FileInfoBatch::removeSwap(size_t index) {
+    garbageBytes += nameLengths[index];
+    size_t last = size() - 1;
+    nameOffsets[index] = nameOffsets[last];
+    nameOffsets.pop_back();
+    nameLengths[index] = nameLengths[last];
+    nameLengths.pop_back();
+    forEachColumn([index, last](auto& column) {
+        column[index] = column[last];
+        column.pop_back();
+    });
+    if (garbageBytes > names.size() / 2) {
+        compact();
+    }
+}
+
+void FileInfoBatch::permute(const vector<uint32_t>& order) {
+    string arena;
+    arena.reserve(names.size() - garbageBytes);
+    vector<uint32_t> offsets(order.size());
+    vector<uint8_t> lengths(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        offsets[i] = static_cast<uint32_t>(arena.size());
+        lengths[i] = nameLengths[order[i]];
+        arena.append(names, nameOffsets[order[i]], nameLengths[order[i]]);
+    }
+    names.swap(arena);
+    nameOffsets.swap(offsets);
+    nameLengths.swap(lengths);
+    garbageBytes = 0;
+    forEachColumn([&order](auto& column) {
+        typename std::remove_reference<decltype(column)>::type reordered(order.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            reordered[i] = column[order[i]];
+        }
+        column.swap(reordered);
+    });
+}
+
+void FileInfoBatch::compact() {
+    if (garbageBytes == 0) {
+        return;
+    }
+    string arena;
+    arena.reserve(names.size() - garbageBytes);
+    for (size_t i = 0; i < size(); ++i) {
+        uint32_t offset = static_cast<uint32_t>(arena.size());
+        arena.append(names, nameOffsets[i], nameLengths[i]);
+        nameOffsets[i] = offset;
+    }
+    names.swap(arena);
+    garbageBytes = 0;
+}
+
+void FileInfoBatch::shrinkToFit() {
+    compact();
+    names.shrink_to_fit();
+    nameOffsets.shrink_to_fit();
+    nameLengths.shrink_to_fit();
+    forEachColumn([](auto& column) { column.shrink_to_fit(); });
+}
+
+string FileInfoBatch::path(size_t i) const {
+    string full;
+    full.reserve(directoryPath.size() + 1 + nameLengths[i]);
+    full += directoryPath;
+    if (!full.empty() && full.back() != '/') {
+        full += '/';
+    }
+    full.append(name(i));
+    return full;
+}
+
+bool FileInfoBatch::isDirectory(size_t i) const {
+    return types[i] == DT_DIR;
+}
+
+size_t FileInfoBatch::memoryUsage() const {
+    return names.capacity() + directoryPath.capacity() +
+           nameOffsets.capacity() * sizeof(uint32_t) + nameLengths.capacity() +
+           types.capacity() + sizes.capacity() * sizeof(uint64_t) +
+           mtimes.capacity() * sizeof(int64_t) + modes.capacity() * sizeof(uint16_t) +
+           uids.capacity() * sizeof(uint32_t) + gids.capacity() * sizeof(uint32_t) +
+           inodes.capacity() * sizeof(uint64_t);
+}
+
+void FileInfoBatch::formatPermissions(unsigned mode, char* out) {
+    memset(out, '-', 10);
+    if (S_ISDIR(mode)) out[0] = 'd';
+    if (S_ISLNK(mode)) out[0] = 'l';
+    if (mode & S_IRUSR) out[1] = 'r';
+    if (mode & S_IWUSR) out[2] = 'w';
+    if (mode & S_IXUSR) out[3] = 'x';
+    if (mode & S_IRGRP) out[4] = 'r';
+    if (mode & S_IWGRP) out[5] = 'w';
+    if (mode & S_IXGRP) out[6] = 'x';
+    if (mode & S_IROTH) out[7] = 'r';
+    if (mode & S_IWOTH) out[8] = 'w';
+    if (mode & S_IXOTH) out[9] = 'x';
+}
+
+string FileInfoBatch::formatPermissions(unsigned mode) {
+    string perms(10, '-');
+    formatPermissions(mode, &perms[0]);
+    return perms;
+}
\ No newline at end of file
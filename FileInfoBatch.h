@@ -0,0 +1,194 @@
+#ifndef FILE_INFO_BATCH_H
+#define FILE_INFO_BATCH_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <sys/types.h>
+#include "NameCache.h"
+
+/**
+ * @brief Metadata fields a listing can ask for
+ *
+ * Each field is one column of a FileInfoBatch; columns that weren't asked
+ * for take no memory, and the reader never fetches them from the kernel.
+ */
+enum ListField : unsigned {
+    LIST_NAME  = 0,        ///< Entry name (always present)
+    LIST_TYPE  = 1u << 0,  ///< Type resolved through symlinks (d_type otherwise)
+    LIST_SIZE  = 1u << 1,  ///< Size in bytes
+    LIST_MODE  = 1u << 2,  ///< Raw st_mode
+    LIST_OWNER = 1u << 3,  ///< Owner uid
+    LIST_GROUP = 1u << 4,  ///< Group gid
+    LIST_MTIME = 1u << 5,  ///< Last modification time
+    LIST_INODE = 1u << 6,  ///< Inode number
+    LIST_ALL   = LIST_TYPE | LIST_SIZE | LIST_MODE | LIST_OWNER | LIST_GROUP | LIST_MTIME | LIST_INODE
+};
+
+/**
+ * @brief Entries of one directory, stored column by column
+ *
+ * Every field lives in its own fixed-width array and all names sit back
+ * to back in a single arena, so a million entries cost a handful of large
+ * allocations instead of millions of small strings. Permissions stay a
+ * raw mode and owners stay ids until something displays them, and paths
+ * are rebuilt from the batch's directory on demand.
+ *
+ * Rows are addressed by index. Removing a row moves the last row into its
+ * place; the name bytes left behind are reclaimed by compact().
+ */
+class FileInfoBatch {
+public:
+    /**
+     * @brief Create an empty batch
+     * @param fields ListField mask of the columns to keep
+     * @param directory Directory the entries belong to (used by path())
+     */
+    explicit FileInfoBatch(unsigned fields = LIST_ALL, std::string directory = "");
+
+    // ==================== Rows ====================
+
+    size_t size() const { return nameOffsets.size(); }
+    bool empty() const { return nameOffsets.empty(); }
+
+    /**
+     * @brief Drop every row, keeping the allocated capacity
+     */
+    void clear();
+
+    /**
+     * @brief Append a row with the given name and zeroed metadata
+     * @return Index of the new row
+     */
+    size_t append(std::string_view name, unsigned char type);
+
+    /**
+     * @brief Append a copy of another batch's row
+     */
+    void appendRow(const FileInfoBatch& other, size_t index);
+
+    /**
+     * @brief Append every row of another batch
+     */
+    void append(const FileInfoBatch& other);
+
+    /**
+     * @brief Overwrite a row's metadata (not its name) with another batch's row
+     */
+    void copyMetadata(size_t index, const FileInfoBatch& other, size_t otherIndex);
+
+    /**
+     * @brief Remove a row by moving the last row into its place
+     */
+    void removeSwap(size_t index);
+
+    /**
+     * @brief Reorder rows so that row i becomes the old row order[i]
+     *
+     * Also compacts the name arena.
+     */
+    void permute(const std::vector<uint32_t>& order);
+
+    /**
+     * @brief Rewrite the name arena without the bytes of removed rows
+     */
+    void compact();
+
+    /**
+     * @brief Release spare capacity (for batches that will be kept around)
+     */
+    void shrinkToFit();
+
+    // ==================== Columns ====================
+
+    unsigned fields() const { return columns; }
+    const std::string& directory() const { return directoryPath; }
+    void setDirectory(std::string directory) { directoryPath = std::move(directory); }
+
+    std::string_view name(size_t i) const {
+        return std::string_view(names.data() + nameOffsets[i], nameLengths[i]);
+    }
+
+    /**
+     * @brief Full path of a row (directory + "/" + name)
+     */
+    std::string path(size_t i) const;
+
+    unsigned char type(size_t i) const { return types[i]; }
+    bool isDirectory(size_t i) const;
+    uint64_t fileSize(size_t i) const { return sizes.empty() ? 0 : sizes[i]; }
+    time_t modifiedTime(size_t i) const { return mtimes.empty() ? 0 : static_cast<time_t>(mtimes[i]); }
+    unsigned mode(size_t i) const { return modes.empty() ? 0 : modes[i]; }
+    uid_t uid(size_t i) const { return uids.empty() ? 0 : uids[i]; }
+    gid_t gid(size_t i) const { return gids.empty() ? 0 : gids[i]; }
+    ino_t inode(size_t i) const { return inodes.empty() ? 0 : inodes[i]; }
+
+    /**
+     * @brief Owner name, resolved through NameCache
+     */
+    NameHandle owner(size_t i) const { return NameCache::instance().user(uid(i)); }
+
+    /**
+     * @brief Group name, resolved through NameCache
+     */
+    NameHandle group(size_t i) const { return NameCache::instance().group(gid(i)); }
+
+    /**
+     * @brief Permission string of a row (e.g. "drwxr-xr-x")
+     */
+    std::string permissions(size_t i) const { return formatPermissions(mode(i)); }
+
+    void setType(size_t i, unsigned char type) { types[i] = type; }
+    void setFileSize(size_t i, uint64_t size) { if (!sizes.empty()) sizes[i] = size; }
+    void setModifiedTime(size_t i, time_t time) { if (!mtimes.empty()) mtimes[i] = time; }
+    void setMode(size_t i, unsigned mode) { if (!modes.empty()) modes[i] = static_cast<uint16_t>(mode); }
+    void setUid(size_t i, uid_t uid) { if (!uids.empty()) uids[i] = uid; }
+    void setGid(size_t i, gid_t gid) { if (!gids.empty()) gids[i] = gid; }
+    void setInode(size_t i, ino_t inode) { if (!inodes.empty()) inodes[i] = inode; }
+
+    /**
+     * @brief Bytes allocated by this batch
+     */
+    size_t memoryUsage() const;
+
+    /**
+     * @brief Write the ten character permission string of a mode into out
+     */
+    static void formatPermissions(unsigned mode, char* out);
+
+    /**
+     * @brief Format a mode as a permission string (e.g. "drwxr-xr-x")
+     */
+    static std::string formatPermissions(unsigned mode);
+
+private:
+    /**
+     * @brief Apply fn to every present metadata column
+     */
+    template <typename Fn>
+    void forEachColumn(Fn fn);
+
+    unsigned columns;                    ///< ListField mask of present columns
+    std::string directoryPath;           ///< Parent of every entry
+    std::string names;                   ///< Name arena
+    size_t garbageBytes = 0;             ///< Arena bytes of removed rows
+    std::vector<uint32_t> nameOffsets;   ///< Start of each name in the arena
+    std::vector<uint8_t> nameLengths;    ///< Length of each name (NAME_MAX is 255)
+    std::vector<uint8_t> types;          ///< DT_* type
+    std::vector<uint64_t> sizes;         ///< LIST_SIZE
+    std::vector<int64_t> mtimes;         ///< LIST_MTIME, seconds
+    std::vector<uint16_t> modes;         ///< LIST_MODE, raw st_mode
+    std::vector<uint32_t> uids;          ///< LIST_OWNER
+    std::vector<uint32_t> gids;          ///< LIST_GROUP
+    std::vector<uint64_t> inodes;        ///< LIST_INODE
+};
+
+/**
+ * @brief Consumer for a directory listing delivered in batches
+ */
+using ListingHandler = std::function<void(const FileInfoBatch& batch)>;
+
+#endif // FILE_INFO_BATCH_H
\ No newline at end of file
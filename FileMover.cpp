@@ -0,0 +1,319 @@
+#include "FileMover.h"
+#include "FileCopier.h"
+#include "TreeDeleter.h"
+#include "ParallelWalker.h"
+#include "JobControl.h"
+#include "Metrics.h"
+#include <stdexcept>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+/**
+ * @brief What a tree holds, for checking a copy against its source
+ */
+struct TreeSummary {
+    uint64_t directories = 0;
+    uint64_t files = 0;
+    uint64_t symlinks = 0;
+    uint64_t others = 0;   ///< FIFOs, sockets, devices
+    uint64_t bytes = 0;    ///< Sizes of the regular files
+    uint64_t errors = 0;   ///< Entries that could not be stat()ed
+
+    void add(const TreeSummary& other) {
+        directories += other.directories;
+        files += other.files;
+        symlinks += other.symlinks;
+        others += other.others;
+        bytes += other.bytes;
+        errors += other.errors;
+    }
+
+    bool matches(const TreeSummary& other) const {
+        return errors == 0 && other.errors == 0 && directories == other.directories && files == other.files &&
+               symlinks == other.symlinks && others == other.others && bytes == other.bytes;
+    }
+
+    string describe() const {
+        return to_string(directories) + " directories, " + to_string(files) + " files, " +
+               to_string(symlinks) + " links, " + to_string(others) + " others, " +
+               to_string(bytes) + " bytes" + (errors > 0 ? ", " + to_string(errors) + " unreadable" : "");
+    }
+};
+
+/**
+ * @brief Count a tree in parallel, one private summary per walker thread
+ */
+TreeSummary summarize(const string& root, unsigned threads) {
+    ParallelWalker walker(threads);
+    vector<TreeSummary> workers(walker.threadCount());
+    walker.walk(root, [&workers](const WalkEntry& entry) {
+        TreeSummary& summary = workers[entry.worker];
+        if (entry.type == DT_DIR) {
+            summary.directories++;
+            return true;
+        } else if (entry.type == DT_LNK) {
+            summary.symlinks++;
+        } else if (entry.type == DT_REG) {
+            struct stat st;
+            if (fstatat(entry.dirFd, entry.name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                summary.errors++;
+            } else {
+                summary.files++;
+                summary.bytes += static_cast<uint64_t>(st.st_size);
+            }
+        } else {
+            summary.others++;
+        }
+        return false;
+    });
+    TreeSummary total;
+    for (const TreeSummary& summary : workers) {
+        total.add(summary);
+    }
+    return total;
+}
+
+/**
+ * @brief Unused name next to path, in the same directory (and so on the same file system)
+ */
+string hiddenSibling(const string& path, const char* tag) {
+    static atomic<unsigned> counter{0};
+    size_t slash = path.find_last_of('/');
+    string parent = slash == string::npos ? "." : path.substr(0, max<size_t>(slash, 1));
+    string name = slash == string::npos ? path : path.substr(slash + 1);
+    return parent + (parent.back() == '/' ? "" : "/") + tag + name + "-" + to_string(getpid()) + "-" +
+           to_string(counter++);
+}
+
+/**
+ * @brief rename() that fails with EEXIST instead of replacing
+ *
+ * File systems without RENAME_NOREPLACE get a check-then-rename, which
+ * can race with another process creating the destination.
+ * @return 0, or the errno of the failure
+ */
+int renameNoReplace(const string& from, const string& to) {
+    FE_COUNT_SYSCALL(Rename, 1);
+    if (renameat2(AT_FDCWD, from.c_str(), AT_FDCWD, to.c_str(), RENAME_NOREPLACE) == 0) {
+        return 0;
+    }
+    if (errno != EINVAL) {
+        return errno;
+    }
+    struct stat st;
+    if (lstat(to.c_str(), &st) == 0) {
+        return EEXIST;
+    }
+    FE_COUNT_SYSCALL(Rename, 1);
+    return ::rename(from.c_str(), to.c_str()) == 0 ? 0 : errno;
+}
+
+/**
+ * @brief Put from at to and park what was at to under a hidden name
+ *
+ * RENAME_EXCHANGE swaps the two in one step, so to never goes missing,
+ * and the old entry is then renamed from the source's place to a hidden
+ * sibling. File systems without the flag get two renames instead.
+ * @param parked Receives the hidden path holding the old to
+ * @return 0, or the errno of the failure (nothing has changed then)
+ */
+int exchangeInto(const string& from, const string& to, string& parked) {
+    FE_COUNT_SYSCALL(Rename, 1);
+    if (renameat2(AT_FDCWD, from.c_str(), AT_FDCWD, to.c_str(), RENAME_EXCHANGE) == 0) {
+        parked = hiddenSibling(from, ".replaced-");
+        FE_COUNT_SYSCALL(Rename, 1);
+        if (::rename(from.c_str(), parked.c_str()) != 0) {
+            parked = from;  // Still out of the way of the destination
+        }
+        return 0;
+    }
+    if (errno != EINVAL) {
+        return errno;
+    }
+    parked = hiddenSibling(to, ".replaced-");
+    FE_COUNT_SYSCALL(Rename, 2);
+    if (::rename(to.c_str(), parked.c_str()) != 0) {
+        return errno;
+    }
+    if (::rename(from.c_str(), to.c_str()) != 0) {
+        int error = errno;
+        ::rename(parked.c_str(), to.c_str());
+        return error;
+    }
+    return 0;
+}
+
+/**
+ * @brief Give a copy the owner and times of its source (ownership only if permitted)
+ */
+void copyAttributes(const string& path, const struct stat& st) {
+    struct timespec times[2] = {st.st_atim, st.st_mtim};
+    utimensat(AT_FDCWD, path.c_str(), times, AT_SYMLINK_NOFOLLOW);
+    if (lchown(path.c_str(), st.st_uid, st.st_gid) != 0) {
+        // Only root may give files away; the copy keeps our ownership
+    }
+}
+
+/**
+ * @brief Remove a partial copy; best effort, and not cancellable
+ */
+void discard(const string& path, unsigned threads) {
+    JobControl::Scope uncancellable(nullptr);
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0) {
+        return;
+    }
+    try {
+        if (S_ISDIR(st.st_mode)) {
+            TreeDeleter(threads).remove(path);
+        } else {
+            ::unlink(path.c_str());
+        }
+    } catch (const exception&) {
+        // Leaves a hidden leftover; the move itself already failed
+    }
+}
+
+} // namespace
+
+FileMover::FileMover(const TreeCopyOptions& copyOptions, unsigned threads)
+    : copyOptions(copyOptions), threads(threads) {}
+
+MoveResult FileMover::move(const string& source, const string& destination, bool replace) {
+    auto start = chrono::steady_clock::now();
+    MoveResult result;
+
+    struct stat srcStat, dstStat;
+    if (lstat(source.c_str(), &srcStat) != 0) {
+        throw runtime_error("Source does not exist: " + source + ": " + strerror(errno));
+    }
+    if (lstat(destination.c_str(), &dstStat) == 0 &&
+        dstStat.st_dev == srcStat.st_dev && dstStat.st_ino == srcStat.st_ino) {
+        throw runtime_error("Source and destination are the same file: " + source);
+    }
+
+    int error = renameNoReplace(source, destination);
+    if (error == EEXIST) {
+        if (!replace) {
+            throw runtime_error("Destination exists: " + destination);
+        }
+        error = exchangeInto(source, destination, result.replaced);
+        result.strategy = MoveStrategy::Exchange;
+    }
+    if (error == EXDEV) {
+        result.strategy = MoveStrategy::Copy;
+        moveAcross(source, destination, srcStat, replace, result);
+    } else if (error != 0) {
+        throw runtime_error("Cannot move " + source + " to " + destination + ": " + strerror(error));
+    }
+
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+void FileMover::moveAcross(const string& source, const string& destination, const struct stat& srcStat,
+                           bool replace, MoveResult& result) {
+    string staged = hiddenSibling(destination, ".moving-");
+    try {
+        if (S_ISDIR(srcStat.st_mode)) {
+            TreeCopyStats stats = TreeCopier(copyOptions).copy(source, staged);
+            if (stats.errors > 0) {
+                throw runtime_error("Cannot copy " + source + ": " + stats.firstError);
+            }
+            result.files = stats.files + stats.symlinks;
+            result.bytes = stats.bytes;
+            TreeSummary original = summarize(source, threads);
+            TreeSummary copied = summarize(staged, threads);
+            if (!original.matches(copied)) {
+                throw runtime_error("Copy of " + source + " does not match it (" + original.describe() +
+                                    " against " + copied.describe() + ")");
+            }
+        } else if (S_ISREG(srcStat.st_mode)) {
+            CopyResult copied = FileCopier::copy(source, staged);
+            copyAttributes(staged, srcStat);
+            struct stat now, copy;
+            if (lstat(source.c_str(), &now) != 0 || now.st_size != srcStat.st_size ||
+                now.st_mtim.tv_sec != srcStat.st_mtim.tv_sec || now.st_mtim.tv_nsec != srcStat.st_mtim.tv_nsec) {
+                throw runtime_error("Source changed while it was being moved: " + source);
+            }
+            if (lstat(staged.c_str(), &copy) != 0 || copy.st_size != srcStat.st_size) {
+                throw runtime_error("Copy of " + source + " is incomplete");
+            }
+            result.files = 1;
+            result.bytes = copied.bytes;
+        } else if (S_ISLNK(srcStat.st_mode)) {
+            char target[PATH_MAX];
+            ssize_t length = readlink(source.c_str(), target, sizeof(target) - 1);
+            if (length < 0) {
+                throw runtime_error("Cannot read link: " + source + ": " + strerror(errno));
+            }
+            target[length] = '\0';
+            if (symlink(target, staged.c_str()) != 0) {
+                throw runtime_error("Cannot create link: " + staged + ": " + strerror(errno));
+            }
+            copyAttributes(staged, srcStat);
+            result.files = 1;
+        } else {
+            throw runtime_error("Cannot move " + source + " to another file system: not a file, link or directory");
+        }
+
+        // One flush of the whole destination file system before the only other copy goes
+        int dirFd = ::open(staged.substr(0, staged.find_last_of('/') + 1).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        FE_COUNT_SYSCALL(Open, 1);
+        if (dirFd >= 0) {
+            FE_COUNT_SYSCALL(Sync, 1);
+            syncfs(dirFd);
+            ::close(dirFd);
+        }
+        install(staged, destination, replace, result);
+    } catch (...) {
+        discard(staged, threads);
+        throw;
+    }
+
+    // The copy is in place; a half-deleted source would help nobody, so this part runs to the end
+    JobControl::Scope uncancellable(nullptr);
+    if (S_ISDIR(srcStat.st_mode)) {
+        DeleteStats removed = TreeDeleter(threads).remove(source);
+        result.sourceErrors = removed.errors;
+        result.firstError = removed.firstError;
+    } else if (::unlink(source.c_str()) != 0) {
+        result.sourceErrors = 1;
+        result.firstError = source + ": " + strerror(errno);
+    }
+}
+
+void FileMover::install(const string& staged, const string& destination, bool replace, MoveResult& result) {
+    int error = renameNoReplace(staged, destination);
+    if (error == EEXIST) {
+        if (!replace) {
+            throw runtime_error("Destination exists: " + destination);
+        }
+        error = exchangeInto(staged, destination, result.replaced);
+    }
+    if (error != 0) {
+        throw runtime_error("Cannot move into place: " + destination + ": " + strerror(error));
+    }
+}
+
+const char* FileMover::strategyName(MoveStrategy strategy) {
+    switch (strategy) {
+        case MoveStrategy::Rename:   return "rename";
+        case MoveStrategy::Exchange: return "atomic exchange";
+        case MoveStrategy::Copy:     return "copy and delete";
+    }
+    return "unknown";
+}
\ No newline at end of file
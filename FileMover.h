@@ -0,0 +1,89 @@
+#ifndef FILE_MOVER_H
+#define FILE_MOVER_H
+
+#include <string>
+#include <cstdint>
+#include <sys/stat.h>
+#include "TreeCopier.h"
+
+/**
+ * @brief How a move was carried out
+ */
+enum class MoveStrategy {
+    Rename,    ///< renameat2(RENAME_NOREPLACE): nothing was in the way
+    Exchange,  ///< renameat2(RENAME_EXCHANGE): swapped with the old destination in one step
+    Copy       ///< Across file systems: copied, verified, then the source deleted
+};
+
+/**
+ * @brief Outcome of a move
+ */
+struct MoveResult {
+    MoveStrategy strategy = MoveStrategy::Rename;
+    std::string replaced;       ///< Hidden path now holding the old destination, to delete later (empty if none)
+    uint64_t files = 0;         ///< Entries copied (Copy only)
+    uint64_t bytes = 0;         ///< File bytes copied (Copy only)
+    uint64_t sourceErrors = 0;  ///< Source entries left behind by the delete after a verified copy
+    std::string firstError;     ///< First of those failures
+    double seconds = 0.0;       ///< Wall time
+};
+
+/**
+ * @brief Move engine: atomic renames on one file system, verified copies across them
+ *
+ * A move first tries renameat2(RENAME_NOREPLACE). If the destination
+ * exists and may be replaced, the source is swapped with it through
+ * RENAME_EXCHANGE, so the destination is never missing, and the old
+ * destination is parked under a hidden name for the caller to delete
+ * whenever it likes; a large tree in the way costs nothing up front.
+ *
+ * On EXDEV the source is copied with FileCopier or TreeCopier to a hidden
+ * sibling of the destination. The copy is then verified against the
+ * source (counts of directories, files and links and the total file
+ * size, from a parallel walk of each side), flushed with a single
+ * syncfs(), and only then renamed into place. The source is deleted last,
+ * with TreeDeleter, so a failure or a cancelled job at any earlier point
+ * leaves the source untouched and removes the partial copy.
+ */
+class FileMover {
+public:
+    /**
+     * @brief Construct a mover
+     * @param copyOptions Settings for copies across file systems
+     * @param threads Walker threads for verifying and deleting (0 = hardware concurrency)
+     */
+    explicit FileMover(const TreeCopyOptions& copyOptions = TreeCopyOptions(), unsigned threads = 0);
+
+    /**
+     * @brief Move a file, symlink or directory tree
+     * @param source Existing path
+     * @param destination New path (not a directory to move into)
+     * @param replace Replace an existing destination rather than fail
+     * @return Strategy, totals and the parked old destination, if any
+     * @throws std::runtime_error if the move fails; the source is then still in place
+     * @throws JobCancelled if the job running the move was cancelled before the source was deleted
+     */
+    MoveResult move(const std::string& source, const std::string& destination, bool replace);
+
+    /**
+     * @brief Human-readable name of a strategy
+     */
+    static const char* strategyName(MoveStrategy strategy);
+
+private:
+    /**
+     * @brief Copy source to a hidden sibling of destination, verify it, then put it in place
+     */
+    void moveAcross(const std::string& source, const std::string& destination, const struct stat& srcStat,
+                    bool replace, MoveResult& result);
+
+    /**
+     * @brief Rename staged into destination, parking what was there if replace is set
+     */
+    void install(const std::string& staged, const std::string& destination, bool replace, MoveResult& result);
+
+    TreeCopyOptions copyOptions;
+    unsigned threads;
+};
+
+#endif // FILE_MOVER_H
\ No newline at end of file
@@ -1,29 +1,93 @@
 #include "FileOperations.h"
+#include "DirectoryReader.h"
+#include "ParallelWalker.h"
+#include "PathArena.h"
+#include "GlobMatcher.h"
+#include "ContentSearcher.h"
+#include "FileCopier.h"
+#include "FileMover.h"
+#include "IoBackend.h"
+#include "TreeDeleter.h"
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <cstring>
+#include <cerrno>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <pwd.h>
 #include <grp.h>
+#include <memory>
 #include <ctime>
 #include <iomanip>
 
 using namespace std;
 namespace fs = std::filesystem;
 
-FileOperations::FileOperations() {
+namespace {
+
+/// Columns shown by a directory listing; the directory cache holds exactly these
+constexpr unsigned LISTING_FIELDS = LIST_TYPE | LIST_SIZE | LIST_MODE | LIST_OWNER | LIST_GROUP | LIST_MTIME;
+
+/// Where this thread's messages go instead of stdout/stderr (see setThreadOutput)
+thread_local ostream* threadOutput = nullptr;
+
+ostream& out() {
+    return threadOutput ? *threadOutput : cout;
+}
+
+ostream& err() {
+    return threadOutput ? *threadOutput : cerr;
+}
+
+/// Warn that a walk skipped directories, so its results are not taken as complete
+void reportUnreadable(const ParallelWalker& walker) {
+    if (walker.unreadableDirectories() > 0) {
+        err() << walker.unreadableDirectories() << " directories could not be read; first error: "
+              << walker.firstError() << endl;
+    }
+}
+
+} // namespace
+
+FileOperations::FileOperations() : searchThreads(0), dirCache(LISTING_FIELDS), interactive(true) {
     currentPath = fs::current_path().string();
 }
 
+FileOperations::FileOperations(const string& directory)
+    : currentPath(directory), searchThreads(0), dirCache(LISTING_FIELDS), interactive(true) {}
+
+FileOperations::~FileOperations() {
+    // Let background deletes finish rather than leaving trash behind
+    if (backgroundWorker.joinable()) {
+        backgroundWorker.join();
+    }
+}
+
 string FileOperations::getCurrentPath() const {
     return currentPath;
 }
 
-void FileOperations::listDirectory(const string& path) {
+void FileOperations::setInteractive(bool enabled) {
+    interactive = enabled;
+}
+
+void FileOperations::setThreadOutput(ostream* stream) {
+    threadOutput = stream;
+}
+
+size_t FileOperations::listDirectory(const string& path, const ListingHandler& onBatch,
+                                     const SortOptions& sort) {
     string targetPath = path.empty() ? currentPath : getAbsolutePath(path);
+
+    // "ls dir/*.log" lists dir, keeping only names that match the last component
+    unique_ptr<GlobMatcher> filter;
+    string leaf = fs::path(targetPath).filename().string();
+    if (GlobMatcher::hasWildcards(leaf)) {
+        filter = make_unique<GlobMatcher>(leaf);
+        targetPath = fs::path(targetPath).parent_path().string();
+    }
     
     if (!fs::exists(targetPath)) {
         throw runtime_error("Directory does not exist: " + targetPath);
@@ -33,59 +97,111 @@ void FileOperations::listDirectory(const string& path) {
         throw runtime_error("Not a directory: " + targetPath);
     }
 
-    cout << "\nContents of " << targetPath << ":\n";
-    cout << "--------------------------------------------------\n";
-    cout << setw(10) << "Type" << setw(15) << "Size" << setw(20) << "Owner"
-         << setw(10) << "Perms" << setw(25) << "Modified" << "  " << "Name\n";
-    cout << "--------------------------------------------------\n";
+    // Sorting needs the whole listing, so a sorted listing goes out as one batch
+    const bool sorted = sort.key != SortKey::None || sort.reverse;
+    auto deliver = [&](FileInfoBatch& listing) {
+        if (sorted) {
+            ListingSorter(sort).sort(listing);
+        }
+        if (!listing.empty()) {
+            onBatch(listing);
+        }
+        return listing.size();
+    };
+
+    const FileInfoBatch* cached = dirCache.find(targetPath);
+    if (cached && !filter && !sorted) {
+        // A cached listing is already complete, so it goes out as one batch
+        if (!cached->empty()) {
+            onBatch(*cached);
+        }
+        return cached->size();
+    }
+    if (cached) {
+        FileInfoBatch listing(cached->fields(), targetPath);
+        for (size_t i = 0; i < cached->size(); ++i) {
+            string_view name = cached->name(i);
+            if (!filter || filter->matches(name.data(), name.size())) {
+                listing.appendRow(*cached, i);
+            }
+        }
+        return deliver(listing);
+    }
 
-    for (const auto& entry : fs::directory_iterator(targetPath)) {
-        try {
-            // Get file status
-            const auto& path = entry.path();
-            const auto status = fs::status(path);
-            
-            // Get file permissions
-            string perms = "";
-            perms += (fs::is_directory(status)) ? 'd' : '-';
-            perms += (status.permissions() & fs::perms::owner_read) != fs::perms::none ? 'r' : '-';
-            perms += (status.permissions() & fs::perms::owner_write) != fs::perms::none ? 'w' : '-';
-            perms += (status.permissions() & fs::perms::owner_exec) != fs::perms::none ? 'x' : '-';
-            perms += (status.permissions() & fs::perms::group_read) != fs::perms::none ? 'r' : '-';
-            perms += (status.permissions() & fs::perms::group_write) != fs::perms::none ? 'w' : '-';
-            perms += (status.permissions() & fs::perms::group_exec) != fs::perms::none ? 'x' : '-';
-            perms += (status.permissions() & fs::perms::others_read) != fs::perms::none ? 'r' : '-';
-            perms += (status.permissions() & fs::perms::others_write) != fs::perms::none ? 'w' : '-';
-            perms += (status.permissions() & fs::perms::others_exec) != fs::perms::none ? 'x' : '-';
-
-            // Get file size
-            uintmax_t size = fs::is_directory(status) ? 0 : fs::file_size(path);
-            
-            // Get last write time
-            auto ftime = fs::last_write_time(path);
-            auto sctp = chrono::time_point_cast<chrono::system_clock::duration>(
-                ftime - fs::file_time_type::clock::now() + chrono::system_clock::now());
-            time_t cftime = chrono::system_clock::to_time_t(sctp);
-            
-            // Get owner and group
-            struct stat fileStat;
-            stat(path.string().c_str(), &fileStat);
-            struct passwd *pw = getpwuid(fileStat.st_uid);
-            struct group *gr = getgrgid(fileStat.st_gid);
-            
-            // Print file info
-            cout << setw(10) << (fs::is_directory(status) ? "<DIR>" : "<FILE>")
-                 << setw(15) << size
-                 << setw(20) << (pw ? pw->pw_name : "unknown")
-                 << setw(10) << perms
-                 << setw(25) << put_time(localtime(&cftime), "%Y-%m-%d %H:%M:%S")
-                 << "  " << path.filename().string() << endl;
-                
-        } catch (const exception& e) {
-            cerr << "Error accessing " << entry.path() << ": " << e.what() << endl;
+    // Only the columns the listing shows are fetched
+    DirectoryReader reader(LISTING_FIELDS);
+    if (filter) {
+        // Partial listing; not cached
+        if (!sorted) {
+            return reader.read(targetPath, onBatch, filter.get());
+        }
+        FileInfoBatch listing = reader.read(targetPath, filter.get());
+        return deliver(listing);
+    }
+    FileInfoBatch all(LISTING_FIELDS, targetPath);
+    size_t count = reader.read(targetPath, [&](const FileInfoBatch& batch) {
+        if (!sorted) {
+            onBatch(batch);
         }
+        all.append(batch);
+    });
+    if (sorted) {
+        deliver(all);  // The cache doesn't mind what order its rows are in
     }
-    cout << endl;
+    dirCache.insert(targetPath, std::move(all));
+    return count;
+}
+
+FileInfoBatch FileOperations::getFileInfo(const string& path) const {
+    fs::path target(getAbsolutePath(path));
+    string parent = target.has_relative_path() ? target.parent_path().string() : target.string();
+    string name = target.has_relative_path() ? target.filename().string() : ".";
+
+    FileInfoBatch info(LISTING_FIELDS, parent);
+    if (!DirectoryReader(LISTING_FIELDS).readEntry(parent, name, info)) {
+        throw runtime_error("Cannot access: " + target.string() + ": " + strerror(errno));
+    }
+    return info;
+}
+
+string FileOperations::readFile(const string& fileName) const {
+    FileViewer viewer(getAbsolutePath(fileName));
+    string content;
+    content.reserve(viewer.size());
+    viewer.read(0, viewer.size(), [&content](string_view text) {
+        content.append(text);
+    });
+    return content;
+}
+
+bool FileOperations::createFile(const string& fileName, const string& content) {
+    string path = getAbsolutePath(fileName);
+    if (fs::exists(fs::symlink_status(path))) {
+        return false;
+    }
+    WriteOptions options;
+    options.exclusive = true;
+    FileWriter::writeFile(path, content, options);
+    return true;
+}
+
+bool FileOperations::writeFile(const string& fileName, const string& content, bool append) {
+    WriteOptions options;
+    options.append = append;
+    return writeFile(fileName, content, options);
+}
+
+bool FileOperations::writeFile(const string& fileName, string_view content, const WriteOptions& options) {
+    FileWriter::writeFile(getAbsolutePath(fileName), content, options);
+    return true;
+}
+
+unique_ptr<FileWriter> FileOperations::openWriter(const string& fileName, const WriteOptions& options) const {
+    return make_unique<FileWriter>(getAbsolutePath(fileName), options);
+}
+
+unique_ptr<FileViewer> FileOperations::openViewer(const string& fileName) const {
+    return make_unique<FileViewer>(getAbsolutePath(fileName));
 }
 
 void FileOperations::changeDirectory(const string& path) {
@@ -100,48 +216,80 @@ void FileOperations::changeDirectory(const string& path) {
     }
     
     currentPath = fs::canonical(newPath).string();
-    cout << "Changed directory to: " << currentPath << endl;
+    out() << "Changed directory to: " << currentPath << endl;
 }
 
-void FileOperations::createDirectory(const string& dirName) {
+bool FileOperations::createDirectory(const string& dirName, bool createParents) {
     string fullPath = getAbsolutePath(dirName);
     
     if (fs::exists(fullPath)) {
-        throw runtime_error("File or directory already exists: " + fullPath);
+        if (fs::is_directory(fullPath)) {
+            return false;
+        }
+        throw runtime_error("File already exists: " + fullPath);
     }
     
-    if (!fs::create_directory(fullPath)) {
-        throw runtime_error("Failed to create directory: " + fullPath);
+    if (createParents) {
+        fs::create_directories(fullPath);
+    } else if (mkdir(fullPath.c_str(), 0777) != 0) {
+        throw runtime_error("Failed to create directory " + fullPath + ": " + strerror(errno));
     }
     
-    cout << "Created directory: " << fullPath << endl;
+    out() << "Created directory: " << fullPath << endl;
+    return true;
 }
 
-void FileOperations::remove(const string& path) {
+bool FileOperations::remove(const string& path, bool background) {
     string targetPath = getAbsolutePath(path);
     
-    if (!fs::exists(targetPath)) {
+    if (!fs::exists(fs::symlink_status(targetPath))) {
         throw runtime_error("File or directory does not exist: " + targetPath);
     }
     
-    if (fs::is_directory(targetPath)) {
+    if (fs::is_directory(fs::symlink_status(targetPath))) {
         // Ask for confirmation before removing directory
-        cout << "Are you sure you want to remove the directory and all its contents? (y/n): ";
-        char confirm;
-        cin >> confirm;
-        if (confirm != 'y' && confirm != 'Y') {
-            cout << "Operation cancelled." << endl;
-            return;
+        if (interactive) {
+            cout << "Are you sure you want to remove the directory and all its contents? (y/n): ";
+            char confirm;
+            cin >> confirm;
+            if (confirm != 'y' && confirm != 'Y') {
+                cout << "Operation cancelled." << endl;
+                return false;
+            }
+        }
+
+        if (background) {
+            // Rename out of the way now; the actual delete happens on a background thread
+            deleteInBackground(TreeDeleter::moveToTrash(targetPath));
+            out() << "Removed: " << targetPath << " (deleting in background)" << endl;
+            return true;
+        }
+
+        TreeDeleter deleter(searchThreads);
+        TreeDeleter::ProgressCallback progress;
+        if (interactive) {
+            progress = [](uint64_t entries, double seconds) {
+                cout << "\rDeleted " << entries << " entries (" << fixed << setprecision(0)
+                     << (seconds > 0 ? entries / seconds : 0.0) << " entries/s)" << flush;
+            };
+        }
+        DeleteStats stats = deleter.remove(targetPath, progress);
+        out() << (interactive ? "\r" : "") << "Deleted " << stats.files << " files and " << stats.directories
+              << " directories in " << fixed << setprecision(2) << stats.seconds << " s ("
+              << setprecision(0) << stats.entriesPerSecond() << " entries/s)" << endl;
+        if (stats.errors > 0) {
+            err() << stats.errors << " entries could not be removed; first error: " << stats.firstError << endl;
+            return false;
         }
-        fs::remove_all(targetPath);
     } else {
         fs::remove(targetPath);
     }
     
-    cout << "Removed: " << targetPath << endl;
+    out() << "Removed: " << targetPath << endl;
+    return true;
 }
 
-void FileOperations::copyFile(const string& source, const string& destination) {
+bool FileOperations::copyFile(const string& source, const string& destination, bool overwrite) {
     string srcPath = getAbsolutePath(source);
     string destPath = getAbsolutePath(destination);
     
@@ -154,25 +302,50 @@ void FileOperations::copyFile(const string& source, const string& destination) {
         destPath += "/" + fs::path(srcPath).filename().string();
     }
     
-    if (fs::exists(destPath)) {
+    if (!overwrite && interactive && fs::exists(destPath)) {
         cout << "Destination file already exists. Overwrite? (y/n): ";
         char confirm;
         cin >> confirm;
         if (confirm != 'y' && confirm != 'Y') {
             cout << "Operation cancelled." << endl;
-            return;
+            return false;
         }
     }
     
-    fs::copy(srcPath, destPath, fs::copy_options::overwrite_existing);
-    cout << "Copied " << srcPath << " to " << destPath << endl;
+    if (fs::is_directory(srcPath)) {
+        TreeCopier copier(copyOptions);
+        TreeCopyStats stats = copier.copy(srcPath, destPath);
+        out() << "Copied " << srcPath << " to " << destPath << ": "
+              << stats.files << " files, " << stats.directories << " directories, "
+              << stats.symlinks << " links, " << fixed << setprecision(1)
+              << (stats.bytes / (1024.0 * 1024.0)) << " MB in " << stats.seconds << " s ("
+              << (stats.seconds > 0 ? stats.files / stats.seconds : 0.0) << " files/s)" << endl;
+        if (stats.errors > 0) {
+            err() << stats.errors << " entries failed; first error: " << stats.firstError << endl;
+            return false;
+        }
+        return true;
+    }
+
+    if (!fs::is_regular_file(srcPath)) {
+        fs::copy(srcPath, destPath, fs::copy_options::overwrite_existing);
+        out() << "Copied " << srcPath << " to " << destPath << endl;
+        return true;
+    }
+
+    CopyResult result = FileCopier::copy(srcPath, destPath);
+    out() << "Copied " << srcPath << " to " << destPath
+          << " (" << FileCopier::strategyName(result.strategy)
+          << (result.sparse ? ", sparse" : "") << ", "
+          << fixed << setprecision(1) << result.throughputMBps() << " MB/s)" << endl;
+    return true;
 }
 
-void FileOperations::moveFile(const string& source, const string& destination) {
+bool FileOperations::moveFile(const string& source, const string& destination, bool overwrite) {
     string srcPath = getAbsolutePath(source);
     string destPath = getAbsolutePath(destination);
     
-    if (!fs::exists(srcPath)) {
+    if (!fs::exists(fs::symlink_status(srcPath))) {
         throw runtime_error("Source does not exist: " + srcPath);
     }
     
@@ -181,39 +354,280 @@ void FileOperations::moveFile(const string& source, const string& destination) {
         destPath += "/" + fs::path(srcPath).filename().string();
     }
     
-    if (fs::exists(destPath)) {
+    if (!overwrite && interactive && fs::exists(fs::symlink_status(destPath))) {
         cout << "Destination file already exists. Overwrite? (y/n): ";
         char confirm;
         cin >> confirm;
         if (confirm != 'y' && confirm != 'Y') {
             cout << "Operation cancelled." << endl;
-            return;
+            return false;
         }
-        fs::remove_all(destPath);
     }
-    
-    fs::rename(srcPath, destPath);
-    cout << "Moved " << srcPath << " to " << destPath << endl;
+
+    MoveResult result = FileMover(copyOptions, searchThreads).move(srcPath, destPath, true);
+    if (!result.replaced.empty()) {
+        deleteInBackground(result.replaced);
+    }
+    out() << "Moved " << srcPath << " to " << destPath;
+    if (result.strategy == MoveStrategy::Copy) {
+        out() << " (" << FileMover::strategyName(result.strategy) << ": " << result.files << " files, "
+              << fixed << setprecision(1) << (result.bytes / (1024.0 * 1024.0)) << " MB in "
+              << result.seconds << " s)";
+    } else if (result.strategy == MoveStrategy::Exchange) {
+        out() << " (" << FileMover::strategyName(result.strategy) << ")";
+    }
+    out() << endl;
+    if (result.sourceErrors > 0) {
+        err() << result.sourceErrors << " source entries could not be removed; first error: "
+              << result.firstError << endl;
+    }
+    return true;
+}
+
+PathBatch FileOperations::expandPaths(const vector<string>& patterns) const {
+    return PathBatch::expand(patterns, currentPath, searchThreads);
+}
+
+bool FileOperations::removePaths(const PathBatch& targets, bool background) {
+    return reportBatch("Removed", targets.remove(searchThreads, background));
+}
+
+bool FileOperations::movePaths(const PathBatch& sources, const string& destination) {
+    string destPath = getAbsolutePath(destination);
+    if (!fs::is_directory(destPath)) {
+        if (sources.size() == 1) {
+            const PathGroup& group = sources.groups().front();
+            return moveFile(group.directory + "/" + group.names.front(), destPath);
+        }
+        throw runtime_error("Not a directory: " + destPath);
+    }
+    sources.requireDistinctNames("move");  // Before asking about replacements
+    if (!confirmReplace(sources, destPath)) {
+        return false;
+    }
+    return reportBatch("Moved", sources.moveInto(destPath, copyOptions, searchThreads));
+}
+
+bool FileOperations::copyPaths(const PathBatch& sources, const string& destination) {
+    string destPath = getAbsolutePath(destination);
+    if (!fs::is_directory(destPath)) {
+        if (sources.size() == 1) {
+            const PathGroup& group = sources.groups().front();
+            return copyFile(group.directory + "/" + group.names.front(), destPath);
+        }
+        throw runtime_error("Not a directory: " + destPath);
+    }
+    sources.requireDistinctNames("copy");  // Before asking about replacements
+    if (!confirmReplace(sources, destPath)) {
+        return false;
+    }
+    return reportBatch("Copied", sources.copyInto(destPath, copyOptions));
 }
 
 void FileOperations::searchFile(const string& fileName) {
-    cout << "Searching for '" << fileName << "' in " << currentPath << "..." << endl;
+    out() << "Searching for '" << fileName << "' in " << currentPath << "..." << endl;
     size_t foundCount = 0;
-    
-    for (const auto& entry : fs::recursive_directory_iterator(currentPath)) {
-        try {
-            if (entry.is_regular_file() && 
-                entry.path().filename().string().find(fileName) != string::npos) {
-                cout << "Found: " << entry.path().string() << endl;
+
+    // Plain names keep the substring behaviour; anything with wildcards is a glob
+    unique_ptr<GlobMatcher> glob;
+    if (GlobMatcher::hasWildcards(fileName)) {
+        glob = make_unique<GlobMatcher>(fileName);
+    }
+
+    if (const FileIndex* fileIndex = currentIndexFor(currentPath)) {
+        auto report = [&](string&& path, unsigned char type) {
+            // Symlinks count when they point at a regular file, as with is_regular_file()
+            struct stat st;
+            if (type == DT_REG || (type == DT_LNK && stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))) {
+                out() << "Found: " << path << endl;
                 foundCount++;
             }
+        };
+        if (glob) {
+            fileIndex->findGlob(currentPath, *glob, report);
+        } else {
+            fileIndex->findSubstring(currentPath, fileName, report);
+        }
+        out() << "Found " << foundCount << " matching files (from index of " << fileIndex->root() << ")." << endl;
+        return;
+    }
+
+    ParallelWalker walker(searchThreads);
+    walker.walk(currentPath, [&](const WalkEntry& entry) {
+        if (entry.type == DT_DIR) {
+            return true;
+        }
+        bool matched = glob ? glob->matches(entry.name, strlen(entry.name))
+                            : strstr(entry.name, fileName.c_str()) != nullptr;
+        if (!matched) {
+            return false;
+        }
+        // Symlinks count when they point at a regular file, as with is_regular_file()
+        struct stat st;
+        if (entry.type == DT_REG ||
+            (entry.type == DT_LNK && fstatat(entry.dirFd, entry.name, &st, 0) == 0 && S_ISREG(st.st_mode))) {
+            walker.emit(entry.path());
+        }
+        return false;
+    }, [&](string&& result) {
+        out() << "Found: " << result << endl;
+        foundCount++;
+    });
+
+    out() << "Found " << foundCount << " matching files." << endl;
+    reportUnreadable(walker);
+}
+
+void FileOperations::setSearchThreads(unsigned threads) {
+    searchThreads = threads;
+}
+
+DirectoryCacheStats FileOperations::directoryCacheStats() const {
+    return dirCache.stats();
+}
+
+void FileOperations::clearDirectoryCache() {
+    dirCache.clear();
+}
+
+string FileOperations::setIoBackend(const string& name) {
+    return IoBackend::select(IoBackend::parseKind(name))->name();
+}
+
+void FileOperations::setCopyConcurrency(unsigned threads, size_t queueDepth) {
+    copyOptions.copyThreads = threads;
+    copyOptions.queueDepth = queueDepth;
+}
+
+vector<string> FileOperations::findFiles(const string& pattern) const {
+    vector<string> results;
+    if (const FileIndex* fileIndex = currentIndexFor(currentPath)) {
+        fileIndex->findGlob(currentPath, GlobMatcher(pattern), [&](string&& path, unsigned char type) {
+            if (type != DT_DIR) {
+                results.push_back(std::move(path));
+            }
+        });
+        return results;
+    }
+    searchFilesRecursive(currentPath, pattern, results);
+    return results;
+}
+
+IndexStats FileOperations::buildIndex(const string& path) {
+    string root = getAbsolutePath(path);
+    if (!fs::is_directory(root)) {
+        throw runtime_error("Not a directory: " + root);
+    }
+    index = FileIndex::build(root, searchThreads);
+    return index->stats();
+}
+
+IndexStats FileOperations::refreshIndex() {
+    const FileIndex* current = indexFor(currentPath);
+    if (!current) {
+        throw runtime_error("No index covers " + currentPath + " (use 'index build')");
+    }
+    index = current->refresh(searchThreads);
+    return index->stats();
+}
+
+IndexStats FileOperations::indexStats() const {
+    const FileIndex* current = indexFor(currentPath);
+    if (!current) {
+        throw runtime_error("No index covers " + currentPath + " (use 'index build')");
+    }
+    return current->stats();
+}
+
+DiskUsageReport FileOperations::diskUsage(const string& path, size_t top) const {
+    string targetPath = path.empty() ? currentPath : getAbsolutePath(path);
+    if (!fs::is_directory(targetPath)) {
+        throw runtime_error("Not a directory: " + targetPath);
+    }
+    return DiskUsageScanner(searchThreads).scan(targetPath, top);
+}
+
+DuplicateReport FileOperations::findDuplicates(const string& path, bool verify) const {
+    string targetPath = path.empty() ? currentPath : getAbsolutePath(path);
+    if (!fs::is_directory(targetPath)) {
+        throw runtime_error("Not a directory: " + targetPath);
+    }
+    return DuplicateFinder(searchThreads, verify).find(targetPath);
+}
+
+const FileIndex* FileOperations::indexFor(const string& path) const {
+    if (index && index->covers(path)) {
+        return index.get();
+    }
+    // An index of any ancestor directory will do; each probe is a single access()
+    for (fs::path dir = fs::path(path).lexically_normal(); ; dir = dir.parent_path()) {
+        string candidate = dir.string();
+        while (candidate.size() > 1 && candidate.back() == '/') {
+            candidate.pop_back();
+        }
+        unique_ptr<FileIndex> loaded;
+        try {
+            loaded = FileIndex::open(candidate);
         } catch (const exception& e) {
-            // Skip files we can't access
-            continue;
+            // A corrupt index is as good as none; 'index build' replaces it
+            err() << "Ignoring index of " << candidate << ": " << e.what() << endl;
+        }
+        if (loaded && loaded->covers(path)) {
+            index = std::move(loaded);
+            return index.get();
+        }
+        if (dir == dir.parent_path()) {
+            return nullptr;
         }
     }
-    
-    cout << "Found " << foundCount << " matching files." << endl;
+}
+
+const FileIndex* FileOperations::currentIndexFor(const string& path) const {
+    const FileIndex* fileIndex = indexFor(path);
+    if (!fileIndex || fileIndex->changedDirectories(path, searchThreads) == 0) {
+        return fileIndex;
+    }
+    // Stale: a refresh re-reads only the changed directories, and later queries reuse it
+    try {
+        index = fileIndex->refresh(searchThreads);
+        return index.get();
+    } catch (const exception& e) {
+        err() << "Cannot refresh index of " << fileIndex->root() << ": " << e.what() << endl;
+        return nullptr;
+    }
+}
+
+void FileOperations::searchFilesRecursive(const string& dirPath,
+                                          const string& pattern,
+                                          vector<string>& results) const {
+    const GlobMatcher glob(pattern);  // compiled once, shared read-only by all workers
+    ParallelWalker walker(searchThreads);
+    walker.walk(dirPath, [&](const WalkEntry& entry) {
+        if (entry.type == DT_DIR) {
+            return true;
+        }
+        if (glob.matches(entry.name, strlen(entry.name))) {
+            walker.emit(entry.path());
+        }
+        return false;
+    }, [&](string&& result) {
+        results.push_back(std::move(result));
+    });
+    reportUnreadable(walker);
+}
+
+vector<string> FileOperations::findInFiles(const string& searchString,
+                                           const string& filePattern) const {
+    ContentSearcher searcher(searchString, searchThreads);
+    vector<string> results;
+    for (const auto& match : searcher.searchTree(currentPath, GlobMatcher(filePattern))) {
+        results.push_back(match.path + ":" + to_string(match.line) + ":" + to_string(match.offset));
+    }
+    return results;
+}
+
+bool FileOperations::matchesPattern(const string& filename, const string& pattern) const {
+    return GlobMatcher(pattern).matches(filename);
 }
 
 string FileOperations::getAbsolutePath(const string& path) const {
@@ -221,9 +635,87 @@ string FileOperations::getAbsolutePath(const string& path) const {
         return currentPath;
     }
     
-    if (fs::path(path).is_absolute()) {
+    if (path[0] == '/') {
         return path;
     }
-    
-    return (fs::path(currentPath) / path).lexically_normal().string();
+
+    PathBuffer absolute;
+    absolute.assign(currentPath);
+    absolute.append(path);
+    return absolute.str();
+}
+
+void FileOperations::deleteInBackground(const string& trash) {
+    lock_guard<mutex> lock(backgroundMutex);
+    backgroundQueue.emplace_back(trash, searchThreads);
+    if (backgroundRunning) {
+        return;
+    }
+    if (backgroundWorker.joinable()) {
+        backgroundWorker.join();  // Finished with an empty queue; it no longer needs the lock
+    }
+    backgroundRunning = true;
+    backgroundWorker = thread(&FileOperations::drainBackgroundDeletes, this);
+}
+
+void FileOperations::drainBackgroundDeletes() {
+    while (true) {
+        pair<string, unsigned> item;
+        {
+            lock_guard<mutex> lock(backgroundMutex);
+            if (backgroundQueue.empty()) {
+                backgroundRunning = false;
+                return;
+            }
+            item = std::move(backgroundQueue.front());
+            backgroundQueue.pop_front();
+        }
+        const string& trash = item.first;
+        try {
+            struct stat st;
+            if (lstat(trash.c_str(), &st) == 0 && !S_ISDIR(st.st_mode)) {
+                fs::remove(trash);
+            } else {
+                TreeDeleter(item.second).remove(trash);
+            }
+        } catch (const exception& e) {
+            cerr << "Background delete of " << trash << " failed: " << e.what() << endl;
+        }
+    }
+}
+
+bool FileOperations::confirmReplace(const PathBatch& sources, const string& directory) const {
+    if (!interactive) {
+        return true;
+    }
+    size_t existing = sources.existingIn(directory);
+    if (existing == 0) {
+        return true;
+    }
+    cout << existing << " of " << sources.size() << " entries already exist in " << directory
+         << ". Overwrite? (y/n): ";
+    char confirm;
+    cin >> confirm;
+    if (confirm != 'y' && confirm != 'Y') {
+        cout << "Operation cancelled." << endl;
+        return false;
+    }
+    return true;
+}
+
+bool FileOperations::reportBatch(const char* verb, const BatchStats& stats) {
+    for (const string& leftover : stats.leftovers) {
+        deleteInBackground(leftover);
+    }
+    out() << verb << " " << stats.done << " entries";
+    if (stats.bytes > 0) {
+        out() << " (" << fixed << setprecision(1) << (stats.bytes / (1024.0 * 1024.0)) << " MB)";
+    }
+    out() << " in " << fixed << setprecision(2) << stats.seconds << " s ("
+          << setprecision(0) << (stats.seconds > 0 ? stats.done / stats.seconds : 0.0) << " entries/s)" << endl;
+    if (stats.errors > 0) {
+        err() << stats.errors << " entries failed; first error: " << stats.firstError << endl;
+        return false;
+    }
+    return true;
 }
\ No newline at end of file
@@ -4,22 +4,24 @@
 #include <string>
 #include <cstdint>
 #include <vector>
+#include <deque>
+#include <utility>
 #include <filesystem>
 #include <fstream>
-
-/**
- * @brief Structure to hold file information
- */
-struct FileInfo {
-    std::string name;           ///< Name of the file/directory
-    std::string path;           ///< Full path to the file/directory
-    uintmax_t size;             ///< Size in bytes (0 for directories)
-    std::string permissions;    ///< File permissions in rwx format
-    std::string owner;          ///< File owner username
-    std::string group;          ///< File group name
-    time_t modifiedTime;        ///< Last modification time
-    bool isDirectory;           ///< True if this is a directory
-};
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "FileInfoBatch.h"
+#include "ListingSorter.h"
+#include "DiskUsage.h"
+#include "DuplicateFinder.h"
+#include "FileViewer.h"
+#include "FileWriter.h"
+#include "TreeCopier.h"
+#include "PathBatch.h"
+#include "FileIndex.h"
+#include "DirectoryCache.h"
 
 /**
  * @brief Handles all file system operations for the file explorer
@@ -34,6 +36,39 @@ public:
      */
     FileOperations();
 
+    /**
+     * @brief Start in a given directory instead of the process's working directory
+     * @param directory Absolute, canonical path
+     */
+    explicit FileOperations(const std::string& directory);
+
+    /**
+     * @brief Waits for any background deletes to finish
+     */
+    ~FileOperations();
+
+    FileOperations(const FileOperations&) = delete;
+    FileOperations& operator=(const FileOperations&) = delete;
+
+    // ==================== Console ====================
+
+    /**
+     * @brief Turn confirmation prompts on or off
+     *
+     * When off (batch mode), nothing is read from stdin: overwrites and
+     * recursive deletes go ahead as if confirmed, and no progress is drawn.
+     */
+    void setInteractive(bool enabled);
+
+    /**
+     * @brief Send the calling thread's messages to a stream instead of stdout/stderr
+     *
+     * Lets commands run on worker threads keep their output apart, to be
+     * printed in order afterwards.
+     * @param stream Destination, or nullptr to go back to stdout/stderr
+     */
+    static void setThreadOutput(std::ostream* stream);
+
     // ==================== Directory Operations ====================
     
     /**
@@ -43,11 +78,19 @@ public:
     std::string getCurrentPath() const;
 
     /**
-     * @brief List contents of a directory
-     * @param path Path to list (defaults to current directory if empty)
+     * @brief Stream the contents of a directory
+     *
+     * Listings of directories seen before are served from the directory cache.
+     * @param path Path to list (current directory if empty); a glob in the
+     *             last component (e.g. "*.log" or "logs/app-*") filters the listing
+     * @param onBatch Receives entries in batches while the directory is still being read;
+     *                a sorted listing arrives as a single batch once it is complete
+     * @param sort Order of the listing (on-disk order by default)
+     * @return Number of entries listed
      * @throws std::runtime_error if the directory cannot be accessed
      */
-    void listDirectory(const std::string& path = "");
+    size_t listDirectory(const std::string& path, const ListingHandler& onBatch,
+                         const SortOptions& sort = SortOptions());
 
     /**
      * @brief Change the current working directory
@@ -60,7 +103,7 @@ public:
      * @brief Create a new directory
      * @param dirName Name of the directory to create
      * @param createParents If true, creates parent directories as needed
-     * @return true if directory was created, false if it already exists
+     * @return true if directory was created, false if a directory of that name already exists
      * @throws std::runtime_error if the directory cannot be created
      */
     bool createDirectory(const std::string& dirName, bool createParents = false);
@@ -78,6 +121,9 @@ public:
 
     /**
      * @brief Create a new empty file
+     *
+     * The file appears complete or not at all, and an existing file is
+     * never replaced, even by a racing writer (RENAME_NOREPLACE).
      * @param fileName Name of the file to create
      * @param content Optional content to write to the file
      * @return true if file was created, false if it already exists
@@ -87,12 +133,23 @@ public:
 
     /**
      * @brief Read the contents of a file
+     *
+     * The whole file ends up in memory; use openViewer() to look at files
+     * that may be large.
      * @param fileName Name of the file to read
      * @return File contents as a string
      * @throws std::runtime_error if the file cannot be read
      */
     std::string readFile(const std::string& fileName) const;
 
+    /**
+     * @brief Open a file for paged reading (view, cat, head, tail)
+     * @param fileName Name of the file to open
+     * @return Viewer mapping the file a window at a time
+     * @throws std::runtime_error if the file cannot be opened or is not a regular file
+     */
+    std::unique_ptr<FileViewer> openViewer(const std::string& fileName) const;
+
     /**
      * @brief Write content to a file
      * @param fileName Name of the file to write to
@@ -103,6 +160,28 @@ public:
      */
     bool writeFile(const std::string& fileName, const std::string& content, bool append = false);
 
+    /**
+     * @brief Write content to a file with explicit durability and atomicity
+     * @param fileName Name of the file to write to
+     * @param content Content to write
+     * @param options Append, atomic replace, backup, sync, O_DIRECT, batching
+     * @return true if write was successful
+     * @throws std::runtime_error if the file cannot be written
+     */
+    bool writeFile(const std::string& fileName, std::string_view content, const WriteOptions& options);
+
+    /**
+     * @brief Open a file for streaming writes
+     *
+     * Nothing is visible at fileName until the writer's commit() (unless
+     * appending); a writer dropped without commit() leaves the file as it was.
+     * @param fileName Name of the file to write to
+     * @param options How the data is put in place
+     * @throws std::runtime_error if the file cannot be created
+     */
+    std::unique_ptr<FileWriter> openWriter(const std::string& fileName,
+                                           const WriteOptions& options = WriteOptions()) const;
+
     /**
      * @brief Delete a file
      * @param path Path to the file to delete
@@ -112,7 +191,16 @@ public:
     bool deleteFile(const std::string& path);
 
     /**
-     * @brief Copy a file
+     * @brief Remove a file, or a directory and everything below it (asks for confirmation)
+     * @param path Path to remove
+     * @param background If true, rename a directory aside and delete it on a background thread
+     * @return true if removed, false if cancelled or some entries could not be removed
+     * @throws std::runtime_error if the path doesn't exist
+     */
+    bool remove(const std::string& path, bool background = false);
+
+    /**
+     * @brief Copy a file, or a directory tree recursively
      * @param source Source file path
      * @param destination Destination path
      * @param overwrite If true, overwrites existing destination file
@@ -122,22 +210,67 @@ public:
     bool copyFile(const std::string& source, const std::string& destination, bool overwrite = false);
 
     /**
-     * @brief Move or rename a file
+     * @brief Configure recursive directory copies
+     * @param threads File copy workers (0 = automatic)
+     * @param queueDepth Maximum files queued for the copy workers
+     */
+    void setCopyConcurrency(unsigned threads, size_t queueDepth);
+
+    /**
+     * @brief Move or rename a file or directory tree (see FileMover)
+     *
+     * An existing destination is swapped out atomically and deleted in the
+     * background. Across file systems the source is copied, verified and
+     * only then deleted.
      * @param source Source file path
      * @param destination Destination path
      * @param overwrite If true, overwrites existing destination file
-     * @return true if move was successful
-     * @throws std::runtime_error if the operation fails
+     * @return true if moved, false if the overwrite was cancelled
+     * @throws std::runtime_error if the operation fails (the source is then left in place)
      */
     bool moveFile(const std::string& source, const std::string& destination, bool overwrite = false);
 
+    /**
+     * @brief Expand the path arguments of one command (globs included) into grouped targets
+     * @param patterns Paths and globs, relative to the current directory unless absolute
+     *                 (escaped as by CommandLine::pattern(), see PathBatch::expand())
+     * @throws std::runtime_error if a path doesn't exist or a glob matches nothing
+     */
+    PathBatch expandPaths(const std::vector<std::string>& patterns) const;
+
+    /**
+     * @brief Remove every target of a batch, without asking per entry
+     * @param background If true, directories are deleted on background threads
+     * @return false if some targets could not be removed
+     * @throws JobCancelled if the job running the removal was cancelled
+     */
+    bool removePaths(const PathBatch& targets, bool background = false);
+
+    /**
+     * @brief Move every target of a batch into a directory
+     *
+     * A single target may instead be renamed to a destination that is not
+     * a directory, as with moveFile(). Existing entries are replaced after
+     * one confirmation for all of them.
+     * @return false if the overwrite was cancelled or some targets could not be moved
+     * @throws std::runtime_error if the destination is not a directory
+     */
+    bool movePaths(const PathBatch& sources, const std::string& destination);
+
+    /**
+     * @brief Copy every target of a batch into a directory (see movePaths())
+     * @return false if the overwrite was cancelled or some targets could not be copied
+     * @throws std::runtime_error if the destination is not a directory
+     */
+    bool copyPaths(const PathBatch& sources, const std::string& destination);
+
     /**
      * @brief Get file information
      * @param path Path to the file or directory
-     * @return FileInfo structure with file details
+     * @return Single-row batch with the file's details
      * @throws std::runtime_error if the file cannot be accessed
      */
-    FileInfo getFileInfo(const std::string& path) const;
+    FileInfoBatch getFileInfo(const std::string& path) const;
 
     /**
      * @brief Check if a path exists
@@ -160,26 +293,118 @@ public:
      */
     bool isFile(const std::string& path) const;
 
+    /**
+     * @brief Counters of the directory listing cache
+     */
+    DirectoryCacheStats directoryCacheStats() const;
+
+    /**
+     * @brief Drop every cached directory listing
+     */
+    void clearDirectoryCache();
+
+    /**
+     * @brief Select the backend used for batched metadata and delete operations
+     * @param name "auto", "uring", "threads" or "sync"
+     * @return Name of the backend now in use (io_uring falls back if unavailable)
+     * @throws std::runtime_error for an unknown name
+     */
+    std::string setIoBackend(const std::string& name);
+
     // ==================== Search Operations ====================
 
+    /**
+     * @brief Search for files by name, printing hits as they are found
+     *
+     * Answered from the filename index when one covers the current
+     * directory, otherwise by walking the tree.
+     * @param fileName Substring to look for in file names, or a glob if it has wildcards
+     */
+    void searchFile(const std::string& fileName);
+
+    /**
+     * @brief Set the number of threads used by recursive searches
+     * @param threads Thread count (0 = hardware concurrency)
+     */
+    void setSearchThreads(unsigned threads);
+
     /**
      * @brief Search for files by name in the current directory and subdirectories
+     *
+     * Uses the filename index when one covers the current directory.
      * @param pattern Pattern to search for (supports * and ? wildcards)
      * @return Vector of matching file paths
      */
     std::vector<std::string> findFiles(const std::string& pattern) const;
 
+    /**
+     * @brief Build the filename index for a directory tree
+     * @param path Directory to index (current directory if empty)
+     * @return Statistics of the new index
+     * @throws std::runtime_error if the tree cannot be read or the index cannot be written
+     */
+    IndexStats buildIndex(const std::string& path = "");
+
+    /**
+     * @brief Bring the index covering the current directory up to date
+     *
+     * Only directories whose mtime changed since the last build are read again.
+     * @return Statistics of the refreshed index
+     * @throws std::runtime_error if no index covers the current directory
+     */
+    IndexStats refreshIndex();
+
+    /**
+     * @brief Describe the index covering the current directory
+     * @throws std::runtime_error if no index covers the current directory
+     */
+    IndexStats indexStats() const;
+
+    /**
+     * @brief Measure the disk space used by a directory tree (like du -x)
+     *
+     * Hard links are counted once and other file systems are not entered.
+     * @param path Directory to measure (current directory if empty)
+     * @param top Number of largest subtrees to report
+     * @return Totals and the largest subtrees
+     * @throws std::runtime_error if the directory cannot be opened
+     */
+    DiskUsageReport diskUsage(const std::string& path = "", size_t top = 10) const;
+
+    /**
+     * @brief Find files with identical contents in a directory tree
+     *
+     * Files are narrowed down by size, then by a hash of their first and
+     * last 4 KB, then by a hash of their full contents. Hard links to the
+     * same file are not duplicates of each other; empty files are ignored.
+     * @param path Directory to search (current directory if empty)
+     * @param verify Also compare candidates byte by byte
+     * @return Groups of identical files, largest waste first
+     * @throws std::runtime_error if the directory cannot be opened
+     */
+    DuplicateReport findDuplicates(const std::string& path = "", bool verify = false) const;
+
     /**
      * @brief Search for files by content
      * @param searchString String to search for in file contents
      * @param filePattern File pattern to search in (e.g., "*.txt")
-     * @return Vector of file paths containing the search string
+     * @return One "path:line:offset" entry per matching line, sorted by path
+     * @throws std::runtime_error if searchString is empty
      */
     std::vector<std::string> findInFiles(const std::string& searchString, 
                                        const std::string& filePattern = "*") const;
 
 private:
     std::string currentPath;  ///< Current working directory
+    unsigned searchThreads;   ///< Worker threads for recursive searches (0 = auto)
+    TreeCopyOptions copyOptions;  ///< Settings for recursive directory copies
+    std::deque<std::pair<std::string, unsigned>> backgroundQueue;  ///< Trash waiting to be deleted, with walker threads
+    std::thread backgroundWorker;                ///< Deletes the queue one path at a time; exits once it is empty
+    bool backgroundRunning = false;              ///< backgroundWorker is still taking from the queue
+    std::mutex backgroundMutex;                  ///< Guards the queue and worker (batch mode moves in parallel)
+    mutable std::unique_ptr<FileIndex> index;    ///< Most recently used filename index
+    DirectoryCache dirCache;                     ///< Listings of visited directories, kept current by inotify
+    bool interactive;                            ///< Ask before overwriting or deleting trees
 
     // ==================== Helper Methods ====================
 
@@ -191,9 +416,42 @@ private:
     std::string getAbsolutePath(const std::string& path) const;
 
     /**
-     * @brief Get file information for a given path (internal use)
+     * @brief Queue a trashed path for the background worker, starting it if it is idle
+     *
+     * One worker serves every background delete of this object, so a long
+     * session or a batch with many leftovers never piles up threads; the
+     * destructor waits for the queue to drain rather than leave trash behind.
+     */
+    void deleteInBackground(const std::string& trash);
+
+    /**
+     * @brief Body of backgroundWorker: delete queued paths until none are left
+     */
+    void drainBackgroundDeletes();
+
+    /**
+     * @brief Ask once before a batch replaces entries in a directory
+     * @return false if the user declined
+     */
+    bool confirmReplace(const PathBatch& sources, const std::string& directory) const;
+
+    /**
+     * @brief Print the totals of a batch operation and any failure
+     * @return false if some targets failed
+     */
+    bool reportBatch(const char* verb, const BatchStats& stats);
+
+    /**
+     * @brief Find an index covering a directory, loading it from disk if needed
+     * @return The index, or null if the directory must be searched live
+     */
+    const FileIndex* indexFor(const std::string& path) const;
+
+    /**
+     * @brief Like indexFor(), but refresh the index first if a directory below path changed
+     * @return An up-to-date index, or null if the directory must be searched live
      */
-    FileInfo getFileInfoInternal(const std::filesystem::path& path) const;
+    const FileIndex* currentIndexFor(const std::string& path) const;
 
     /**
      * @brief Recursively search for files matching a pattern
@@ -204,6 +462,8 @@ private:
 
     /**
      * @brief Check if a filename matches a pattern with wildcards
+     *
+     * Compiles the pattern on every call; loops should build a GlobMatcher once instead.
      */
     bool matchesPattern(const std::string& filename, const std::string& pattern) const;
 };
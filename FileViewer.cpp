@@ -0,0 +1,361 @@
+#include "FileViewer.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FILE_VIEWER_X86 1
+#endif
+
+using namespace std;
+
+namespace {
+
+static_assert(FileViewer::WINDOW_SIZE % FileViewer::BLOCK_SIZE == 0, "blocks must not straddle windows");
+
+using CountFunction = size_t (*)(const char*, size_t);
+
+size_t countScalar(const char* data, size_t length) {
+    return static_cast<size_t>(count(data, data + length, '\n'));
+}
+
+#ifdef FILE_VIEWER_X86
+
+/**
+ * @brief SSE2 newline count
+ *
+ * Matches are accumulated as byte counters (cmpeq gives -1, subtracted),
+ * and folded into 64-bit sums with psadbw before any counter can overflow.
+ */
+size_t countSse2(const char* data, size_t length) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    __m128i total = _mm_setzero_si128();
+    size_t i = 0;
+    while (i + 16 <= length) {
+        __m128i counters = _mm_setzero_si128();
+        for (int step = 0; step < 255 && i + 16 <= length; ++step, i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(block, newline));
+        }
+        total = _mm_add_epi64(total, _mm_sad_epu8(counters, _mm_setzero_si128()));
+    }
+    size_t sum = static_cast<size_t>(_mm_cvtsi128_si64(total)) +
+                 static_cast<size_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total)));
+    return sum + countScalar(data + i, length - i);
+}
+
+/**
+ * @brief AVX2 variant of countSse2, 32 bytes per step
+ */
+__attribute__((target("avx2")))
+size_t countAvx2(const char* data, size_t length) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+    while (i + 32 <= length) {
+        __m256i counters = _mm256_setzero_si256();
+        for (int step = 0; step < 255 && i + 32 <= length; ++step, i += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(block, newline));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(counters, _mm256_setzero_si256()));
+    }
+    size_t sum = static_cast<size_t>(_mm256_extract_epi64(total, 0)) + static_cast<size_t>(_mm256_extract_epi64(total, 1)) +
+                 static_cast<size_t>(_mm256_extract_epi64(total, 2)) + static_cast<size_t>(_mm256_extract_epi64(total, 3));
+    return sum + countScalar(data + i, length - i);
+}
+
+#endif // FILE_VIEWER_X86
+
+/**
+ * @brief Pick the widest implementation the running CPU supports
+ */
+CountFunction selectCount() {
+#ifdef FILE_VIEWER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return countAvx2;
+    }
+    return countSse2;
+#else
+    return countScalar;
+#endif
+}
+
+const CountFunction countImpl = selectCount();
+
+struct FdGuard {
+    int fd;
+    ~FdGuard() { if (fd >= 0) ::close(fd); }
+};
+
+} // namespace
+
+FileViewer::FileViewer(const string& path)
+    : filePath(path), fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC)), fileSize(0),
+      window(nullptr), windowStart(0), windowLength(0), blockLines(1, 0) {
+    FE_COUNT_SYSCALL(Open, 1);
+    if (fd < 0) {
+        throw runtime_error("Cannot open: " + path + ": " + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        throw runtime_error("Not a regular file: " + path);
+    }
+    fileSize = static_cast<uint64_t>(st.st_size);
+}
+
+FileViewer::~FileViewer() {
+    ::close(fd);
+}
+
+size_t FileViewer::countNewlines(const char* data, size_t length) {
+    return countImpl(data, length);
+}
+
+// ==================== Windows ====================
+
+const char* FileViewer::load(uint64_t offset, size_t& available) {
+    if (!window || offset < windowStart || offset >= windowStart + windowLength) {
+        window = nullptr;
+        uint64_t start = offset - offset % WINDOW_SIZE;
+        size_t length = static_cast<size_t>(min<uint64_t>(WINDOW_SIZE, fileSize - start));
+        buffer.resize(length);
+        size_t got = 0;
+        while (got < length) {
+            ssize_t bytes = pread(fd, buffer.data() + got, length - got, static_cast<off_t>(start + got));
+            FE_COUNT_SYSCALL(Read, 1);
+            if (bytes < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes < 0) {
+                throw runtime_error("Cannot read " + filePath + ": " + strerror(errno));
+            }
+            if (bytes == 0) {
+                break;  // Truncated since the last refresh()
+            }
+            got += static_cast<size_t>(bytes);
+        }
+        if (start + got <= offset) {
+            throw runtime_error("File shrank while reading: " + filePath);
+        }
+        window = buffer.data();
+        windowStart = start;
+        windowLength = got;
+    }
+    available = windowLength - static_cast<size_t>(offset - windowStart);
+    return window + (offset - windowStart);
+}
+
+void FileViewer::release() {
+    window = nullptr;
+    windowLength = 0;
+    buffer = vector<char>();
+}
+
+void FileViewer::read(uint64_t offset, uint64_t length, const TextHandler& onText) {
+    uint64_t end = min(fileSize, offset + min(length, fileSize));
+    while (offset < end) {
+        size_t available;
+        const char* data = load(offset, available);
+        size_t chunk = static_cast<size_t>(min<uint64_t>(available, end - offset));
+        FE_COUNT_BYTES_READ(chunk);
+        onText(string_view(data, chunk));
+        offset += chunk;
+    }
+}
+
+bool FileViewer::refresh() {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) == fileSize) {
+        return false;
+    }
+    uint64_t newSize = static_cast<uint64_t>(st.st_size);
+    window = nullptr;  // The window may end at the old size
+    if (newSize < fileSize) {
+        blockLines.assign(1, 0);
+    }
+    fileSize = newSize;
+    return true;
+}
+
+// ==================== Lines ====================
+
+void FileViewer::indexUntil(uint64_t newlines) {
+    while (blockLines.back() < newlines) {
+        uint64_t start = (blockLines.size() - 1) * BLOCK_SIZE;
+        if (start + BLOCK_SIZE > fileSize) {
+            return;  // Only complete blocks are indexed, so growth never invalidates them
+        }
+        size_t available;
+        const char* data = load(start, available);
+        blockLines.push_back(blockLines.back() + countNewlines(data, BLOCK_SIZE));
+    }
+}
+
+uint64_t FileViewer::skipNewlines(uint64_t offset, uint64_t n) {
+    while (n > 0 && offset < fileSize) {
+        size_t available;
+        const char* data = load(offset, available);
+        const char* end = data + available;
+        const char* p = data;
+        while (n > 0) {
+            const void* newline = memchr(p, '\n', end - p);
+            if (!newline) {
+                p = end;
+                break;
+            }
+            p = static_cast<const char*>(newline) + 1;
+            --n;
+        }
+        offset += p - data;
+    }
+    return n > 0 ? fileSize : offset;
+}
+
+uint64_t FileViewer::lineOffset(uint64_t line) {
+    if (line == 0) {
+        return 0;
+    }
+    indexUntil(line);
+    // Last block with fewer than 'line' newlines before it holds that newline
+    // (or, if the index doesn't reach it, the unindexed end of the file does)
+    size_t block = static_cast<size_t>(lower_bound(blockLines.begin(), blockLines.end(), line) - blockLines.begin()) - 1;
+    return skipNewlines(block * BLOCK_SIZE, line - blockLines[block]);
+}
+
+uint64_t FileViewer::lineCount() {
+    if (fileSize == 0) {
+        return 0;
+    }
+    indexUntil(UINT64_MAX);
+    uint64_t lines = blockLines.back();
+    read((blockLines.size() - 1) * BLOCK_SIZE, fileSize, [&lines](string_view text) {
+        lines += countNewlines(text.data(), text.size());
+    });
+    size_t available;
+    if (*load(fileSize - 1, available) != '\n') {
+        ++lines;  // Unterminated last line
+    }
+    return lines;
+}
+
+uint64_t FileViewer::tailOffset(uint64_t count) {
+    if (count == 0 || fileSize == 0) {
+        return fileSize;
+    }
+    size_t available;
+    uint64_t end = fileSize;
+    if (*load(end - 1, available) == '\n') {
+        --end;  // The final newline ends the last line rather than starting one
+    }
+    while (end > 0) {
+        load(end - 1, available);
+        const char* data = window;
+        size_t length = static_cast<size_t>(end - windowStart);
+        while (length > 0) {
+            const void* newline = memrchr(data, '\n', length);
+            if (!newline) {
+                break;
+            }
+            length = static_cast<size_t>(static_cast<const char*>(newline) - data);
+            if (--count == 0) {
+                return windowStart + length + 1;
+            }
+        }
+        end = windowStart;
+    }
+    return 0;
+}
+
+uint64_t FileViewer::lines(uint64_t first, uint64_t count, const LineHandler& onLine) {
+    uint64_t offset = lineOffset(first);
+    uint64_t delivered = 0;
+    string carry;  // A line that crosses a window boundary
+    bool carrying = false;
+
+    while (delivered < count && offset < fileSize) {
+        size_t available;
+        const char* data = load(offset, available);
+        const void* newline = memchr(data, '\n', available);
+        size_t length = newline ? static_cast<size_t>(static_cast<const char*>(newline) - data) : available;
+
+        if (carrying || !newline) {
+            carry.append(data, min(length, MAX_LINE_LENGTH - min(carry.size(), MAX_LINE_LENGTH)));
+            carrying = true;
+        }
+        offset += length + (newline ? 1 : 0);
+        if (!newline && offset < fileSize) {
+            continue;
+        }
+        string_view line = carrying ? string_view(carry) : string_view(data, min(length, MAX_LINE_LENGTH));
+        onLine(first + delivered + 1, line);
+        ++delivered;
+        carry.clear();
+        carrying = false;
+    }
+    return delivered;
+}
+
+// ==================== Following ====================
+
+void FileViewer::follow(uint64_t from, const TextHandler& onText, int stopFd) {
+    FdGuard notify{inotify_init1(IN_CLOEXEC)};
+    if (notify.fd < 0 ||
+        inotify_add_watch(notify.fd, filePath.c_str(),
+                          IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF) < 0) {
+        throw runtime_error("Cannot watch " + filePath + ": " + strerror(errno));
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        refresh();
+        if (fileSize < from) {
+            from = fileSize;  // Truncated: carry on from the new end
+        }
+        if (fileSize > from) {
+            read(from, fileSize - from, onText);
+            from = fileSize;
+        }
+        release();  // Don't hold a window while idle
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_nlink == 0) {
+            return;  // Deleted
+        }
+
+        pollfd fds[2] = {{notify.fd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+        int ready = poll(fds, stopFd >= 0 ? 2 : 1, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (stopFd >= 0 && (fds[1].revents & (POLLIN | POLLHUP))) {
+            return;
+        }
+
+        ssize_t bytes = ::read(notify.fd, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < bytes;) {
+            auto* event = reinterpret_cast<inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED)) {
+                refresh();
+                if (fileSize > from) {
+                    read(from, fileSize - from, onText);
+                }
+                return;
+            }
+        }
+    }
+}
\ No newline at end of file
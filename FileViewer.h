@@ -0,0 +1,148 @@
+#ifndef FILE_VIEWER_H
+#define FILE_VIEWER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+/// Receives a run of file bytes
+using TextHandler = std::function<void(std::string_view text)>;
+
+/// Receives one line (1-based number, text without its '\n')
+using LineHandler = std::function<void(uint64_t number, std::string_view line)>;
+
+/**
+ * @brief Read-only paged view of a file of any size
+ *
+ * The file is never loaded whole: it is read one WINDOW_SIZE window at a
+ * time into a buffer the viewer owns, so memory use stays flat whether the
+ * file is 1 KB or 20 GB. Windows are read with pread rather than mmap()ed:
+ * a mapping of a file that is truncated behind the viewer's back raises
+ * SIGBUS, where a read just comes up short.
+ *
+ * Jumping to a line uses a sparse line index, built lazily: for every
+ * BLOCK_SIZE block it records how many newlines come before it, counted
+ * with SSE2/AVX2. Only the blocks up to the wanted line are counted, the
+ * index costs 8 bytes per megabyte of file, and the line is then found by
+ * scanning a single block. The last lines of a file are found by scanning
+ * backwards from the end and need no index at all.
+ */
+class FileViewer {
+public:
+    /// Bytes read at a time
+    static constexpr size_t WINDOW_SIZE = 4 * 1024 * 1024;
+
+    /// Bytes covered by one line index entry (divides WINDOW_SIZE)
+    static constexpr size_t BLOCK_SIZE = 1024 * 1024;
+
+    /// Longer lines are cut short when delivered as lines
+    static constexpr size_t MAX_LINE_LENGTH = 1024 * 1024;
+
+    /**
+     * @brief Open a file for viewing
+     * @throws std::runtime_error if path cannot be opened or is not a regular file
+     */
+    explicit FileViewer(const std::string& path);
+    ~FileViewer();
+
+    FileViewer(const FileViewer&) = delete;
+    FileViewer& operator=(const FileViewer&) = delete;
+
+    const std::string& path() const { return filePath; }
+
+    /**
+     * @brief File size as of opening or the last refresh()
+     */
+    uint64_t size() const { return fileSize; }
+
+    /**
+     * @brief Number of lines (a last line without '\n' counts); indexes the whole file
+     */
+    uint64_t lineCount();
+
+    /**
+     * @brief Offset at which a line starts (size() if the file has fewer lines)
+     * @param line 0-based line number
+     */
+    uint64_t lineOffset(uint64_t line);
+
+    /**
+     * @brief Offset at which the last count lines start
+     */
+    uint64_t tailOffset(uint64_t count);
+
+    /**
+     * @brief Deliver the bytes [offset, offset + length), clipped to the file, window by window
+     */
+    void read(uint64_t offset, uint64_t length, const TextHandler& onText);
+
+    /**
+     * @brief Deliver up to count lines starting at a 0-based line number
+     * @return Number of lines delivered
+     */
+    uint64_t lines(uint64_t first, uint64_t count, const LineHandler& onLine);
+
+    /**
+     * @brief Pick up changes to the file's size
+     *
+     * Growth keeps the line index; a file that shrank (truncated or
+     * rewritten) drops it.
+     * @return true if the size changed
+     */
+    bool refresh();
+
+    /**
+     * @brief Deliver data appended to the file until told to stop (tail -f)
+     *
+     * Waits for changes with inotify. If the file is truncated, following
+     * restarts from its new end. Returns when stopFd becomes readable
+     * (nothing is read from it) or the file is deleted or renamed away.
+     * @param from Offset to follow from (normally size())
+     * @param stopFd Descriptor to watch for a stop request (-1 for none)
+     * @throws std::runtime_error if inotify is unavailable
+     */
+    void follow(uint64_t from, const TextHandler& onText, int stopFd);
+
+    /**
+     * @brief Count '\n' bytes, using the widest SIMD the CPU supports
+     */
+    static size_t countNewlines(const char* data, size_t length);
+
+private:
+    /**
+     * @brief Read the window holding offset, unless it is already loaded
+     * @return Pointer to the byte at offset; available is set to the bytes loaded from there
+     * @throws std::runtime_error if the file can't be read or has shrunk below offset
+     */
+    const char* load(uint64_t offset, size_t& available);
+
+    /**
+     * @brief Drop the window and free its buffer
+     */
+    void release();
+
+    /**
+     * @brief Count blocks until at least that many newlines are indexed, or every complete block is
+     */
+    void indexUntil(uint64_t newlines);
+
+    /**
+     * @brief Offset just after the n-th newline counted from offset (size() if there are fewer)
+     */
+    uint64_t skipNewlines(uint64_t offset, uint64_t n);
+
+    std::string filePath;
+    int fd;
+    uint64_t fileSize;
+    std::vector<char> buffer;   ///< Holds the current window
+    const char* window;         ///< Current window in buffer (nullptr if none)
+    uint64_t windowStart;       ///< File offset of window
+    size_t windowLength;        ///< Bytes loaded
+    /// blockLines[i] = newlines in the first i complete blocks; always starts with 0
+    std::vector<uint64_t> blockLines;
+};
+
+#endif // FILE_VIEWER_H
\ No newline at end of file
@@ -0,0 +1,458 @@
+#include "FileWriter.h"
+#include "Metrics.h"
+#include "IoBackend.h"
+#include "FileCopier.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+
+using namespace std;
+
+namespace {
+
+/// Idle buffers kept per thread
+constexpr size_t SPARE_BUFFERS = 4;
+
+/**
+ * @brief Aligned buffers left behind by finished writers on this thread
+ */
+struct BufferCache {
+    vector<char*> buffers;
+    ~BufferCache() {
+        for (char* buffer : buffers) {
+            free(buffer);
+        }
+    }
+};
+
+thread_local BufferCache spareBuffers;
+
+char* acquireBuffer() {
+    if (!spareBuffers.buffers.empty()) {
+        char* buffer = spareBuffers.buffers.back();
+        spareBuffers.buffers.pop_back();
+        return buffer;
+    }
+    void* buffer = aligned_alloc(FileWriter::DIRECT_ALIGNMENT, FileWriter::BUFFER_SIZE);
+    if (!buffer) {
+        throw bad_alloc();
+    }
+    return static_cast<char*>(buffer);
+}
+
+void releaseBuffer(char* buffer) {
+    if (spareBuffers.buffers.size() < SPARE_BUFFERS) {
+        spareBuffers.buffers.push_back(buffer);
+    } else {
+        free(buffer);
+    }
+}
+
+/**
+ * @brief Directory part of a path ("a/b" -> "a", "b" -> ".", "/b" -> "/")
+ */
+string parentOf(const string& path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == string::npos) {
+        return ".";
+    }
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+/**
+ * @brief Name for a temporary file next to path: ".name.tmp<pid>.<n>"
+ */
+string temporaryName(const string& path) {
+    static atomic<unsigned> counter{0};
+    size_t slash = path.find_last_of('/');
+    string dir = slash == string::npos ? string() : path.substr(0, slash + 1);
+    string name = slash == string::npos ? path : path.substr(slash + 1);
+    return dir + "." + name + ".tmp" + to_string(getpid()) + "." + to_string(counter++);
+}
+
+/**
+ * @brief Give a replacement file the extended attributes (ACLs included) of the file it replaces
+ *
+ * Best effort: attributes the file system or our privileges refuse are skipped.
+ */
+void copyExtendedAttributes(const string& from, int toFd) {
+    ssize_t length = llistxattr(from.c_str(), nullptr, 0);
+    if (length <= 0) {
+        return;
+    }
+    vector<char> names(static_cast<size_t>(length));
+    length = llistxattr(from.c_str(), names.data(), names.size());
+    vector<char> value;
+    for (ssize_t i = 0; i < length; i += static_cast<ssize_t>(strlen(names.data() + i)) + 1) {
+        const char* name = names.data() + i;
+        ssize_t size = lgetxattr(from.c_str(), name, nullptr, 0);
+        if (size < 0) {
+            continue;
+        }
+        value.resize(static_cast<size_t>(size));
+        size = lgetxattr(from.c_str(), name, value.data(), value.size());
+        if (size >= 0) {
+            fsetxattr(toFd, name, value.data(), static_cast<size_t>(size), 0);
+        }
+    }
+}
+
+/**
+ * @brief write() all of data, retrying short writes
+ * @return 0, or the errno of the failure
+ */
+int writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = ::write(fd, data, length);
+        FE_COUNT_SYSCALL(Write, 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return n < 0 ? errno : ENOSPC;
+        }
+        FE_COUNT_BYTES_WRITTEN(static_cast<uint64_t>(n));
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return 0;
+}
+
+/**
+ * @brief open(), retrying without O_DIRECT on file systems that refuse it
+ */
+int openFile(const string& path, int flags, mode_t mode, bool& direct) {
+    FE_COUNT_SYSCALL(Open, 1);
+    if (direct) {
+        int fd = ::open(path.c_str(), flags | O_DIRECT, mode);
+        if (fd >= 0 || errno != EINVAL) {
+            return fd;
+        }
+        direct = false;
+    }
+    return ::open(path.c_str(), flags, mode);
+}
+
+} // namespace
+
+// ==================== FileWriter ====================
+
+FileWriter::FileWriter(const string& path, const WriteOptions& writeOptions)
+    : target(path), options(writeOptions), fd(-1), direct(false), committed(false),
+      buffer(nullptr), buffered(0), written(0) {
+    if (options.append) {
+        options.atomic = false;
+    }
+    // O_DIRECT needs aligned file offsets, which an append can't promise
+    direct = options.direct && !options.append && options.expectedSize >= DIRECT_THRESHOLD;
+
+    struct stat existing;
+    bool exists = ::stat(target.c_str(), &existing) == 0;
+    if (options.exclusive && exists) {
+        throw runtime_error("File exists: " + target);
+    }
+
+    if (options.atomic && exists) {
+        // Replace the file a symlink points to, not the symlink
+        char resolved[PATH_MAX];
+        if (realpath(target.c_str(), resolved)) {
+            target = resolved;
+        }
+        // A rename would split hard links, and only the owner of a file can give its
+        // replacement the same owner: write those (and anything but a regular file) in place
+        if (!S_ISREG(existing.st_mode) || existing.st_nlink > 1 || existing.st_uid != geteuid()) {
+            options.atomic = false;
+            if (options.backup) {
+                FileCopier::copy(target, target + "~");
+                options.backup = false;
+            }
+        }
+    } else if (options.atomic) {
+        struct stat link;
+        if (::lstat(target.c_str(), &link) == 0) {
+            options.atomic = false;  // A dangling symlink: writing through it creates its target
+        }
+    }
+    if (!options.atomic) {
+        options.backup = false;
+    }
+
+    if (options.atomic) {
+        // Next to the target, so the final rename stays on one file system
+        do {
+            temp = temporaryName(target);
+            fd = openFile(temp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, options.mode, direct);
+        } while (fd < 0 && errno == EEXIST);
+        if (fd >= 0 && exists && !options.exclusive) {
+            // A replaced file keeps its permissions, group, ACLs and other attributes
+            fchmod(fd, existing.st_mode & 07777);
+            if (existing.st_gid != getegid() && fchown(fd, static_cast<uid_t>(-1), existing.st_gid) != 0) {
+                // Not a member of that group: the file keeps ours
+            }
+            copyExtendedAttributes(target, fd);
+        }
+    } else {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (options.append ? O_APPEND : O_TRUNC) |
+                    (options.exclusive ? O_EXCL : 0);
+        fd = openFile(target, flags, options.mode, direct);
+    }
+    if (fd < 0) {
+        int err = errno;
+        temp.clear();
+        throw runtime_error("Cannot create " + target + ": " + strerror(err));
+    }
+
+    if (options.expectedSize > 0) {
+        // Best effort: file systems without fallocate just allocate as we write
+        off_t start = options.append ? lseek(fd, 0, SEEK_END) : 0;
+        fallocate(fd, FALLOC_FL_KEEP_SIZE, start, static_cast<off_t>(options.expectedSize));
+    }
+    buffer = acquireBuffer();
+}
+
+FileWriter::~FileWriter() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!temp.empty()) {
+        ::unlink(temp.c_str());  // Never committed (or failed): the target is untouched
+    }
+    if (buffer) {
+        releaseBuffer(buffer);
+    }
+}
+
+void FileWriter::write(string_view data) {
+    if (committed) {
+        throw runtime_error("Write after commit: " + target);
+    }
+    while (!data.empty()) {
+        if (buffered == 0 && !direct && data.size() >= BUFFER_SIZE) {
+            // Large chunk and nothing buffered: write it straight from the caller's memory
+            size_t length = data.size() - data.size() % BUFFER_SIZE;
+            if (int err = writeAll(fd, data.data(), length)) {
+                throw runtime_error("Cannot write " + target + ": " + strerror(err));
+            }
+            written += length;
+            data.remove_prefix(length);
+            continue;
+        }
+        size_t chunk = min(data.size(), BUFFER_SIZE - buffered);
+        memcpy(buffer + buffered, data.data(), chunk);
+        buffered += chunk;
+        data.remove_prefix(chunk);
+        if (buffered == BUFFER_SIZE) {
+            flushBuffer(BUFFER_SIZE);
+        }
+    }
+}
+
+void FileWriter::flushBuffer(size_t length) {
+    if (direct && length % DIRECT_ALIGNMENT != 0) {
+        // The unaligned tail goes through the page cache
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+        direct = false;
+    }
+    if (int err = writeAll(fd, buffer, length)) {
+        throw runtime_error("Cannot write " + target + ": " + strerror(err));
+    }
+    written += length;
+    buffered = 0;
+}
+
+void FileWriter::commit() {
+    if (committed) {
+        return;
+    }
+    if (buffered > 0) {
+        flushBuffer(buffered);
+    }
+    if (!options.append && options.expectedSize > written) {
+        ftruncate(fd, static_cast<off_t>(written));  // Give back preallocated space we didn't use
+    }
+    committed = true;
+
+    if (options.batch) {
+        SyncBatch::PendingFile pending{fd, temp, target, options.exclusive, options.backup};
+        fd = -1;
+        temp.clear();  // The batch owns it now
+        options.batch->add(std::move(pending));
+        return;
+    }
+
+    if (options.sync) {
+        FE_COUNT_SYSCALL(Sync, 1);
+    }
+    if (options.sync && fdatasync(fd) != 0) {
+        throw runtime_error("Cannot sync " + target + ": " + strerror(errno));
+    }
+    int rc = ::close(fd);
+    fd = -1;
+    if (rc != 0) {
+        throw runtime_error("Cannot write " + target + ": " + strerror(errno));
+    }
+    if (!temp.empty()) {
+        publish(temp, target, options.exclusive, options.backup);
+        temp.clear();
+    }
+    if (options.sync) {
+        syncDirectory(parentOf(target));
+    }
+}
+
+void FileWriter::writeFile(const string& path, string_view content, const WriteOptions& options) {
+    WriteOptions sized = options;
+    if (sized.expectedSize == 0) {
+        sized.expectedSize = content.size();
+    }
+    FileWriter writer(path, sized);
+    writer.write(content);
+    writer.commit();
+}
+
+void FileWriter::exchange(const string& a, const string& b) {
+    FE_COUNT_SYSCALL(Rename, 1);
+    if (renameat2(AT_FDCWD, a.c_str(), AT_FDCWD, b.c_str(), RENAME_EXCHANGE) != 0) {
+        throw runtime_error("Cannot exchange " + a + " and " + b + ": " + strerror(errno));
+    }
+}
+
+void FileWriter::publish(const string& temp, const string& target, bool exclusive, bool backup) {
+    FE_COUNT_SYSCALL(Rename, 1);
+    if (backup) {
+        string previous = target + "~";
+        if (renameat2(AT_FDCWD, temp.c_str(), AT_FDCWD, target.c_str(), RENAME_EXCHANGE) == 0) {
+            // The new contents are in place; temp now holds the old ones
+            if (::rename(temp.c_str(), previous.c_str()) != 0) {
+                throw runtime_error("Cannot keep backup " + previous + ": " + strerror(errno));
+            }
+            return;
+        }
+        if (errno != ENOENT) {
+            // No RENAME_EXCHANGE here: hard-link the old file as the backup first
+            ::unlink(previous.c_str());
+            if (::link(target.c_str(), previous.c_str()) != 0 && errno != ENOENT) {
+                throw runtime_error("Cannot keep backup " + previous + ": " + strerror(errno));
+            }
+        }
+    }
+
+    if (renameat2(AT_FDCWD, temp.c_str(), AT_FDCWD, target.c_str(), exclusive ? RENAME_NOREPLACE : 0) == 0) {
+        return;
+    }
+    if (errno == EINVAL && exclusive) {
+        // No RENAME_NOREPLACE on this file system; link() refuses to replace too
+        if (::link(temp.c_str(), target.c_str()) == 0) {
+            ::unlink(temp.c_str());
+            return;
+        }
+    } else if (errno == EINVAL || errno == ENOSYS) {
+        if (::rename(temp.c_str(), target.c_str()) == 0) {
+            return;
+        }
+    }
+    if (errno == EEXIST) {
+        throw runtime_error("File exists: " + target);
+    }
+    throw runtime_error("Cannot rename " + temp + " to " + target + ": " + strerror(errno));
+}
+
+void FileWriter::syncDirectory(const string& dir) {
+    int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    FE_COUNT_SYSCALL(Open, 1);
+    if (dirFd < 0) {
+        throw runtime_error("Cannot open " + dir + ": " + strerror(errno));
+    }
+    FE_COUNT_SYSCALL(Sync, 1);
+    int rc = fsync(dirFd);
+    int err = errno;
+    ::close(dirFd);
+    if (rc != 0 && err != EINVAL) {  // Some file systems can't sync directories
+        throw runtime_error("Cannot sync " + dir + ": " + strerror(err));
+    }
+}
+
+// ==================== SyncBatch ====================
+
+SyncBatch::SyncBatch(size_t limit) : limit(max<size_t>(limit, 1)), syncedFiles(0) {}
+
+SyncBatch::~SyncBatch() {
+    try {
+        flush();
+    } catch (const exception&) {
+        // Destructors must not throw; callers wanting errors call flush()
+    }
+}
+
+void SyncBatch::add(PendingFile file) {
+    files.push_back(std::move(file));
+    if (files.size() >= limit) {
+        flush();
+    }
+}
+
+void SyncBatch::flush() {
+    if (files.empty()) {
+        return;
+    }
+    vector<PendingFile> batch;
+    batch.swap(files);
+
+    // Every fdatasync in one submission, then every close
+    vector<IoRequest> syncs(batch.size(), IoRequest{IoOp::Fdatasync});
+    vector<IoRequest> closes(batch.size(), IoRequest{IoOp::Close});
+    for (size_t i = 0; i < batch.size(); ++i) {
+        syncs[i].fd = closes[i].fd = batch[i].fd;
+    }
+    auto backend = IoBackend::current();
+    backend->submit(syncs.data(), syncs.size());
+    backend->submit(closes.data(), closes.size());
+
+    string error;
+    vector<string> directories;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const PendingFile& file = batch[i];
+        long failure = syncs[i].result < 0 ? syncs[i].result : closes[i].result;
+        try {
+            if (failure < 0) {
+                throw runtime_error("Cannot sync " + file.target + ": " + strerror(static_cast<int>(-failure)));
+            }
+            if (!file.temp.empty()) {
+                FileWriter::publish(file.temp, file.target, file.exclusive, file.backup);
+            }
+            syncedFiles++;
+            directories.push_back(parentOf(file.target));
+        } catch (const exception& e) {
+            if (!file.temp.empty()) {
+                ::unlink(file.temp.c_str());
+            }
+            if (error.empty()) {
+                error = e.what();
+            }
+        }
+    }
+
+    // One directory sync covers every rename into that directory
+    sort(directories.begin(), directories.end());
+    directories.erase(unique(directories.begin(), directories.end()), directories.end());
+    for (const string& dir : directories) {
+        try {
+            FileWriter::syncDirectory(dir);
+        } catch (const exception& e) {
+            if (error.empty()) {
+                error = e.what();
+            }
+        }
+    }
+    if (!error.empty()) {
+        throw runtime_error(error);
+    }
+}
\ No newline at end of file
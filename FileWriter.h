@@ -0,0 +1,184 @@
+#ifndef FILE_WRITER_H
+#define FILE_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+
+class SyncBatch;
+
+/**
+ * @brief How a FileWriter puts its data in place
+ */
+struct WriteOptions {
+    bool append = false;         ///< Add to the end of the file (written in place, never atomic)
+    bool atomic = true;          ///< Write a temporary file and rename it over the target (where that is safe)
+    bool exclusive = false;      ///< Fail if the target already exists
+    bool backup = false;         ///< Keep the old contents as "<name>~" (a copy when written in place)
+    bool sync = false;           ///< Make the data (and the rename) durable before commit() returns
+    bool direct = false;         ///< Use O_DIRECT when expectedSize reaches DIRECT_THRESHOLD
+    uint64_t expectedSize = 0;   ///< Final size if known: space is preallocated with fallocate
+    mode_t mode = 0644;          ///< Permissions of a new file (before the umask)
+    SyncBatch* batch = nullptr;  ///< Leave the sync (and rename) to this batch; implies sync
+};
+
+/**
+ * @brief Streams data into a file through a reusable aligned buffer
+ *
+ * Data passed to write() is gathered in a BUFFER_SIZE buffer and written
+ * a full buffer at a time; small files cost a single write() at commit().
+ * Buffers are aligned for O_DIRECT and kept per thread once a writer is
+ * done, so writing many files allocates one buffer.
+ *
+ * By default the data goes to a temporary file next to the target, which
+ * commit() renames over it: readers see the old contents or the new ones,
+ * never a mix. The temporary file takes the mode, group and extended
+ * attributes (ACLs included) of the file it replaces, and a symlink is
+ * resolved first so the file it points to is the one replaced. Targets a
+ * rename can't stand in for are written in place with O_TRUNC instead:
+ * files with several hard links, files owned by another user, anything
+ * that isn't a regular file, and dangling symlinks. Exclusive writes use renameat2(RENAME_NOREPLACE), and
+ * backups use RENAME_EXCHANGE so the target is never missing. With sync,
+ * the file is fdatasync()ed before the rename and the directory after it.
+ * A writer destroyed without commit() leaves the target untouched.
+ */
+class FileWriter {
+public:
+    /// Bytes gathered before each write()
+    static constexpr size_t BUFFER_SIZE = 1024 * 1024;
+
+    /// Alignment of buffers, offsets and lengths for O_DIRECT
+    static constexpr size_t DIRECT_ALIGNMENT = 4096;
+
+    /// Payloads smaller than this never use O_DIRECT
+    static constexpr uint64_t DIRECT_THRESHOLD = 8 * 1024 * 1024;
+
+    /**
+     * @brief Open a file for writing
+     * @throws std::runtime_error if the file cannot be created (message includes strerror)
+     */
+    explicit FileWriter(const std::string& path, const WriteOptions& options = WriteOptions());
+    ~FileWriter();
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    /**
+     * @brief Append data to the file
+     * @throws std::runtime_error if a write fails
+     */
+    void write(std::string_view data);
+
+    /**
+     * @brief Write out buffered data and put the file in place
+     *
+     * With options.batch set, the file is handed to the batch and only
+     * appears at the target once the batch is flushed.
+     * @throws std::runtime_error if writing, syncing or renaming fails
+     */
+    void commit();
+
+    /**
+     * @brief Bytes passed to write() so far
+     */
+    uint64_t size() const { return written + buffered; }
+
+    /**
+     * @brief Write a whole file in one call
+     */
+    static void writeFile(const std::string& path, std::string_view content,
+                          const WriteOptions& options = WriteOptions());
+
+    /**
+     * @brief Atomically swap two paths (renameat2 RENAME_EXCHANGE)
+     * @throws std::runtime_error if either is missing or the file system can't exchange
+     */
+    static void exchange(const std::string& a, const std::string& b);
+
+private:
+    friend class SyncBatch;
+
+    /**
+     * @brief Write the first length bytes of the buffer at the current offset
+     */
+    void flushBuffer(size_t length);
+
+    /**
+     * @brief Put a finished temporary file at its target
+     */
+    static void publish(const std::string& temp, const std::string& target, bool exclusive, bool backup);
+
+    /**
+     * @brief fsync() a directory, making renames into it durable
+     */
+    static void syncDirectory(const std::string& dir);
+
+    std::string target;
+    std::string temp;  ///< Temporary file (empty unless atomic)
+    WriteOptions options;
+    int fd;
+    bool direct;       ///< O_DIRECT is on
+    bool committed;
+    char* buffer;
+    size_t buffered;   ///< Bytes in buffer
+    uint64_t written;  ///< Bytes written to the file
+};
+
+/**
+ * @brief Defers the syncs of many small files so they are paid once per batch
+ *
+ * Writers given a batch leave their descriptor open at commit(). flush()
+ * then issues every fdatasync through the IoBackend in one submission,
+ * renames the temporary files into place, and fsync()s each directory
+ * involved once, instead of once per file. Not thread-safe.
+ */
+class SyncBatch {
+public:
+    /// Pending files that trigger a flush
+    static constexpr size_t DEFAULT_LIMIT = 256;
+
+    explicit SyncBatch(size_t limit = DEFAULT_LIMIT);
+
+    /**
+     * @brief Flush what is pending; errors are dropped, call flush() to see them
+     */
+    ~SyncBatch();
+
+    SyncBatch(const SyncBatch&) = delete;
+    SyncBatch& operator=(const SyncBatch&) = delete;
+
+    /**
+     * @brief Sync and publish every pending file
+     * @throws std::runtime_error naming the first file that failed (the others are still done)
+     */
+    void flush();
+
+    size_t pending() const { return files.size(); }
+
+    /**
+     * @brief Files synced by this batch so far
+     */
+    uint64_t synced() const { return syncedFiles; }
+
+private:
+    friend class FileWriter;
+
+    struct PendingFile {
+        int fd;
+        std::string temp;    ///< Empty if written in place
+        std::string target;
+        bool exclusive;
+        bool backup;
+    };
+
+    void add(PendingFile file);
+
+    size_t limit;
+    std::vector<PendingFile> files;
+    uint64_t syncedFiles;
+};
+
+#endif // FILE_WRITER_H
\ No newline at end of file
@@ -0,0 +1,382 @@
+#include "GlobMatcher.h"
+#include <stdexcept>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+/// Upper bound on {a,b} expansions, to keep hostile patterns from exploding
+constexpr size_t MAX_BRACE_EXPANSIONS = 1024;
+
+/**
+ * @brief Skip past a [...] class starting at pos, returning the index of its ']' (or npos)
+ */
+size_t skipClass(const string& pattern, size_t pos) {
+    size_t i = pos + 1;
+    if (i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^')) ++i;
+    if (i < pattern.size() && pattern[i] == ']') ++i;
+    while (i < pattern.size() && pattern[i] != ']') ++i;
+    return i < pattern.size() ? i : string::npos;
+}
+
+/**
+ * @brief Expand the first top-level {a,b,...} group, recursively
+ */
+void expandBraces(const string& pattern, vector<string>& out) {
+    size_t open = string::npos;
+    vector<size_t> commas;
+    size_t close = string::npos;
+    int depth = 0;
+
+    for (size_t i = 0; i < pattern.size() && close == string::npos; ++i) {
+        char c = pattern[i];
+        if (c == '\\') {
+            ++i;
+        } else if (c == '[') {
+            size_t end = skipClass(pattern, i);
+            if (end != string::npos) i = end;
+        } else if (c == '{') {
+            if (depth++ == 0) {
+                open = i;
+                commas.clear();
+            }
+        } else if (c == ',' && depth == 1) {
+            commas.push_back(i);
+        } else if (c == '}' && depth > 0) {
+            if (--depth == 0) {
+                if (commas.empty()) {
+                    open = string::npos;  // "{abc}" is literal text
+                } else {
+                    close = i;
+                }
+            }
+        }
+    }
+
+    if (close == string::npos) {
+        out.push_back(pattern);
+        return;
+    }
+
+    string prefix = pattern.substr(0, open);
+    string suffix = pattern.substr(close + 1);
+    size_t start = open + 1;
+    commas.push_back(close);
+    for (size_t comma : commas) {
+        if (out.size() >= MAX_BRACE_EXPANSIONS) {
+            throw runtime_error("Too many brace expansions in pattern: " + pattern);
+        }
+        expandBraces(prefix + pattern.substr(start, comma - start) + suffix, out);
+        start = comma + 1;
+    }
+}
+
+} // namespace
+
+GlobMatcher::GlobMatcher(const string& pattern) : kind(Kind::General), starMask(0), directoryMask(0) {
+    compile(pattern);
+}
+
+const string& GlobMatcher::requiredLiteral() const {
+    static const string none;
+    switch (kind) {
+        case Kind::Literal:
+        case Kind::Prefix:
+        case Kind::Suffix:
+        case Kind::Contains:
+            return literal;
+        case Kind::General:
+            return required;
+        default:
+            return none;
+    }
+}
+
+size_t GlobMatcher::findWildcard(const string& text) {
+    for (size_t i = 0; i < text.size(); ++i) {
+        switch (text[i]) {
+            case '\\': ++i; break;
+            case '*': case '?': case '[': case '{': return i;
+            default: break;
+        }
+    }
+    return string::npos;
+}
+
+string GlobMatcher::escape(const string& text) {
+    string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        if (c != '\0' && strchr("\\*?[]{},", c)) {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+string GlobMatcher::unescape(const string& text) {
+    string literal;
+    literal.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\\' && i + 1 < text.size()) {
+            ++i;
+        }
+        literal += text[i];
+    }
+    return literal;
+}
+
+void GlobMatcher::compile(const string& pattern) {
+    source = pattern;
+
+    vector<string> expanded;
+    expandBraces(pattern, expanded);
+    if (expanded.size() > 1) {
+        kind = Kind::Alternatives;
+        alternatives.reserve(expanded.size());
+        for (const auto& alt : expanded) {
+            alternatives.emplace_back(alt);
+        }
+        return;
+    }
+
+    compileTokens(pattern);
+
+    // Pick a fast path when the pattern is a literal with at most a leading
+    // and/or trailing single-component '*'
+    size_t first = 0, last = tokens.size();
+    bool leadingStar = !tokens.empty() && tokens.front().type == Token::Star;
+    bool trailingStar = tokens.size() > 1 && tokens.back().type == Token::Star;
+    if (leadingStar) ++first;
+    if (trailingStar) --last;
+
+    bool literalCore = true;
+    string core;
+    for (size_t i = first; i < last; ++i) {
+        if (tokens[i].type != Token::Char || tokens[i].ch == '/') {
+            literalCore = false;
+            break;
+        }
+        core += static_cast<char>(tokens[i].ch);
+    }
+
+    if (literalCore) {
+        literal = core;
+        if (tokens.size() == 1 && leadingStar) {
+            kind = Kind::AnyName;
+        } else if (leadingStar && trailingStar) {
+            kind = Kind::Contains;
+        } else if (leadingStar) {
+            kind = Kind::Suffix;
+        } else if (trailingStar) {
+            kind = Kind::Prefix;
+        } else {
+            kind = Kind::Literal;
+        }
+        return;
+    }
+
+    kind = Kind::General;
+    string run;
+    for (const auto& token : tokens) {
+        if (token.type == Token::Char) {
+            run += static_cast<char>(token.ch);
+        } else {
+            if (run.size() > required.size()) required = run;
+            run.clear();
+        }
+    }
+    if (run.size() > required.size()) required = run;
+
+    for (size_t i = 0; i < tokens.size() && i < 64; ++i) {
+        if (tokens[i].type == Token::Star || tokens[i].type == Token::GlobStar) {
+            starMask |= 1ull << i;
+        } else if (tokens[i].type == Token::Directories) {
+            directoryMask |= 1ull << i;
+        }
+    }
+}
+
+void GlobMatcher::compileTokens(const string& pattern) {
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        char c = pattern[i];
+        if (c == '\\' && i + 1 < pattern.size()) {
+            tokens.push_back({Token::Char, static_cast<uint8_t>(pattern[++i]), 0});
+        } else if (c == '*') {
+            size_t start = i;
+            bool globStar = false;
+            while (i + 1 < pattern.size() && pattern[i + 1] == '*') {
+                globStar = true;
+                ++i;
+            }
+            // "**/" as a whole component is zero or more directories, as in bash's globstar:
+            // Directories starts a directory name (or is skipped), DirectoryRest is inside one
+            if (globStar && (start == 0 || pattern[start - 1] == '/') &&
+                i + 1 < pattern.size() && pattern[i + 1] == '/') {
+                ++i;
+                if (tokens.empty() || tokens.back().type != Token::DirectoryRest) {
+                    tokens.push_back({Token::Directories, 0, 0});
+                    tokens.push_back({Token::DirectoryRest, 0, 0});
+                }
+                continue;
+            }
+            Token::Type type = globStar ? Token::GlobStar : Token::Star;
+            if (tokens.empty() || tokens.back().type != type) {
+                tokens.push_back({type, 0, 0});
+            }
+        } else if (c == '?') {
+            tokens.push_back({Token::AnyChar, 0, 0});
+        } else if (c == '[') {
+            size_t end = skipClass(pattern, i);
+            if (end == string::npos) {
+                throw runtime_error("Unterminated character class in pattern: " + pattern);
+            }
+            bitset<256> set;
+            size_t j = i + 1;
+            bool negate = pattern[j] == '!' || pattern[j] == '^';
+            if (negate) ++j;
+            for (; j < end; ++j) {
+                unsigned char lo = pattern[j];
+                if (lo == '\\' && j + 1 < end) {
+                    lo = pattern[++j];
+                }
+                if (j + 2 < end && pattern[j + 1] == '-') {
+                    unsigned char hi = pattern[j + 2];
+                    for (unsigned ch = lo; ch <= hi; ++ch) set.set(ch);
+                    j += 2;
+                } else {
+                    set.set(lo);
+                }
+            }
+            if (negate) set.flip();
+            set.reset('/');
+            classes.push_back(set);
+            tokens.push_back({Token::Class, 0, static_cast<uint16_t>(classes.size() - 1)});
+            i = end;
+        } else {
+            tokens.push_back({Token::Char, static_cast<uint8_t>(c), 0});
+        }
+    }
+}
+
+bool GlobMatcher::matches(const char* name, size_t length) const {
+    switch (kind) {
+        case Kind::Literal:
+            return length == literal.size() && memcmp(name, literal.data(), length) == 0;
+        case Kind::Prefix:
+            return length >= literal.size() && memcmp(name, literal.data(), literal.size()) == 0 &&
+                   !memchr(name, '/', length);
+        case Kind::Suffix:
+            return length >= literal.size() &&
+                   memcmp(name + length - literal.size(), literal.data(), literal.size()) == 0 &&
+                   !memchr(name, '/', length);
+        case Kind::Contains:
+            return memmem(name, length, literal.data(), literal.size()) != nullptr &&
+                   !memchr(name, '/', length);
+        case Kind::AnyName:
+            return !memchr(name, '/', length);
+        case Kind::Alternatives:
+            for (const auto& alt : alternatives) {
+                if (alt.matches(name, length)) return true;
+            }
+            return false;
+        case Kind::General:
+            // memmem is vectorized in glibc; most names fail here
+            if (required.size() > 1 &&
+                memmem(name, length, required.data(), required.size()) == nullptr) {
+                return false;
+            }
+            return tokens.size() < 64 ? matchGeneral(name, length) : matchWide(name, length);
+    }
+    return false;
+}
+
+bool GlobMatcher::matchGeneral(const char* name, size_t length) const {
+    // Bit i set = "token i is the next to match"; bit tokens.size() = accept
+    const uint64_t accept = 1ull << tokens.size();
+    auto closure = [this](uint64_t states) {
+        uint64_t prev;
+        do {
+            prev = states;
+            states |= (states & starMask) << 1;       // a star may match nothing
+            states |= (states & directoryMask) << 2;  // nor may "**/"
+        } while (states != prev);
+        return states;
+    };
+
+    uint64_t states = closure(1);
+    for (size_t pos = 0; pos < length; ++pos) {
+        unsigned char c = name[pos];
+        uint64_t next = 0;
+        uint64_t active = states & (accept - 1);
+        while (active) {
+            unsigned i = __builtin_ctzll(active);
+            active &= active - 1;
+            const Token& token = tokens[i];
+            switch (token.type) {
+                case Token::Char:     if (c == token.ch) next |= 2ull << i; break;
+                case Token::AnyChar:  if (c != '/') next |= 2ull << i; break;
+                case Token::Class:    if (classes[token.cls][c]) next |= 2ull << i; break;
+                case Token::Star:     if (c != '/') next |= 1ull << i; break;
+                case Token::GlobStar: next |= 1ull << i; break;
+                case Token::Directories:   if (c != '/') next |= 2ull << i; break;
+                case Token::DirectoryRest: next |= (c == '/') ? (1ull << (i - 1)) : (1ull << i); break;
+            }
+        }
+        if (!next) {
+            return false;
+        }
+        states = closure(next);
+    }
+    return (states & accept) != 0;
+}
+
+bool GlobMatcher::matchWide(const char* name, size_t length) const {
+    // Same automaton as matchGeneral for patterns with 64+ tokens
+    const size_t count = tokens.size();
+    vector<char> states(count + 1, 0), next(count + 1, 0);
+    auto closure = [&](vector<char>& set) {
+        for (size_t i = 0; i < count; ++i) {
+            if (set[i] && (tokens[i].type == Token::Star || tokens[i].type == Token::GlobStar)) {
+                set[i + 1] = 1;
+            } else if (set[i] && tokens[i].type == Token::Directories) {
+                set[i + 2] = 1;
+            }
+        }
+    };
+
+    states[0] = 1;
+    closure(states);
+    for (size_t pos = 0; pos < length; ++pos) {
+        unsigned char c = name[pos];
+        fill(next.begin(), next.end(), 0);
+        bool any = false;
+        for (size_t i = 0; i < count; ++i) {
+            if (!states[i]) continue;
+            const Token& token = tokens[i];
+            size_t target = i + 1;
+            bool ok = false;
+            switch (token.type) {
+                case Token::Char:     ok = c == token.ch; break;
+                case Token::AnyChar:  ok = c != '/'; break;
+                case Token::Class:    ok = classes[token.cls][c]; break;
+                case Token::Star:     ok = c != '/'; target = i; break;
+                case Token::GlobStar: ok = true; target = i; break;
+                case Token::Directories:   ok = c != '/'; break;
+                case Token::DirectoryRest: ok = true; target = (c == '/') ? i - 1 : i; break;
+            }
+            if (ok) {
+                next[target] = 1;
+                any = true;
+            }
+        }
+        if (!any) {
+            return false;
+        }
+        states.swap(next);
+        closure(states);
+    }
+    return states[count] != 0;
+}
\ No newline at end of file
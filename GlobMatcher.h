@@ -0,0 +1,104 @@
+#ifndef GLOB_MATCHER_H
+#define GLOB_MATCHER_H
+
+#include <string>
+#include <vector>
+#include <bitset>
+#include <cstdint>
+
+/**
+ * @brief Glob pattern compiled once and matched many times
+ *
+ * Supported syntax:
+ *   *        any run of characters except '/'
+ *   **       any run of characters, including '/'; as a whole component
+ *            followed by '/', zero or more directories (the components
+ *            a, **, b match a/b as well as a/x/y/b)
+ *   ?        any single character except '/'
+ *   [a-z0-9] character class, negated with [!...] or [^...]
+ *   {a,b}    alternatives (expanded at compile time, may nest)
+ *   \c       the literal character c
+ *
+ * Common shapes (literal, "prefix*", "*suffix", "*.ext", "*infix*") are
+ * detected at compile time and matched with plain memory compares. Other
+ * patterns run a bit-parallel NFA, guarded by a memmem() prefilter on the
+ * longest literal the name must contain so most non-matches are rejected
+ * without touching the automaton.
+ */
+class GlobMatcher {
+public:
+    /**
+     * @brief Compile a pattern
+     * @param pattern Glob pattern
+     * @throws std::runtime_error if the pattern is malformed (e.g. unterminated class)
+     */
+    explicit GlobMatcher(const std::string& pattern);
+
+    /**
+     * @brief Test a name against the pattern
+     */
+    bool matches(const char* name, size_t length) const;
+
+    bool matches(const std::string& name) const { return matches(name.data(), name.size()); }
+
+    /**
+     * @brief The pattern this matcher was compiled from
+     */
+    const std::string& pattern() const { return source; }
+
+    /**
+     * @brief A literal every matching name contains (empty if there is none)
+     *
+     * Lets callers with their own index of names narrow the candidates
+     * before calling matches().
+     */
+    const std::string& requiredLiteral() const;
+
+    /**
+     * @brief Check whether a string contains glob metacharacters
+     */
+    static bool hasWildcards(const std::string& text) { return findWildcard(text) != std::string::npos; }
+
+    /**
+     * @brief Index of the first metacharacter not escaped with '\' (npos if none)
+     */
+    static size_t findWildcard(const std::string& text);
+
+    /**
+     * @brief Escape the metacharacters (and backslashes) of a literal, so it matches only itself
+     */
+    static std::string escape(const std::string& text);
+
+    /**
+     * @brief Drop the backslashes of an escaped pattern, giving the literal it stands for
+     */
+    static std::string unescape(const std::string& text);
+
+private:
+    /// Strategy chosen at compile time
+    enum class Kind { Literal, Prefix, Suffix, Contains, AnyName, Alternatives, General };
+
+    /// One element of a compiled general pattern
+    struct Token {
+        enum Type : uint8_t { Char, AnyChar, Star, GlobStar, Directories, DirectoryRest, Class } type;
+        uint8_t ch;       ///< Literal character (Char)
+        uint16_t cls;     ///< Index into classes (Class)
+    };
+
+    void compile(const std::string& pattern);
+    void compileTokens(const std::string& pattern);
+    bool matchGeneral(const char* name, size_t length) const;
+    bool matchWide(const char* name, size_t length) const;
+
+    std::string source;                       ///< Original pattern text
+    Kind kind;                                ///< Matching strategy
+    std::string literal;                      ///< Literal for the fast paths
+    std::string required;                     ///< Prefilter literal for General
+    std::vector<Token> tokens;                ///< Compiled general pattern
+    std::vector<std::bitset<256>> classes;    ///< Character classes
+    std::vector<GlobMatcher> alternatives;    ///< Expanded {a,b} branches
+    uint64_t starMask;                        ///< Bits of Star/GlobStar tokens (General)
+    uint64_t directoryMask;                   ///< Bits of Directories tokens, skipped with their DirectoryRest
+};
+
+#endif // GLOB_MATCHER_H
\ No newline at end of file
@@ -0,0 +1,410 @@
+#include "IoBackend.h"
+#include "ThreadPool.h"
+#include "Metrics.h"
+#include <bitset>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+using namespace std;
+
+namespace {
+
+/// Submission queue size of each per-thread ring
+constexpr unsigned URING_ENTRIES = 256;
+
+/// Batches smaller than this run inline on the thread-pool backend
+constexpr size_t MIN_PARALLEL_BATCH = 4;
+
+/**
+ * @brief Count a completed request, however it was executed
+ */
+inline void countRequest(const IoRequest& request) {
+    switch (request.op) {
+        case IoOp::Statx:     FE_COUNT_SYSCALL(Stat, 1); break;
+        case IoOp::Openat:    FE_COUNT_SYSCALL(Open, 1); break;
+        case IoOp::Close:     FE_COUNT_SYSCALL(Close, 1); break;
+        case IoOp::Unlinkat:  FE_COUNT_SYSCALL(Unlink, 1); break;
+        case IoOp::Renameat:  FE_COUNT_SYSCALL(Rename, 1); break;
+        case IoOp::Fdatasync: FE_COUNT_SYSCALL(Sync, 1); break;
+        case IoOp::Read:
+            FE_COUNT_SYSCALL(Read, 1);
+            FE_COUNT_BYTES_READ(request.result > 0 ? static_cast<uint64_t>(request.result) : 0);
+            break;
+        case IoOp::Write:
+            FE_COUNT_SYSCALL(Write, 1);
+            FE_COUNT_BYTES_WRITTEN(request.result > 0 ? static_cast<uint64_t>(request.result) : 0);
+            break;
+    }
+}
+
+/**
+ * @brief Blocking syscalls on the calling thread
+ */
+class SyncBackend : public IoBackend {
+public:
+    void submit(IoRequest* requests, size_t count) override {
+        for (size_t i = 0; i < count; ++i) {
+            executeSync(requests[i]);
+        }
+    }
+    const char* name() const override { return "sync"; }
+};
+
+/**
+ * @brief Blocking syscalls overlapped on a thread pool
+ */
+class ThreadPoolBackend : public IoBackend {
+public:
+    ThreadPoolBackend() : pool(max(8u, 2 * thread::hardware_concurrency())) {}
+
+    void submit(IoRequest* requests, size_t count) override {
+        if (count < MIN_PARALLEL_BATCH) {
+            for (size_t i = 0; i < count; ++i) {
+                executeSync(requests[i]);
+            }
+            return;
+        }
+        pool.parallelFor(count, [requests](size_t i) { executeSync(requests[i]); });
+    }
+    const char* name() const override { return "threads"; }
+
+private:
+    ThreadPool pool;
+};
+
+/**
+ * @brief One io_uring instance with its shared rings mapped
+ *
+ * Rings are not safe for concurrent submission, so each thread that uses
+ * the io_uring backend gets its own.
+ */
+class UringRing {
+public:
+    explicit UringRing(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            throw runtime_error(string("io_uring_setup failed: ") + strerror(errno));
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap) {
+            sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+        }
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQ_RING);
+        cqRing = singleMmap ? sqRing
+                            : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                   fd, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqesMap = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             fd, IORING_OFF_SQES);
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqesMap == MAP_FAILED) {
+            int err = errno;
+            unmap(sqesMap);
+            ::close(fd);
+            throw runtime_error(string("io_uring mmap failed: ") + strerror(err));
+        }
+        sqes = static_cast<io_uring_sqe*>(sqesMap);
+
+        auto* sq = static_cast<char*>(sqRing);
+        auto* cq = static_cast<char*>(cqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        capacity = params.sq_entries;
+    }
+
+    ~UringRing() {
+        unmap(sqes);
+        ::close(fd);
+    }
+
+    int descriptor() const { return fd; }
+
+    /**
+     * @brief Submit up to capacity requests and wait for all completions
+     */
+    void run(IoRequest* requests, size_t count) {
+        for (size_t start = 0; start < count; start += capacity) {
+            runChunk(requests + start, min<size_t>(capacity, count - start));
+        }
+    }
+
+    UringRing(const UringRing&) = delete;
+    UringRing& operator=(const UringRing&) = delete;
+
+private:
+    void unmap(void* sqesMap) {
+        if (sqesMap && sqesMap != MAP_FAILED) munmap(sqesMap, sqesSize);
+        if (cqRing && cqRing != MAP_FAILED && !singleMmap) munmap(cqRing, cqRingSize);
+        if (sqRing && sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        sqRing = cqRing = nullptr;
+    }
+
+    static void prepare(io_uring_sqe& sqe, const IoRequest& request) {
+        memset(&sqe, 0, sizeof(sqe));
+        switch (request.op) {
+            case IoOp::Statx:
+                sqe.opcode = IORING_OP_STATX;
+                sqe.fd = request.dirFd;
+                sqe.addr = reinterpret_cast<uint64_t>(request.path);
+                sqe.len = request.mask;
+                sqe.off = reinterpret_cast<uint64_t>(request.statxBuf);
+                sqe.statx_flags = request.flags;
+                break;
+            case IoOp::Openat:
+                sqe.opcode = IORING_OP_OPENAT;
+                sqe.fd = request.dirFd;
+                sqe.addr = reinterpret_cast<uint64_t>(request.path);
+                sqe.len = request.mode;
+                sqe.open_flags = request.flags;
+                break;
+            case IoOp::Read:
+            case IoOp::Write:
+                sqe.opcode = request.op == IoOp::Read ? IORING_OP_READ : IORING_OP_WRITE;
+                sqe.fd = request.fd;
+                sqe.addr = reinterpret_cast<uint64_t>(request.buffer);
+                sqe.len = static_cast<uint32_t>(request.length);
+                sqe.off = request.offset;
+                break;
+            case IoOp::Close:
+                sqe.opcode = IORING_OP_CLOSE;
+                sqe.fd = request.fd;
+                break;
+            case IoOp::Unlinkat:
+                sqe.opcode = IORING_OP_UNLINKAT;
+                sqe.fd = request.dirFd;
+                sqe.addr = reinterpret_cast<uint64_t>(request.path);
+                sqe.unlink_flags = request.flags;
+                break;
+            case IoOp::Renameat:
+                sqe.opcode = IORING_OP_RENAMEAT;
+                sqe.fd = request.dirFd;
+                sqe.addr = reinterpret_cast<uint64_t>(request.path);
+                sqe.len = static_cast<uint32_t>(request.newDirFd);
+                sqe.addr2 = reinterpret_cast<uint64_t>(request.newPath);
+                sqe.rename_flags = request.flags;
+                break;
+            case IoOp::Fdatasync:
+                sqe.opcode = IORING_OP_FSYNC;
+                sqe.fd = request.fd;
+                sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+                break;
+        }
+    }
+
+    void runChunk(IoRequest* requests, size_t count) {
+        unsigned tail = *sqTail;  // only this thread writes the SQ tail
+        for (size_t i = 0; i < count; ++i) {
+            unsigned index = tail & sqMask;
+            prepare(sqes[index], requests[i]);
+            sqes[index].user_data = i;
+            sqArray[index] = index;
+            ++tail;
+        }
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+        size_t completed = 0;
+        unsigned toSubmit = static_cast<unsigned>(count);
+        while (completed < count) {
+            long rc = syscall(__NR_io_uring_enter, fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (rc < 0) {
+                if (errno == EINTR) continue;
+                throw runtime_error(string("io_uring_enter failed: ") + strerror(errno));
+            }
+            toSubmit -= min<unsigned>(toSubmit, static_cast<unsigned>(rc));
+
+            unsigned head = *cqHead;
+            unsigned ready = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != ready; ++head) {
+                const io_uring_cqe& cqe = cqes[head & cqMask];
+                requests[cqe.user_data].result = cqe.res;
+                ++completed;
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    int fd;
+    bool singleMmap;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqRingSize, cqRingSize, sqesSize;
+    io_uring_sqe* sqes;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    io_uring_cqe* cqes;
+    unsigned capacity;
+};
+
+/**
+ * @brief io_uring backend; opcodes the kernel lacks run synchronously
+ */
+class UringBackend : public IoBackend {
+public:
+    UringBackend() {
+        // Creating a ring up front both proves io_uring is usable here
+        // (it is often blocked by seccomp) and lets us probe opcodes.
+        UringRing ring(8);
+        vector<char> probeBuffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+        if (syscall(__NR_io_uring_register, ring.descriptor(), IORING_REGISTER_PROBE, probe, 256) < 0) {
+            throw runtime_error("io_uring opcode probe not supported");
+        }
+        for (unsigned i = 0; i < probe->ops_len && i < 256; ++i) {
+            if (probe->ops[i].flags & IO_URING_OP_SUPPORTED) {
+                supported.set(probe->ops[i].op);
+            }
+        }
+    }
+
+    void submit(IoRequest* requests, size_t count) override {
+        thread_local unique_ptr<UringRing> ring;
+        if (!ring) {
+            ring = make_unique<UringRing>(URING_ENTRIES);
+        }
+
+        // Keep supported requests in one contiguous run per ring submission
+        vector<IoRequest*> deferred;
+        vector<IoRequest> batch;
+        vector<size_t> origin;
+        batch.reserve(count);
+        origin.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (supported.test(opcodeFor(requests[i].op))) {
+                batch.push_back(requests[i]);
+                origin.push_back(i);
+            } else {
+                deferred.push_back(&requests[i]);
+            }
+        }
+        ring->run(batch.data(), batch.size());
+        for (size_t i = 0; i < batch.size(); ++i) {
+            requests[origin[i]].result = batch[i].result;
+            countRequest(batch[i]);
+        }
+        for (IoRequest* request : deferred) {
+            executeSync(*request);
+        }
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+private:
+    static unsigned opcodeFor(IoOp op) {
+        switch (op) {
+            case IoOp::Statx:    return IORING_OP_STATX;
+            case IoOp::Openat:   return IORING_OP_OPENAT;
+            case IoOp::Read:     return IORING_OP_READ;
+            case IoOp::Write:    return IORING_OP_WRITE;
+            case IoOp::Close:    return IORING_OP_CLOSE;
+            case IoOp::Unlinkat: return IORING_OP_UNLINKAT;
+            case IoOp::Renameat: return IORING_OP_RENAMEAT;
+            case IoOp::Fdatasync: return IORING_OP_FSYNC;
+        }
+        return 0;
+    }
+
+    bitset<256> supported;  ///< Opcodes this kernel implements
+};
+
+mutex backendMutex;
+shared_ptr<IoBackend> activeBackend;
+
+shared_ptr<IoBackend> createBackend(IoBackendKind kind) {
+    switch (kind) {
+        case IoBackendKind::Sync:
+            return make_shared<SyncBackend>();
+        case IoBackendKind::ThreadPool:
+            return make_shared<ThreadPoolBackend>();
+        case IoBackendKind::Auto:
+        case IoBackendKind::Uring:
+            try {
+                return make_shared<UringBackend>();
+            } catch (const exception&) {
+                return make_shared<ThreadPoolBackend>();
+            }
+    }
+    return make_shared<SyncBackend>();
+}
+
+} // namespace
+
+void IoBackend::executeSync(IoRequest& request) {
+    long rc = -1;
+    switch (request.op) {
+        case IoOp::Statx:
+            rc = statx(request.dirFd, request.path, request.flags, request.mask, request.statxBuf);
+            break;
+        case IoOp::Openat:
+            rc = openat(request.dirFd, request.path, request.flags, request.mode);
+            break;
+        case IoOp::Read:
+            rc = pread(request.fd, request.buffer, request.length, static_cast<off_t>(request.offset));
+            break;
+        case IoOp::Write:
+            rc = pwrite(request.fd, request.buffer, request.length, static_cast<off_t>(request.offset));
+            break;
+        case IoOp::Close:
+            rc = ::close(request.fd);
+            break;
+        case IoOp::Unlinkat:
+            rc = unlinkat(request.dirFd, request.path, request.flags);
+            break;
+        case IoOp::Renameat:
+            rc = renameat2(request.dirFd, request.path, request.newDirFd, request.newPath,
+                           static_cast<unsigned>(request.flags));
+            break;
+        case IoOp::Fdatasync:
+            rc = fdatasync(request.fd);
+            break;
+    }
+    request.result = rc < 0 ? -errno : rc;
+    countRequest(request);
+}
+
+shared_ptr<IoBackend> IoBackend::current() {
+    lock_guard<mutex> lock(backendMutex);
+    if (!activeBackend) {
+        activeBackend = createBackend(IoBackendKind::Auto);
+    }
+    return activeBackend;
+}
+
+shared_ptr<IoBackend> IoBackend::select(IoBackendKind kind) {
+    auto backend = createBackend(kind);
+    lock_guard<mutex> lock(backendMutex);
+    activeBackend = backend;
+    return backend;
+}
+
+IoBackendKind IoBackend::parseKind(const string& name) {
+    if (name == "auto") return IoBackendKind::Auto;
+    if (name == "uring" || name == "io_uring") return IoBackendKind::Uring;
+    if (name == "threads") return IoBackendKind::ThreadPool;
+    if (name == "sync") return IoBackendKind::Sync;
+    throw runtime_error("Unknown I/O backend: " + name + " (use auto, uring, threads or sync)");
+}
\ No newline at end of file
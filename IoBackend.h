@@ -0,0 +1,104 @@
+#ifndef IO_BACKEND_H
+#define IO_BACKEND_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <fcntl.h>
+#include <sys/types.h>
+
+struct statx;
+
+/**
+ * @brief Kind of operation carried by an IoRequest
+ */
+enum class IoOp : uint8_t { Statx, Openat, Read, Write, Close, Unlinkat, Renameat, Fdatasync };
+
+/**
+ * @brief One operation in a batch; fields not used by the op are ignored
+ *
+ * Paths are resolved relative to dirFd exactly like the *at() syscalls.
+ * After submission result holds the syscall's return value, or -errno.
+ */
+struct IoRequest {
+    IoOp op;
+    int dirFd = AT_FDCWD;           ///< Directory for relative paths (Statx, Openat, Unlinkat, Renameat)
+    const char* path = nullptr;     ///< Path (Statx, Openat, Unlinkat, Renameat source)
+    int flags = 0;                  ///< AT_* / O_* / RENAME_* flags
+    unsigned mask = 0;              ///< STATX_* mask (Statx)
+    struct statx* statxBuf = nullptr;  ///< Output buffer (Statx)
+    mode_t mode = 0;                ///< Creation mode (Openat)
+    int fd = -1;                    ///< File descriptor (Read, Write, Close, Fdatasync)
+    void* buffer = nullptr;         ///< Data buffer (Read, Write)
+    size_t length = 0;              ///< Buffer length (Read, Write)
+    uint64_t offset = 0;            ///< File offset (Read, Write)
+    int newDirFd = AT_FDCWD;        ///< Target directory (Renameat)
+    const char* newPath = nullptr;  ///< Target path (Renameat)
+    long result = 0;                ///< Return value or -errno, set on completion
+};
+
+/**
+ * @brief Backend implementations that can be selected at runtime
+ */
+enum class IoBackendKind {
+    Auto,        ///< io_uring if the kernel allows it, thread pool otherwise
+    Uring,       ///< io_uring: hundreds of operations per io_uring_enter
+    ThreadPool,  ///< Blocking syscalls spread over a thread pool
+    Sync         ///< Blocking syscalls on the calling thread
+};
+
+/**
+ * @brief Executes batches of file-system operations
+ *
+ * Callers that would otherwise issue one blocking syscall per entry
+ * (statx per listed file, unlinkat per deleted file) collect the requests
+ * and hand them over in one submit() call. The io_uring backend turns
+ * that into a handful of io_uring_enter calls; the thread-pool backend
+ * overlaps the blocking calls, which is what hides latency on network
+ * and other high-latency storage.
+ */
+class IoBackend {
+public:
+    virtual ~IoBackend() = default;
+
+    /**
+     * @brief Execute every request and wait until all have completed
+     *
+     * Requests in one batch may run in any order and concurrently, so a
+     * batch must not contain operations that depend on each other.
+     */
+    virtual void submit(IoRequest* requests, size_t count) = 0;
+
+    /**
+     * @brief Short name for display ("io_uring", "threads", "sync")
+     */
+    virtual const char* name() const = 0;
+
+    /**
+     * @brief Get the process-wide backend (selected lazily with Auto)
+     *
+     * Hold on to the returned pointer for the duration of an operation;
+     * select() may swap the backend at any time.
+     */
+    static std::shared_ptr<IoBackend> current();
+
+    /**
+     * @brief Switch the process-wide backend
+     * @return The backend now in use (Uring falls back if unavailable)
+     */
+    static std::shared_ptr<IoBackend> select(IoBackendKind kind);
+
+    /**
+     * @brief Parse "auto", "uring", "threads" or "sync"
+     * @throws std::runtime_error for any other name
+     */
+    static IoBackendKind parseKind(const std::string& name);
+
+    /**
+     * @brief Run one request with a plain blocking syscall
+     */
+    static void executeSync(IoRequest& request);
+};
+
+#endif // IO_BACKEND_H
\ No newline at end of file
@@ -0,0 +1,123 @@
+#ifndef JOB_CONTROL_H
+#define JOB_CONTROL_H
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+
+/**
+ * @brief Thrown by long operations that stop early because their job was cancelled
+ */
+class JobCancelled : public std::runtime_error {
+public:
+    JobCancelled() : std::runtime_error("Cancelled") {}
+};
+
+/**
+ * @brief Work done and work known about, as seen by a job's watchers
+ */
+struct JobProgress {
+    uint64_t bytesDone = 0;
+    uint64_t bytesTotal = 0;    ///< Grows while a walk is still discovering files
+    uint64_t entriesDone = 0;
+    uint64_t entriesTotal = 0;
+    uint64_t scanned = 0;       ///< Directory entries walked past (searches, deletes)
+};
+
+/**
+ * @brief Cancellation flag and progress counters shared by a job and its watchers
+ *
+ * Long operations (ParallelWalker, TreeCopier, TreeDeleter, FileCopier)
+ * pick up the control of the thread that starts them with current() and
+ * hand it to their own workers, so nothing has to be threaded through
+ * their interfaces. Without a current control they behave exactly as
+ * before. Every call is a relaxed atomic; checking for cancellation once
+ * per directory or per chunk costs nothing measurable.
+ */
+class JobControl {
+public:
+    JobControl() = default;
+
+    /**
+     * @brief Ask the job to stop at its next cancellation point
+     */
+    void cancel() { stop.store(true, std::memory_order_relaxed); }
+
+    bool cancelled() const { return stop.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Cancellation point
+     * @throws JobCancelled if cancel() was called
+     */
+    void checkpoint() const {
+        if (cancelled()) {
+            throw JobCancelled();
+        }
+    }
+
+    /**
+     * @brief Record work discovered (a file to copy, its size)
+     */
+    void addTotal(uint64_t bytes, uint64_t entries) {
+        bytesTotal.fetch_add(bytes, std::memory_order_relaxed);
+        entriesTotal.fetch_add(entries, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Record work finished
+     */
+    void addDone(uint64_t bytes, uint64_t entries) {
+        bytesDone.fetch_add(bytes, std::memory_order_relaxed);
+        entriesDone.fetch_add(entries, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Record directory entries walked (once per directory, not per entry)
+     */
+    void addScanned(uint64_t entries) {
+        scanned.fetch_add(entries, std::memory_order_relaxed);
+    }
+
+    JobProgress progress() const {
+        JobProgress now;
+        now.bytesDone = bytesDone.load(std::memory_order_relaxed);
+        now.bytesTotal = bytesTotal.load(std::memory_order_relaxed);
+        now.entriesDone = entriesDone.load(std::memory_order_relaxed);
+        now.entriesTotal = entriesTotal.load(std::memory_order_relaxed);
+        now.scanned = scanned.load(std::memory_order_relaxed);
+        return now;
+    }
+
+    /**
+     * @brief Control of the job the calling thread works for, or nullptr
+     */
+    static JobControl* current();
+
+    /**
+     * @brief Makes a control current on the calling thread for the enclosing scope
+     */
+    class Scope {
+    public:
+        explicit Scope(JobControl* control);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        JobControl* previous;
+    };
+
+    JobControl(const JobControl&) = delete;
+    JobControl& operator=(const JobControl&) = delete;
+
+private:
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> bytesDone{0};
+    std::atomic<uint64_t> bytesTotal{0};
+    std::atomic<uint64_t> entriesDone{0};
+    std::atomic<uint64_t> entriesTotal{0};
+    std::atomic<uint64_t> scanned{0};
+};
+
+#endif // JOB_CONTROL_H
\ No newline at end of file
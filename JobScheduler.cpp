@@ -0,0 +1,280 @@
+#include "JobScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+namespace {
+
+/// Nice value of the bulk lane
+constexpr int BULK_NICE = 10;
+
+/// ioprio_set() encoding (linux/ioprio.h is not exported everywhere)
+constexpr int IOPRIO_WHO_PROCESS = 1;
+constexpr int IOPRIO_CLASS_BE = 2;
+constexpr int IOPRIO_CLASS_SHIFT = 13;
+constexpr int IOPRIO_LOWEST = 7;
+
+/// Control of the job the calling thread works for (see JobControl::current)
+thread_local JobControl* currentControl = nullptr;
+
+/**
+ * @brief Lower the calling thread's CPU and I/O priority; threads it creates inherit both
+ *
+ * Failures are ignored: a job at normal priority is still a working job.
+ */
+void lowerPriority() {
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    setpriority(PRIO_PROCESS, static_cast<id_t>(tid), BULK_NICE);
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | IOPRIO_LOWEST);
+}
+
+bool isFinished(JobState state) {
+    return state == JobState::Done || state == JobState::Failed || state == JobState::Cancelled;
+}
+
+} // namespace
+
+// ==================== JobControl ====================
+
+JobControl* JobControl::current() {
+    return currentControl;
+}
+
+JobControl::Scope::Scope(JobControl* control) : previous(currentControl) {
+    currentControl = control;
+}
+
+JobControl::Scope::~Scope() {
+    currentControl = previous;
+}
+
+// ==================== JobInfo ====================
+
+double JobInfo::rate() const {
+    if (seconds <= 0) {
+        return 0.0;
+    }
+    return (progress.bytesTotal > 0 ? progress.bytesDone : progress.entriesDone) / seconds;
+}
+
+double JobInfo::eta() const {
+    double speed = rate();
+    uint64_t done = progress.bytesTotal > 0 ? progress.bytesDone : progress.entriesDone;
+    uint64_t total = progress.bytesTotal > 0 ? progress.bytesTotal : progress.entriesTotal;
+    if (speed <= 0 || total == 0 || done > total) {
+        return -1.0;
+    }
+    return (total - done) / speed;
+}
+
+// ==================== JobScheduler ====================
+
+struct JobScheduler::Job {
+    unsigned id;
+    string command;
+    JobPriority priority;
+    Work work;
+    JobState state = JobState::Queued;
+    JobControl control;
+    string output;         ///< What the work printed
+    string message;
+    chrono::steady_clock::time_point started;
+    chrono::steady_clock::time_point ended;
+};
+
+JobScheduler::JobScheduler(unsigned interactiveWorkers, unsigned bulkWorkers) {
+    for (unsigned i = 0; i < max(1u, interactiveWorkers); ++i) {
+        workers.emplace_back([this] { workerLoop(JobPriority::Interactive); });
+    }
+    for (unsigned i = 0; i < max(1u, bulkWorkers); ++i) {
+        workers.emplace_back([this] { workerLoop(JobPriority::Bulk); });
+    }
+}
+
+JobScheduler::~JobScheduler() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        for (auto& entry : jobs) {
+            entry.second->control.cancel();
+        }
+    }
+    available.notify_all();
+    changed.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+unsigned JobScheduler::submit(const string& command, JobPriority priority, Work work) {
+    unsigned id;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        id = nextId++;
+        auto job = make_unique<Job>();
+        job->id = id;
+        job->command = command;
+        job->priority = priority;
+        job->work = std::move(work);
+        job->started = job->ended = chrono::steady_clock::now();
+        queues[static_cast<size_t>(priority)].push_back(job.get());
+        jobs.emplace(id, std::move(job));
+    }
+    available.notify_all();
+    return id;
+}
+
+void JobScheduler::workerLoop(JobPriority lane) {
+    if (lane == JobPriority::Bulk) {
+        lowerPriority();
+    }
+    deque<Job*>& queue = queues[static_cast<size_t>(lane)];
+    while (true) {
+        Job* job;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            job = queue.front();
+            queue.pop_front();
+            job->state = JobState::Running;
+            job->started = chrono::steady_clock::now();
+        }
+        run(*job);
+        changed.notify_all();
+    }
+}
+
+void JobScheduler::run(Job& job) {
+    JobState state;
+    string message;
+    ostringstream output;
+    {
+        JobControl::Scope scope(&job.control);
+        try {
+            message = job.work(output);
+            state = JobState::Done;
+        } catch (const JobCancelled&) {
+            state = JobState::Cancelled;
+        } catch (const exception& e) {
+            state = JobState::Failed;
+            message = e.what();
+        }
+    }
+    job.work = nullptr;  // Drops whatever the work captured, outside the lock
+
+    lock_guard<std::mutex> lock(mutex);
+    job.output = output.str();
+    job.message = std::move(message);
+    job.state = state;
+    job.ended = chrono::steady_clock::now();
+}
+
+JobInfo JobScheduler::describe(const Job& job) const {
+    JobInfo info;
+    info.id = job.id;
+    info.command = job.command;
+    info.priority = job.priority;
+    info.state = job.state;
+    info.progress = job.control.progress();
+    info.message = job.message;
+    if (job.state != JobState::Queued) {
+        auto end = isFinished(job.state) ? job.ended : chrono::steady_clock::now();
+        info.seconds = chrono::duration<double>(end - job.started).count();
+    }
+    return info;
+}
+
+vector<JobInfo> JobScheduler::list() const {
+    lock_guard<std::mutex> lock(mutex);
+    vector<JobInfo> infos;
+    for (const auto& entry : jobs) {
+        infos.push_back(describe(*entry.second));
+    }
+    return infos;
+}
+
+bool JobScheduler::cancel(unsigned id) {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        auto it = jobs.find(id);
+        if (it == jobs.end() || isFinished(it->second->state)) {
+            return false;
+        }
+        Job& job = *it->second;
+        if (job.state == JobState::Running) {
+            job.control.cancel();
+            return true;
+        }
+        deque<Job*>& queue = queues[static_cast<size_t>(job.priority)];
+        queue.erase(find(queue.begin(), queue.end(), &job));
+        job.state = JobState::Cancelled;
+        job.work = nullptr;
+    }
+    changed.notify_all();
+    return true;
+}
+
+bool JobScheduler::wait(unsigned id, double timeoutSeconds) const {
+    unique_lock<std::mutex> lock(mutex);
+    return changed.wait_for(lock, chrono::duration<double>(timeoutSeconds), [&] {
+        auto it = jobs.find(id);
+        return stopping || it == jobs.end() || isFinished(it->second->state);
+    });
+}
+
+bool JobScheduler::info(unsigned id, JobInfo& out) const {
+    lock_guard<std::mutex> lock(mutex);
+    auto it = jobs.find(id);
+    if (it == jobs.end()) {
+        return false;
+    }
+    out = describe(*it->second);
+    return true;
+}
+
+bool JobScheduler::collect(unsigned id, JobInfo& info, string& output) {
+    lock_guard<std::mutex> lock(mutex);
+    auto it = jobs.find(id);
+    if (it == jobs.end() || !isFinished(it->second->state)) {
+        return false;
+    }
+    info = describe(*it->second);
+    output = std::move(it->second->output);
+    jobs.erase(it);
+    return true;
+}
+
+vector<unsigned> JobScheduler::finished() const {
+    lock_guard<std::mutex> lock(mutex);
+    vector<unsigned> ids;
+    for (const auto& entry : jobs) {
+        if (isFinished(entry.second->state)) {
+            ids.push_back(entry.first);
+        }
+    }
+    return ids;
+}
+
+unsigned JobScheduler::latest() const {
+    lock_guard<std::mutex> lock(mutex);
+    return jobs.empty() ? 0 : jobs.rbegin()->first;
+}
+
+const char* JobScheduler::stateName(JobState state) {
+    switch (state) {
+        case JobState::Queued:    return "queued";
+        case JobState::Running:   return "running";
+        case JobState::Done:      return "done";
+        case JobState::Failed:    return "failed";
+        case JobState::Cancelled: return "cancelled";
+    }
+    return "unknown";
+}
\ No newline at end of file
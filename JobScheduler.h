@@ -0,0 +1,154 @@
+#ifndef JOB_SCHEDULER_H
+#define JOB_SCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <ostream>
+#include <cstdint>
+#include "JobControl.h"
+
+/**
+ * @brief How a job competes with the prompt and with other jobs
+ */
+enum class JobPriority : uint8_t {
+    Interactive,  ///< Runs at the prompt's priority (searches the user is waiting on)
+    Bulk          ///< nice 10 and the lowest best-effort I/O priority (copies, moves, deletes)
+};
+
+enum class JobState : uint8_t { Queued, Running, Done, Failed, Cancelled };
+
+/**
+ * @brief A job as shown by the jobs command
+ */
+struct JobInfo {
+    unsigned id = 0;
+    std::string command;
+    JobPriority priority = JobPriority::Bulk;
+    JobState state = JobState::Queued;
+    JobProgress progress;
+    double seconds = 0.0;   ///< Running time so far, or in total once finished
+    std::string message;    ///< Result line once Done; the error once Failed
+
+    /**
+     * @brief Bytes per second, or entries per second when no bytes are counted
+     */
+    double rate() const;
+
+    /**
+     * @brief Seconds left at the current rate, or a negative value if unknown
+     */
+    double eta() const;
+};
+
+/**
+ * @brief Runs long commands in the background on a shared set of worker lanes
+ *
+ * Each priority class has its own lane of worker threads. A lane's
+ * threads set their CPU and I/O priority once when they start, and the
+ * threads an operation spawns (walkers, copy workers) inherit it. So a
+ * bulk copy hammering the disk yields to the prompt and to interactive
+ * jobs in the kernel's schedulers, without any coordination in user space.
+ * Commands typed at the prompt never wait for a lane.
+ *
+ * A job's output goes to a buffer instead of the terminal (see
+ * FileOperations::setThreadOutput) and is handed over when the job is
+ * collected. Jobs are cancelled cooperatively through their JobControl.
+ */
+class JobScheduler {
+public:
+    /**
+     * @brief The work of a job: prints to output, returns its result line, throws on failure
+     */
+    using Work = std::function<std::string(std::ostream& output)>;
+
+    /**
+     * @brief Start the lanes
+     * @param interactiveWorkers Threads for interactive jobs
+     * @param bulkWorkers Threads for bulk jobs; one keeps a single disk from thrashing between copies
+     */
+    explicit JobScheduler(unsigned interactiveWorkers = 2, unsigned bulkWorkers = 1);
+
+    /**
+     * @brief Cancel every job and wait for the running ones to stop
+     */
+    ~JobScheduler();
+
+    /**
+     * @brief Queue a job
+     * @return Job number, counting from 1
+     */
+    unsigned submit(const std::string& command, JobPriority priority, Work work);
+
+    /**
+     * @brief Every job not yet collected, in submission order
+     */
+    std::vector<JobInfo> list() const;
+
+    /**
+     * @brief Ask a job to stop; a queued job is dropped without running
+     * @return false if there is no such job or it has already finished
+     */
+    bool cancel(unsigned id);
+
+    /**
+     * @brief Wait until a job finishes or the timeout passes
+     * @return true if the job has finished (or doesn't exist)
+     */
+    bool wait(unsigned id, double timeoutSeconds) const;
+
+    /**
+     * @brief Describe one job
+     * @return false if there is no such job
+     */
+    bool info(unsigned id, JobInfo& out) const;
+
+    /**
+     * @brief Remove a finished job from the table
+     * @param output Receives everything the job printed
+     * @return false if there is no such job or it is still queued or running
+     */
+    bool collect(unsigned id, JobInfo& info, std::string& output);
+
+    /**
+     * @brief Jobs that have finished but haven't been collected yet
+     */
+    std::vector<unsigned> finished() const;
+
+    /**
+     * @brief Most recently submitted job still in the table, or 0
+     */
+    unsigned latest() const;
+
+    /**
+     * @brief Lower-case name of a state ("running", "done" ...)
+     */
+    static const char* stateName(JobState state);
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+private:
+    struct Job;
+
+    void workerLoop(JobPriority lane);
+    void run(Job& job);
+    JobInfo describe(const Job& job) const;
+
+    mutable std::mutex mutex;
+    mutable std::condition_variable changed;     ///< A job finished, or the scheduler is stopping
+    std::condition_variable available;           ///< Work was queued
+    std::map<unsigned, std::unique_ptr<Job>> jobs;
+    std::deque<Job*> queues[2];                  ///< Waiting jobs, one queue per lane
+    std::vector<std::thread> workers;
+    unsigned nextId = 1;
+    bool stopping = false;
+};
+
+#endif // JOB_SCHEDULER_H
\ No newline at end of file
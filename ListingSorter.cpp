@@ -0,0 +1,358 @@
+#include "ListingSorter.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <cstring>
+#include <dirent.h>
+
+using namespace std;
+
+namespace {
+
+/// Below this many rows a radix pass costs more than std::sort
+constexpr size_t SMALL_SORT = 64;
+
+/// Longest sort key a FileInfoBatch name can hold
+constexpr size_t MAX_KEY_LENGTH = 255;
+
+/**
+ * @brief A row with the key it is being sorted by
+ */
+struct KeyedRow {
+    uint64_t key;
+    uint32_t row;
+};
+
+/**
+ * @brief Eight bytes of a name starting at depth, big-endian and zero padded
+ *
+ * Comparing two of these as integers gives the same answer as comparing
+ * the bytes. The zero padding sorts a shorter string first, as byte
+ * comparison would, as long as the longer one doesn't go on with NUL
+ * bytes; names never contain NUL, and the derived keys below never have
+ * one straight after a shorter key's end.
+ */
+uint64_t bytePrefix(string_view text, size_t depth) {
+    uint64_t prefix = 0;
+    size_t length = depth < text.size() ? min<size_t>(text.size() - depth, 8) : 0;
+    for (size_t i = 0; i < length; ++i) {
+        prefix |= static_cast<uint64_t>(static_cast<unsigned char>(text[depth + i])) << (56 - 8 * i);
+    }
+    return prefix;
+}
+
+/**
+ * @brief The part of a name from depth on (empty if the name is shorter)
+ */
+string_view tail(string_view name, size_t depth) {
+    return depth < name.size() ? name.substr(depth) : string_view();
+}
+
+/**
+ * @brief Extension of a name: the text after the last '.', or empty
+ */
+string_view extension(string_view name) {
+    size_t dot = name.rfind('.');
+    return dot == string_view::npos ? string_view() : name.substr(dot + 1);
+}
+
+/**
+ * @brief Stable LSD radix sort on KeyedRow::key, one byte per pass
+ *
+ * All eight histograms are counted in a single pass, and a byte on which
+ * every key agrees is skipped, so keys that vary in only a few low bytes
+ * (sizes, recent timestamps) take only a few passes.
+ */
+void radixSort(vector<KeyedRow>& items) {
+    const size_t count = items.size();
+    if (count < 2) {
+        return;
+    }
+    vector<size_t> histogram(8 * 256, 0);
+    for (const KeyedRow& item : items) {
+        for (int digit = 0; digit < 8; ++digit) {
+            histogram[digit * 256 + ((item.key >> (8 * digit)) & 0xff)]++;
+        }
+    }
+
+    vector<KeyedRow> scratch;
+    for (int digit = 0; digit < 8; ++digit) {
+        size_t* counts = &histogram[digit * 256];
+        if (counts[(items[0].key >> (8 * digit)) & 0xff] == count) {
+            continue;
+        }
+        size_t offset = 0;
+        for (int bucket = 0; bucket < 256; ++bucket) {
+            size_t size = counts[bucket];
+            counts[bucket] = offset;
+            offset += size;
+        }
+        scratch.resize(count);
+        for (const KeyedRow& item : items) {
+            scratch[counts[(item.key >> (8 * digit)) & 0xff]++] = item;
+        }
+        items.swap(scratch);
+    }
+}
+
+/**
+ * @brief Copy the sorted rows back and collect the runs of equal keys
+ */
+vector<pair<size_t, size_t>> storeRows(const vector<KeyedRow>& items, uint32_t* rows) {
+    vector<pair<size_t, size_t>> ties;
+    for (size_t begin = 0; begin < items.size();) {
+        size_t end = begin;
+        while (end < items.size() && items[end].key == items[begin].key) {
+            rows[end] = items[end].row;
+            ++end;
+        }
+        if (end - begin > 1) {
+            ties.emplace_back(begin, end);
+        }
+        begin = end;
+    }
+    return ties;
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * @brief Key whose byte order is the natural order of the name
+ *
+ * Each digit run becomes '0', a byte holding the run's length without
+ * leading zeros, then those digits. The '0' sorts against other bytes
+ * exactly where a digit would, and the length byte makes longer numbers
+ * larger. Names equal as numbers ("07" and "7") get equal keys.
+ */
+void naturalKey(string_view name, string& key) {
+    key.clear();
+    for (size_t i = 0; i < name.size();) {
+        if (!isDigit(name[i])) {
+            key += name[i++];
+            continue;
+        }
+        while (i < name.size() && name[i] == '0') ++i;
+        size_t end = i;
+        while (end < name.size() && isDigit(name[end])) ++end;
+        key += '0';
+        key += static_cast<char>(end - i);
+        key.append(name.data() + i, end - i);
+        i = end;
+    }
+}
+
+/**
+ * @brief Key whose byte order is extension order, then name order
+ */
+void extensionKey(string_view name, string& key) {
+    key.assign(extension(name));
+    key += '\0';  // Sorts a shorter extension first, as a string compare would
+    key.append(name.data(), name.size());
+}
+
+} // namespace
+
+ListingSorter::ListingSorter(SortOptions options)
+    : options(options),
+      threads(options.threads != 0 ? options.threads : max(1u, thread::hardware_concurrency())) {}
+
+SortKey ListingSorter::parseKey(const string& name) {
+    if (name == "name") return SortKey::Name;
+    if (name == "version" || name == "natural") return SortKey::Version;
+    if (name == "size") return SortKey::Size;
+    if (name == "time") return SortKey::Time;
+    if (name == "extension") return SortKey::Extension;
+    if (name == "none") return SortKey::None;
+    throw runtime_error("Unknown sort key: " + name + " (use name, version, size, time, extension or none)");
+}
+
+int ListingSorter::compareNatural(string_view a, string_view b) {
+    // Identical bytes compare equal either way, so start at the first
+    // difference, backed up to the start of the digit run it falls in
+    size_t i = 0;
+    size_t limit = min(a.size(), b.size());
+    while (i < limit && a[i] == b[i]) {
+        ++i;
+    }
+    while (i > 0 && isDigit(a[i - 1])) {
+        --i;
+    }
+
+    size_t j = i;
+    while (i < a.size() && j < b.size()) {
+        if (isDigit(a[i]) && isDigit(b[j])) {
+            // Compare the two numbers by value: ignore leading zeros, then
+            // the longer run is larger, then compare digit by digit
+            while (i < a.size() && a[i] == '0') ++i;
+            while (j < b.size() && b[j] == '0') ++j;
+            size_t endA = i;
+            size_t endB = j;
+            while (endA < a.size() && isDigit(a[endA])) ++endA;
+            while (endB < b.size() && isDigit(b[endB])) ++endB;
+            if (endA - i != endB - j) {
+                return endA - i < endB - j ? -1 : 1;
+            }
+            int order = memcmp(a.data() + i, b.data() + j, endA - i);
+            if (order != 0) {
+                return order;
+            }
+            i = endA;
+            j = endB;
+            continue;
+        }
+        unsigned char ca = static_cast<unsigned char>(a[i]);
+        unsigned char cb = static_cast<unsigned char>(b[j]);
+        if (ca != cb) {
+            return ca < cb ? -1 : 1;
+        }
+        ++i;
+        ++j;
+    }
+    if (i < a.size() || j < b.size()) {
+        return i < a.size() ? 1 : -1;
+    }
+    return a.compare(b);  // Equal as numbers ("07" vs "7"): fall back to bytes
+}
+
+vector<uint32_t> ListingSorter::order(const FileInfoBatch& files) const {
+    vector<uint32_t> rows(files.size());
+    iota(rows.begin(), rows.end(), 0u);
+
+    switch (options.key) {
+    case SortKey::None:
+        break;
+    case SortKey::Name:
+        sortByName(files, rows.data(), rows.size(), 0);
+        break;
+    case SortKey::Extension:
+        sortByExtension(files, rows);
+        break;
+    case SortKey::Version:
+        sortByVersion(files, rows);
+        break;
+    case SortKey::Size:
+    case SortKey::Time: {
+        // Keys are flipped so that ascending radix order is largest/newest first
+        vector<uint64_t> keys(files.size());
+        for (size_t i = 0; i < files.size(); ++i) {
+            keys[i] = options.key == SortKey::Size
+                ? ~files.fileSize(i)
+                : ~(static_cast<uint64_t>(files.modifiedTime(i)) ^ (1ull << 63));
+        }
+        sortByNumber(files, rows, keys);
+        break;
+    }
+    }
+
+    if (options.reverse) {
+        reverse(rows.begin(), rows.end());
+    }
+    return rows;
+}
+
+void ListingSorter::sort(FileInfoBatch& files) const {
+    if (options.key == SortKey::None && !options.reverse) {
+        return;
+    }
+    files.permute(order(files));
+}
+
+void ListingSorter::sortByName(const FileInfoBatch& files, uint32_t* rows, size_t count, size_t depth) const {
+    if (count < SMALL_SORT) {
+        std::sort(rows, rows + count, [&files, depth](uint32_t a, uint32_t b) {
+            return tail(files.name(a), depth) < tail(files.name(b), depth);
+        });
+        return;
+    }
+
+    vector<KeyedRow> items(count);
+    bool longer = false;  // Does any name go on past these eight bytes?
+    for (size_t i = 0; i < count; ++i) {
+        string_view name = files.name(rows[i]);
+        items[i] = KeyedRow{bytePrefix(name, depth), rows[i]};
+        longer |= name.size() > depth + 8;
+    }
+    radixSort(items);
+    Runs ties = storeRows(items, rows);
+    if (!longer) {
+        return;  // Equal prefixes mean equal names
+    }
+    items = vector<KeyedRow>();
+
+    forEachRun(ties, depth == 0 ? count : 0, [&](size_t begin, size_t end) {
+        sortByName(files, rows + begin, end - begin, depth + 8);
+    });
+}
+
+void ListingSorter::sortByExtension(const FileInfoBatch& files, vector<uint32_t>& rows) const {
+    sortByKey(files, rows, extensionKey, [&files](uint32_t a, uint32_t b) {
+        string_view nameA = files.name(a);
+        string_view nameB = files.name(b);
+        int order = extension(nameA).compare(extension(nameB));
+        return order != 0 ? order < 0 : nameA < nameB;
+    });
+}
+
+void ListingSorter::sortByVersion(const FileInfoBatch& files, vector<uint32_t>& rows) const {
+    sortByKey(files, rows, naturalKey, [&files](uint32_t a, uint32_t b) {
+        return compareNatural(files.name(a), files.name(b)) < 0;
+    });
+}
+
+void ListingSorter::sortByNumber(const FileInfoBatch& files, vector<uint32_t>& rows,
+                                 const vector<uint64_t>& keys) const {
+    vector<KeyedRow> items(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        items[i] = KeyedRow{keys[rows[i]], rows[i]};
+    }
+    radixSort(items);
+    Runs ties = storeRows(items, rows.data());
+
+    // Equal keys come out in on-disk order; ls orders them by name
+    forEachRun(ties, rows.size(), [&](size_t begin, size_t end) {
+        sortByName(files, rows.data() + begin, end - begin, 0);
+    });
+}
+
+template <typename Fn>
+void ListingSorter::forEachRun(const Runs& runs, size_t rows, const Fn& fn) const {
+    if (rows < PARALLEL_THRESHOLD || threads < 2 || runs.size() < 2) {
+        for (const auto& run : runs) {
+            fn(run.first, run.second);
+        }
+        return;
+    }
+    ThreadPool pool(threads - 1);  // The calling thread is the last worker
+    pool.parallelFor(runs.size(), [&](size_t i) {
+        fn(runs[i].first, runs[i].second);
+    });
+}
+
+template <typename MakeKey, typename Less>
+void ListingSorter::sortByKey(const FileInfoBatch& files, vector<uint32_t>& rows,
+                              MakeKey makeKey, const Less& less) const {
+    // Keys longer than a name can be are cut short; rows whose keys tie
+    // are put in order by the real comparator afterwards
+    FileInfoBatch keys(LIST_NAME);
+    string key;
+    for (size_t i = 0; i < files.size(); ++i) {
+        makeKey(files.name(i), key);
+        keys.append(string_view(key).substr(0, MAX_KEY_LENGTH), DT_UNKNOWN);
+    }
+    sortByName(keys, rows.data(), rows.size(), 0);
+
+    for (size_t begin = 0; begin < rows.size();) {
+        size_t end = begin + 1;
+        while (end < rows.size() && keys.name(rows[end]) == keys.name(rows[begin])) {
+            ++end;
+        }
+        if (end - begin > 1) {
+            std::sort(rows.data() + begin, rows.data() + end, less);
+        }
+        begin = end;
+    }
+}
\ No newline at end of file
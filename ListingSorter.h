@@ -0,0 +1,120 @@
+#ifndef LISTING_SORTER_H
+#define LISTING_SORTER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "FileInfoBatch.h"
+
+/**
+ * @brief Order of a directory listing
+ */
+enum class SortKey {
+    None,       ///< On-disk order (no sorting, rows stream as they are read)
+    Name,       ///< Byte order of the names, independent of the locale
+    Version,    ///< Natural order: digit runs compare by value ("file9" < "file10")
+    Size,       ///< Largest first
+    Time,       ///< Newest first
+    Extension   ///< By the text after the last '.', then by name
+};
+
+/**
+ * @brief How a listing should be sorted
+ */
+struct SortOptions {
+    SortKey key = SortKey::None;  ///< Primary key
+    bool reverse = false;         ///< Reverse the final order
+    unsigned threads = 0;         ///< Threads for huge listings (0 = hardware concurrency)
+};
+
+/**
+ * @brief Sorts listings through a permutation index
+ *
+ * Rows of a FileInfoBatch are never compared in place. The sorter builds
+ * an array of row numbers, orders that, and the batch is permuted once at
+ * the end.
+ *
+ * Every key is a radix sort on 64-bit keys: size, time, or the next eight
+ * bytes of the name, big-endian so integer order is byte order. Byte
+ * positions every key agrees on are skipped. Rows that tie are sorted
+ * again on the following eight bytes of their names, so names cost a pass
+ * per eight bytes of shared prefix rather than a comparison sort. Natural
+ * and extension order first rewrite each name into a key whose byte order
+ * is the wanted order, then sort those keys the same way. Once a listing
+ * has PARALLEL_THRESHOLD rows, the tie runs are spread over a ThreadPool.
+ */
+class ListingSorter {
+public:
+    /// Listings with at least this many rows are sorted on several threads
+    static constexpr size_t PARALLEL_THRESHOLD = 64 * 1024;
+
+    explicit ListingSorter(SortOptions options);
+
+    /**
+     * @brief Compute the sorted order of a listing without touching it
+     * @return Row numbers; row i of the sorted listing is files row order[i]
+     */
+    std::vector<uint32_t> order(const FileInfoBatch& files) const;
+
+    /**
+     * @brief Sort a listing in place
+     */
+    void sort(FileInfoBatch& files) const;
+
+    /**
+     * @brief Parse a --sort= argument (name, version, size, time, extension, none)
+     * @throws std::runtime_error for an unknown key
+     */
+    static SortKey parseKey(const std::string& name);
+
+    /**
+     * @brief Compare two names in natural order
+     * @return Negative, zero or positive like memcmp
+     */
+    static int compareNatural(std::string_view a, std::string_view b);
+
+private:
+    using Runs = std::vector<std::pair<size_t, size_t>>;  ///< [begin, end) ranges of rows
+
+    /**
+     * @brief Radix sort rows by name, starting at byte depth of each name
+     */
+    void sortByName(const FileInfoBatch& files, uint32_t* rows, size_t count, size_t depth) const;
+
+    /**
+     * @brief Sort rows by extension, then by name
+     */
+    void sortByExtension(const FileInfoBatch& files, std::vector<uint32_t>& rows) const;
+
+    /**
+     * @brief Sort rows in natural name order
+     */
+    void sortByVersion(const FileInfoBatch& files, std::vector<uint32_t>& rows) const;
+
+    /**
+     * @brief Radix sort rows by a 64-bit key, breaking ties by name
+     */
+    void sortByNumber(const FileInfoBatch& files, std::vector<uint32_t>& rows,
+                      const std::vector<uint64_t>& keys) const;
+
+    /**
+     * @brief Call fn(begin, end) for every run, on several threads when there are many rows
+     */
+    template <typename Fn>
+    void forEachRun(const Runs& runs, size_t rows, const Fn& fn) const;
+
+    /**
+     * @brief Sort rows by derived keys whose byte order is the wanted order
+     * @param makeKey Writes the key of a name into a string
+     * @param less Orders rows whose keys are equal
+     */
+    template <typename MakeKey, typename Less>
+    void sortByKey(const FileInfoBatch& files, std::vector<uint32_t>& rows,
+                   MakeKey makeKey, const Less& less) const;
+
+    SortOptions options;
+    unsigned threads;  ///< Resolved thread count
+};
+
+#endif // LISTING_SORTER_H
\ No newline at end of file
@@ -0,0 +1,371 @@
+#include "Metrics.h"
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t SYSCALL_KINDS = static_cast<size_t>(Syscall::COUNT);
+constexpr size_t PHASES = static_cast<size_t>(Phase::COUNT);
+constexpr size_t BUCKETS = LatencyHistogram::BUCKETS;
+
+/// Events a thread buffers before writing them to the trace file
+constexpr size_t TRACE_FLUSH_EVENTS = 4096;
+
+struct TraceEvent {
+    string name;
+    const char* category;
+    uint64_t start;
+    uint64_t nanos;
+};
+
+/**
+ * @brief Add to a counter that only the calling thread writes
+ *
+ * A plain load and store: readers see a consistent value, and nothing
+ * locks the bus the way fetch_add would.
+ */
+inline void bump(atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+struct ThreadMetrics;
+
+/**
+ * @brief State shared by every thread; never touched by the counting paths
+ */
+struct Registry {
+    mutex lock;
+    vector<ThreadMetrics*> threads;
+    MetricsSnapshot retired;    ///< Counted by threads that have exited
+    MetricsSnapshot baseline;   ///< Subtracted from every snapshot (set by reset())
+    map<string, LatencyHistogram> commands;
+
+    atomic<bool> tracing{false};
+    ofstream traceFile;
+    string tracePath;
+    bool firstEvent = true;
+    uint64_t traceStart = 0;
+};
+
+/// Never destroyed: pool threads may still exit during static destruction
+Registry& registry() {
+    static Registry* instance = new Registry;
+    return *instance;
+}
+
+string jsonEscape(const string& text) {
+    string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+/**
+ * @brief Append events to the trace file (registry lock held)
+ */
+void writeEvents(Registry& shared, const vector<TraceEvent>& events, long tid) {
+    if (!shared.traceFile.is_open()) {
+        return;
+    }
+    char line[160];
+    for (const TraceEvent& event : events) {
+        uint64_t start = event.start > shared.traceStart ? event.start - shared.traceStart : 0;
+        snprintf(line, sizeof(line), "\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%ld}",
+                 event.category, start / 1000.0, event.nanos / 1000.0, static_cast<int>(getpid()), tid);
+        shared.traceFile << (shared.firstEvent ? "\n" : ",\n") << "{\"name\":\"" << jsonEscape(event.name)
+                         << "\"," << line;
+        shared.firstEvent = false;
+    }
+}
+
+/**
+ * @brief One thread's counters, registered on the thread's first use
+ */
+struct ThreadMetrics {
+    atomic<uint64_t> syscalls[SYSCALL_KINDS];
+    atomic<uint64_t> bytesRead;
+    atomic<uint64_t> bytesWritten;
+    atomic<uint64_t> phaseBuckets[PHASES][BUCKETS];
+    atomic<uint64_t> phaseSamples[PHASES];
+    atomic<uint64_t> phaseNanos[PHASES];
+
+    mutex traceLock;            ///< Only contended while a trace is being finished
+    vector<TraceEvent> trace;
+    long tid;
+
+    ThreadMetrics() : tid(syscall(SYS_gettid)) {
+        for (auto& counter : syscalls) counter.store(0, memory_order_relaxed);
+        bytesRead.store(0, memory_order_relaxed);
+        bytesWritten.store(0, memory_order_relaxed);
+        for (size_t p = 0; p < PHASES; ++p) {
+            for (auto& bucket : phaseBuckets[p]) bucket.store(0, memory_order_relaxed);
+            phaseSamples[p].store(0, memory_order_relaxed);
+            phaseNanos[p].store(0, memory_order_relaxed);
+        }
+        Registry& shared = registry();
+        lock_guard<mutex> lock(shared.lock);
+        shared.threads.push_back(this);
+    }
+
+    ~ThreadMetrics() {
+        Registry& shared = registry();
+        lock_guard<mutex> lock(shared.lock);
+        addTo(shared.retired);
+        writeEvents(shared, trace, tid);
+        for (size_t i = 0; i < shared.threads.size(); ++i) {
+            if (shared.threads[i] == this) {
+                shared.threads[i] = shared.threads.back();
+                shared.threads.pop_back();
+                break;
+            }
+        }
+    }
+
+    void addTo(MetricsSnapshot& totals) const {
+        for (size_t i = 0; i < SYSCALL_KINDS; ++i) {
+            totals.syscalls[i] += syscalls[i].load(memory_order_relaxed);
+        }
+        totals.bytesRead += bytesRead.load(memory_order_relaxed);
+        totals.bytesWritten += bytesWritten.load(memory_order_relaxed);
+        for (size_t p = 0; p < PHASES; ++p) {
+            LatencyHistogram& histogram = totals.phases[p];
+            for (size_t b = 0; b < BUCKETS; ++b) {
+                histogram.counts[b] += phaseBuckets[p][b].load(memory_order_relaxed);
+            }
+            histogram.samples += phaseSamples[p].load(memory_order_relaxed);
+            histogram.totalNanos += phaseNanos[p].load(memory_order_relaxed);
+        }
+    }
+
+    void addTrace(string name, const char* category, uint64_t start, uint64_t nanos) {
+        vector<TraceEvent> full;
+        {
+            lock_guard<mutex> lock(traceLock);
+            trace.push_back(TraceEvent{std::move(name), category, start, nanos});
+            if (trace.size() < TRACE_FLUSH_EVENTS) {
+                return;
+            }
+            full.swap(trace);
+        }
+        Registry& shared = registry();
+        lock_guard<mutex> lock(shared.lock);
+        writeEvents(shared, full, tid);
+    }
+};
+
+thread_local ThreadMetrics local;
+
+/**
+ * @brief Live and retired totals, before the baseline is taken off (registry lock held)
+ */
+MetricsSnapshot gather(Registry& shared) {
+    MetricsSnapshot totals = shared.retired;
+    for (const ThreadMetrics* thread : shared.threads) {
+        thread->addTo(totals);
+    }
+    return totals;
+}
+
+/**
+ * @brief Write out every buffered event and close the trace (registry lock held)
+ */
+string finishTrace(Registry& shared) {
+    if (!shared.traceFile.is_open()) {
+        return "";
+    }
+    shared.tracing.store(false, memory_order_relaxed);
+    for (ThreadMetrics* thread : shared.threads) {
+        vector<TraceEvent> events;
+        {
+            lock_guard<mutex> lock(thread->traceLock);
+            events.swap(thread->trace);
+        }
+        writeEvents(shared, events, thread->tid);
+    }
+    shared.traceFile << "\n]}\n";
+    shared.traceFile.close();
+    return shared.tracePath;
+}
+
+} // namespace
+
+// ==================== LatencyHistogram ====================
+
+size_t LatencyHistogram::bucketFor(uint64_t nanos) {
+    if (nanos == 0) {
+        return 0;
+    }
+    return min(BUCKETS - 1, static_cast<size_t>(63 - __builtin_clzll(nanos)));
+}
+
+void LatencyHistogram::add(uint64_t nanos) {
+    ++counts[bucketFor(nanos)];
+    ++samples;
+    totalNanos += nanos;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        counts[i] += other.counts[i];
+    }
+    samples += other.samples;
+    totalNanos += other.totalNanos;
+}
+
+void LatencyHistogram::subtract(const LatencyHistogram& other) {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        counts[i] -= other.counts[i];
+    }
+    samples -= other.samples;
+    totalNanos -= other.totalNanos;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    if (samples == 0) {
+        return 0;
+    }
+    uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(ceil(q * samples)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return uint64_t(1) << (i + 1);
+        }
+    }
+    return uint64_t(1) << BUCKETS;
+}
+
+// ==================== Metrics ====================
+
+void Metrics::countSyscall(Syscall kind, uint64_t calls) {
+    bump(local.syscalls[static_cast<size_t>(kind)], calls);
+}
+
+void Metrics::addBytesRead(uint64_t bytes) {
+    bump(local.bytesRead, bytes);
+}
+
+void Metrics::addBytesWritten(uint64_t bytes) {
+    bump(local.bytesWritten, bytes);
+}
+
+void Metrics::recordPhase(Phase phase, uint64_t start, uint64_t nanos) {
+    ThreadMetrics& metrics = local;
+    size_t p = static_cast<size_t>(phase);
+    bump(metrics.phaseBuckets[p][LatencyHistogram::bucketFor(nanos)], 1);
+    bump(metrics.phaseSamples[p], 1);
+    bump(metrics.phaseNanos[p], nanos);
+    if (registry().tracing.load(memory_order_relaxed)) {
+        metrics.addTrace(phaseName(phase), "phase", start, nanos);
+    }
+}
+
+void Metrics::recordCommand(const string& name, uint64_t start, uint64_t nanos) {
+    Registry& shared = registry();
+    {
+        lock_guard<mutex> lock(shared.lock);
+        shared.commands[name].add(nanos);
+    }
+    if (shared.tracing.load(memory_order_relaxed)) {
+        local.addTrace(name, "command", start, nanos);
+    }
+}
+
+MetricsSnapshot Metrics::snapshot() {
+    Registry& shared = registry();
+    lock_guard<mutex> lock(shared.lock);
+    MetricsSnapshot totals = gather(shared);
+    for (size_t i = 0; i < SYSCALL_KINDS; ++i) {
+        totals.syscalls[i] -= shared.baseline.syscalls[i];
+    }
+    totals.bytesRead -= shared.baseline.bytesRead;
+    totals.bytesWritten -= shared.baseline.bytesWritten;
+    for (size_t p = 0; p < PHASES; ++p) {
+        totals.phases[p].subtract(shared.baseline.phases[p]);
+    }
+    totals.commands.assign(shared.commands.begin(), shared.commands.end());
+    return totals;
+}
+
+void Metrics::reset() {
+    Registry& shared = registry();
+    lock_guard<mutex> lock(shared.lock);
+    shared.baseline = gather(shared);
+    shared.commands.clear();
+}
+
+void Metrics::startTrace(const string& path) {
+    Registry& shared = registry();
+    lock_guard<mutex> lock(shared.lock);
+    finishTrace(shared);
+    shared.traceFile.open(path, ios::out | ios::trunc);
+    if (!shared.traceFile) {
+        throw runtime_error("Cannot create trace file " + path + ": " + strerror(errno));
+    }
+    shared.traceFile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    shared.tracePath = path;
+    shared.firstEvent = true;
+    shared.traceStart = now();
+    shared.tracing.store(true, memory_order_relaxed);
+}
+
+string Metrics::stopTrace() {
+    Registry& shared = registry();
+    lock_guard<mutex> lock(shared.lock);
+    return finishTrace(shared);
+}
+
+uint64_t Metrics::now() {
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+const char* Metrics::syscallName(Syscall kind) {
+    switch (kind) {
+        case Syscall::Open:     return "open";
+        case Syscall::Close:    return "close";
+        case Syscall::Getdents: return "getdents";
+        case Syscall::Stat:     return "stat";
+        case Syscall::Read:     return "read";
+        case Syscall::Write:    return "write";
+        case Syscall::Copy:     return "copy";
+        case Syscall::Mmap:     return "mmap";
+        case Syscall::Unlink:   return "unlink";
+        case Syscall::Rename:   return "rename";
+        case Syscall::Mkdir:    return "mkdir";
+        case Syscall::Sync:     return "sync";
+        case Syscall::COUNT:    break;
+    }
+    return "?";
+}
+
+const char* Metrics::phaseName(Phase phase) {
+    switch (phase) {
+        case Phase::Metadata:       return "metadata";
+        case Phase::NameResolution: return "name resolution";
+        case Phase::Rendering:      return "rendering";
+        case Phase::COUNT:          break;
+    }
+    return "?";
+}
\ No newline at end of file
@@ -0,0 +1,153 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+/// System calls counted by FE_COUNT_SYSCALL
+enum class Syscall : uint8_t {
+    Open, Close, Getdents, Stat, Read, Write, Copy, Mmap, Unlink, Rename, Mkdir, Sync,
+    COUNT
+};
+
+/// Where time goes, measured by FE_TIME_PHASE
+enum class Phase : uint8_t {
+    Metadata,        ///< getdents and stat calls
+    NameResolution,  ///< uid/gid lookups that reach NSS (cache hits cost less than timing them)
+    Rendering,       ///< Formatting and writing listing rows
+    COUNT
+};
+
+/**
+ * @brief Log2 latency histogram: bucket i counts durations in [2^i, 2^(i+1)) ns
+ */
+struct LatencyHistogram {
+    static constexpr size_t BUCKETS = 48;
+
+    uint64_t counts[BUCKETS] = {};
+    uint64_t samples = 0;
+    uint64_t totalNanos = 0;
+
+    void add(uint64_t nanos);
+    void merge(const LatencyHistogram& other);
+    void subtract(const LatencyHistogram& other);
+
+    /**
+     * @brief Upper bound, in nanoseconds, of the bucket holding quantile q (0 if empty)
+     */
+    uint64_t percentile(double q) const;
+
+    static size_t bucketFor(uint64_t nanos);
+};
+
+/**
+ * @brief Totals over every thread, since the start or the last reset
+ */
+struct MetricsSnapshot {
+    uint64_t syscalls[static_cast<size_t>(Syscall::COUNT)] = {};
+    uint64_t bytesRead = 0;
+    uint64_t bytesWritten = 0;
+    LatencyHistogram phases[static_cast<size_t>(Phase::COUNT)];
+    std::vector<std::pair<std::string, LatencyHistogram>> commands;  ///< Per command name, by name
+};
+
+/**
+ * @brief Process-wide counters, latency histograms and an optional trace
+ *
+ * Every thread counts into its own block, registered once when the thread
+ * first records something. Recording is a relaxed load and store on that
+ * block: no lock and no atomic read-modify-write, since only the owning
+ * thread writes it. snapshot() sums the blocks of live threads with the
+ * totals left by finished ones, so it is only exact once work has stopped.
+ *
+ * Hot paths use the FE_* macros, which compile to nothing when
+ * FE_NO_METRICS is defined (make METRICS=0).
+ *
+ * While a trace is on, timed phases and commands are also logged as
+ * Chrome trace events (chrome://tracing, Perfetto), buffered per thread.
+ */
+class Metrics {
+public:
+#ifdef FE_NO_METRICS
+    static constexpr bool ENABLED = false;
+#else
+    static constexpr bool ENABLED = true;
+#endif
+
+    static void countSyscall(Syscall kind, uint64_t calls = 1);
+    static void addBytesRead(uint64_t bytes);
+    static void addBytesWritten(uint64_t bytes);
+
+    /**
+     * @brief Record a timed phase (start and duration from now())
+     */
+    static void recordPhase(Phase phase, uint64_t start, uint64_t nanos);
+
+    /**
+     * @brief Record the latency of a command (takes a lock; not for hot paths)
+     */
+    static void recordCommand(const std::string& name, uint64_t start, uint64_t nanos);
+
+    static MetricsSnapshot snapshot();
+
+    /**
+     * @brief Start counting from zero again
+     */
+    static void reset();
+
+    /**
+     * @brief Start writing a Chrome trace (ends any trace already running)
+     * @throws std::runtime_error if the file cannot be created
+     */
+    static void startTrace(const std::string& path);
+
+    /**
+     * @brief Finish the trace file
+     * @return Its path, or an empty string if no trace was running
+     */
+    static std::string stopTrace();
+
+    /**
+     * @brief Monotonic clock in nanoseconds
+     */
+    static uint64_t now();
+
+    static const char* syscallName(Syscall kind);
+    static const char* phaseName(Phase phase);
+
+    /**
+     * @brief Times the enclosing scope as a phase
+     */
+    class PhaseTimer {
+    public:
+        explicit PhaseTimer(Phase phase) : phase(phase), start(now()) {}
+        ~PhaseTimer() { recordPhase(phase, start, now() - start); }
+
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    private:
+        Phase phase;
+        uint64_t start;
+    };
+};
+
+#define FE_METRICS_CONCAT2(a, b) a##b
+#define FE_METRICS_CONCAT(a, b) FE_METRICS_CONCAT2(a, b)
+
+#ifdef FE_NO_METRICS
+#define FE_COUNT_SYSCALL(kind, calls) ((void)0)
+#define FE_COUNT_BYTES_READ(bytes) ((void)0)
+#define FE_COUNT_BYTES_WRITTEN(bytes) ((void)0)
+#define FE_TIME_PHASE(phase) ((void)0)
+#else
+#define FE_COUNT_SYSCALL(kind, calls) Metrics::countSyscall(Syscall::kind, (calls))
+#define FE_COUNT_BYTES_READ(bytes) Metrics::addBytesRead(bytes)
+#define FE_COUNT_BYTES_WRITTEN(bytes) Metrics::addBytesWritten(bytes)
+#define FE_TIME_PHASE(phase) Metrics::PhaseTimer FE_METRICS_CONCAT(phaseTimer, __LINE__)(Phase::phase)
+#endif
+
+#endif // METRICS_H
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "NameCache.h"
+#include "Metrics.h"
+#include <vector>
+#include <mutex>
+#include <cerrno>
+#include <unistd.h>
+#include <pwd.h>
+#include <grp.h>
+
+using namespace std;
+
+namespace {
+
+const char* const UNKNOWN_NAME = "unknown";
+
+/**
+ * @brief Target of default-constructed handles (function-local to avoid init-order issues)
+ */
+const string& emptyName() {
+    static const string empty;
+    return empty;
+}
+
+/**
+ * @brief Initial buffer size for the reentrant NSS calls
+ */
+size_t nssBufferSize(int name) {
+    long size = sysconf(name);
+    return size > 0 ? static_cast<size_t>(size) : 1024;
+}
+
+string resolveUser(uint32_t uid) {
+    FE_TIME_PHASE(NameResolution);
+    vector<char> buffer(nssBufferSize(_SC_GETPW_R_SIZE_MAX));
+    struct passwd pwd;
+    struct passwd* result = nullptr;
+    int rc;
+    while ((rc = getpwuid_r(uid, &pwd, buffer.data(), buffer.size(), &result)) == ERANGE) {
+        buffer.resize(buffer.size() * 2);
+    }
+    return (rc == 0 && result) ? string(result->pw_name) : UNKNOWN_NAME;
+}
+
+string resolveGroup(uint32_t gid) {
+    FE_TIME_PHASE(NameResolution);
+    vector<char> buffer(nssBufferSize(_SC_GETGR_R_SIZE_MAX));
+    struct group grp;
+    struct group* result = nullptr;
+    int rc;
+    while ((rc = getgrgid_r(gid, &grp, buffer.data(), buffer.size(), &result)) == ERANGE) {
+        buffer.resize(buffer.size() * 2);
+    }
+    return (rc == 0 && result) ? string(result->gr_name) : UNKNOWN_NAME;
+}
+
+} // namespace
+
+NameHandle::NameHandle() : name(&emptyName()) {}
+
+NameCache& NameCache::instance() {
+    static NameCache cache;
+    return cache;
+}
+
+template <typename Resolver>
+NameHandle NameCache::lookup(unordered_map<uint32_t, string>& table,
+                             shared_mutex& mutex, uint32_t id, Resolver resolve,
+                             atomic<uint64_t>& hits, atomic<uint64_t>& misses) {
+    {
+        shared_lock<shared_mutex> lock(mutex);
+        auto it = table.find(id);
+        if (it != table.end()) {
+            hits.fetch_add(1, memory_order_relaxed);
+            return NameHandle(&it->second);
+        }
+    }
+
+    // Resolve under the exclusive lock so each id reaches NSS exactly once.
+    // unordered_map never moves its nodes, so handles stay valid on rehash.
+    unique_lock<shared_mutex> lock(mutex);
+    auto it = table.find(id);
+    if (it != table.end()) {
+        hits.fetch_add(1, memory_order_relaxed);
+        return NameHandle(&it->second);
+    }
+    misses.fetch_add(1, memory_order_relaxed);
+    it = table.emplace(id, resolve(id)).first;
+    return NameHandle(&it->second);
+}
+
+NameHandle NameCache::user(uid_t uid) {
+    return lookup(users, usersMutex, uid, resolveUser, userHits, userMisses);
+}
+
+NameHandle NameCache::group(gid_t gid) {
+    return lookup(groups, groupsMutex, gid, resolveGroup, groupHits, groupMisses);
+}
+
+NameCache::Stats NameCache::stats() const {
+    return Stats{userHits.load(memory_order_relaxed), userMisses.load(memory_order_relaxed),
+                 groupHits.load(memory_order_relaxed), groupMisses.load(memory_order_relaxed)};
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#ifndef NAME_CACHE_H
+#define NAME_CACHE_H
+
+#include <string>
+#include <cstdint>
+#include <atomic>
+#include <ostream>
+#include <shared_mutex>
+#include <unordered_map>
+#include <sys/types.h>
+
+/**
+ * @brief Handle to an interned user or group name
+ *
+ * Handles are cheap to copy and point into storage owned by NameCache,
+ * which lives for the whole process, so they never dangle.
+ */
+class NameHandle {
+public:
+    /**
+     * @brief Construct an empty handle
+     */
+    NameHandle();
+
+    /**
+     * @brief Access the interned name
+     */
+    const std::string& str() const { return *name; }
+
+    operator const std::string&() const { return *name; }
+
+    bool operator==(const NameHandle& other) const { return name == other.name; }
+    bool operator!=(const NameHandle& other) const { return name != other.name; }
+
+private:
+    friend class NameCache;
+    explicit NameHandle(const std::string* name) : name(name) {}
+
+    const std::string* name;  ///< Interned string owned by NameCache
+};
+
+inline std::ostream& operator<<(std::ostream& os, const NameHandle& handle) {
+    return os << handle.str();
+}
+
+/**
+ * @brief Process-wide, thread-safe uid/gid to name cache
+ *
+ * Each distinct id is resolved exactly once through the reentrant
+ * getpwuid_r/getgrgid_r calls; every later lookup is a shared-lock hash
+ * probe. This keeps NSS (and any LDAP behind it) off the listing path.
+ */
+class NameCache {
+public:
+    /**
+     * @brief Counters describing cache effectiveness
+     */
+    struct Stats {
+        uint64_t userHits;     ///< Owner lookups served from the cache
+        uint64_t userMisses;   ///< Owner lookups that went to NSS
+        uint64_t groupHits;    ///< Group lookups served from the cache
+        uint64_t groupMisses;  ///< Group lookups that went to NSS
+    };
+
+    /**
+     * @brief Get the process-wide instance
+     */
+    static NameCache& instance();
+
+    /**
+     * @brief Resolve a user id to its name ("unknown" if it has no passwd entry)
+     */
+    NameHandle user(uid_t uid);
+
+    /**
+     * @brief Resolve a group id to its name ("unknown" if it has no group entry)
+     */
+    NameHandle group(gid_t gid);
+
+    /**
+     * @brief Snapshot the hit/miss counters
+     */
+    Stats stats() const;
+
+    NameCache(const NameCache&) = delete;
+    NameCache& operator=(const NameCache&) = delete;
+
+private:
+    NameCache() = default;
+
+    /**
+     * @brief Shared lookup/insert logic for both id tables
+     */
+    template <typename Resolver>
+    NameHandle lookup(std::unordered_map<uint32_t, std::string>& table,
+                      std::shared_mutex& mutex, uint32_t id, Resolver resolve,
+                      std::atomic<uint64_t>& hits, std::atomic<uint64_t>& misses);
+
+    std::unordered_map<uint32_t, std::string> users;   ///< uid -> name
+    std::unordered_map<uint32_t, std::string> groups;  ///< gid -> name
+    std::shared_mutex usersMutex;
+    std::shared_mutex groupsMutex;
+
+    std::atomic<uint64_t> userHits{0};
+    std::atomic<uint64_t> userMisses{0};
+    std::atomic<uint64_t> groupHits{0};
+    std::atomic<uint64_t> groupMisses{0};
+};
+
+#endif // NAME_CACHE_H
\ No newline at end of file
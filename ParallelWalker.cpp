@@ -0,0 +1,297 @@
+#include "ParallelWalker.h"
+#include "Metrics.h"
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+namespace {
+
+/// Layout of the records returned by getdents64 (not exported by glibc)
+struct linux_dirent64 {
+    ino64_t        d_ino;
+    off64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+constexpr size_t DIRENT_BUFFER_SIZE = 64 * 1024;
+
+/**
+ * @brief Shared ownership of a directory descriptor
+ *
+ * A directory's fd stays open while any of its subdirectories is still
+ * waiting in a queue, so those can be opened with openat().
+ */
+struct FdRef {
+    int fd;
+    explicit FdRef(int fd) : fd(fd) {}
+    ~FdRef() { if (fd >= 0) ::close(fd); }
+};
+
+unsigned char typeFromMode(mode_t mode) {
+    if (S_ISDIR(mode)) return DT_DIR;
+    if (S_ISREG(mode)) return DT_REG;
+    if (S_ISLNK(mode)) return DT_LNK;
+    return DT_UNKNOWN;
+}
+
+} // namespace
+
+struct ParallelWalker::DirTask {
+    shared_ptr<FdRef> parent;  ///< Parent directory (null for the root)
+    string path;               ///< Full path of this directory
+    size_t nameOffset;         ///< Start of the name relative to parent within path
+    int openFd;                ///< Already-open descriptor, or -1
+};
+
+struct ParallelWalker::ResultNode {
+    atomic<ResultNode*> next{nullptr};
+    string value;
+};
+
+ParallelWalker::ParallelWalker(unsigned threads)
+    : threads(threads ? threads : max(1u, thread::hardware_concurrency())), control(JobControl::current()) {
+    for (unsigned i = 0; i < this->threads; ++i) {
+        queues.push_back(make_unique<WorkQueue>());
+    }
+    resultsTail = new ResultNode();
+    resultsHead.store(resultsTail);
+}
+
+ParallelWalker::~ParallelWalker() {
+    while (resultsTail) {
+        ResultNode* next = resultsTail->next.load();
+        delete resultsTail;
+        resultsTail = next;
+    }
+}
+
+void ParallelWalker::emit(string result) {
+    // Vyukov multi-producer/single-consumer queue: one exchange per push
+    auto* node = new ResultNode();
+    node->value = std::move(result);
+    ResultNode* prev = resultsHead.exchange(node, memory_order_acq_rel);
+    prev->next.store(node, memory_order_release);
+}
+
+string ParallelWalker::firstError() const {
+    lock_guard<mutex> lock(errorMutex);
+    return firstFailure;
+}
+
+void ParallelWalker::recordError(const string& path, int error) {
+    if (unreadable.fetch_add(1, memory_order_relaxed) == 0) {
+        lock_guard<mutex> lock(errorMutex);
+        firstFailure = path + ": " + strerror(error);
+    }
+}
+
+bool ParallelWalker::drainResults(const ResultHandler& onResult) {
+    bool any = false;
+    while (ResultNode* next = resultsTail->next.load(memory_order_acquire)) {
+        delete resultsTail;
+        resultsTail = next;
+        if (onResult) {
+            onResult(std::move(next->value));
+        }
+        any = true;
+    }
+    return any;
+}
+
+ParallelWalker::DirTask* ParallelWalker::takeTask(unsigned index) {
+    {
+        WorkQueue& own = *queues[index];
+        lock_guard<mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            DirTask* task = own.tasks.back();
+            own.tasks.pop_back();
+            return task;
+        }
+    }
+    for (unsigned i = 1; i < threads; ++i) {
+        WorkQueue& victim = *queues[(index + i) % threads];
+        lock_guard<mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            DirTask* task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void ParallelWalker::processDirectory(DirTask* task, unsigned index, const Visitor& visitor,
+                                      const DirectoryHandler& onDirectoryDone, vector<char>& buffer,
+                                      PathBuffer& path, PathArena& arena) {
+    int fd = task->openFd;
+    if (fd < 0) {
+        fd = ::openat(task->parent ? task->parent->fd : AT_FDCWD,
+                      task->path.c_str() + (task->parent ? task->nameOffset : 0),
+                      O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        FE_COUNT_SYSCALL(Open, 1);
+    }
+    task->parent.reset();
+    if (fd < 0) {
+        recordError(task->path, errno);  // Skip it, but let the caller know the tree is partial
+        return;
+    }
+    auto self = make_shared<FdRef>(fd);
+    path.assign(task->path);
+    uint64_t scanned = 0;
+
+    while (!stopped()) {
+        long bytes;
+        {
+            FE_TIME_PHASE(Metadata);
+            bytes = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+            FE_COUNT_SYSCALL(Getdents, 1);
+        }
+        if (bytes <= 0) {
+            if (bytes < 0) {
+                recordError(task->path, errno);
+            }
+            break;
+        }
+        for (long offset = 0; offset < bytes;) {
+            auto* d = reinterpret_cast<linux_dirent64*>(buffer.data() + offset);
+            offset += d->d_reclen;
+
+            const char* name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            ++scanned;
+
+            unsigned char type = d->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat st;
+                FE_COUNT_SYSCALL(Stat, 1);
+                if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+                    type = typeFromMode(st.st_mode);
+                }
+            }
+
+            size_t mark = path.push(name);
+            bool descend = false;
+            try {
+                descend = visitor(WalkEntry{fd, task->path, name, type, index, path.view(), arena});
+            } catch (const exception&) {
+                path.truncate(mark);
+                continue;  // Skip entries the visitor can't handle
+            }
+
+            if (type == DT_DIR && descend) {
+                auto* child = new DirTask{self, path.str(), path.size() - strlen(name), -1};
+                pending.fetch_add(1, memory_order_relaxed);
+                WorkQueue& own = *queues[index];
+                lock_guard<mutex> lock(own.mutex);
+                own.tasks.push_back(child);
+            }
+            path.truncate(mark);
+        }
+    }
+
+    if (onDirectoryDone) {
+        try {
+            onDirectoryDone(fd, task->path, index);
+        } catch (const exception&) {
+            // Same policy as the visitor: a failing directory doesn't stop the walk
+        }
+    }
+    arena.reset();
+    if (control) {
+        control->addScanned(scanned);
+    }
+}
+
+void ParallelWalker::workerLoop(unsigned index, const Visitor& visitor,
+                                const DirectoryHandler& onDirectoryDone) {
+    vector<char> buffer(DIRENT_BUFFER_SIZE);
+    PathBuffer path;
+    PathArena arena;
+    JobControl::Scope job(control);  // For anything the visitor starts
+    unsigned idleRounds = 0;
+
+    while (true) {
+        DirTask* task = takeTask(index);
+        if (task) {
+            if (!stopped()) {
+                processDirectory(task, index, visitor, onDirectoryDone, buffer, path, arena);
+            } else if (task->openFd >= 0) {
+                ::close(task->openFd);  // Stopping: drain the queues without opening anything
+            }
+            delete task;
+            pending.fetch_sub(1, memory_order_acq_rel);
+            idleRounds = 0;
+            continue;
+        }
+        if (pending.load(memory_order_acquire) == 0) {
+            break;
+        }
+        // Others are still expanding directories; back off gently
+        if (++idleRounds < 64) {
+            this_thread::yield();
+        } else {
+            this_thread::sleep_for(chrono::microseconds(50));
+        }
+    }
+}
+
+void ParallelWalker::walk(const string& root, const Visitor& visitor, const ResultHandler& onResult,
+                          const DirectoryHandler& onDirectoryDone) {
+    int rootFd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        throw runtime_error("Cannot open directory: " + root + ": " + strerror(errno));
+    }
+
+    pending.store(1);
+    stopping.store(false);
+    unreadable.store(0);
+    firstFailure.clear();
+    queues[0]->tasks.push_back(new DirTask{nullptr, root, 0, rootFd});
+
+    atomic<unsigned> running{threads};
+    vector<thread> workers;
+    workers.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([this, i, &visitor, &onDirectoryDone, &running] {
+            workerLoop(i, visitor, onDirectoryDone);
+            running.fetch_sub(1, memory_order_acq_rel);
+        });
+    }
+
+    // Stream results to the caller while the workers run. If the caller's
+    // handler throws, the workers still reference this frame: stop them and
+    // join before the exception leaves.
+    try {
+        while (running.load(memory_order_acquire) > 0) {
+            if (!drainResults(onResult)) {
+                this_thread::sleep_for(chrono::microseconds(200));
+            }
+        }
+    } catch (...) {
+        stopping.store(true);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        throw;
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    drainResults(onResult);
+    if (control) {
+        control->checkpoint();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,165 @@
+#ifndef PARALLEL_WALKER_H
+#define PARALLEL_WALKER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include "PathArena.h"
+#include "JobControl.h"
+
+/**
+ * @brief One directory entry as seen by a ParallelWalker visitor
+ */
+struct WalkEntry {
+    int dirFd;                   ///< Open descriptor of the containing directory
+    const std::string& dirPath;  ///< Path of the containing directory
+    const char* name;            ///< Entry name (no path components)
+    unsigned char type;          ///< DT_* type; DT_UNKNOWN is resolved before the visit
+    unsigned worker;             ///< Index of the worker thread making the visit
+    std::string_view fullPath;   ///< dirPath/name in the worker's path buffer, valid during the visit
+    PathArena& arena;            ///< Worker's scratch arena, reset after each directory
+
+    /**
+     * @brief Copy the full path of this entry, for results that outlive the visit
+     */
+    std::string path() const { return std::string(fullPath); }
+};
+
+/**
+ * @brief Multi-threaded recursive directory walker
+ *
+ * Each worker owns a deque of pending directories: it pushes and pops at
+ * the back (depth-first, so parent descriptors are released quickly) and
+ * steals from the front of other workers' deques when it runs dry.
+ * Directories are opened with openat() relative to their parent's
+ * descriptor and read with getdents64, so paths are never re-resolved.
+ *
+ * Each worker builds entry paths in its own PathBuffer and lends visitors
+ * a PathArena that is reset once a directory is done, so visiting an entry
+ * allocates nothing unless the visitor keeps a copy (WalkEntry::path()).
+ *
+ * A walker started on a job's thread stops early when the job is
+ * cancelled: workers check once per directory and per getdents64 buffer,
+ * and walk() then throws JobCancelled. Walked entries are counted into
+ * the job's progress.
+ *
+ * Subdirectories that cannot be opened or read (EACCES, EMFILE, ...) are
+ * skipped so the rest of the tree is still walked; they are counted, and
+ * callers report unreadableDirectories() so a partial result is not
+ * mistaken for a complete one.
+ *
+ * Results emitted by visitors travel through a lock-free queue and are
+ * handed to the caller's thread as soon as they arrive, so the first hits
+ * can be printed while the walk is still running.
+ */
+class ParallelWalker {
+public:
+    /**
+     * @brief Visitor called on a worker thread for every entry
+     * @return For directories, true to descend into it; ignored otherwise
+     */
+    using Visitor = std::function<bool(const WalkEntry& entry)>;
+
+    /**
+     * @brief Receives emitted results on the thread that called walk()
+     */
+    using ResultHandler = std::function<void(std::string&& result)>;
+
+    /**
+     * @brief Called on the worker once every entry of a directory has been visited
+     *
+     * The directory's descriptor is still open, and views into the
+     * worker's arena are still valid, so batched *at() work queued by the
+     * visitor can be flushed here.
+     */
+    using DirectoryHandler = std::function<void(int dirFd, const std::string& dirPath, unsigned worker)>;
+
+    /**
+     * @brief Construct a walker
+     * @param threads Number of worker threads (0 = hardware concurrency)
+     */
+    explicit ParallelWalker(unsigned threads = 0);
+    ~ParallelWalker();
+
+    /**
+     * @brief Number of worker threads used by walk()
+     */
+    unsigned threadCount() const { return threads; }
+
+    /**
+     * @brief Walk a tree, blocking until every directory has been visited
+     * @param root Directory to start from (not itself passed to the visitor)
+     * @param visitor Called for every entry below root
+     * @param onResult Called for every emit()ted result; may be empty
+     * @param onDirectoryDone Called after each directory's entries; may be empty
+     * @throws std::runtime_error if root cannot be opened
+     * @throws JobCancelled if the job running the walk was cancelled
+     *
+     * Anything thrown by onResult stops the workers and is rethrown once
+     * they have all been joined.
+     */
+    void walk(const std::string& root, const Visitor& visitor,
+              const ResultHandler& onResult = ResultHandler(),
+              const DirectoryHandler& onDirectoryDone = DirectoryHandler());
+
+    /**
+     * @brief Queue a result for the caller; safe to call from any visitor
+     */
+    void emit(std::string result);
+
+    /**
+     * @brief Directories below root the last walk() could not open or read
+     */
+    uint64_t unreadableDirectories() const { return unreadable.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief "path: reason" for the first of them, or empty if there were none
+     */
+    std::string firstError() const;
+
+    ParallelWalker(const ParallelWalker&) = delete;
+    ParallelWalker& operator=(const ParallelWalker&) = delete;
+
+private:
+    struct DirTask;
+    struct ResultNode;
+
+    /**
+     * @brief Per-worker deque of pending directories
+     */
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<DirTask*> tasks;
+    };
+
+    void workerLoop(unsigned index, const Visitor& visitor, const DirectoryHandler& onDirectoryDone);
+    void processDirectory(DirTask* task, unsigned index, const Visitor& visitor,
+                          const DirectoryHandler& onDirectoryDone, std::vector<char>& buffer,
+                          PathBuffer& path, PathArena& arena);
+    DirTask* takeTask(unsigned index);
+    bool drainResults(const ResultHandler& onResult);
+    void recordError(const std::string& path, int error);
+    bool stopped() const {
+        return stopping.load(std::memory_order_relaxed) || (control && control->cancelled());
+    }
+
+    unsigned threads;                                 ///< Worker thread count
+    JobControl* control;                              ///< Job of the constructing thread, or null
+    std::vector<std::unique_ptr<WorkQueue>> queues;   ///< One deque per worker
+    std::atomic<size_t> pending{0};                   ///< Directories queued or in progress
+    std::atomic<bool> stopping{false};                ///< Set when the caller's onResult threw
+
+    std::atomic<uint64_t> unreadable{0};              ///< Directories skipped by the current walk
+    mutable std::mutex errorMutex;                    ///< Guards firstFailure
+    std::string firstFailure;                         ///< First of them, as "path: reason"
+
+    std::atomic<ResultNode*> resultsHead;             ///< Producers push here
+    ResultNode* resultsTail;                          ///< Consumer pops here
+};
+
+#endif // PARALLEL_WALKER_H
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "PathArena.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// ==================== PathArena ====================
+
+string_view PathArena::copy(string_view text) {
+    size_t need = text.size() + 1;
+    while (current < blocks.size() && blocks[current].size - offset < need) {
+        ++current;
+        offset = 0;
+    }
+    if (current == blocks.size()) {
+        size_t size = max(BLOCK_SIZE, need);
+        blocks.push_back(Block{make_unique<char[]>(size), size});
+        offset = 0;
+    }
+    char* out = blocks[current].data.get() + offset;
+    memcpy(out, text.data(), text.size());
+    out[text.size()] = '\0';
+    offset += need;
+    used += need;
+    return string_view(out, text.size());
+}
+
+void PathArena::reset() {
+    current = 0;
+    offset = 0;
+    used = 0;
+}
+
+// ==================== PathBuffer ====================
+
+void PathBuffer::assign(string_view path) {
+    buffer.assign(path.data(), path.size());
+}
+
+size_t PathBuffer::push(string_view segment) {
+    size_t mark = buffer.size();
+    if (buffer.empty() || buffer.back() != '/') {
+        buffer += '/';
+    }
+    buffer.append(segment.data(), segment.size());
+    return mark;
+}
+
+void PathBuffer::popSegment() {
+    while (buffer.size() > 1 && buffer.back() == '/') {
+        buffer.pop_back();
+    }
+    size_t slash = buffer.find_last_of('/');
+    if (slash == string::npos) {
+        buffer.clear();
+    } else {
+        buffer.resize(max<size_t>(slash, 1));
+    }
+}
+
+void PathBuffer::append(string_view relative) {
+    bool trailingSlash = false;
+    while (!relative.empty()) {
+        size_t end = relative.find('/');
+        string_view segment = relative.substr(0, end);
+        relative = (end == string_view::npos) ? string_view() : relative.substr(end + 1);
+
+        if (segment.empty() || segment == ".") {
+            trailingSlash = true;
+        } else if (segment == "..") {
+            popSegment();
+            trailingSlash = true;
+        } else {
+            push(segment);
+            trailingSlash = end != string_view::npos;
+        }
+    }
+    if (trailingSlash && !buffer.empty() && buffer.back() != '/') {
+        buffer += '/';
+    }
+}
\ No newline at end of file
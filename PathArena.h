@@ -0,0 +1,108 @@
+#ifndef PATH_ARENA_H
+#define PATH_ARENA_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+/**
+ * @brief Monotonic allocator for short-lived names and paths
+ *
+ * copy() bumps a pointer through fixed-size blocks; nothing is freed until
+ * reset(), which rewinds to the first block and keeps every block for
+ * reuse. After the first few directories a walker's arena stops touching
+ * the heap entirely.
+ */
+class PathArena {
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    PathArena() = default;
+
+    /**
+     * @brief Copy text into the arena, NUL-terminated
+     * @return View of the copy (data() is a C string), valid until reset()
+     */
+    std::string_view copy(std::string_view text);
+
+    /**
+     * @brief Forget everything copied so far; every view becomes invalid
+     */
+    void reset();
+
+    /**
+     * @brief Bytes handed out since the last reset
+     */
+    size_t bytesUsed() const { return used; }
+
+    PathArena(const PathArena&) = delete;
+    PathArena& operator=(const PathArena&) = delete;
+    PathArena(PathArena&&) = default;
+    PathArena& operator=(PathArena&&) = default;
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0;  ///< Block being filled
+    size_t offset = 0;   ///< Next free byte of that block
+    size_t used = 0;
+};
+
+/**
+ * @brief Path built as a stack of segments in one reused buffer
+ *
+ * push() appends "/name" and returns a mark that truncate() goes back to,
+ * so a walker can form the full path of every entry of a directory
+ * without allocating: the buffer only grows when a path is longer than
+ * any seen before.
+ */
+class PathBuffer {
+public:
+    PathBuffer() = default;
+
+    /**
+     * @brief Start again from a directory path
+     */
+    void assign(std::string_view path);
+
+    /**
+     * @brief Append one segment, adding a separator unless the path ends in '/'
+     * @return Length before the push, for truncate()
+     */
+    size_t push(std::string_view segment);
+
+    /**
+     * @brief Go back to a length returned by push()
+     */
+    void truncate(size_t mark) { buffer.resize(mark); }
+
+    /**
+     * @brief Drop the last segment; the root "/" is never dropped
+     */
+    void popSegment();
+
+    /**
+     * @brief Append a relative path, resolving "." and ".." lexically
+     *
+     * Same result as std::filesystem::path::lexically_normal() on the
+     * concatenation, including the trailing '/' left by ".", ".." or a
+     * final separator, but without building a path object per segment.
+     */
+    void append(std::string_view relative);
+
+    std::string_view view() const { return buffer; }
+    const char* c_str() const { return buffer.c_str(); }
+    size_t size() const { return buffer.size(); }
+    std::string str() const { return buffer; }
+
+private:
+    std::string buffer;
+};
+
+#endif // PATH_ARENA_H
\ No newline at end of file
@@ -0,0 +1,582 @@
+#include "PathBatch.h"
+#include "PathArena.h"
+#include "ParallelWalker.h"
+#include "GlobMatcher.h"
+#include "IoBackend.h"
+#include "FileCopier.h"
+#include "FileMover.h"
+#include "TreeDeleter.h"
+#include "ThreadPool.h"
+#include "JobControl.h"
+#include "Metrics.h"
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Most unlinkat/renameat2 calls handed to the IoBackend at once
+constexpr size_t IO_BATCH_SIZE = 256;
+
+struct FdGuard {
+    int fd;
+    ~FdGuard() { if (fd >= 0) ::close(fd); }
+};
+
+/**
+ * @brief Directory descriptors kept open for a whole operation
+ */
+struct FdList {
+    vector<int> fds;
+    ~FdList() {
+        for (int fd : fds) {
+            ::close(fd);
+        }
+    }
+};
+
+unsigned char typeOf(mode_t mode) {
+    if (S_ISDIR(mode)) return DT_DIR;
+    if (S_ISREG(mode)) return DT_REG;
+    if (S_ISLNK(mode)) return DT_LNK;
+    return DT_UNKNOWN;
+}
+
+/**
+ * @brief Open a directory for *at() calls
+ * @throws runtime_error if it can't be opened
+ */
+int openDirectory(const string& path) {
+    FE_COUNT_SYSCALL(Open, 1);
+    int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        throw runtime_error("Cannot open directory: " + path + ": " + strerror(errno));
+    }
+    return fd;
+}
+
+string joinPath(const string& directory, const string& name) {
+    return directory.back() == '/' ? directory + name : directory + "/" + name;
+}
+
+/**
+ * @brief Collects failures from several threads; keeps the first message
+ */
+class FailureLog {
+public:
+    void add(const string& message) {
+        lock_guard<std::mutex> lock(mutex);
+        if (count++ == 0) {
+            first = message;
+        }
+    }
+
+    void moveTo(BatchStats& stats) {
+        stats.errors += count;
+        if (stats.firstError.empty()) {
+            stats.firstError = std::move(first);
+        }
+    }
+
+private:
+    std::mutex mutex;
+    uint64_t count = 0;
+    string first;
+};
+
+/**
+ * @brief Expand one absolute glob into (path, type) pairs
+ *
+ * The walk starts at the deepest directory before the first wildcard and
+ * matches each entry's path relative to it, descending no deeper than the
+ * pattern has components unless it contains "**".
+ */
+void expandGlob(const string& path, unsigned threads, vector<pair<string, unsigned char>>& found) {
+    size_t wildcard = GlobMatcher::findWildcard(path);
+    size_t slash = path.rfind('/', wildcard);
+    string root = slash == 0 ? "/" : GlobMatcher::unescape(path.substr(0, slash));
+    string relative = path.substr(slash + 1);
+
+    vector<string> components;
+    for (size_t start = 0; start <= relative.size();) {
+        size_t end = relative.find('/', start);
+        if (end == string::npos) {
+            end = relative.size();
+        }
+        components.push_back(relative.substr(start, end - start));
+        start = end + 1;
+    }
+    const bool deep = relative.find("**") != string::npos;
+    const size_t maxLevel = components.size() - 1;
+    const GlobMatcher glob(relative);
+
+    ParallelWalker walker(threads);
+    vector<vector<pair<string, unsigned char>>> matches(walker.threadCount());
+    const size_t skip = root.size() == 1 ? 1 : root.size() + 1;
+    walker.walk(root, [&](const WalkEntry& entry) {
+        string_view rel = entry.fullPath.substr(skip);
+        size_t level = static_cast<size_t>(count(rel.begin(), rel.end(), '/'));
+        // Wildcards don't match hidden names unless the pattern asks for a dot
+        const string& component = components[min(level, maxLevel)];
+        if (entry.name[0] == '.' && (component.empty() || component[0] != '.')) {
+            return false;
+        }
+        if (glob.matches(rel.data(), rel.size())) {
+            matches[entry.worker].emplace_back(entry.path(), entry.type);
+        }
+        return entry.type == DT_DIR && (deep || level < maxLevel);
+    });
+    for (auto& list : matches) {
+        for (auto& match : list) {
+            found.push_back(std::move(match));
+        }
+    }
+}
+
+} // namespace
+
+PathBatch PathBatch::expand(const vector<string>& patterns, const string& base, unsigned threads) {
+    vector<pair<string, unsigned char>> found;
+    for (const string& pattern : patterns) {
+        // A glob is built escaped, base included; anything else is the literal it stands for
+        const bool glob = GlobMatcher::hasWildcards(pattern);
+        PathBuffer absolute;
+        if (!pattern.empty() && pattern[0] == '/') {
+            absolute.assign("/");
+        } else {
+            absolute.assign(glob ? GlobMatcher::escape(base) : base);
+        }
+        absolute.append(glob ? pattern : GlobMatcher::unescape(pattern));
+        string path = absolute.str();
+        while (path.size() > 1 && path.back() == '/') {
+            path.pop_back();
+        }
+
+        if (!glob) {
+            struct stat st;
+            if (lstat(path.c_str(), &st) != 0) {
+                throw runtime_error("Cannot access " + path + ": " + strerror(errno));
+            }
+            if (path == "/") {
+                throw runtime_error("Refusing to operate on /");
+            }
+            found.emplace_back(std::move(path), typeOf(st.st_mode));
+            continue;
+        }
+        size_t before = found.size();
+        expandGlob(path, threads, found);
+        if (found.size() == before) {
+            throw runtime_error("No match: " + pattern);
+        }
+    }
+
+    // Shortest first, so a directory is kept before anything inside it is looked at
+    sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+        return a.first.size() != b.first.size() ? a.first.size() < b.first.size() : a.first < b.first;
+    });
+    set<string, less<>> keptDirectories;
+    map<string, PathGroup> byParent;
+    PathBatch batch;
+    string_view previous;
+    for (const auto& [path, type] : found) {
+        if (path == previous) {
+            continue;
+        }
+        previous = path;
+        bool covered = false;
+        for (size_t end = path.find('/', 1); end != string::npos && !covered; end = path.find('/', end + 1)) {
+            covered = keptDirectories.count(string_view(path).substr(0, end)) > 0;
+        }
+        if (covered) {
+            continue;
+        }
+        if (type == DT_DIR) {
+            keptDirectories.insert(path);
+            batch.directoryCount++;
+        }
+        size_t slash = path.find_last_of('/');
+        string parent = slash == 0 ? "/" : path.substr(0, slash);
+        PathGroup& group = byParent[parent];
+        group.directory = parent;
+        group.names.push_back(path.substr(slash + 1));
+        group.types.push_back(type);
+        batch.count++;
+    }
+    for (auto& entry : byParent) {
+        batch.entries.push_back(std::move(entry.second));
+    }
+    return batch;
+}
+
+string PathBatch::describe() const {
+    size_t files = count - directoryCount;
+    string text;
+    if (files > 0) {
+        text = to_string(files) + (files == 1 ? " file" : " files");
+    }
+    if (directoryCount > 0) {
+        text += (text.empty() ? "" : " and ") + to_string(directoryCount) +
+                (directoryCount == 1 ? " directory" : " directories");
+    }
+    return text;
+}
+
+size_t PathBatch::existingIn(const string& directory) const {
+    FdGuard dir{openDirectory(directory)};
+    size_t existing = 0;
+    for (const PathGroup& group : entries) {
+        for (const string& name : group.names) {
+            struct stat st;
+            FE_COUNT_SYSCALL(Stat, 1);
+            if (fstatat(dir.fd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW) == 0) {
+                ++existing;
+            }
+        }
+    }
+    return existing;
+}
+
+void PathBatch::requireDistinctNames(const string& verb) const {
+    // Two sources of one name would both go to directory/name: the second
+    // would replace (or, copied in parallel, interleave with) the first
+    unordered_map<string_view, const string*> seen;
+    seen.reserve(count);
+    for (const PathGroup& group : entries) {
+        for (const string& name : group.names) {
+            auto [it, inserted] = seen.emplace(name, &group.directory);
+            if (!inserted) {
+                throw runtime_error("Cannot " + verb + " " + joinPath(*it->second, name) + " and " +
+                                    joinPath(group.directory, name) + " to the same name");
+            }
+        }
+    }
+}
+
+BatchStats PathBatch::remove(unsigned threads, bool trashDirectories) const {
+    auto start = chrono::steady_clock::now();
+    BatchStats stats;
+    FailureLog failures;
+    atomic<uint64_t> removed{0};
+    JobControl* control = JobControl::current();
+
+    // Files first: each directory opened once, its entries unlinked in batches, directories in parallel
+    shared_ptr<IoBackend> backend = IoBackend::current();
+    ThreadPool pool(threads);
+    pool.parallelFor(entries.size(), [&](size_t g) {
+        const PathGroup& group = entries[g];
+        if (control && control->cancelled()) {
+            return;
+        }
+        int dirFd;
+        try {
+            dirFd = openDirectory(group.directory);
+        } catch (const exception& e) {
+            failures.add(e.what());
+            return;
+        }
+        FdGuard dir{dirFd};
+        vector<IoRequest> requests;
+        vector<size_t> index;
+        auto flush = [&] {
+            backend->submit(requests.data(), requests.size());
+            uint64_t done = 0;
+            for (size_t i = 0; i < requests.size(); ++i) {
+                if (requests[i].result < 0) {
+                    failures.add("Cannot remove " + joinPath(group.directory, group.names[index[i]]) + ": " +
+                                 strerror(static_cast<int>(-requests[i].result)));
+                } else {
+                    ++done;
+                }
+            }
+            removed.fetch_add(done, memory_order_relaxed);
+            if (control) {
+                control->addDone(0, done);
+            }
+            requests.clear();
+            index.clear();
+        };
+        for (size_t i = 0; i < group.names.size(); ++i) {
+            if (group.types[i] == DT_DIR) {
+                continue;
+            }
+            IoRequest request{IoOp::Unlinkat};
+            request.dirFd = dir.fd;
+            request.path = group.names[i].c_str();
+            requests.push_back(request);
+            index.push_back(i);
+            if (requests.size() == IO_BATCH_SIZE) {
+                flush();
+            }
+        }
+        if (!requests.empty()) {
+            flush();
+        }
+    });
+    if (control) {
+        control->checkpoint();
+    }
+    stats.done = removed.load();
+
+    // Then trees, one after another: TreeDeleter is parallel by itself
+    for (const PathGroup& group : entries) {
+        for (size_t i = 0; i < group.names.size(); ++i) {
+            if (group.types[i] != DT_DIR) {
+                continue;
+            }
+            string path = joinPath(group.directory, group.names[i]);
+            try {
+                if (trashDirectories) {
+                    stats.leftovers.push_back(TreeDeleter::moveToTrash(path));
+                    stats.done++;
+                    continue;
+                }
+                DeleteStats deleted = TreeDeleter(threads).remove(path);
+                if (deleted.errors > 0) {
+                    failures.add(deleted.firstError);
+                } else {
+                    stats.done++;
+                }
+            } catch (const JobCancelled&) {
+                throw;
+            } catch (const exception& e) {
+                failures.add(e.what());
+            }
+        }
+    }
+    failures.moveTo(stats);
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+BatchStats PathBatch::moveInto(const string& directory, const TreeCopyOptions& options, unsigned threads) const {
+    requireDistinctNames("move");
+    auto start = chrono::steady_clock::now();
+    BatchStats stats;
+    FailureLog failures;
+    JobControl* control = JobControl::current();
+    if (control) {
+        control->addTotal(0, count);
+    }
+    FdGuard target{openDirectory(directory)};
+    shared_ptr<IoBackend> backend = IoBackend::current();
+
+    // Renames that can't be done in place: name taken, or another file system
+    vector<string> slow;
+    for (const PathGroup& group : entries) {
+        if (control) {
+            control->checkpoint();
+        }
+        int dirFd;
+        try {
+            dirFd = openDirectory(group.directory);
+        } catch (const exception& e) {
+            failures.add(e.what());
+            continue;
+        }
+        FdGuard dir{dirFd};
+        for (size_t first = 0; first < group.names.size(); first += IO_BATCH_SIZE) {
+            size_t last = min(group.names.size(), first + IO_BATCH_SIZE);
+            vector<IoRequest> requests(last - first, IoRequest{IoOp::Renameat});
+            for (size_t i = first; i < last; ++i) {
+                IoRequest& request = requests[i - first];
+                request.dirFd = dir.fd;
+                request.path = group.names[i].c_str();
+                request.newDirFd = target.fd;
+                request.newPath = group.names[i].c_str();
+                request.flags = RENAME_NOREPLACE;
+            }
+            backend->submit(requests.data(), requests.size());
+            uint64_t done = 0;
+            for (size_t i = first; i < last; ++i) {
+                long result = requests[i - first].result;
+                if (result == 0) {
+                    ++done;
+                } else if (result == -EEXIST || result == -EXDEV || result == -EINVAL) {
+                    slow.push_back(joinPath(group.directory, group.names[i]));
+                } else {
+                    failures.add("Cannot move " + joinPath(group.directory, group.names[i]) + ": " +
+                                 strerror(static_cast<int>(-result)));
+                }
+            }
+            stats.done += done;
+            if (control) {
+                control->addDone(0, done);
+            }
+        }
+    }
+
+    // The rest go through FileMover, a few at a time
+    mutex leftoverMutex;
+    atomic<uint64_t> moved{0}, bytes{0};
+    ThreadPool pool(threads);
+    pool.parallelFor(slow.size(), [&](size_t i) {
+        JobControl::Scope job(control);
+        if (control && control->cancelled()) {
+            return;
+        }
+        string name = slow[i].substr(slow[i].find_last_of('/') + 1);
+        try {
+            MoveResult result = FileMover(options, threads).move(slow[i], joinPath(directory, name), true);
+            moved.fetch_add(1, memory_order_relaxed);
+            bytes.fetch_add(result.bytes, memory_order_relaxed);
+            if (control) {
+                control->addDone(0, 1);
+            }
+            if (!result.replaced.empty()) {
+                lock_guard<mutex> lock(leftoverMutex);
+                stats.leftovers.push_back(std::move(result.replaced));
+            }
+            if (result.sourceErrors > 0) {
+                failures.add(result.firstError);
+            }
+        } catch (const JobCancelled&) {
+            // Reported by the checkpoint below
+        } catch (const exception& e) {
+            failures.add(e.what());
+        }
+    });
+    if (control) {
+        control->checkpoint();
+    }
+    stats.done += moved.load();
+    stats.bytes = bytes.load();
+    failures.moveTo(stats);
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+BatchStats PathBatch::copyInto(const string& directory, const TreeCopyOptions& options) const {
+    requireDistinctNames("copy");
+    auto start = chrono::steady_clock::now();
+    BatchStats stats;
+    FailureLog failures;
+    JobControl* control = JobControl::current();
+    FdGuard target{openDirectory(directory)};
+
+    // Regular files of every group, copied descriptor to descriptor across the pool
+    struct FileTask {
+        int dirFd;
+        const PathGroup* group;
+        size_t index;
+    };
+    FdList groupDirs;
+    vector<FileTask> files;
+    for (const PathGroup& group : entries) {
+        int dirFd;
+        try {
+            dirFd = openDirectory(group.directory);
+        } catch (const exception& e) {
+            failures.add(e.what());
+            continue;
+        }
+        groupDirs.fds.push_back(dirFd);
+        for (size_t i = 0; i < group.names.size(); ++i) {
+            if (group.types[i] == DT_REG) {
+                files.push_back(FileTask{dirFd, &group, i});
+            }
+        }
+    }
+
+    atomic<uint64_t> copied{0}, bytes{0};
+    ThreadPool pool(options.copyThreads);
+    pool.parallelFor(files.size(), [&](size_t t) {
+        JobControl::Scope job(control);
+        if (control && control->cancelled()) {
+            return;
+        }
+        const FileTask& task = files[t];
+        const string& name = task.group->names[task.index];
+        string source = joinPath(task.group->directory, name);
+        FE_COUNT_SYSCALL(Open, 1);
+        FdGuard src{::openat(task.dirFd, name.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW)};
+        struct stat srcStat, dstStat;
+        if (src.fd < 0 || fstat(src.fd, &srcStat) != 0) {
+            failures.add("Cannot open source: " + source + ": " + strerror(errno));
+            return;
+        }
+        if (fstatat(target.fd, name.c_str(), &dstStat, 0) == 0 &&
+            dstStat.st_dev == srcStat.st_dev && dstStat.st_ino == srcStat.st_ino) {
+            failures.add("Source and destination are the same file: " + source);
+            return;
+        }
+        mode_t mode = srcStat.st_mode & 07777;
+        FE_COUNT_SYSCALL(Open, 1);
+        FdGuard dst{::openat(target.fd, name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode)};
+        if (dst.fd < 0) {
+            failures.add("Cannot open destination: " + joinPath(directory, name) + ": " + strerror(errno));
+            return;
+        }
+        fchmod(dst.fd, mode);
+
+        uint64_t size = static_cast<uint64_t>(srcStat.st_size);
+        bool sparse = static_cast<uint64_t>(srcStat.st_blocks) * 512 < size;
+        if (control) {
+            control->addTotal(size, 1);
+        }
+        try {
+            CopyResult result = FileCopier::copyFd(src.fd, dst.fd, size, sparse);
+            copied.fetch_add(1, memory_order_relaxed);
+            bytes.fetch_add(result.bytes, memory_order_relaxed);
+            if (control) {
+                control->addDone(0, 1);
+            }
+        } catch (const JobCancelled&) {
+            unlinkat(target.fd, name.c_str(), 0);  // Don't leave a truncated copy behind
+        } catch (const exception& e) {
+            failures.add(source + ": " + e.what());
+        }
+    });
+    if (control) {
+        control->checkpoint();
+    }
+    stats.done = copied.load();
+    stats.bytes = bytes.load();
+
+    // Trees and links one after another; TreeCopier is parallel by itself
+    for (const PathGroup& group : entries) {
+        for (size_t i = 0; i < group.names.size(); ++i) {
+            if (group.types[i] == DT_REG) {
+                continue;
+            }
+            string source = joinPath(group.directory, group.names[i]);
+            string destination = joinPath(directory, group.names[i]);
+            try {
+                if (group.types[i] == DT_DIR) {
+                    TreeCopyStats tree = TreeCopier(options).copy(source, destination);
+                    stats.bytes += tree.bytes;
+                    if (tree.errors > 0) {
+                        failures.add(tree.firstError);
+                        continue;
+                    }
+                } else {
+                    fs::copy(source, destination,
+                             fs::copy_options::overwrite_existing | fs::copy_options::copy_symlinks);
+                }
+                stats.done++;
+            } catch (const JobCancelled&) {
+                throw;
+            } catch (const exception& e) {
+                failures.add(e.what());
+            }
+        }
+    }
+    failures.moveTo(stats);
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+#ifndef PATH_BATCH_H
+#define PATH_BATCH_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "TreeCopier.h"
+
+/**
+ * @brief Entries of one directory named by a command
+ */
+struct PathGroup {
+    std::string directory;              ///< Absolute path of the parent directory
+    std::vector<std::string> names;     ///< Entries in it
+    std::vector<unsigned char> types;   ///< DT_* type of each entry
+};
+
+/**
+ * @brief Totals for an operation on a PathBatch
+ */
+struct BatchStats {
+    uint64_t done = 0;                  ///< Targets handled
+    uint64_t errors = 0;                ///< Targets that failed
+    uint64_t bytes = 0;                 ///< File bytes copied (copies and cross-device moves)
+    std::string firstError;             ///< Message of the first failure, if any
+    std::vector<std::string> leftovers; ///< Hidden paths (trashed or replaced trees) for the caller to delete
+    double seconds = 0.0;               ///< Wall time
+};
+
+/**
+ * @brief The targets of one cp, mv or rm, expanded once and grouped by parent directory
+ *
+ * Arguments are made absolute and their globs expanded a single time, by
+ * one ParallelWalker run per pattern from the deepest directory without
+ * wildcards, so "*.tmp" or a recursive "**" pattern needs no shell loop. As in the shell,
+ * wildcards skip hidden names unless the pattern component starts with a
+ * dot. Targets inside another target are dropped, since the outer one
+ * already covers them. What is left is grouped by parent, so
+ * each directory is opened once and its entries go to the IoBackend as
+ * one batch of unlinkat() or renameat2() calls relative to that
+ * descriptor; file copies of a group run across a thread pool.
+ *
+ * Run as a job, every target counts into its progress, and cancelling
+ * stops the batch between targets (a file cut off mid-copy is removed).
+ */
+class PathBatch {
+public:
+    /**
+     * @brief Expand arguments into targets
+     * @param patterns Paths and globs, relative to base unless absolute; a metacharacter
+     *                 escaped with a backslash is literal, and a word without wildcards
+     *                 is a plain path once its backslashes are dropped
+     * @param base Directory relative paths start from
+     * @param threads Walker threads for globs (0 = hardware concurrency)
+     * @throws std::runtime_error if a path doesn't exist or a glob matches nothing
+     */
+    static PathBatch expand(const std::vector<std::string>& patterns, const std::string& base,
+                            unsigned threads = 0);
+
+    const std::vector<PathGroup>& groups() const { return entries; }
+
+    /**
+     * @brief Number of targets
+     */
+    size_t size() const { return count; }
+
+    /**
+     * @brief Number of targets that are directories
+     */
+    size_t directories() const { return directoryCount; }
+
+    /**
+     * @brief Counts for a confirmation ("120 files and 2 directories")
+     */
+    std::string describe() const;
+
+    /**
+     * @brief Number of targets whose name already exists in a directory
+     */
+    size_t existingIn(const std::string& directory) const;
+
+    /**
+     * @brief Refuse targets that would land on the same name in one directory
+     * @param verb "move" or "copy", for the message
+     * @throws std::runtime_error naming the first two targets sharing a name
+     */
+    void requireDistinctNames(const std::string& verb) const;
+
+    /**
+     * @brief Delete every target: files by batched unlinkat, directories with TreeDeleter
+     * @param threads Walker threads for directory trees (0 = hardware concurrency)
+     * @param trashDirectories Rename directories to hidden siblings (into leftovers) instead of deleting them
+     * @throws JobCancelled if the job running the batch was cancelled
+     */
+    BatchStats remove(unsigned threads, bool trashDirectories) const;
+
+    /**
+     * @brief Move every target into a directory, replacing entries of the same name
+     *
+     * Each group goes out as one batch of renameat2(RENAME_NOREPLACE);
+     * targets that hit an existing name or another file system go through
+     * FileMover instead. Replaced entries end up in leftovers.
+     * @throws std::runtime_error if directory is not a directory, or two targets share a name
+     * @throws JobCancelled if the job running the batch was cancelled
+     */
+    BatchStats moveInto(const std::string& directory, const TreeCopyOptions& options, unsigned threads) const;
+
+    /**
+     * @brief Copy every target into a directory, replacing files of the same name
+     * @throws std::runtime_error if directory is not a directory, or two targets share a name
+     * @throws JobCancelled if the job running the batch was cancelled
+     */
+    BatchStats copyInto(const std::string& directory, const TreeCopyOptions& options) const;
+
+private:
+    std::vector<PathGroup> entries;
+    size_t count = 0;
+    size_t directoryCount = 0;
+};
+
+#endif // PATH_BATCH_H
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "ThreadPool.h"
+#include <atomic>
+#include <algorithm>
+
+using namespace std;
+
+ThreadPool::ThreadPool(unsigned threads) : stopping(false) {
+    if (threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(function<void()> task) {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    available.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    // A few chunks per thread balances uneven items without per-item overhead
+    const size_t chunks = min(count, static_cast<size_t>(size() + 1) * 4);
+    const size_t chunkSize = (count + chunks - 1) / chunks;
+
+    atomic<size_t> next{0};
+    size_t helpers = min(chunks, static_cast<size_t>(size()));
+    size_t remaining = helpers;
+    std::mutex doneMutex;
+    condition_variable done;
+
+    auto drain = [&] {
+        size_t begin;
+        while ((begin = next.fetch_add(chunkSize)) < count) {
+            size_t end = min(count, begin + chunkSize);
+            for (size_t i = begin; i < end; ++i) {
+                fn(i);
+            }
+        }
+    };
+
+    for (size_t i = 0; i < helpers; ++i) {
+        submit([&] {
+            drain();
+            lock_guard<std::mutex> lock(doneMutex);
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        });
+    }
+    drain();
+
+    unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [&] { return remaining == 0; });
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+/**
+ * @brief Fixed-size pool of worker threads
+ *
+ * Used where work arrives as independent items (batches of I/O requests,
+ * files to hash) rather than as a tree, which ParallelWalker handles.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Start the workers
+     * @param threads Number of threads (0 = hardware concurrency)
+     */
+    explicit ThreadPool(unsigned threads = 0);
+
+    /**
+     * @brief Finish queued tasks and join the workers
+     */
+    ~ThreadPool();
+
+    /**
+     * @brief Number of worker threads
+     */
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    /**
+     * @brief Queue a task for any worker
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Run fn(0) .. fn(count - 1) across the pool and wait for all of them
+     *
+     * Indices are handed out in contiguous chunks so tiny items don't pay
+     * one queue round-trip each. The calling thread takes part as well.
+     * fn must not throw.
+     */
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping;
+};
+
+#endif // THREAD_POOL_H
\ No newline at end of file
@@ -0,0 +1,257 @@
+#include "TreeCopier.h"
+#include "Metrics.h"
+#include "BoundedQueue.h"
+#include "FileCopier.h"
+#include "JobControl.h"
+#include "ParallelWalker.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+/**
+ * @brief A file or symlink waiting for a copy worker
+ */
+struct CopyItem {
+    string source;
+    string destination;
+    unsigned char type;
+};
+
+/**
+ * @brief Directory metadata applied once all contents are in place
+ */
+struct DirFixup {
+    string path;
+    struct stat st;
+    size_t depth;
+};
+
+struct FdGuard {
+    int fd;
+    ~FdGuard() { if (fd >= 0) ::close(fd); }
+};
+
+string stripTrailingSlashes(string path) {
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+    return path;
+}
+
+} // namespace
+
+TreeCopier::TreeCopier(const TreeCopyOptions& options) : options(options) {
+    if (this->options.copyThreads == 0) {
+        this->options.copyThreads = max(4u, 2 * thread::hardware_concurrency());
+    }
+}
+
+TreeCopyStats TreeCopier::copy(const string& sourceRoot, const string& destinationRoot) {
+    auto start = chrono::steady_clock::now();
+    const string source = stripTrailingSlashes(sourceRoot);
+    const string destination = stripTrailingSlashes(destinationRoot);
+
+    struct stat rootStat;
+    if (stat(source.c_str(), &rootStat) != 0 || !S_ISDIR(rootStat.st_mode)) {
+        throw runtime_error("Not a directory: " + source);
+    }
+    if (destination.compare(0, source.size() + 1, source + "/") == 0) {
+        throw runtime_error("Cannot copy a directory into itself: " + destination);
+    }
+    // Directories are created owner-writable and get their real mode in stage 3
+    FE_COUNT_SYSCALL(Mkdir, 1);
+    if (mkdir(destination.c_str(), 0700) != 0 && errno != EEXIST) {
+        throw runtime_error("Cannot create directory: " + destination + ": " + strerror(errno));
+    }
+
+    TreeCopyStats stats;
+    atomic<uint64_t> directories{0}, files{0}, symlinks{0}, bytes{0}, errors{0};
+    mutex errorMutex;
+    auto fail = [&](const string& message) {
+        errors.fetch_add(1, memory_order_relaxed);
+        lock_guard<mutex> lock(errorMutex);
+        if (stats.firstError.empty()) {
+            stats.firstError = message;
+        }
+    };
+
+    // Progress and cancellation of the job running the copy, if any
+    JobControl* control = JobControl::current();
+
+    // ---- Stage 2: copy workers ----
+    BoundedQueue<CopyItem> queue(options.queueDepth);
+    auto copyOne = [&](const CopyItem& item) {
+        if (item.type == DT_LNK) {
+            vector<char> target(PATH_MAX);
+            ssize_t len = readlink(item.source.c_str(), target.data(), target.size() - 1);
+            if (len < 0) {
+                throw runtime_error("Cannot read link: " + item.source + ": " + strerror(errno));
+            }
+            target[len] = '\0';
+            if (symlink(target.data(), item.destination.c_str()) != 0) {
+                if (errno != EEXIST || unlink(item.destination.c_str()) != 0 ||
+                    symlink(target.data(), item.destination.c_str()) != 0) {
+                    throw runtime_error("Cannot create link: " + item.destination + ": " + strerror(errno));
+                }
+            }
+            struct stat st;
+            if (lstat(item.source.c_str(), &st) == 0) {
+                if (options.preserveOwnership) {
+                    (void)lchown(item.destination.c_str(), st.st_uid, st.st_gid);
+                }
+                if (options.preserveTimes) {
+                    struct timespec times[2] = {st.st_atim, st.st_mtim};
+                    utimensat(AT_FDCWD, item.destination.c_str(), times, AT_SYMLINK_NOFOLLOW);
+                }
+            }
+            symlinks.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+
+        FdGuard src{::open(item.source.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW)};
+        FE_COUNT_SYSCALL(Open, 1);
+        struct stat st;
+        if (src.fd < 0 || fstat(src.fd, &st) != 0) {
+            throw runtime_error("Cannot open source: " + item.source + ": " + strerror(errno));
+        }
+        FdGuard dst{::open(item.destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)};
+        FE_COUNT_SYSCALL(Open, 1);
+        if (dst.fd < 0) {
+            throw runtime_error("Cannot open destination: " + item.destination + ": " + strerror(errno));
+        }
+        uint64_t size = static_cast<uint64_t>(st.st_size);
+        FileCopier::copyFd(src.fd, dst.fd, size, static_cast<uint64_t>(st.st_blocks) * 512 < size);
+
+        if (options.preserveOwnership) {
+            (void)fchown(dst.fd, st.st_uid, st.st_gid);  // EPERM for non-root is expected
+        }
+        fchmod(dst.fd, st.st_mode & 07777);  // after chown, which may clear setuid bits
+        if (options.preserveTimes) {
+            struct timespec times[2] = {st.st_atim, st.st_mtim};
+            futimens(dst.fd, times);
+        }
+        files.fetch_add(1, memory_order_relaxed);
+        bytes.fetch_add(size, memory_order_relaxed);
+    };
+
+    vector<thread> workers;
+    for (unsigned i = 0; i < options.copyThreads; ++i) {
+        workers.emplace_back([&] {
+            JobControl::Scope job(control);
+            CopyItem item;
+            while (queue.pop(item)) {
+                if (control && control->cancelled()) {
+                    continue;  // Drain, so the walk isn't stuck on a full queue
+                }
+                try {
+                    copyOne(item);
+                    if (control) {
+                        control->addDone(0, 1);
+                    }
+                } catch (const JobCancelled&) {
+                    ::unlink(item.destination.c_str());  // Cut off mid-file
+                } catch (const exception& e) {
+                    fail(e.what());
+                }
+            }
+        });
+    }
+
+    // ---- Stage 1: walk the source, creating directories as they are found ----
+    ParallelWalker walker(options.walkThreads);
+    vector<vector<DirFixup>> fixups(walker.threadCount());
+    try {
+        walker.walk(source, [&](const WalkEntry& entry) {
+            string dstPath = destination;
+            dstPath.append(entry.fullPath.substr(source.size()));
+
+            if (entry.type == DT_DIR) {
+                struct stat st;
+                if (fstatat(entry.dirFd, entry.name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                    fail("Cannot stat: " + entry.path() + ": " + strerror(errno));
+                    return false;
+                }
+                FE_COUNT_SYSCALL(Mkdir, 1);
+                if (mkdir(dstPath.c_str(), 0700) != 0 && errno != EEXIST) {
+                    fail("Cannot create directory: " + dstPath + ": " + strerror(errno));
+                    return false;
+                }
+                size_t depth = static_cast<size_t>(count(dstPath.begin(), dstPath.end(), '/'));
+                fixups[entry.worker].push_back({std::move(dstPath), st, depth});
+                directories.fetch_add(1, memory_order_relaxed);
+                return true;
+            }
+            if (entry.type == DT_REG || entry.type == DT_LNK) {
+                if (control) {
+                    // Sizes up front give the job a total to estimate against
+                    struct stat st;
+                    bool sized = entry.type == DT_REG &&
+                                 fstatat(entry.dirFd, entry.name, &st, AT_SYMLINK_NOFOLLOW) == 0;
+                    control->addTotal(sized ? static_cast<uint64_t>(st.st_size) : 0, 1);
+                }
+                queue.push({entry.path(), std::move(dstPath), entry.type});
+            } else {
+                fail("Skipped special file: " + entry.path());
+            }
+            return false;
+        });
+    } catch (const JobCancelled&) {
+        // Carry on to stage 3, so the directories made so far get their metadata
+    } catch (...) {
+        queue.close();
+        for (auto& worker : workers) worker.join();
+        throw;
+    }
+    queue.close();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // ---- Stage 3: directory metadata, deepest first ----
+    vector<DirFixup> allFixups;
+    for (auto& list : fixups) {
+        allFixups.insert(allFixups.end(), make_move_iterator(list.begin()), make_move_iterator(list.end()));
+    }
+    allFixups.push_back({destination, rootStat, static_cast<size_t>(count(destination.begin(), destination.end(), '/'))});
+    sort(allFixups.begin(), allFixups.end(),
+         [](const DirFixup& a, const DirFixup& b) { return a.depth > b.depth; });
+
+    for (const auto& fixup : allFixups) {
+        if (options.preserveOwnership) {
+            (void)lchown(fixup.path.c_str(), fixup.st.st_uid, fixup.st.st_gid);
+        }
+        if (chmod(fixup.path.c_str(), fixup.st.st_mode & 07777) != 0) {
+            fail("Cannot set mode: " + fixup.path + ": " + strerror(errno));
+        }
+        if (options.preserveTimes) {
+            struct timespec times[2] = {fixup.st.st_atim, fixup.st.st_mtim};
+            utimensat(AT_FDCWD, fixup.path.c_str(), times, 0);
+        }
+    }
+    if (control) {
+        control->checkpoint();  // Reported once the copied part is consistent
+    }
+
+    stats.directories = directories.load();
+    stats.files = files.load();
+    stats.symlinks = symlinks.load();
+    stats.bytes = bytes.load();
+    stats.errors = errors.load();
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef TREE_COPIER_H
+#define TREE_COPIER_H
+
+#include <string>
+#include <cstdint>
+
+/**
+ * @brief Tuning knobs for a recursive copy
+ */
+struct TreeCopyOptions {
+    unsigned walkThreads = 0;        ///< Threads walking the source (0 = hardware concurrency)
+    unsigned copyThreads = 0;        ///< File copy workers (0 = twice hardware concurrency, min 4)
+    size_t queueDepth = 1024;        ///< Maximum files waiting for a copy worker
+    bool preserveOwnership = true;   ///< chown copies to the source uid/gid (ignored if not permitted)
+    bool preserveTimes = true;       ///< Copy access and modification times
+};
+
+/**
+ * @brief Totals for a finished recursive copy
+ */
+struct TreeCopyStats {
+    uint64_t directories = 0;  ///< Directories created
+    uint64_t files = 0;        ///< Regular files copied
+    uint64_t symlinks = 0;     ///< Symbolic links recreated
+    uint64_t bytes = 0;        ///< File bytes copied
+    uint64_t errors = 0;       ///< Entries that could not be copied
+    std::string firstError;    ///< Message of the first failure, if any
+    double seconds = 0.0;      ///< Wall time
+};
+
+/**
+ * @brief Three-stage parallel recursive copy
+ *
+ * Stage 1 walks the source with ParallelWalker and creates each
+ * destination directory before descending into it. Regular files and
+ * symlinks are handed through a bounded queue (stage 2) to a pool of copy
+ * workers that use FileCopier and apply each file's metadata right away.
+ * Stage 3 runs once all data is written and fixes up directory modes,
+ * ownership and times deepest-first, so writing into a directory can no
+ * longer disturb its timestamps and read-only directories still receive
+ * their contents.
+ *
+ * Run as a job, every file is counted into the job's progress as it is
+ * found (entries and bytes to copy) and as it is copied. Cancelling stops
+ * the walk and the workers; files cut off mid-copy are removed.
+ */
+class TreeCopier {
+public:
+    /**
+     * @brief Construct a copier
+     * @param options Concurrency and preservation settings
+     */
+    explicit TreeCopier(const TreeCopyOptions& options = TreeCopyOptions());
+
+    /**
+     * @brief Copy a directory tree
+     * @param source Existing source directory
+     * @param destination Destination directory (created if missing, merged if present)
+     * @return Totals; per-entry failures are counted rather than thrown
+     * @throws std::runtime_error if the source or destination root is unusable
+     * @throws JobCancelled if the job running the copy was cancelled
+     */
+    TreeCopyStats copy(const std::string& source, const std::string& destination);
+
+private:
+    TreeCopyOptions options;
+};
+
+#endif // TREE_COPIER_H
\ No newline at end of file
@@ -0,0 +1,360 @@
+#include "TreeDeleter.h"
+#include "IoBackend.h"
+#include "ParallelWalker.h"
+#include "PathArena.h"
+#include "JobControl.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+/// Unlinks queued per worker before a batch is submitted mid-directory
+constexpr size_t UNLINK_BATCH_SIZE = 256;
+
+/// Interval between progress callbacks
+constexpr auto PROGRESS_INTERVAL = chrono::milliseconds(500);
+
+/**
+ * @brief Names waiting to be unlinked from the directory a worker is reading
+ */
+struct UnlinkBatch {
+    vector<string_view> names;  ///< NUL-terminated copies in the worker's PathArena
+    vector<IoRequest> requests;
+};
+
+/**
+ * @brief A directory being emptied of subdirectories in phase 2
+ */
+struct RemovalFrame {
+    uint32_t dir;     ///< Index into the directory list
+    int fd;           ///< O_PATH handle of the directory, for *at() calls on its children
+    size_t next = 0;  ///< Next child to descend into
+};
+
+/// Handles phase 2 opens: never through a symlink swapped in after phase 1
+constexpr int HANDLE_FLAGS = O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+
+string_view nameOf(const string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == string::npos ? string_view(path) : string_view(path).substr(slash + 1);
+}
+
+} // namespace
+
+double DeleteStats::entriesPerSecond() const {
+    return seconds > 0 ? (files + directories) / seconds : 0.0;
+}
+
+TreeDeleter::TreeDeleter(unsigned threads) : threads(threads) {}
+
+string TreeDeleter::moveToTrash(const string& path) {
+    string trimmed = path;
+    while (trimmed.size() > 1 && trimmed.back() == '/') {
+        trimmed.pop_back();
+    }
+    size_t slash = trimmed.find_last_of('/');
+    string parent = slash == string::npos ? "." : trimmed.substr(0, max<size_t>(slash, 1));
+    string name = slash == string::npos ? trimmed : trimmed.substr(slash + 1);
+
+    // A name left over from an earlier process with the same pid is skipped, never replaced
+    static atomic<unsigned> counter{0};
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        string trash = parent + "/.trash-" + name + "-" + to_string(getpid()) + "-" + to_string(counter++);
+        int result = renameat2(AT_FDCWD, trimmed.c_str(), AT_FDCWD, trash.c_str(), RENAME_NOREPLACE);
+        if (result != 0 && (errno == EINVAL || errno == ENOSYS)) {
+            // No RENAME_NOREPLACE here: check, then rename (racy, but only against ourselves)
+            struct stat st;
+            if (lstat(trash.c_str(), &st) == 0) {
+                errno = EEXIST;
+                continue;
+            }
+            result = rename(trimmed.c_str(), trash.c_str());
+        }
+        if (result == 0) {
+            return trash;
+        }
+        if (errno != EEXIST) {
+            break;
+        }
+    }
+    throw runtime_error("Cannot move to trash: " + trimmed + ": " + strerror(errno));
+}
+
+DeleteStats TreeDeleter::remove(const string& rootPath, const ProgressCallback& progress) {
+    auto start = chrono::steady_clock::now();
+    string path = rootPath;
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+    DeleteStats stats;
+    atomic<uint64_t> files{0}, directories{0}, errors{0};
+    mutex errorMutex;
+    auto fail = [&](const string& what, long err) {
+        errors.fetch_add(1, memory_order_relaxed);
+        lock_guard<mutex> lock(errorMutex);
+        if (stats.firstError.empty()) {
+            stats.firstError = what + ": " + strerror(static_cast<int>(-err));
+        }
+    };
+
+    // Progress reporter; stops as soon as the delete finishes
+    mutex progressMutex;
+    condition_variable progressDone;
+    bool finished = false;
+    thread reporter;
+    if (progress) {
+        reporter = thread([&] {
+            unique_lock<mutex> lock(progressMutex);
+            while (!progressDone.wait_for(lock, PROGRESS_INTERVAL, [&] { return finished; })) {
+                progress(files.load() + directories.load(),
+                         chrono::duration<double>(chrono::steady_clock::now() - start).count());
+            }
+        });
+    }
+    auto stopReporter = [&] {
+        if (reporter.joinable()) {
+            {
+                lock_guard<mutex> lock(progressMutex);
+                finished = true;
+            }
+            progressDone.notify_one();
+            reporter.join();
+        }
+    };
+
+    shared_ptr<IoBackend> backend = IoBackend::current();
+    JobControl* control = JobControl::current();
+    ParallelWalker walker(threads);
+    vector<UnlinkBatch> batches(walker.threadCount());
+    vector<vector<string>> pendingDirs(walker.threadCount());
+
+    auto flush = [&](int dirFd, const string& dirPath, UnlinkBatch& batch) {
+        if (batch.names.empty()) {
+            return;
+        }
+        batch.requests.assign(batch.names.size(), IoRequest{IoOp::Unlinkat});
+        for (size_t i = 0; i < batch.names.size(); ++i) {
+            batch.requests[i].dirFd = dirFd;
+            batch.requests[i].path = batch.names[i].data();
+        }
+        backend->submit(batch.requests.data(), batch.requests.size());
+        uint64_t removed = 0;
+        for (size_t i = 0; i < batch.requests.size(); ++i) {
+            if (batch.requests[i].result < 0) {
+                fail("Cannot remove " + dirPath + "/" + string(batch.names[i]), batch.requests[i].result);
+            } else {
+                ++removed;
+            }
+        }
+        files.fetch_add(removed, memory_order_relaxed);
+        if (control) {
+            control->addDone(0, removed);
+        }
+        batch.names.clear();
+    };
+
+    // ---- Phase 1: unlink everything that isn't a directory ----
+    try {
+        walker.walk(path, [&](const WalkEntry& entry) {
+            if (entry.type == DT_DIR) {
+                pendingDirs[entry.worker].push_back(entry.path());
+                return true;
+            }
+            UnlinkBatch& batch = batches[entry.worker];
+            batch.names.push_back(entry.arena.copy(entry.name));  // getdents buffer is reused; copy the name
+            if (batch.names.size() >= UNLINK_BATCH_SIZE) {
+                flush(entry.dirFd, entry.dirPath, batch);
+            }
+            return false;
+        }, ParallelWalker::ResultHandler(), [&](int dirFd, const string& dirPath, unsigned worker) {
+            flush(dirFd, dirPath, batches[worker]);
+        });
+    } catch (...) {
+        stopReporter();
+        throw;
+    }
+
+    // ---- Phase 2: remove directories bottom up, relative to handles on their parents ----
+    vector<string> dirs{path};
+    for (auto& list : pendingDirs) {
+        for (auto& dir : list) {
+            dirs.push_back(std::move(dir));
+        }
+    }
+    vector<vector<uint32_t>> children(dirs.size());
+    vector<uint32_t> parentOf(dirs.size(), 0);
+    {
+        unordered_map<string_view, uint32_t> ids;
+        ids.reserve(dirs.size());
+        for (uint32_t i = 0; i < dirs.size(); ++i) {
+            ids.emplace(dirs[i], i);
+        }
+        for (uint32_t i = 1; i < dirs.size(); ++i) {
+            auto parent = ids.find(string_view(dirs[i]).substr(0, dirs[i].find_last_of('/')));
+            if (parent != ids.end()) {
+                children[parent->second].push_back(i);
+                parentOf[i] = parent->second;
+            }
+        }
+    }
+
+    // Remove the given subdirectories of the directory open as dirFd, as batches
+    auto removeDirectories = [&](int dirFd, const vector<uint32_t>& list) {
+        vector<IoRequest> requests;
+        vector<string> names;
+        for (size_t first = 0; first < list.size(); first += UNLINK_BATCH_SIZE) {
+            size_t count = min(UNLINK_BATCH_SIZE, list.size() - first);
+            names.assign(count, string());
+            requests.assign(count, IoRequest{IoOp::Unlinkat});
+            for (size_t i = 0; i < count; ++i) {
+                names[i] = string(nameOf(dirs[list[first + i]]));
+                requests[i].dirFd = dirFd;
+                requests[i].path = names[i].c_str();
+                requests[i].flags = AT_REMOVEDIR;
+            }
+            backend->submit(requests.data(), requests.size());
+            for (size_t i = 0; i < count; ++i) {
+                if (requests[i].result < 0) {
+                    fail("Cannot remove directory " + dirs[list[first + i]], requests[i].result);
+                } else {
+                    directories.fetch_add(1, memory_order_relaxed);
+                    if (control) {
+                        control->addDone(0, 1);
+                    }
+                }
+            }
+        }
+    };
+
+    // Remove everything below dir (open as dirFd, which is closed), post-order,
+    // so a handle stays open only while its subtree is worked on
+    auto emptySubtree = [&](uint32_t dir, int dirFd) {
+        vector<RemovalFrame> stack{{dir, dirFd}};
+        while (!stack.empty()) {
+            RemovalFrame& frame = stack.back();
+            const vector<uint32_t>& list = children[frame.dir];
+            if (frame.next < list.size()) {
+                uint32_t child = list[frame.next++];
+                if (!children[child].empty()) {
+                    int childFd = openat(frame.fd, string(nameOf(dirs[child])).c_str(), HANDLE_FLAGS);
+                    if (childFd >= 0) {
+                        stack.push_back({child, childFd});
+                    }
+                    // Otherwise removing it fails below and is reported
+                }
+                continue;
+            }
+            removeDirectories(frame.fd, list);
+            ::close(frame.fd);
+            stack.pop_back();
+        }
+    };
+
+    // Split the tree for the workers: the directories with the largest
+    // subtrees are opened up (they form the "upper" tree, handled last),
+    // until there are a few independent subtrees per thread
+    vector<uint32_t> subtreeSize(dirs.size(), 1);
+    {
+        vector<uint32_t> order{0};  // Parents before children
+        for (size_t i = 0; i < order.size(); ++i) {
+            order.insert(order.end(), children[order[i]].begin(), children[order[i]].end());
+        }
+        for (size_t i = order.size(); i-- > 1;) {
+            subtreeSize[parentOf[order[i]]] += subtreeSize[order[i]];
+        }
+    }
+    const size_t wanted = static_cast<size_t>(walker.threadCount()) * 4;
+    auto larger = [&subtreeSize](uint32_t a, uint32_t b) { return subtreeSize[a] < subtreeSize[b]; };
+    vector<uint32_t> upper{0};  // Parents before children
+    vector<uint32_t> frontier;  // Heap of subtrees still worth splitting, largest on top
+    vector<uint32_t> tasks;
+    auto split = [&](uint32_t dir) {
+        for (uint32_t child : children[dir]) {
+            if (!children[child].empty()) {
+                frontier.push_back(child);
+                push_heap(frontier.begin(), frontier.end(), larger);
+            }
+        }
+    };
+    split(0);
+    while (!frontier.empty() && frontier.size() + tasks.size() < wanted) {
+        pop_heap(frontier.begin(), frontier.end(), larger);
+        uint32_t dir = frontier.back();
+        frontier.pop_back();
+        if (subtreeSize[dir] <= 2) {
+            tasks.push_back(dir);  // Not worth a split: just one level of leaves
+            continue;
+        }
+        upper.push_back(dir);
+        split(dir);
+    }
+    tasks.insert(tasks.end(), frontier.begin(), frontier.end());
+    sort(tasks.begin(), tasks.end(), [&](uint32_t a, uint32_t b) { return larger(b, a); });
+
+    // Handles on the upper tree, each opened from its parent's
+    size_t slash = path.find_last_of('/');
+    string parentPath = slash == string::npos ? "." : path.substr(0, max<size_t>(slash, 1));
+    int parentFd = ::open(parentPath.c_str(), HANDLE_FLAGS);
+    vector<int> handles(dirs.size(), -1);
+    handles[0] = parentFd < 0 ? -1 : openat(parentFd, string(nameOf(path)).c_str(), HANDLE_FLAGS);
+    const bool rootOpen = handles[0] >= 0;
+    if (!rootOpen) {
+        fail("Cannot open directory " + path, -errno);
+    }
+    for (size_t i = 1; i < upper.size(); ++i) {
+        int parent = handles[parentOf[upper[i]]];
+        if (parent >= 0) {
+            handles[upper[i]] = openat(parent, string(nameOf(dirs[upper[i]])).c_str(), HANDLE_FLAGS);
+        }
+    }
+
+    // Independent subtrees in parallel, then the upper tree bottom up
+    {
+        ThreadPool pool(walker.threadCount());
+        pool.parallelFor(tasks.size(), [&](size_t t) {
+            uint32_t dir = tasks[t];
+            int parent = handles[parentOf[dir]];
+            int fd = parent < 0 ? -1 : openat(parent, string(nameOf(dirs[dir])).c_str(), HANDLE_FLAGS);
+            if (fd >= 0) {
+                emptySubtree(dir, fd);
+            }
+            // Otherwise removing it fails below and is reported
+        });
+    }
+    for (size_t i = upper.size(); i-- > 0;) {
+        int fd = handles[upper[i]];
+        if (fd >= 0) {
+            removeDirectories(fd, children[upper[i]]);
+            ::close(fd);
+        }
+    }
+    if (rootOpen) {
+        removeDirectories(parentFd, {0});
+    }
+    if (parentFd >= 0) {
+        ::close(parentFd);
+    }
+
+    stopReporter();
+    stats.files = files.load();
+    stats.directories = directories.load();
+    stats.errors = errors.load();
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
\ No newline at end of file
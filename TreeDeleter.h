@@ -0,0 +1,80 @@
+#ifndef TREE_DELETER_H
+#define TREE_DELETER_H
+
+#include <string>
+#include <cstdint>
+#include <functional>
+
+/**
+ * @brief Totals for a finished recursive delete
+ */
+struct DeleteStats {
+    uint64_t files = 0;        ///< Non-directory entries unlinked
+    uint64_t directories = 0;  ///< Directories removed (including the root)
+    uint64_t errors = 0;       ///< Entries that could not be removed
+    std::string firstError;    ///< Message of the first failure, if any
+    double seconds = 0.0;      ///< Wall time
+
+    /**
+     * @brief Removal rate over the whole operation
+     */
+    double entriesPerSecond() const;
+};
+
+/**
+ * @brief Parallel recursive delete working on directory descriptors
+ *
+ * Phase 1 walks the tree with ParallelWalker and unlinks every
+ * non-directory with unlinkat() relative to its parent's descriptor; the
+ * unlinks of a directory are submitted as batches through the current
+ * IoBackend. Phase 2 removes the emptied directories bottom up: the
+ * subdirectories of each directory go as one batch of
+ * unlinkat(AT_REMOVEDIR) relative to an O_PATH handle on it, opened from
+ * its parent's handle with O_NOFOLLOW. The tree is first cut into a few
+ * independent subtrees per thread, by opening up the largest ones; those
+ * are emptied in parallel, each post-order, and the few directories above
+ * them are removed last. No path is resolved again after phase 1, so a
+ * directory swapped for a symlink can't redirect the removal, and only
+ * the handles on the branches being worked on are open at once.
+ * Run as a job, removed
+ * entries count into its progress, and cancelling stops the walk before
+ * phase 2, leaving whatever was not yet removed.
+ */
+class TreeDeleter {
+public:
+    /**
+     * @brief Receives (entries removed so far, seconds elapsed) a few times per second
+     */
+    using ProgressCallback = std::function<void(uint64_t entries, double seconds)>;
+
+    /**
+     * @brief Construct a deleter
+     * @param threads Walker threads (0 = hardware concurrency)
+     */
+    explicit TreeDeleter(unsigned threads = 0);
+
+    /**
+     * @brief Delete a directory and everything below it
+     * @param path Directory to remove
+     * @param progress Optional progress reporter, called from a helper thread
+     * @return Totals; per-entry failures are counted rather than thrown
+     * @throws std::runtime_error if path cannot be opened
+     * @throws JobCancelled if the job running the delete was cancelled
+     */
+    DeleteStats remove(const std::string& path, const ProgressCallback& progress = ProgressCallback());
+
+    /**
+     * @brief Rename a path to a hidden sibling so it can be deleted later
+     *
+     * The rename stays on the same file system, so it is instant regardless
+     * of how large the tree is.
+     * @return Path of the renamed entry
+     * @throws std::runtime_error if the rename fails
+     */
+    static std::string moveToTrash(const std::string& path);
+
+private:
+    unsigned threads;
+};
+
+#endif // TREE_DELETER_H
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <sstream>
 #include <chrono>
 #include <ctime>
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
 
 using namespace std;
 
@@ -20,13 +23,332 @@ void UIManager::displayCurrentDirectory(const string& path) const {
     cout << string(80, '=') << "\n";
 }
 
-void UIManager::displayFileInfo(const FileInfo& file) const {
-    cout << left << setw(15) << (file.isDirectory ? "[DIR]" : "[FILE]")
-         << setw(20) << file.name
-         << setw(15) << formatSize(file.size)
-         << setw(15) << file.permissions
-         << setw(25) << formatTime(file.modifiedTime)
-         << file.owner << "@" << file.group << "\n";
+namespace {
+
+/// Column widths of a listing row: type, name, size, permissions, modified
+constexpr size_t COLUMN_TYPE = 15;
+constexpr size_t COLUMN_NAME = 20;
+constexpr size_t COLUMN_SIZE = 15;
+constexpr size_t COLUMN_PERMS = 15;
+constexpr size_t COLUMN_TIME = 25;
+
+/// Buffered file lines are written out once they pass this size
+constexpr size_t LINE_BUFFER_LIMIT = 64 * 1024;
+
+/**
+ * @brief Append text left-aligned in a column (like setw with left)
+ */
+void appendPadded(string& out, const char* text, size_t length, size_t width) {
+    out.append(text, length);
+    if (length < width) {
+        out.append(width - length, ' ');
+    }
+}
+
+/**
+ * @brief write() all of a buffer to stdout, retrying short writes
+ */
+void writeOut(const char* data, size_t remaining) {
+    while (remaining > 0) {
+        ssize_t written = ::write(STDOUT_FILENO, data, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;  // stdout is gone; nothing useful left to do with the output
+        }
+        data += written;
+        remaining -= static_cast<size_t>(written);
+    }
+}
+
+} // namespace
+
+void UIManager::displayFileInfo(const FileInfoBatch& files, size_t index) const {
+    appendFileRow(files, index);
+    flushOutput();
+}
+
+void UIManager::displayListingHeader() const {
+    outputBuffer.clear();
+    appendPadded(outputBuffer, "Type", 4, COLUMN_TYPE);
+    appendPadded(outputBuffer, "Name", 4, COLUMN_NAME);
+    appendPadded(outputBuffer, "Size", 4, COLUMN_SIZE);
+    appendPadded(outputBuffer, "Permissions", 11, COLUMN_PERMS);
+    appendPadded(outputBuffer, "Modified", 8, COLUMN_TIME);
+    outputBuffer += "Owner@Group\n";
+    outputBuffer.append(80, '-');
+    outputBuffer += '\n';
+    flushOutput();
+}
+
+void UIManager::displayFileBatch(const FileInfoBatch& files) const {
+    FE_TIME_PHASE(Rendering);
+    for (size_t i = 0; i < files.size(); ++i) {
+        appendFileRow(files, i);
+    }
+    flushOutput();
+}
+
+void UIManager::appendFileRow(const FileInfoBatch& files, size_t index) const {
+    char field[64];
+    bool isDirectory = files.isDirectory(index);
+    string_view name = files.name(index);
+    appendPadded(outputBuffer, isDirectory ? "[DIR]" : "[FILE]", isDirectory ? 5 : 6, COLUMN_TYPE);
+    appendPadded(outputBuffer, name.data(), name.size(), COLUMN_NAME);
+
+    uintmax_t size = files.fileSize(index);
+    int length;
+    if (size < 1024) {
+        length = snprintf(field, sizeof(field), "%ju B", size);
+    } else if (size < 1024 * 1024) {
+        length = snprintf(field, sizeof(field), "%.1f KB", size / 1024.0);
+    } else if (size < 1024 * 1024 * 1024) {
+        length = snprintf(field, sizeof(field), "%.1f MB", size / (1024.0 * 1024.0));
+    } else {
+        length = snprintf(field, sizeof(field), "%.1f GB", size / (1024.0 * 1024.0 * 1024.0));
+    }
+    appendPadded(outputBuffer, field, static_cast<size_t>(length), COLUMN_SIZE);
+    FileInfoBatch::formatPermissions(files.mode(index), field);
+    appendPadded(outputBuffer, field, 10, COLUMN_PERMS);
+
+    struct tm local;
+    time_t modified = files.modifiedTime(index);
+    localtime_r(&modified, &local);
+    appendPadded(outputBuffer, field, strftime(field, sizeof(field), "%Y-%m-%d %H:%M:%S", &local), COLUMN_TIME);
+
+    outputBuffer += files.owner(index).str();
+    outputBuffer += '@';
+    outputBuffer += files.group(index).str();
+    outputBuffer += '\n';
+}
+
+void UIManager::flushOutput() const {
+    cout.flush();  // Keep anything already sent through cout ahead of these rows
+    writeOut(outputBuffer.data(), outputBuffer.size());
+    outputBuffer.clear();
+}
+
+void UIManager::displayText(string_view text) const {
+    flushOutput();
+    writeOut(text.data(), text.size());
+}
+
+void UIManager::displayLine(uint64_t number, string_view line) const {
+    char field[32];
+    int length = snprintf(field, sizeof(field), "%7ju  ", static_cast<uintmax_t>(number));
+    outputBuffer.append(field, static_cast<size_t>(length));
+    outputBuffer.append(line.data(), line.size());
+    outputBuffer += '\n';
+    if (outputBuffer.size() >= LINE_BUFFER_LIMIT) {
+        flushOutput();
+    }
+}
+
+void UIManager::displayIndexStats(const IndexStats& stats) const {
+    cout << "Index of " << stats.root << "\n";
+    cout << "  File:        " << stats.file << " (" << formatSize(stats.fileBytes) << ")\n";
+    cout << "  Built:       " << formatTime(stats.builtAt) << " in " << fixed << setprecision(2)
+         << stats.buildSeconds << " s\n";
+    cout << "  Directories: " << stats.directories << " (" << stats.directoriesRead << " read, "
+         << stats.directoriesReused << " unchanged)\n";
+    cout << "  Entries:     " << stats.entries << "\n";
+    cout << "  Trigrams:    " << stats.trigrams << " (" << stats.postings << " postings)\n";
+}
+
+void UIManager::displayDiskUsage(const DiskUsageReport& report) const {
+    const DiskUsageEntry& total = report.total;
+    cout << "Disk usage of " << total.path << "\n";
+    cout << "  Allocated:   " << formatSize(total.allocatedBytes) << " (" << total.allocatedBytes << " bytes)\n";
+    cout << "  Apparent:    " << formatSize(total.apparentBytes) << " (" << total.apparentBytes << " bytes)\n";
+    cout << "  Files:       " << total.files << " in " << total.directories << " directories\n";
+    if (report.hardLinksSkipped > 0 || report.mountPointsSkipped > 0 || report.errors > 0) {
+        cout << "  Skipped:     " << report.hardLinksSkipped << " extra hard links, "
+             << report.mountPointsSkipped << " mount points, " << report.errors << " unreadable\n";
+    }
+    if (report.unreadableDirectories > 0) {
+        cout << "  Incomplete:  " << report.unreadableDirectories << " directories could not be read (first: "
+             << report.firstError << ")\n";
+    }
+    cout << "  Scanned in " << fixed << setprecision(2) << report.seconds << " s\n";
+
+    if (!report.largest.empty()) {
+        cout << "\nLargest subtrees:\n";
+        for (const auto& entry : report.largest) {
+            cout << "  " << left << setw(12) << formatSize(entry.allocatedBytes) << entry.path << "\n";
+        }
+    }
+}
+
+void UIManager::displayDuplicates(const DuplicateReport& report) const {
+    uint64_t wasted = 0;
+    for (const auto& group : report.groups) {
+        cout << formatSize(group.size) << " x " << group.paths.size() << "\n";
+        for (const auto& path : group.paths) {
+            cout << "  " << path << "\n";
+        }
+        wasted += group.wastedBytes();
+    }
+    if (!report.groups.empty()) {
+        cout << "\n";
+    }
+
+    const DuplicateStats& stats = report.stats;
+    cout << report.groups.size() << " groups of duplicates, " << formatSize(wasted) << " reclaimable\n";
+    cout << "  Files scanned:   " << stats.filesScanned;
+    if (stats.hardLinksSkipped > 0) {
+        cout << " (" << stats.hardLinksSkipped << " extra hard links skipped)";
+    }
+    cout << "\n";
+    cout << "  Same size:       " << stats.sameSize << "\n";
+    cout << "  Same first/last: " << stats.sameEdges << "\n";
+    cout << "  Same hash:       " << stats.sameHash << "\n";
+    if (stats.verified > 0) {
+        cout << "  Byte-compared:   " << stats.verified << "\n";
+    }
+    if (stats.unreadable > 0) {
+        cout << "  Unreadable:      " << stats.unreadable << "\n";
+    }
+    if (stats.unreadableDirectories > 0) {
+        cout << "  Incomplete:      " << stats.unreadableDirectories << " directories could not be read (first: "
+             << stats.firstError << ")\n";
+    }
+    cout << "  Read " << formatSize(stats.bytesRead) << " in " << fixed << setprecision(2)
+         << stats.seconds << " s\n";
+}
+
+void UIManager::displayCacheStats(const DirectoryCacheStats& stats) const {
+    uint64_t lookups = stats.hits + stats.misses;
+    cout << "Directory cache\n";
+    cout << "  Directories:   " << stats.directories << " (" << stats.entries << " entries)\n";
+    cout << "  Memory:        " << formatSize(stats.bytes) << " of " << formatSize(stats.limitBytes) << "\n";
+    cout << "  Hits/misses:   " << stats.hits << " / " << stats.misses;
+    if (lookups > 0) {
+        cout << " (" << fixed << setprecision(1) << 100.0 * stats.hits / lookups << "% hits)";
+    }
+    cout << "\n";
+    cout << "  Patched:       " << stats.patches << " entries\n";
+    cout << "  Invalidated:   " << stats.invalidations << "\n";
+    cout << "  Evicted:       " << stats.evictions << "\n";
+}
+
+void UIManager::displayMetrics(const MetricsSnapshot& metrics) const {
+    if (!Metrics::ENABLED) {
+        cout << "Metrics were compiled out (built with METRICS=0)\n";
+        return;
+    }
+    auto millis = [](uint64_t nanos) {
+        ostringstream text;
+        text << fixed << setprecision(3) << nanos / 1e6 << " ms";
+        return text.str();
+    };
+
+    cout << "System calls\n";
+    bool any = false;
+    for (size_t i = 0; i < static_cast<size_t>(Syscall::COUNT); ++i) {
+        if (metrics.syscalls[i] > 0) {
+            cout << "  " << left << setw(17) << Metrics::syscallName(static_cast<Syscall>(i))
+                 << right << metrics.syscalls[i] << "\n";
+            any = true;
+        }
+    }
+    if (!any) {
+        cout << "  (none)\n";
+    }
+    cout << "  Bytes read:      " << formatSize(metrics.bytesRead) << " (" << metrics.bytesRead << " bytes)\n";
+    cout << "  Bytes written:   " << formatSize(metrics.bytesWritten) << " (" << metrics.bytesWritten << " bytes)\n";
+
+    cout << "Phases\n";
+    for (size_t i = 0; i < static_cast<size_t>(Phase::COUNT); ++i) {
+        const LatencyHistogram& phase = metrics.phases[i];
+        cout << "  " << left << setw(17) << Metrics::phaseName(static_cast<Phase>(i)) << right;
+        if (phase.samples == 0) {
+            cout << "-\n";
+            continue;
+        }
+        cout << phase.samples << " x, " << millis(phase.totalNanos)
+             << " total, p50 " << millis(phase.percentile(0.5))
+             << ", p99 " << millis(phase.percentile(0.99)) << "\n";
+    }
+
+    cout << "Commands\n";
+    if (metrics.commands.empty()) {
+        cout << "  (none)\n";
+    }
+    for (const auto& [name, latency] : metrics.commands) {
+        cout << "  " << left << setw(17) << name << right << latency.samples << " x, p50 "
+             << millis(latency.percentile(0.5)) << ", p99 " << millis(latency.percentile(0.99))
+             << ", mean " << millis(latency.totalNanos / latency.samples) << "\n";
+    }
+}
+
+namespace {
+
+/**
+ * @brief Format seconds as "42s", "3m05s" or "1h02m"
+ */
+string formatDuration(double seconds) {
+    uint64_t whole = static_cast<uint64_t>(seconds + 0.5);
+    ostringstream text;
+    if (whole < 60) {
+        text << whole << "s";
+    } else if (whole < 3600) {
+        text << whole / 60 << "m" << setw(2) << setfill('0') << whole % 60 << "s";
+    } else {
+        text << whole / 3600 << "h" << setw(2) << setfill('0') << whole / 60 % 60 << "m";
+    }
+    return text.str();
+}
+
+} // namespace
+
+void UIManager::displayJobs(const vector<JobInfo>& jobs) const {
+    if (jobs.empty()) {
+        cout << "No jobs\n";
+        return;
+    }
+    for (const JobInfo& job : jobs) {
+        cout << "[" << job.id << "] " << left << setw(10) << JobScheduler::stateName(job.state) << right
+             << (job.priority == JobPriority::Bulk ? "bulk  " : "      ") << job.command << "\n";
+        if (job.state != JobState::Queued) {
+            cout << "    " << formatJobProgress(job) << "\n";
+        }
+    }
+}
+
+void UIManager::displayJobProgress(const JobInfo& job) const {
+    cout << "\r\033[K[" << job.id << "] " << formatJobProgress(job) << flush;
+}
+
+void UIManager::clearProgressLine() const {
+    cout << "\r\033[K" << flush;
+}
+
+string UIManager::formatJobProgress(const JobInfo& job) const {
+    const JobProgress& progress = job.progress;
+    ostringstream text;
+    if (progress.bytesTotal > 0) {
+        text << fixed << setprecision(1) << 100.0 * progress.bytesDone / progress.bytesTotal << "%  "
+             << formatSize(progress.bytesDone) << " of " << formatSize(progress.bytesTotal) << "  "
+             << formatSize(static_cast<uintmax_t>(job.rate())) << "/s";
+        if (progress.entriesTotal > 1) {
+            text << "  " << progress.entriesDone << " of " << progress.entriesTotal << " files";
+        }
+    } else if (progress.entriesTotal > 0) {
+        text << progress.entriesDone << " of " << progress.entriesTotal << " entries  "
+             << fixed << setprecision(0) << job.rate() << " entries/s";
+    } else if (progress.entriesDone > 0) {
+        text << progress.entriesDone << " entries  " << fixed << setprecision(0) << job.rate() << " entries/s";
+    } else {
+        text << progress.scanned << " entries scanned";
+    }
+    double eta = job.eta();
+    if (job.state == JobState::Running && eta >= 0) {
+        text << "  ETA " << formatDuration(eta);
+    } else {
+        text << "  " << formatDuration(job.seconds);
+    }
+    return text.str();
 }
 
 void UIManager::displayError(const string& message) const {
@@ -49,6 +371,9 @@ string UIManager::getUserInput(const string& prompt) const {
 }
 
 bool UIManager::confirmAction(const string& message) const {
+    if (!interactive) {
+        return true;
+    }
     cout << message << " (y/n): ";
     char response;
     cin >> response;
@@ -86,26 +411,63 @@ string UIManager::formatTime(time_t time) const {
 }
 
 void UIManager::displayHelp() const {
-    clearScreen();
+    if (interactive) {
+        clearScreen();
+    }
     cout << "\033[1;36m=== File Explorer Help ===\033[0m\n";
     cout << "\n\033[1mNavigation:\033[0m\n";
-    cout << "  ls [path]     - List directory contents\n";
+    cout << "  ls [opts] [path] - List directory contents (path may end in a glob)\n";
+    cout << "                   -S size, -t time, -X extension, -v natural, -r reverse,\n";
+    cout << "                   --sort=name|version|size|time|extension|none\n";
     cout << "  cd <path>     - Change directory\n";
     cout << "  pwd           - Show current directory\n\n";
     
     cout << "\033[1mFile Operations:\033[0m\n";
-    cout << "  cp <src> <dst> - Copy file\n";
-    cout << "  mv <src> <dst> - Move/rename file\n";
-    cout << "  rm <path>     - Remove file or directory\n\n";
+    cout << "  cp [-r] <src>... <dst> - Copy files or directory trees\n";
+    cout << "  mv <src>... <dst> - Move/rename; across file systems copies, verifies, then deletes\n";
+    cout << "  rm [-b] <path>... - Remove files or directories (-b: delete trees in background)\n";
+    cout << "                   Sources may be globs (*.tmp, src/**); several sources need a\n";
+    cout << "                   directory as <dst>, and rm asks once for all of them\n";
+    cout << "  write [-a] [--sync] [--backup] <file> [text] - Replace (or -a append to) a file atomically\n\n";
     
     cout << "\033[1mDirectory Operations:\033[0m\n";
-    cout << "  mkdir <name>  - Create new directory\n\n";
+    cout << "  mkdir [-p] <name> - Create new directory (-p: with parents, existing is fine)\n\n";
+    
+    cout << "\033[1mViewing Files:\033[0m\n";
+    cout << "  view <file> [line] [count] - Show count lines (default 40) from a line number\n";
+    cout << "  cat <file>    - Print a file\n";
+    cout << "  head [-n N] <file> - Print the first N lines (default 10)\n";
+    cout << "  tail [-n N] [-f] <file> - Print the last N lines; -f follows (Enter stops)\n\n";
     
     cout << "\033[1mSearch and Info:\033[0m\n";
-    cout << "  find <name>   - Search for files\n";
+    cout << "  find <name>   - Search for files (name or glob: *, ?, [a-z], {a,b}, **)\n";
+    cout << "  grep <text> [glob] - Search file contents (file:line:offset)\n";
+    cout << "  index build [path] - Build the filename index used by find\n";
+    cout << "  index refresh - Update the index (re-reads changed directories only)\n";
+    cout << "  index stats   - Show the index covering the current directory\n";
+    cout << "  du [-n N] [path] - Disk usage of a tree and its N largest subtrees\n";
+    cout << "  dupes [--verify] [path] - Find files with identical contents\n";
+    cout << "  cache [clear] - Show (or drop) the directory listing cache\n";
+    cout << "  io [backend]  - Batched I/O backend: auto, uring, threads, sync\n";
+    cout << "  stats [reset] - System calls, bytes and latencies since start (or reset)\n";
+    cout << "  stats trace <file>|off - Record a Chrome trace (chrome://tracing, Perfetto)\n";
     cout << "  help          - Show this help\n";
     cout << "  exit          - Exit the program\n\n";
+
+    cout << "\033[1mBackground Jobs:\033[0m\n";
+    cout << "  <cmd> &       - Run cp, mv, rm, find or grep in the background (never prompts)\n";
+    cout << "  jobs          - List jobs with progress, rate and time left\n";
+    cout << "  fg [job]      - Wait for a job (default: the latest); Enter leaves it running\n";
+    cout << "  cancel <job>  - Stop a job; a half-copied file is removed\n\n";
+
+    cout << "\033[1mQuoting and Scripts:\033[0m\n";
+    cout << "  'a b', \"a b\" and a\\ b are one word; # starts a comment\n";
+    cout << "  linux-file-explorer [-e] [-j N] script  - Run commands from a file ('-' or a pipe: stdin)\n";
+    cout << "                   without prompts; independent cp/mv/mkdir/rm/write run N at once\n";
+    cout << "                   (default 8), -e stops at the first error; --trace FILE traces the run\n\n";
     
-    cout << "Press Enter to continue...";
-    cin.ignore();
+    if (interactive) {
+        cout << "Press Enter to continue...";
+        cin.ignore();
+    }
 }
\ No newline at end of file
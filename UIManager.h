@@ -2,21 +2,13 @@
 #define UI_MANAGER_H
 
 #include <string>
+#include <string_view>
+#include <vector>
 #include <cstdint>
 #include <ctime>
-
-/**
- * @brief Structure to hold file information for display
- */
-struct FileInfo {
-    std::string name;           ///< Name of the file/directory
-    uintmax_t size;             ///< Size in bytes
-    std::string permissions;    ///< File permissions (e.g., "rwxr-xr--")
-    std::string owner;          ///< File owner username
-    std::string group;          ///< File group name
-    time_t modifiedTime;        ///< Last modification time
-    bool isDirectory;           ///< True if this is a directory
-};
+#include "FileOperations.h"
+#include "JobScheduler.h"
+#include "Metrics.h"
 
 /**
  * @brief Handles all user interface components for the file explorer
@@ -39,9 +31,92 @@ public:
 
     /**
      * @brief Display information about a file or directory
-     * @param file FileInfo structure containing file details
+     * @param files Batch holding the entry
+     * @param index Row of the entry within the batch
+     */
+    void displayFileInfo(const FileInfoBatch& files, size_t index = 0) const;
+
+    /**
+     * @brief Display the column header of a directory listing
      */
-    void displayFileInfo(const FileInfo& file) const;
+    void displayListingHeader() const;
+
+    /**
+     * @brief Display a batch of directory entries
+     *
+     * Rows are formatted into a reusable buffer and written to stdout with
+     * a single write(), so a listing of any size costs one syscall per batch.
+     * @param files Entries to display
+     */
+    void displayFileBatch(const FileInfoBatch& files) const;
+
+    /**
+     * @brief Display the statistics of a filename index
+     * @param stats Index description
+     */
+    void displayIndexStats(const IndexStats& stats) const;
+
+    /**
+     * @brief Display the counters of the directory listing cache
+     * @param stats Cache counters
+     */
+    void displayCacheStats(const DirectoryCacheStats& stats) const;
+
+    /**
+     * @brief Display syscall counts, bytes moved and phase and command latencies
+     * @param metrics Totals since the start or the last reset
+     */
+    void displayMetrics(const MetricsSnapshot& metrics) const;
+
+    /**
+     * @brief Display background jobs with their progress, rate and time left
+     * @param jobs Jobs not yet reported
+     */
+    void displayJobs(const std::vector<JobInfo>& jobs) const;
+
+    /**
+     * @brief Redraw the one-line progress of a job in place
+     * @param job Job being waited on
+     */
+    void displayJobProgress(const JobInfo& job) const;
+
+    /**
+     * @brief Erase a progress line drawn by displayJobProgress()
+     */
+    void clearProgressLine() const;
+
+    /**
+     * @brief Display the totals and largest subtrees of a disk usage scan
+     * @param report Scan result
+     */
+    void displayDiskUsage(const DiskUsageReport& report) const;
+
+    /**
+     * @brief Display groups of duplicate files and how many files each stage kept
+     * @param report Search result
+     */
+    void displayDuplicates(const DuplicateReport& report) const;
+
+    /**
+     * @brief Write file contents to stdout as they are, without copying them
+     * @param text Bytes to write
+     */
+    void displayText(std::string_view text) const;
+
+    /**
+     * @brief Display one numbered line of a file
+     *
+     * Lines are collected in the output buffer; call flushOutput() after
+     * the last one.
+     * @param number 1-based line number
+     * @param line Line text without its newline
+     */
+    void displayLine(uint64_t number, std::string_view line) const;
+
+    /**
+     * @brief Write the output buffer to stdout and empty it
+     */
+    void flushOutput() const;
 
     /**
      * @brief Display an error message
@@ -71,7 +146,7 @@ public:
     /**
      * @brief Ask for confirmation before performing a potentially destructive action
      * @param message Confirmation message to display
-     * @return true if user confirms, false otherwise
+     * @return true if user confirms, false otherwise (always true when not interactive)
      */
     bool confirmAction(const std::string& message) const;
 
@@ -85,6 +160,14 @@ public:
      */
     void displayHelp() const;
 
+    /**
+     * @brief Turn prompts and screen clearing on or off
+     *
+     * Batch mode runs without a terminal: confirmations are taken as yes
+     * and nothing waits for Enter, which would swallow script lines.
+     */
+    void setInteractive(bool enabled) { interactive = enabled; }
+
 private:
     /**
      * @brief Format a file size in human-readable format
@@ -99,6 +182,19 @@ private:
      * @return Formatted date/time string
      */
     std::string formatTime(time_t time) const;
+
+    /**
+     * @brief Format how far a job has got (e.g. "42.0%  1.2 GB of 2.9 GB  85.3 MB/s  ETA 20s")
+     */
+    std::string formatJobProgress(const JobInfo& job) const;
+
+    /**
+     * @brief Append one formatted listing row to the output buffer
+     */
+    void appendFileRow(const FileInfoBatch& files, size_t index) const;
+
+    mutable std::string outputBuffer;  ///< Rendered rows waiting for flushOutput()
+    bool interactive = true;           ///< Prompts and clears the screen
 };
 
 #endif // UI_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,439 @@
+#include "TreeGenerator.h"
+#include "FileOperations.h"
+#include "DirectoryReader.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+#ifndef BENCH_VERSION
+#define BENCH_VERSION "unknown"
+#endif
+
+namespace {
+
+/**
+ * @brief Command line settings
+ */
+struct BenchOptions {
+    TreeSpec tree;
+    string root;               ///< Where the tree is generated (default: a new directory in /tmp)
+    unsigned runs = 5;         ///< Timed runs per operation and cache state
+    size_t samples = 200;      ///< Files or directories one run of a per-item operation touches
+    string json;               ///< Write results here ("-" for stdout, empty for none)
+    bool keep = false;         ///< Leave the tree behind
+    bool dropCaches = false;   ///< Cold runs also drop dentries and inodes (needs root)
+};
+
+/**
+ * @brief Timings of one operation under one cache state
+ */
+struct Result {
+    string operation;
+    string cache;             ///< "warm" or "cold"
+    vector<double> seconds;   ///< One entry per operation performed
+
+    /**
+     * @brief Nearest-rank percentile in microseconds
+     */
+    double percentile(double q) const {
+        vector<double> sorted = seconds;
+        sort(sorted.begin(), sorted.end());
+        size_t rank = static_cast<size_t>(q * sorted.size());
+        return sorted[min(rank, sorted.size() - 1)] * 1e6;
+    }
+
+    double opsPerSecond() const {
+        double total = 0;
+        for (double s : seconds) {
+            total += s;
+        }
+        return total > 0 ? seconds.size() / total : 0.0;
+    }
+};
+
+/// Performs one run, appending the duration of every operation it times
+using RunBody = function<void(vector<double>& seconds)>;
+
+template <typename Fn>
+double timed(Fn&& fn) {
+    auto start = chrono::steady_clock::now();
+    fn();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Evict file data below the given directories from the page cache
+ *
+ * posix_fadvise(DONTNEED) drops cached pages, but not the dentries and
+ * inodes that path lookups hit; only /proc/sys/vm/drop_caches does that,
+ * and it needs root.
+ */
+void evict(const vector<string>& roots, bool dropAll) {
+    ::sync();  // Dirty pages can't be dropped
+    if (dropAll) {
+        ofstream control("/proc/sys/vm/drop_caches");
+        control << "3" << endl;
+        if (!control) {
+            throw runtime_error(string("Cannot drop caches: ") + strerror(errno));
+        }
+    }
+    for (const string& root : roots) {
+        if (!fs::exists(root)) {
+            continue;
+        }
+        for (const auto& entry : fs::recursive_directory_iterator(root)) {
+            int fd = open(entry.path().c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+            if (fd >= 0) {
+                posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+                close(fd);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Read a directory the way listDirectory did before DirectoryReader
+ *
+ * The baseline for readDirectory: a directory_iterator, then fs::status,
+ * file_size and last_write_time by path, plus a stat() for the owner, so
+ * every entry's path is resolved four or five times. Nothing is printed.
+ * @return Total size of the files, so the work can't be optimised away
+ */
+uintmax_t readDirectoryByPath(const string& dir) {
+    uintmax_t bytes = 0;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        const auto& path = entry.path();
+        error_code ec;
+        const auto status = fs::status(path, ec);
+        uintmax_t size = fs::is_directory(status) ? 0 : fs::file_size(path, ec);
+        struct stat st;
+        if (fs::last_write_time(path, ec) != fs::file_time_type::min() && ::stat(path.c_str(), &st) == 0) {
+            bytes += size;
+        }
+    }
+    return bytes;
+}
+
+/**
+ * @brief Runs every operation warm and cold against one generated tree
+ */
+class Benchmark {
+public:
+    Benchmark(const GeneratedTree& tree, const BenchOptions& options)
+        : tree(tree), options(options), scratch(tree.root + ".scratch"), sink(nullptr) {
+        // Keep the per-operation messages of FileOperations out of the report
+        FileOperations::setThreadOutput(&sink);
+        ops.setInteractive(false);
+        ops.changeDirectory(tree.root);
+
+        size_t files = min(options.samples, tree.files.size());
+        for (size_t i = 0; i < files; ++i) {
+            sampleFiles.push_back(tree.files[i * tree.files.size() / files]);
+        }
+        size_t dirs = min(options.samples, tree.directories.size());
+        for (size_t i = 0; i < dirs; ++i) {
+            sampleDirs.push_back(tree.directories[i * tree.directories.size() / dirs]);
+        }
+    }
+
+    ~Benchmark() {
+        FileOperations::setThreadOutput(nullptr);
+        error_code ec;
+        fs::remove_all(scratch, ec);
+    }
+
+    vector<Result> run() {
+        string needle = fs::path(tree.files.back()).stem().string();
+
+        add("listDirectory", [this] { ops.clearDirectoryCache(); }, [this](vector<double>& seconds) {
+            for (const string& dir : sampleDirs) {
+                seconds.push_back(timed([&] { ops.listDirectory(dir, [](const FileInfoBatch&) {}); }));
+            }
+        });
+        // DirectoryReader against the per-path calls it replaced, without the cache or output
+        add("readDirectory", nullptr, [this](vector<double>& seconds) {
+            const DirectoryReader reader(LIST_TYPE | LIST_SIZE | LIST_MODE | LIST_OWNER | LIST_GROUP | LIST_MTIME);
+            for (const string& dir : sampleDirs) {
+                seconds.push_back(timed([&] { reader.read(dir); }));
+            }
+        });
+        add("readDirByPath", nullptr, [this](vector<double>& seconds) {
+            for (const string& dir : sampleDirs) {
+                seconds.push_back(timed([&] { readDirectoryByPath(dir); }));
+            }
+        });
+        add("searchFile", nullptr, [this, needle](vector<double>& seconds) {
+            seconds.push_back(timed([&] { ops.searchFile(needle); }));
+        });
+        add("copyFile", [this] { resetScratch(); }, [this](vector<double>& seconds) {
+            for (size_t i = 0; i < sampleFiles.size(); ++i) {
+                string target = scratch + "/copy" + to_string(i);
+                seconds.push_back(timed([&] { ops.copyFile(sampleFiles[i], target, true); }));
+            }
+        });
+        add("moveFile", [this] { makeCopies(); }, [this](vector<double>& seconds) {
+            for (size_t i = 0; i < sampleFiles.size(); ++i) {
+                string source = scratch + "/copy" + to_string(i);
+                string target = scratch + "/moved" + to_string(i);
+                seconds.push_back(timed([&] { ops.moveFile(source, target, true); }));
+            }
+        });
+        add("remove", [this] { makeCopies(); }, [this](vector<double>& seconds) {
+            for (size_t i = 0; i < sampleFiles.size(); ++i) {
+                string target = scratch + "/copy" + to_string(i);
+                seconds.push_back(timed([&] { ops.remove(target); }));
+            }
+        });
+        add("copyTree", [this] { resetScratch(); }, [this](vector<double>& seconds) {
+            seconds.push_back(timed([&] { ops.copyFile(tree.root, scratch + "/tree", true); }));
+        });
+        add("removeTree", [this] {
+            resetScratch();
+            ops.copyFile(tree.root, scratch + "/tree", true);
+        }, [this](vector<double>& seconds) {
+            seconds.push_back(timed([&] { ops.remove(scratch + "/tree"); }));
+        });
+        return results;
+    }
+
+private:
+    /**
+     * @brief Time an operation warm, then cold
+     * @param setup Untimed preparation before every run (may be empty)
+     */
+    void add(const string& operation, const function<void()>& setup, const RunBody& body) {
+        for (bool cold : {false, true}) {
+            Result result{operation, cold ? "cold" : "warm", {}};
+            // A warm measurement starts from caches filled by an untimed run
+            for (unsigned run = cold ? 1 : 0; run <= options.runs; ++run) {
+                if (setup) {
+                    setup();
+                }
+                if (cold) {
+                    evict({tree.root, scratch}, options.dropCaches);
+                }
+                vector<double> seconds;
+                body(seconds);
+                if (run > 0) {
+                    result.seconds.insert(result.seconds.end(), seconds.begin(), seconds.end());
+                }
+            }
+            cerr << "  " << left << setw(14) << operation << " " << result.cache << " done\n";
+            results.push_back(std::move(result));
+        }
+    }
+
+    void resetScratch() {
+        fs::remove_all(scratch);
+        fs::create_directory(scratch);
+    }
+
+    void makeCopies() {
+        resetScratch();
+        for (size_t i = 0; i < sampleFiles.size(); ++i) {
+            fs::copy_file(sampleFiles[i], scratch + "/copy" + to_string(i));
+        }
+    }
+
+    const GeneratedTree& tree;
+    const BenchOptions& options;
+    FileOperations ops;
+    string scratch;                ///< Directory copies and moves go to
+    ostream sink;                  ///< Discards FileOperations messages
+    vector<string> sampleFiles;
+    vector<string> sampleDirs;
+    vector<Result> results;
+};
+
+// ==================== Reporting ====================
+
+string jsonString(const string& text) {
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+void printTable(const vector<Result>& results) {
+    cout << left << setw(16) << "operation" << setw(7) << "cache" << right << setw(9) << "samples"
+         << setw(12) << "p50 (us)" << setw(12) << "p99 (us)" << setw(12) << "ops/s" << "\n";
+    cout << string(68, '-') << "\n";
+    for (const Result& result : results) {
+        cout << left << setw(16) << result.operation << setw(7) << result.cache << right
+             << setw(9) << result.seconds.size() << fixed << setprecision(1)
+             << setw(12) << result.percentile(0.50) << setw(12) << result.percentile(0.99)
+             << setw(12) << result.opsPerSecond() << "\n";
+    }
+}
+
+void writeJson(ostream& out, const GeneratedTree& tree, const BenchOptions& options,
+               const vector<Result>& results) {
+    char timestamp[32];
+    time_t now = time(nullptr);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    utsname host{};
+    uname(&host);
+
+    out << "{\n";
+    out << "  \"version\": " << jsonString(BENCH_VERSION) << ",\n";
+    out << "  \"timestamp\": \"" << timestamp << "\",\n";
+    out << "  \"host\": {\"kernel\": " << jsonString(host.release)
+        << ", \"cpus\": " << sysconf(_SC_NPROCESSORS_ONLN) << "},\n";
+    out << "  \"tree\": {\"root\": " << jsonString(tree.root)
+        << ", \"files\": " << tree.files.size() << ", \"directories\": " << tree.directories.size()
+        << ", \"bytes\": " << tree.bytes << ", \"breadth\": " << options.tree.breadth
+        << ", \"depth\": " << options.tree.depth << ", \"seed\": " << options.tree.seed << "},\n";
+    out << "  \"runs\": " << options.runs << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        out << "    {\"operation\": \"" << result.operation << "\", \"cache\": \"" << result.cache
+            << "\", \"samples\": " << result.seconds.size() << fixed << setprecision(3)
+            << ", \"p50_us\": " << result.percentile(0.50) << ", \"p99_us\": " << result.percentile(0.99)
+            << ", \"ops_per_sec\": " << result.opsPerSecond() << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// ==================== Command Line ====================
+
+/**
+ * @brief Parse a count or size, allowing a K, M or G suffix
+ */
+uint64_t parseNumber(const string& text) {
+    size_t used = 0;
+    uint64_t value = stoull(text, &used);
+    string suffix = text.substr(used);
+    if (suffix == "K" || suffix == "k") return value << 10;
+    if (suffix == "M" || suffix == "m") return value << 20;
+    if (suffix == "G" || suffix == "g") return value << 30;
+    if (!suffix.empty()) {
+        throw runtime_error("Bad number: " + text);
+    }
+    return value;
+}
+
+void usage(const char* program) {
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --files N        Files in the generated tree (default 10000)\n"
+         << "  --breadth N      Subdirectories per directory (default 8)\n"
+         << "  --depth N        Levels of subdirectories (default 3)\n"
+         << "  --min-size N     Smallest file, K/M/G suffixes allowed (default 128)\n"
+         << "  --max-size N     Largest file (default 64K)\n"
+         << "  --sizes D        Size distribution: fixed, uniform or log (default log)\n"
+         << "  --seed N         Seed of the generator (default 1)\n"
+         << "  --runs N         Timed runs per operation and cache state (default 5)\n"
+         << "  --samples N      Files or directories per run of per-item operations (default 200)\n"
+         << "  --root DIR       Generate the tree here (must not exist; default under /tmp)\n"
+         << "  --json FILE      Also write results as JSON ('-' for stdout)\n"
+         << "  --drop-caches    Cold runs also drop dentries and inodes (root only)\n"
+         << "  --keep           Keep the generated tree\n";
+}
+
+BenchOptions parseOptions(int argc, char* argv[]) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        auto value = [&]() -> string {
+            if (i + 1 >= argc) {
+                throw runtime_error("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if (arg == "--files") options.tree.files = parseNumber(value());
+        else if (arg == "--breadth") options.tree.breadth = static_cast<unsigned>(parseNumber(value()));
+        else if (arg == "--depth") options.tree.depth = static_cast<unsigned>(parseNumber(value()));
+        else if (arg == "--min-size") options.tree.minSize = parseNumber(value());
+        else if (arg == "--max-size") options.tree.maxSize = parseNumber(value());
+        else if (arg == "--sizes") options.tree.sizes = TreeGenerator::parseDistribution(value());
+        else if (arg == "--seed") options.tree.seed = parseNumber(value());
+        else if (arg == "--runs") options.runs = max<unsigned>(1, static_cast<unsigned>(parseNumber(value())));
+        else if (arg == "--samples") options.samples = max<size_t>(1, parseNumber(value()));
+        else if (arg == "--root") options.root = value();
+        else if (arg == "--json") options.json = value();
+        else if (arg == "--drop-caches") options.dropCaches = true;
+        else if (arg == "--keep") options.keep = true;
+        else throw runtime_error("Unknown option: " + arg);
+    }
+    if (options.root.empty()) {
+        options.root = (fs::temp_directory_path() / ("fe-bench-" + to_string(getpid()))).string();
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        usage(argv[0]);
+        return 2;
+    }
+
+    try {
+        cerr << "Generating " << options.tree.files << " files in " << options.root << "...\n";
+        GeneratedTree tree;
+        double seconds = timed([&] { tree = TreeGenerator::generate(options.root, options.tree); });
+        cerr << "  " << tree.files.size() << " files, " << tree.directories.size() << " directories, "
+             << fixed << setprecision(1) << tree.bytes / (1024.0 * 1024.0) << " MB in "
+             << setprecision(2) << seconds << " s\n";
+
+        vector<Result> results;
+        {
+            Benchmark benchmark(tree, options);
+            results = benchmark.run();
+        }
+
+        printTable(results);
+        if (options.json == "-") {
+            writeJson(cout, tree, options, results);
+        } else if (!options.json.empty()) {
+            ofstream out(options.json);
+            writeJson(out, tree, options, results);
+            if (!out) {
+                throw runtime_error("Cannot write " + options.json + ": " + strerror(errno));
+            }
+            cerr << "Results written to " << options.json << "\n";
+        }
+
+        if (!options.keep) {
+            fs::remove_all(options.root);
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
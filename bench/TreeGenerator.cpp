@@ -0,0 +1,123 @@
+#include "TreeGenerator.h"
+#include "FileWriter.h"
+#include "ThreadPool.h"
+#include <random>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+/// Pseudo-random bytes that file contents are cut from
+constexpr size_t BLOCK_SIZE = 1024 * 1024;
+
+const char* const EXTENSIONS[] = {"txt", "log", "dat", "cpp", "json", "bin"};
+
+void makeDirectory(const string& path) {
+    if (mkdir(path.c_str(), 0755) != 0) {
+        throw runtime_error("Cannot create " + path + ": " + strerror(errno));
+    }
+}
+
+uint64_t drawSize(mt19937_64& random, const TreeSpec& spec) {
+    switch (spec.sizes) {
+        case SizeDistribution::Fixed:
+            return spec.maxSize;
+        case SizeDistribution::Uniform:
+            return uniform_int_distribution<uint64_t>(spec.minSize, spec.maxSize)(random);
+        case SizeDistribution::LogUniform: {
+            // Drawn on a log scale of size + 1 so a minimum of 0 works
+            double low = log(static_cast<double>(spec.minSize) + 1);
+            double high = log(static_cast<double>(spec.maxSize) + 1);
+            double size = exp(uniform_real_distribution<double>(low, high)(random)) - 1;
+            return min(spec.maxSize, max(spec.minSize, static_cast<uint64_t>(size)));
+        }
+    }
+    return spec.maxSize;
+}
+
+} // namespace
+
+GeneratedTree TreeGenerator::generate(const string& root, const TreeSpec& spec) {
+    if (spec.minSize > spec.maxSize) {
+        throw runtime_error("Minimum file size is larger than the maximum");
+    }
+
+    GeneratedTree tree;
+    tree.root = root;
+    makeDirectory(root);
+    tree.directories.push_back(root);
+
+    size_t levelStart = 0;
+    for (unsigned level = 0; level < spec.depth; ++level) {
+        size_t levelEnd = tree.directories.size();
+        for (size_t parent = levelStart; parent < levelEnd; ++parent) {
+            for (unsigned child = 0; child < spec.breadth; ++child) {
+                string path = tree.directories[parent] + "/dir" + to_string(child);
+                makeDirectory(path);
+                tree.directories.push_back(std::move(path));
+            }
+        }
+        levelStart = levelEnd;
+    }
+
+    // Names and sizes are drawn up front so the tree doesn't depend on thread timing
+    mt19937_64 random(spec.seed);
+    vector<uint64_t> sizes(spec.files);
+    tree.files.reserve(spec.files);
+    for (uint64_t i = 0; i < spec.files; ++i) {
+        const string& dir = tree.directories[i % tree.directories.size()];
+        const char* extension = EXTENSIONS[i % (sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0]))];
+        tree.files.push_back(dir + "/file" + to_string(i) + "." + extension);
+        sizes[i] = drawSize(random, spec);
+        tree.bytes += sizes[i];
+    }
+
+    string block(BLOCK_SIZE, '\0');
+    for (char& c : block) {
+        c = static_cast<char>(random());
+    }
+
+    mutex errorMutex;
+    string firstError;
+    ThreadPool pool(spec.threads);
+    pool.parallelFor(tree.files.size(), [&](size_t i) {
+        try {
+            WriteOptions options;
+            options.atomic = false;
+            options.expectedSize = sizes[i];
+            FileWriter writer(tree.files[i], options);
+            // Each file starts at a different point of the block
+            size_t offset = (i * 4099) % BLOCK_SIZE;
+            for (uint64_t left = sizes[i]; left > 0;) {
+                size_t chunk = static_cast<size_t>(min<uint64_t>(left, BLOCK_SIZE - offset));
+                writer.write(string_view(block.data() + offset, chunk));
+                left -= chunk;
+                offset = 0;
+            }
+            writer.commit();
+        } catch (const exception& e) {
+            lock_guard<mutex> lock(errorMutex);
+            if (firstError.empty()) {
+                firstError = e.what();
+            }
+        }
+    });
+    if (!firstError.empty()) {
+        throw runtime_error(firstError);
+    }
+    return tree;
+}
+
+SizeDistribution TreeGenerator::parseDistribution(const string& name) {
+    if (name == "fixed") return SizeDistribution::Fixed;
+    if (name == "uniform") return SizeDistribution::Uniform;
+    if (name == "log") return SizeDistribution::LogUniform;
+    throw runtime_error("Unknown size distribution: " + name + " (fixed, uniform or log)");
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef TREE_GENERATOR_H
+#define TREE_GENERATOR_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief How generated file sizes are drawn from [minSize, maxSize]
+ */
+enum class SizeDistribution {
+    Fixed,       ///< Every file is maxSize bytes
+    Uniform,     ///< Evenly spread
+    LogUniform   ///< Evenly spread over orders of magnitude: many small files, a few large ones
+};
+
+/**
+ * @brief Shape of a synthetic directory tree
+ */
+struct TreeSpec {
+    unsigned breadth = 8;        ///< Subdirectories per directory
+    unsigned depth = 3;          ///< Levels of subdirectories below the root
+    uint64_t files = 10000;      ///< Regular files, spread evenly over all directories
+    uint64_t minSize = 128;      ///< Smallest file size in bytes
+    uint64_t maxSize = 64 * 1024;  ///< Largest file size in bytes
+    SizeDistribution sizes = SizeDistribution::LogUniform;
+    uint64_t seed = 1;           ///< Same seed, same tree
+    unsigned threads = 0;        ///< Threads writing files (0 = hardware concurrency)
+};
+
+/**
+ * @brief What was generated
+ */
+struct GeneratedTree {
+    std::string root;
+    std::vector<std::string> directories;  ///< Every directory, root first, parents before children
+    std::vector<std::string> files;        ///< Every file, in creation order
+    uint64_t bytes = 0;                    ///< Sum of file sizes
+};
+
+/**
+ * @brief Builds reproducible directory trees for benchmarks
+ *
+ * Directory i of a level holds files i, i + n, i + 2n ... (n directories in
+ * all), so every directory gets nearly the same number of entries. File
+ * names cycle through a few extensions, and contents are pseudo-random so
+ * nothing compresses or deduplicates.
+ */
+class TreeGenerator {
+public:
+    /**
+     * @brief Create the tree under root (which must not exist yet)
+     * @throws std::runtime_error if root exists or a file cannot be written
+     */
+    static GeneratedTree generate(const std::string& root, const TreeSpec& spec);
+
+    /**
+     * @brief Parse "fixed", "uniform" or "log"
+     * @throws std::runtime_error for anything else
+     */
+    static SizeDistribution parseDistribution(const std::string& name);
+};
+
+#endif // TREE_GENERATOR_H
\ No newline at end of file
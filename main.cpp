@@ -1,165 +1,958 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
+#include <set>
+#include <memory>
+#include <filesystem>
+#include <algorithm>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <poll.h>
+#include "CommandLine.h"
 #include "FileExplorer.h"
+#include "GlobMatcher.h"
+#include "JobScheduler.h"
+#include "Metrics.h"
+#include "ThreadPool.h"
 #include "UIManager.h"
 
 using namespace std;
+namespace fs = std::filesystem;
 
-vector<string> splitCommand(const string& command) {
-    vector<string> tokens;
-    string token;
-    for (char ch : command) {
-        if (ch == ' ') {
-            if (!token.empty()) {
-                tokens.push_back(token);
-                token.clear();
+namespace {
+
+/// Commands batch mode runs at once unless told otherwise (-j)
+constexpr unsigned BATCH_JOBS = 8;
+
+/// Most commands gathered into one concurrent run
+constexpr size_t BATCH_WINDOW = 256;
+
+/// Seconds between progress updates while fg waits for a job
+constexpr double JOB_PROGRESS_INTERVAL = 0.25;
+
+/**
+ * @brief Settings of a batch run
+ */
+struct BatchOptions {
+    unsigned jobs = BATCH_JOBS;  ///< Commands run at once (1 = strictly one after another)
+    bool stopOnError = false;    ///< Stop reading the script after a failed command
+};
+
+/**
+ * @brief Whether a command touches nothing but the paths it names
+ *
+ * Only these may run side by side in batch mode.
+ */
+bool isPathCommand(const CommandLine& command) {
+    string_view name = command[0];
+    return name == "cp" || name == "mv" || name == "rm" || name == "mkdir" || name == "write";
+}
+
+/**
+ * @brief Absolute, normalized paths a path command reads or writes
+ */
+vector<string> commandPaths(const CommandLine& command, const string& currentPath) {
+    vector<string> paths;
+    bool write = command[0] == "write";
+    for (size_t i = 1; i < command.size(); ++i) {
+        if (command[i].empty() || command[i][0] == '-') {
+            continue;
+        }
+        string arg = command.str(i);
+        string pattern = command.pattern(i);
+        size_t wildcard = write ? string::npos : GlobMatcher::findWildcard(pattern);
+        if (wildcard != string::npos) {
+            // A glob may reach anything below the directory it starts from
+            size_t slash = pattern.rfind('/', wildcard);
+            arg = (slash == string::npos) ? "." : GlobMatcher::unescape(pattern.substr(0, slash + 1));
+        }
+        string path = (fs::path(currentPath) / arg).lexically_normal().string();
+        if (path.size() > 1 && path.back() == '/') {
+            path.pop_back();
+        }
+        paths.push_back(std::move(path));
+        if (write) {
+            break;  // The rest is the text
+        }
+    }
+    return paths;
+}
+
+/**
+ * @brief Paths taken by the commands of one concurrent run
+ *
+ * A path conflicts with a claimed one if it is the same, above it or below
+ * it. Paths are compared as written, so two names for one file (through a
+ * symlink) are not caught; scripts relying on that need -j 1.
+ */
+class PathClaims {
+public:
+    bool conflicts(const string& path) const {
+        string_view view(path);
+        for (size_t end = view.size(); end > 0 && end != string_view::npos; end = view.rfind('/', end - 1)) {
+            if (claimed.find(view.substr(0, end)) != claimed.end()) {
+                return true;
             }
+        }
+        string prefix = path + "/";
+        auto below = claimed.lower_bound(prefix);
+        return below != claimed.end() && below->compare(0, prefix.size(), prefix) == 0;
+    }
+
+    void claim(const string& path) { claimed.insert(path); }
+    void clear() { claimed.clear(); }
+
+private:
+    set<string, less<>> claimed;
+};
+
+/**
+ * @brief Whether a command ends in "&", asking to run it as a background job
+ */
+bool isBackground(const CommandLine& command) {
+    return command.size() > 1 && command[command.size() - 1] == "&";
+}
+
+/**
+ * @brief Records how long the enclosing scope took as a run of a command
+ */
+class CommandTimer {
+public:
+    explicit CommandTimer(const CommandLine& command)
+        : name(Metrics::ENABLED && !isBackground(command) ? command.str(0) : string()), start(Metrics::now()) {}
+
+    ~CommandTimer() {
+        if (Metrics::ENABLED && !name.empty()) {  // A background job is timed by the job itself
+            Metrics::recordCommand(name, start, Metrics::now() - start);
+        }
+    }
+
+    CommandTimer(const CommandTimer&) = delete;
+    CommandTimer& operator=(const CommandTimer&) = delete;
+
+private:
+    string name;
+    uint64_t start;
+};
+
+/**
+ * @brief Path arguments of cp, mv or rm, with the leading options taken out
+ */
+struct PathArguments {
+    bool background = false;  ///< rm -b
+    vector<string> paths;     ///< The words as typed, quotes removed
+    vector<string> patterns;  ///< The same words for globbing, quoted metacharacters escaped
+};
+
+PathArguments pathArguments(const CommandLine& command) {
+    PathArguments args;
+    size_t i = 1;
+    for (; i < command.size(); ++i) {
+        if (command[0] == "rm" && command[i] == "-b") {
+            args.background = true;
+        } else if (command[0] == "cp" && (command[i] == "-r" || command[i] == "-R")) {
+            // Directories are always copied recursively
         } else {
-            token += ch;
+            break;
+        }
+    }
+    for (; i < command.size(); ++i) {
+        args.paths.push_back(command.str(i));
+        args.patterns.push_back(command.pattern(i));
+    }
+    return args;
+}
+
+/**
+ * @brief Whether arguments name several targets or a glob, and so run as one PathBatch
+ */
+bool isMultiTarget(const vector<string>& patterns) {
+    return patterns.size() > 1 || any_of(patterns.begin(), patterns.end(), [](const string& pattern) {
+        return GlobMatcher::hasWildcards(pattern);
+    });
+}
+
+/**
+ * @brief Remove the targets of an rm that has already been confirmed
+ * @throws runtime_error if some targets could not be removed
+ */
+string removeTargets(const PathBatch& targets, bool background, FileExplorer& explorer) {
+    if (!explorer.removePaths(targets, background)) {
+        throw runtime_error("Some entries could not be removed");
+    }
+    return "Removed: " + targets.describe();
+}
+
+/**
+ * @brief Run cp, mv, mkdir, rm or write
+ *
+ * Prints nothing itself, so batch mode can call it from worker threads.
+ * @return Message describing what was done
+ * @throws runtime_error on a usage error or if the operation fails
+ */
+string runPathCommand(const CommandLine& command, FileExplorer& explorer) {
+    string_view name = command[0];
+    if (name == "mkdir") {
+        bool parents = command.size() > 2 && command[1] == "-p";
+        size_t arg = parents ? 2 : 1;
+        if (command.size() <= arg) {
+            throw runtime_error("Usage: mkdir [-p] <directory_name>");
+        }
+        if (!explorer.createDirectory(command.str(arg), parents)) {
+            if (!parents) {
+                throw runtime_error("Directory already exists: " + command.str(arg));
+            }
+            return "Directory exists: " + command.str(arg);
+        }
+        return "Directory created: " + command.str(arg);
+    } else if (name == "rm") {
+        // rm [-b] <path>...
+        PathArguments args = pathArguments(command);
+        if (args.paths.empty()) {
+            throw runtime_error("Usage: rm [-b] <path>...");
+        }
+        if (isMultiTarget(args.patterns)) {
+            return removeTargets(explorer.expandPaths(args.patterns), args.background, explorer);
+        }
+        if (!explorer.remove(args.paths[0], args.background)) {
+            throw runtime_error("Failed to remove " + args.paths[0]);
+        }
+        return "Removed: " + args.paths[0];
+    } else if (name == "cp" || name == "mv") {
+        // cp [-r] <source>... <destination> | mv <source>... <destination>
+        PathArguments args = pathArguments(command);
+        if (args.paths.size() < 2) {
+            throw runtime_error("Usage: " + command.str(0) + (name == "cp" ? " [-r]" : "") +
+                                " <source>... <destination>");
+        }
+        string destination = args.paths.back();
+        args.paths.pop_back();
+        args.patterns.pop_back();
+        if (isMultiTarget(args.patterns)) {
+            PathBatch sources = explorer.expandPaths(args.patterns);
+            if (name == "cp") {
+                if (!explorer.copyPaths(sources, destination)) {
+                    throw runtime_error("Failed to copy some entries");
+                }
+                return "Copied " + sources.describe() + " to: " + destination;
+            }
+            if (!explorer.movePaths(sources, destination)) {
+                throw runtime_error("Failed to move some entries");
+            }
+            return "Moved " + sources.describe() + " to: " + destination;
+        }
+        if (name == "cp") {
+            if (!explorer.copyFile(args.paths[0], destination)) {
+                throw runtime_error("Failed to copy file");
+            }
+            return "Copied to: " + destination;
+        }
+        if (!explorer.moveFile(args.paths[0], destination)) {
+            throw runtime_error("Failed to move file");
         }
+        return "Moved to: " + destination;
     }
-    if (!token.empty()) {
-        tokens.push_back(token);
+
+    // write [-a] [--sync] [--backup] <file> [text...]
+    WriteOptions options;
+    size_t i = 1;
+    for (; i < command.size() && !command[i].empty() && command[i][0] == '-'; ++i) {
+        if (command[i] == "-a") options.append = true;
+        else if (command[i] == "--sync") options.sync = true;
+        else if (command[i] == "--backup") options.backup = true;
+        else break;
+    }
+    if (i >= command.size()) {
+        throw runtime_error("Usage: write [-a] [--sync] [--backup] <file> [text...]");
+    }
+    string file = command.str(i);
+    string text = command.join(i + 1);
+    text += '\n';
+    explorer.writeFile(file, text, options);
+    return (options.append ? "Appended to " : "Wrote ") + file;
+}
+
+/**
+ * @brief Run a background job's command on a job worker
+ *
+ * Prints through FileOperations' thread output, never to the terminal.
+ * @return Result line of the job
+ */
+string runJobCommand(const CommandLine& command, FileExplorer& explorer, ostream& output) {
+    string_view name = command[0];
+    if (name == "find") {
+        if (command.size() < 2) {
+            throw runtime_error("Usage: find <filename>");
+        }
+        explorer.searchFile(command.str(1));
+        return "";
+    } else if (name == "grep") {
+        if (command.size() < 2) {
+            throw runtime_error("Usage: grep <text> [file_pattern]");
+        }
+        string filePattern = (command.size() > 2) ? command.str(2) : "*";
+        auto results = explorer.findInFiles(command.str(1), filePattern);
+        for (const auto& result : results) {
+            output << "  " << result << "\n";
+        }
+        return "Found " + to_string(results.size()) + " matching lines.";
+    }
+    return runPathCommand(command, explorer);
+}
+
+/**
+ * @brief Question to put before a background cp or mv replaces something
+ *
+ * Resolves the destination the way runPathCommand will: a directory
+ * receives each source under its own name, anything else is the target.
+ * @return Empty if nothing at the destination would be overwritten
+ * @throws runtime_error if a source doesn't exist or two share a name
+ */
+string overwriteQuestion(const CommandLine& command, const FileExplorer& explorer) {
+    PathArguments args = pathArguments(command);
+    if (args.paths.size() < 2) {
+        return "";  // The job reports the usage error
+    }
+    fs::path destination = fs::path(explorer.getCurrentPath()) / args.paths.back();
+    args.paths.pop_back();
+    args.patterns.pop_back();
+    string source = args.paths[0];
+    if (isMultiTarget(args.patterns)) {
+        PathBatch sources = explorer.expandPaths(args.patterns);
+        if (fs::is_directory(destination)) {
+            sources.requireDistinctNames(command.str(0) == "cp" ? "copy" : "move");
+            size_t existing = sources.existingIn(destination.string());
+            if (existing == 0) {
+                return "";
+            }
+            return to_string(existing) + " of " + to_string(sources.size()) +
+                   " entries already exist in " + destination.string() + ". Overwrite?";
+        }
+        if (sources.size() != 1) {
+            return "";  // The job fails with "Not a directory" before touching anything
+        }
+        const PathGroup& group = sources.groups().front();
+        source = group.directory + "/" + group.names.front();
+    }
+    if (fs::is_directory(destination)) {
+        destination /= fs::path(source).filename();
+    }
+    if (!fs::exists(fs::symlink_status(destination))) {
+        return "";
+    }
+    return "Destination " + destination.string() + " already exists. Overwrite?";
+}
+
+/**
+ * @brief Start "<command> &" as a background job
+ *
+ * Copies, moves and deletes go to the bulk lane; searches to the
+ * interactive one. Each job gets an explorer of its own, opened on the
+ * current directory, so a later cd or a command at the prompt can't move
+ * the ground under it. Jobs never prompt: an rm, and a cp or mv that
+ * would overwrite something, is confirmed here, before it is queued.
+ */
+void startJob(CommandLine command, FileExplorer& explorer, UIManager& ui, JobScheduler& jobs) {
+    command.dropLast();
+    string_view name = command[0];
+    JobPriority priority;
+    if (name == "cp" || name == "mv" || name == "rm") {
+        priority = JobPriority::Bulk;
+    } else if (name == "find" || name == "grep") {
+        priority = JobPriority::Interactive;
+    } else {
+        throw runtime_error("Only cp, mv, rm, find and grep can run in the background");
+    }
+    if (name == "rm") {
+        PathArguments args = pathArguments(command);
+        string what = isMultiTarget(args.patterns) ? explorer.expandPaths(args.patterns).describe()
+                                                    : (args.paths.empty() ? "" : args.paths[0]);
+        if (!what.empty() && !ui.confirmAction("Are you sure you want to delete " + what + "?")) {
+            return;
+        }
+    } else if (name == "cp" || name == "mv") {
+        string question = overwriteQuestion(command, explorer);
+        if (!question.empty() && !ui.confirmAction(question)) {
+            return;
+        }
+    }
+
+    string text = command.join(0);
+    string directory = explorer.getCurrentPath();
+    unsigned id = jobs.submit(text, priority, [command, directory](ostream& output) {
+        CommandTimer timer(command);
+        FileExplorer jobExplorer(directory);
+        jobExplorer.setInteractive(false);
+        FileOperations::setThreadOutput(&output);
+        try {
+            string message = runJobCommand(command, jobExplorer, output);
+            FileOperations::setThreadOutput(nullptr);
+            return message;
+        } catch (...) {
+            FileOperations::setThreadOutput(nullptr);
+            throw;
+        }
+    });
+    ui.displayInfo("[" + to_string(id) + "] " + text);
+}
+
+/**
+ * @brief Print what a finished job printed and how it ended, and forget it
+ * @param raise Throw a failure as runtime_error (for fg) instead of displaying it
+ * @return How the job ended
+ */
+JobState reportJob(unsigned id, JobScheduler& jobs, UIManager& ui, bool raise = false) {
+    JobInfo info;
+    string output;
+    if (!jobs.collect(id, info, output)) {
+        return info.state;
+    }
+    cout << output;
+    string label = "[" + to_string(id) + "] " + info.command;
+    if (info.state == JobState::Done) {
+        ui.displaySuccess(label + (info.message.empty() ? "" : ": " + info.message));
+    } else if (info.state == JobState::Failed && raise) {
+        throw runtime_error(label + ": " + info.message);
+    } else if (info.state == JobState::Failed) {
+        ui.displayError(label + ": " + info.message);
+    } else {
+        ui.displayInfo(label + ": cancelled");
+    }
+    return info.state;
+}
+
+/**
+ * @brief Report every job that has finished since the last prompt
+ */
+void reportFinishedJobs(JobScheduler& jobs, UIManager& ui) {
+    for (unsigned id : jobs.finished()) {
+        reportJob(id, jobs, ui);
+    }
+}
+
+/**
+ * @brief Job number from "3" or "%3"
+ */
+unsigned parseJobId(const string& text) {
+    size_t start = (!text.empty() && text[0] == '%') ? 1 : 0;
+    char* end = nullptr;
+    unsigned long id = strtoul(text.c_str() + start, &end, 10);
+    if (start == text.size() || *end != '\0' || id == 0) {
+        throw runtime_error("Not a job number: " + text);
+    }
+    return static_cast<unsigned>(id);
+}
+
+/**
+ * @brief Wait for a job, showing its progress; Enter leaves it in the background
+ */
+void foregroundJob(unsigned id, JobScheduler& jobs, UIManager& ui, bool interactive) {
+    JobInfo info;
+    if (!jobs.info(id, info)) {
+        throw runtime_error("No such job: " + to_string(id));
+    }
+    if (interactive) {
+        ui.displayInfo("[" + to_string(id) + "] " + info.command + " (press Enter to leave it in the background)");
+    }
+    while (!jobs.wait(id, JOB_PROGRESS_INTERVAL)) {
+        if (!interactive) {
+            continue;
+        }
+        if (jobs.info(id, info)) {
+            ui.displayJobProgress(info);
+        }
+        pollfd input{STDIN_FILENO, POLLIN, 0};
+        if (poll(&input, 1, 0) > 0) {
+            string rest;
+            getline(cin, rest);  // The Enter that detached it
+            ui.clearProgressLine();
+            ui.displayInfo("[" + to_string(id) + "] continues in the background");
+            return;
+        }
+    }
+    if (interactive) {
+        ui.clearProgressLine();
+    }
+    reportJob(id, jobs, ui, true);
+}
+
+/**
+ * @brief Run one command
+ * @param interactive Prompts, confirmations and tail -f stopping on Enter are available
+ * @return false if the command was exit
+ * @throws runtime_error on a usage error or if the command fails
+ */
+bool runCommand(const CommandLine& command, FileExplorer& explorer, UIManager& ui, JobScheduler& jobs,
+                bool interactive) {
+    string_view cmd = command[0];
+
+    if (isBackground(command)) {
+        startJob(command, explorer, ui, jobs);
+    } else if (cmd == "exit") {
+        vector<JobInfo> active = jobs.list();
+        bool running = any_of(active.begin(), active.end(), [](const JobInfo& job) {
+            return job.state == JobState::Queued || job.state == JobState::Running;
+        });
+        if (ui.confirmAction(running ? "Background jobs are still running; cancel them and exit?"
+                                     : "Are you sure you want to exit?")) {
+            if (interactive) {
+                ui.displayInfo("Goodbye!");
+            }
+            return false;
+        }
+    } else if (cmd == "help") {
+        ui.displayHelp();
+    } else if (isPathCommand(command)) {
+        if (cmd == "rm") {
+            // One confirmation for every target, asked once the globs are expanded
+            PathArguments args = pathArguments(command);
+            if (isMultiTarget(args.patterns)) {
+                PathBatch targets = explorer.expandPaths(args.patterns);
+                if (ui.confirmAction("Are you sure you want to delete " + targets.describe() + "?")) {
+                    ui.displaySuccess(removeTargets(targets, args.background, explorer));
+                }
+                return true;
+            }
+            if (!args.paths.empty() && !ui.confirmAction("Are you sure you want to delete " + args.paths[0] + "?")) {
+                return true;
+            }
+        }
+        ui.displaySuccess(runPathCommand(command, explorer));
+    } else if (cmd == "ls") {
+        // ls [-S|-t|-X|-v|-r|--sort=KEY] [path]
+        SortOptions sort;
+        string path = ".";
+        for (size_t i = 1; i < command.size(); ++i) {
+            string_view arg = command[i];
+            if (arg == "-S") sort.key = SortKey::Size;
+            else if (arg == "-t") sort.key = SortKey::Time;
+            else if (arg == "-X") sort.key = SortKey::Extension;
+            else if (arg == "-v") sort.key = SortKey::Version;
+            else if (arg == "-r") sort.reverse = true;
+            else if (arg.rfind("--sort=", 0) == 0) sort.key = ListingSorter::parseKey(string(arg.substr(7)));
+            else path = string(arg);
+        }
+        ui.displayListingHeader();
+        size_t count = explorer.listDirectory(path, [&ui](const FileInfoBatch& batch) {
+            ui.displayFileBatch(batch);
+        }, sort);
+        ui.displayInfo(to_string(count) + " entries");
+    } else if (cmd == "cd") {
+        if (command.size() < 2) {
+            throw runtime_error("Usage: cd <directory>");
+        }
+        explorer.changeDirectory(command.str(1));
+        ui.displaySuccess("Changed directory to: " + explorer.getCurrentPath());
+    } else if (cmd == "find") {
+        if (command.size() < 2) {
+            throw runtime_error("Usage: find <filename>");
+        }
+        explorer.searchFile(command.str(1));
+    } else if (cmd == "grep") {
+        if (command.size() < 2) {
+            throw runtime_error("Usage: grep <text> [file_pattern]");
+        }
+        string filePattern = (command.size() > 2) ? command.str(2) : "*";
+        auto results = explorer.findInFiles(command.str(1), filePattern);
+        if (results.empty()) {
+            ui.displayInfo("No matches for: " + command.str(1));
+        } else {
+            for (const auto& result : results) {
+                ui.displayInfo("  " + result);
+            }
+            ui.displayInfo("Found " + to_string(results.size()) + " matching lines.");
+        }
+    } else if (cmd == "index") {
+        string action = (command.size() > 1) ? command.str(1) : "stats";
+        if (action == "build") {
+            ui.displayIndexStats(explorer.buildIndex(command.size() > 2 ? command.str(2) : ""));
+        } else if (action == "refresh") {
+            ui.displayIndexStats(explorer.refreshIndex());
+        } else if (action == "stats") {
+            ui.displayIndexStats(explorer.indexStats());
+        } else {
+            throw runtime_error("Usage: index build [path] | index refresh | index stats");
+        }
+    } else if (cmd == "du") {
+        // du [-n N] [path]
+        size_t top = 10;
+        string path;
+        for (size_t i = 1; i < command.size(); ++i) {
+            if (command[i] == "-n" && i + 1 < command.size()) {
+                top = stoul(command.str(++i));
+            } else {
+                path = command.str(i);
+            }
+        }
+        ui.displayDiskUsage(explorer.diskUsage(path, top));
+    } else if (cmd == "dupes") {
+        // dupes [--verify] [path]
+        bool verify = false;
+        string path;
+        for (size_t i = 1; i < command.size(); ++i) {
+            if (command[i] == "--verify") {
+                verify = true;
+            } else {
+                path = command.str(i);
+            }
+        }
+        ui.displayDuplicates(explorer.findDuplicates(path, verify));
+    } else if (cmd == "cat" || cmd == "head" || cmd == "tail" || cmd == "view") {
+        // cat <file> | head [-n N] <file> | tail [-n N] [-f] <file> | view <file> [line] [count]
+        uint64_t count = (cmd == "view") ? 40 : 10;
+        bool follow = false;
+        vector<string> args;
+        for (size_t i = 1; i < command.size(); ++i) {
+            if (command[i] == "-n" && i + 1 < command.size() && (cmd == "head" || cmd == "tail")) {
+                count = stoull(command.str(++i));
+            } else if (command[i] == "-f" && cmd == "tail") {
+                follow = true;
+            } else {
+                args.push_back(command.str(i));
+            }
+        }
+        if (args.empty()) {
+            throw runtime_error("Usage: cat <file> | head [-n N] <file> | tail [-n N] [-f] <file> | "
+                                "view <file> [line] [count]");
+        }
+        unique_ptr<FileViewer> viewer = explorer.openViewer(args[0]);
+        auto print = [&ui](string_view text) { ui.displayText(text); };
+        if (cmd == "cat") {
+            viewer->read(0, viewer->size(), print);
+        } else if (cmd == "head") {
+            viewer->read(0, viewer->lineOffset(count), print);
+        } else if (cmd == "tail") {
+            uint64_t from = viewer->tailOffset(count);
+            viewer->read(from, viewer->size() - from, print);
+            if (follow && interactive) {
+                ui.displayInfo("Following " + viewer->path() + " (press Enter to stop)");
+                viewer->follow(viewer->size(), print, STDIN_FILENO);
+                string rest;
+                getline(cin, rest);  // The Enter that stopped it
+            } else if (follow) {
+                // Stdin may be the script itself, so only deleting or moving the file ends this
+                viewer->follow(viewer->size(), print, -1);
+            }
+        } else {
+            uint64_t first = (args.size() > 1) ? max<uint64_t>(1, stoull(args[1])) : 1;
+            if (args.size() > 2) {
+                count = stoull(args[2]);
+            }
+            uint64_t shown = viewer->lines(first - 1, count, [&ui](uint64_t number, string_view line) {
+                ui.displayLine(number, line);
+            });
+            ui.flushOutput();
+            if (shown == 0) {
+                ui.displayInfo(viewer->path() + " has fewer than " + to_string(first) + " lines");
+            } else {
+                ui.displayInfo("Lines " + to_string(first) + "-" + to_string(first + shown - 1) +
+                               " of " + viewer->path() + " (" + to_string(viewer->size()) + " bytes)");
+            }
+        }
+    } else if (cmd == "cache") {
+        if (command.size() > 1 && command[1] == "clear") {
+            explorer.clearDirectoryCache();
+            ui.displaySuccess("Directory cache cleared");
+        } else {
+            ui.displayCacheStats(explorer.directoryCacheStats());
+        }
+    } else if (cmd == "stats") {
+        // stats [reset | trace FILE | trace off]
+        string action = (command.size() > 1) ? command.str(1) : "";
+        if (action.empty()) {
+            ui.displayMetrics(Metrics::snapshot());
+        } else if (action == "reset" && command.size() == 2) {
+            Metrics::reset();
+            ui.displaySuccess("Statistics reset");
+        } else if (action == "trace" && command.size() == 3 && command[2] == "off") {
+            string path = Metrics::stopTrace();
+            if (path.empty()) {
+                ui.displayInfo("No trace running");
+            } else {
+                ui.displaySuccess("Trace written to " + path);
+            }
+        } else if (action == "trace" && command.size() == 3) {
+            Metrics::startTrace(command.str(2));
+            ui.displaySuccess("Tracing to " + command.str(2) + " (stats trace off to finish)");
+        } else {
+            throw runtime_error("Usage: stats [reset | trace <file> | trace off]");
+        }
+    } else if (cmd == "jobs") {
+        ui.displayJobs(jobs.list());
+    } else if (cmd == "fg") {
+        unsigned id = (command.size() > 1) ? parseJobId(command.str(1)) : jobs.latest();
+        if (id == 0) {
+            throw runtime_error("No jobs");
+        }
+        foregroundJob(id, jobs, ui, interactive);
+    } else if (cmd == "cancel") {
+        if (command.size() < 2) {
+            throw runtime_error("Usage: cancel <job>");
+        }
+        unsigned id = parseJobId(command.str(1));
+        if (!jobs.cancel(id)) {
+            throw runtime_error("No running job " + to_string(id));
+        }
+        ui.displaySuccess("Cancelling [" + to_string(id) + "]");
+    } else if (cmd == "io") {
+        string backend = (command.size() > 1) ? command.str(1) : "auto";
+        ui.displaySuccess("I/O backend: " + explorer.setIoBackend(backend));
+    } else if (cmd == "pwd") {
+        ui.displayInfo("Current directory: " + explorer.getCurrentPath());
+    } else {
+        throw runtime_error("Unknown command: " + command.str(0) + " (type 'help' for available commands)");
     }
-    return tokens;
+    return true;
 }
 
-vector<string> splitCommand(const string& command) {
-    vector<string> tokens;
-    string token;
-    for (char ch : command) {
-        if (ch == ' ') {
-            if (!token.empty()) {
-                tokens.push_back(token);
-                token.clear();
+/**
+ * @brief Finishes any trace still running when main() returns
+ */
+struct TraceSession {
+    TraceSession() = default;
+    ~TraceSession() { Metrics::stopTrace(); }
+
+    TraceSession(const TraceSession&) = delete;
+    TraceSession& operator=(const TraceSession&) = delete;
+};
+
+/**
+ * @brief A path command waiting in, or finished by, a concurrent run
+ */
+struct PendingCommand {
+    CommandLine command;
+    size_t line;      ///< Line number in the script
+    string output;    ///< What the command printed while running
+    string message;   ///< Success message
+    string error;     ///< Why it failed (empty if it didn't)
+};
+
+/**
+ * @brief Run commands read from a script or pipe, without prompts or banners
+ *
+ * Runs of consecutive cp/mv/mkdir/rm/write commands whose paths don't
+ * overlap are executed together on a thread pool, so the latency of one
+ * file system call hides behind the others. Any other command, or a path
+ * command that touches a path already taken by the run, first waits for
+ * the run to finish, which keeps every command's view of the tree the same
+ * as if the script ran line by line. Output is printed in script order.
+ * @param source Name of the script, used in error messages
+ * @return Exit status: 0 if every command succeeded, 1 otherwise
+ */
+int runBatch(istream& in, const string& source, FileExplorer& explorer, UIManager& ui, JobScheduler& jobs,
+             const BatchOptions& options) {
+    // The calling thread runs commands too
+    unique_ptr<ThreadPool> pool;
+    if (options.jobs > 1) {
+        pool = make_unique<ThreadPool>(options.jobs - 1);
+    }
+
+    vector<PendingCommand> window;
+    PathClaims claims;
+    size_t failures = 0;
+
+    auto fail = [&](size_t line, const string& message) {
+        ui.displayError(source + ":" + to_string(line) + ": " + message);
+        ++failures;
+    };
+
+    auto runWindow = [&] {
+        auto run = [&](size_t i) {
+            PendingCommand& pending = window[i];
+            ostringstream output;
+            FileOperations::setThreadOutput(&output);
+            try {
+                CommandTimer timer(pending.command);
+                pending.message = runPathCommand(pending.command, explorer);
+            } catch (const exception& e) {
+                pending.error = e.what();
             }
+            FileOperations::setThreadOutput(nullptr);
+            pending.output = output.str();
+        };
+        if (pool && window.size() > 1) {
+            pool->parallelFor(window.size(), run);
         } else {
-            token += ch;
+            for (size_t i = 0; i < window.size(); ++i) {
+                run(i);
+            }
+        }
+        for (const PendingCommand& pending : window) {
+            cout << pending.output;
+            if (pending.error.empty()) {
+                ui.displaySuccess(pending.message);
+            } else {
+                fail(pending.line, pending.error);
+            }
+        }
+        window.clear();
+        claims.clear();
+    };
+
+    CommandLine command;
+    string line;
+    size_t lineNumber = 0;
+    while (!(options.stopOnError && failures > 0)) {
+        // Don't sit on a finished run while a pipe waits for its output
+        if (!window.empty() && &in == &cin && cin.rdbuf()->in_avail() <= 0) {
+            runWindow();
+            continue;
+        }
+        if (!getline(in, line)) {
+            break;
+        }
+        ++lineNumber;
+        try {
+            command.parse(line);
+        } catch (const exception& e) {
+            runWindow();  // Keeps errors in script order
+            fail(lineNumber, e.what());
+            continue;
+        }
+        if (command.empty()) {
+            continue;
+        }
+
+        if (isPathCommand(command) && !isBackground(command) && options.jobs > 1) {
+            vector<string> paths = commandPaths(command, explorer.getCurrentPath());
+            bool conflict = any_of(paths.begin(), paths.end(), [&](const string& path) {
+                return claims.conflicts(path);
+            });
+            if (conflict || window.size() == BATCH_WINDOW) {
+                runWindow();
+            }
+            for (const string& path : paths) {
+                claims.claim(path);
+            }
+            window.push_back(PendingCommand{command, lineNumber, "", "", ""});
+            continue;
+        }
+
+        // Everything else runs alone, once the commands before it are done
+        runWindow();
+        if (options.stopOnError && failures > 0) {
+            break;
+        }
+        try {
+            CommandTimer timer(command);
+            if (!runCommand(command, explorer, ui, jobs, false)) {
+                break;
+            }
+        } catch (const exception& e) {
+            fail(lineNumber, e.what());
         }
     }
-    if (!token.empty()) {
-        tokens.push_back(token);
+    runWindow();
+
+    // A script's background jobs finish before it does
+    for (const JobInfo& job : jobs.list()) {
+        while (!jobs.wait(job.id, JOB_PROGRESS_INTERVAL)) {
+            // No terminal to show progress on
+        }
+        if (reportJob(job.id, jobs, ui) == JobState::Failed) {
+            ++failures;
+        }
     }
-    return tokens;
+    cout.flush();
+    return failures > 0 ? 1 : 0;
 }
 
-int main() {
+} // namespace
+
+int main(int argc, char* argv[]) {
+    // [-b|--batch] [-e] [-j N] [--trace FILE] [script|-]; batch mode is also used when stdin is not a terminal
+    BatchOptions batch;
+    bool batchMode = !isatty(STDIN_FILENO);
+    string script;
+    string trace;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "-b" || arg == "--batch") {
+            batchMode = true;
+        } else if (arg == "-e") {
+            batch.stopOnError = true;
+        } else if (arg == "-j" && i + 1 < argc) {
+            batch.jobs = static_cast<unsigned>(max(1, atoi(argv[++i])));
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace = argv[++i];
+        } else if (arg == "-" || arg[0] != '-') {
+            script = arg;
+            batchMode = true;
+        } else {
+            cerr << "Usage: " << argv[0] << " [-b|--batch] [-e] [-j jobs] [--trace file] [script|-]" << endl;
+            return 2;
+        }
+    }
+
+    TraceSession session;
+    if (!trace.empty()) {
+        try {
+            Metrics::startTrace(trace);
+        } catch (const exception& e) {
+            cerr << e.what() << endl;
+            return 2;
+        }
+    }
+
+    if (batchMode) {
+        // Nothing else reads stdin, and scripts can be long
+        ios::sync_with_stdio(false);
+    }
+
     UIManager ui;
     FileExplorer explorer;
-    string command;
-    
+    JobScheduler jobs;
+
+    if (batchMode) {
+        ui.setInteractive(false);
+        explorer.setInteractive(false);
+        if (script.empty() || script == "-") {
+            return runBatch(cin, "stdin", explorer, ui, jobs, batch);
+        }
+        ifstream file(script);
+        if (!file) {
+            cerr << "Cannot open " << script << ": " << strerror(errno) << endl;
+            return 2;
+        }
+        return runBatch(file, script, explorer, ui, jobs, batch);
+    }
+
     // Show welcome message
     ui.displayWelcomeMessage();
-    
+
+    CommandLine command;
     while (true) {
+        reportFinishedJobs(jobs, ui);
+
         // Show current directory
         ui.displayCurrentDirectory(explorer.getCurrentPath());
-        
+
         // Get user command using UIManager
-        command = ui.getUserInput("Command: ");
-        
-        if (command.empty()) continue;
-        
-        vector<string> tokens = splitCommand(command);
-        if (tokens.empty()) continue;
-        
-        string cmd = tokens[0];
-        
+        string input = ui.getUserInput("Command: ");
+        if (!cin) {
+            break;  // End of input
+        }
+
         try {
-            if (cmd == "exit") {
-                if (ui.confirmAction("Are you sure you want to exit?")) {
-                    ui.displayInfo("Goodbye!");
-                    break;
-                }
-            } else if (cmd == "help") {
-                ui.displayHelp();
-            } else if (cmd == "ls") {
-                string path = (tokens.size() > 1) ? tokens[1] : ".";
-                auto files = explorer.listDirectory(path);
-                for (const auto& file : files) {
-                    ui.displayFileInfo(file);
-                }
-            } else if (cmd == "cd") {
-                if (tokens.size() < 2) {
-                    ui.displayError("Usage: cd <directory>");
-                } else {
-                    if (explorer.changeDirectory(tokens[1])) {
-                        ui.displaySuccess("Changed directory to: " + explorer.getCurrentPath());
-                    } else {
-                        ui.displayError("Failed to change directory");
-                    }
-                }
-            } else if (cmd == "mkdir") {
-                if (tokens.size() < 2) {
-                    ui.displayError("Usage: mkdir <directory_name>");
-                } else {
-                    if (explorer.createDirectory(tokens[1])) {
-                        ui.displaySuccess("Directory created: " + tokens[1]);
-                    } else {
-                        ui.displayError("Failed to create directory");
-                    }
-                }
-            } else if (cmd == "rm") {
-                if (tokens.size() < 2) {
-                    ui.displayError("Usage: rm <file_or_directory>");
-                } else {
-                    if (ui.confirmAction("Are you sure you want to delete " + tokens[1] + "?")) {
-                        if (explorer.remove(tokens[1])) {
-                            ui.displaySuccess("Removed: " + tokens[1]);
-                        } else {
-                            ui.displayError("Failed to remove " + tokens[1]);
-                        }
-                    }
-                }
-            } else if (cmd == "cp") {
-                if (tokens.size() < 3) {
-                    ui.displayError("Usage: cp <source> <destination>");
-                } else {
-                    if (explorer.copyFile(tokens[1], tokens[2])) {
-                        ui.displaySuccess("Copied to: " + tokens[2]);
-                    } else {
-                        ui.displayError("Failed to copy file");
-                    }
-                }
-            } else if (cmd == "mv") {
-                if (tokens.size() < 3) {
-                    ui.displayError("Usage: mv <source> <destination>");
-                } else {
-                    if (explorer.moveFile(tokens[1], tokens[2])) {
-                        ui.displaySuccess("Moved to: " + tokens[2]);
-                    } else {
-                        ui.displayError("Failed to move file");
-                    }
-                }
-            } else if (cmd == "find") {
-                if (tokens.size() < 2) {
-                    ui.displayError("Usage: find <filename>");
-                } else {
-                    auto results = explorer.searchFile(tokens[1]);
-                    if (results.empty()) {
-                        ui.displayInfo("No files found matching: " + tokens[1]);
-                    } else {
-                        ui.displayInfo("Found " + to_string(results.size()) + " results:");
-                        for (const auto& result : results) {
-                            ui.displayInfo("  " + result);
-                        }
-                    }
-                }
-            } else if (cmd == "pwd") {
-                ui.displayInfo("Current directory: " + explorer.getCurrentPath());
-            } else {
-                ui.displayError("Unknown command: " + cmd + " (type 'help' for available commands)");
+            command.parse(input);
+            if (command.empty()) {
+                continue;
+            }
+            CommandTimer timer(command);
+            if (!runCommand(command, explorer, ui, jobs, true)) {
+                break;
             }
         } catch (const exception& e) {
             cerr << "Error: " << e.what() << endl;
         }
     }
-    
+
     cout << "Exiting Linux File Explorer. Goodbye!" << endl;
     return 0;
 }
\ No newline at end of file
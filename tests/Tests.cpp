@@ -0,0 +1,922 @@
+#include "CommandLine.h"
+#include "GlobMatcher.h"
+#include "PathBatch.h"
+#include "FileWriter.h"
+#include "DirectoryCache.h"
+#include "FileOperations.h"
+#include "FileIndex.h"
+#include "TreeDeleter.h"
+#include "ParallelWalker.h"
+#include "ContentSearcher.h"
+#include "FileViewer.h"
+#include "FileMover.h"
+#include "ListingSorter.h"
+#include "Metrics.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <random>
+#include <set>
+#include <filesystem>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @brief A failed CHECK: stops the test it is in
+ */
+struct CheckFailed : runtime_error {
+    using runtime_error::runtime_error;
+};
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            throw CheckFailed(string(__FILE__) + ":" + to_string(__LINE__) + ": CHECK(" #condition ") failed"); \
+        } \
+    } while (0)
+
+/**
+ * @brief Scratch directory for one test, removed afterwards
+ */
+class Scratch {
+public:
+    Scratch() {
+        string pattern = (fs::temp_directory_path() / "fe-tests-XXXXXX").string();
+        if (!mkdtemp(pattern.data())) {
+            throw runtime_error("Cannot create a scratch directory in " + fs::temp_directory_path().string());
+        }
+        root = pattern;
+    }
+
+    ~Scratch() {
+        error_code ec;
+        fs::remove_all(root, ec);
+    }
+
+    /**
+     * @brief Create a file (and its parent directories) below the root
+     */
+    string touch(const string& relative, const string& text = "") const {
+        fs::path path = fs::path(root) / relative;
+        fs::create_directories(path.parent_path());
+        ofstream(path) << text;
+        return path.string();
+    }
+
+    string read(const string& relative) const {
+        ifstream in(fs::path(root) / relative);
+        return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+
+    bool exists(const string& relative) const {
+        return fs::exists(fs::symlink_status(fs::path(root) / relative));
+    }
+
+    string root;
+};
+
+/**
+ * @brief Names a batch targets, sorted, relative to their group's directory
+ */
+vector<string> targetNames(const PathBatch& batch) {
+    vector<string> names;
+    for (const PathGroup& group : batch.groups()) {
+        names.insert(names.end(), group.names.begin(), group.names.end());
+    }
+    sort(names.begin(), names.end());
+    return names;
+}
+
+void testQuotedGlobCharacters() {
+    CommandLine command;
+    command.parse("rm \"x[12].log\" a\\*b 'c?d' x[12].log");
+    CHECK(command.str(1) == "x[12].log");
+    CHECK(command.pattern(1) == "x\\[12\\].log");
+    CHECK(command.str(2) == "a*b");
+    CHECK(command.pattern(2) == "a\\*b");
+    CHECK(command.pattern(3) == "c\\?d");
+    CHECK(command.pattern(4) == "x[12].log");
+    CHECK(!GlobMatcher::hasWildcards(command.pattern(1)));
+    CHECK(GlobMatcher::hasWildcards(command.pattern(4)));
+}
+
+void testBracketedFileName() {
+    Scratch scratch;
+    scratch.touch("x1.log");
+    scratch.touch("x2.log");
+    scratch.touch("x[12].log");
+    scratch.touch("a*b");
+    scratch.touch("aXb");
+
+    CommandLine command;
+    command.parse("rm \"x[12].log\" a\\*b");
+    PathBatch quoted = PathBatch::expand({command.pattern(1), command.pattern(2)}, scratch.root, 1);
+    CHECK((targetNames(quoted) == vector<string>{"a*b", "x[12].log"}));
+
+    BatchStats stats = quoted.remove(1, false);
+    CHECK(stats.errors == 0);
+    CHECK(!scratch.exists("x[12].log"));
+    CHECK(!scratch.exists("a*b"));
+    CHECK(scratch.exists("x1.log"));
+    CHECK(scratch.exists("x2.log"));
+    CHECK(scratch.exists("aXb"));
+
+    // Unquoted, the same word is a class matching both numbered files
+    command.parse("rm x[12].log");
+    PathBatch globbed = PathBatch::expand({command.pattern(1)}, scratch.root, 1);
+    CHECK((targetNames(globbed) == vector<string>{"x1.log", "x2.log"}));
+}
+
+void testSameNameSourcesRefused() {
+    Scratch scratch;
+    scratch.touch("a/x", "from a");
+    scratch.touch("b/x", "from b");
+    fs::create_directory(scratch.root + "/dst");
+
+    PathBatch batch = PathBatch::expand({"a/x", "b/x"}, scratch.root, 1);
+    for (bool move : {true, false}) {
+        bool refused = false;
+        try {
+            if (move) {
+                batch.moveInto(scratch.root + "/dst", TreeCopyOptions(), 1);
+            } else {
+                batch.copyInto(scratch.root + "/dst", TreeCopyOptions());
+            }
+        } catch (const runtime_error& e) {
+            refused = string(e.what()).find("to the same name") != string::npos;
+        }
+        CHECK(refused);
+    }
+    CHECK(scratch.read("a/x") == "from a");
+    CHECK(scratch.read("b/x") == "from b");
+    CHECK(fs::is_empty(scratch.root + "/dst"));
+
+    // Distinct names still go through, and a name that was there before is replaced
+    scratch.touch("dst/x", "old");
+    PathBatch single = PathBatch::expand({"a/x"}, scratch.root, 1);
+    BatchStats stats = single.moveInto(scratch.root + "/dst", TreeCopyOptions(), 1);
+    CHECK(stats.errors == 0 && stats.done == 1);
+    CHECK(scratch.read("dst/x") == "from a");
+    for (const string& leftover : stats.leftovers) {
+        fs::remove_all(leftover);
+    }
+}
+
+void testGlobBelowBracketedDirectory() {
+    Scratch scratch;
+    scratch.touch("d[1]/in.log");
+    scratch.touch("d[1]/in.txt");
+    scratch.touch("d1/other.log");
+
+    PathBatch batch = PathBatch::expand({"*.log"}, scratch.root + "/d[1]", 1);
+    CHECK((targetNames(batch) == vector<string>{"in.log"}));
+    CHECK(batch.groups()[0].directory == scratch.root + "/d[1]");
+}
+
+void testGlobStarMatchesNoDirectory() {
+    GlobMatcher any("**/*.tmp");
+    CHECK(any.matches("top.tmp"));
+    CHECK(any.matches("s/deep.tmp"));
+    CHECK(any.matches("s/t/deeper.tmp"));
+    CHECK(!any.matches("top.txt"));
+
+    GlobMatcher middle("a/**/b");
+    CHECK(middle.matches("a/b"));
+    CHECK(middle.matches("a/x/b"));
+    CHECK(middle.matches("a/x/y/b"));
+    CHECK(!middle.matches("ab"));
+    CHECK(!middle.matches("a/xb"));
+
+    // 64 tokens and more take the wide automaton, which must agree
+    string name(70, 'n');
+    GlobMatcher wide("a/**/" + name + "?");
+    CHECK(wide.matches("a/" + name + "x"));
+    CHECK(wide.matches("a/x/y/" + name + "x"));
+    CHECK(!wide.matches("a/x" + name + "x"));
+
+    // Not a whole component: still any run of characters
+    GlobMatcher inside("a**/b");
+    CHECK(inside.matches("ax/b"));
+    CHECK(!inside.matches("b"));
+
+    Scratch scratch;
+    scratch.touch("top.tmp");
+    scratch.touch("s/deep.tmp");
+    scratch.touch("s/keep.txt");
+    PathBatch batch = PathBatch::expand({"**/*.tmp"}, scratch.root, 1);
+    CHECK((targetNames(batch) == vector<string>{"deep.tmp", "top.tmp"}));
+}
+
+void testWriteThroughLinks() {
+    Scratch scratch;
+    string real = scratch.touch("real", "old");
+    fs::create_symlink("real", scratch.root + "/link");
+    string first = scratch.touch("first", "old");
+    fs::create_hard_link(first, scratch.root + "/second");
+    fs::create_symlink("missing", scratch.root + "/dangling");
+
+    FileWriter::writeFile(scratch.root + "/link", "new");
+    CHECK(fs::is_symlink(scratch.root + "/link"));
+    CHECK(scratch.read("real") == "new");
+
+    FileWriter::writeFile(scratch.root + "/second", "new");
+    CHECK(fs::equivalent(first, scratch.root + "/second"));
+    CHECK(scratch.read("first") == "new");
+
+    WriteOptions backup;
+    backup.backup = true;
+    FileWriter::writeFile(scratch.root + "/second", "newer", backup);
+    CHECK(fs::hard_link_count(first) == 2);
+    CHECK(scratch.read("first") == "newer");
+    CHECK(scratch.read("second~") == "new");
+
+    FileWriter::writeFile(scratch.root + "/dangling", "created");
+    CHECK(fs::is_symlink(scratch.root + "/dangling"));
+    CHECK(scratch.read("missing") == "created");
+}
+
+void testWriteKeepsAttributes() {
+    Scratch scratch;
+    string path = scratch.touch("plain", "old");
+    chmod(path.c_str(), 0600);
+    bool tagged = setxattr(path.c_str(), "user.tag", "keep", 4, 0) == 0;  // Not every file system has user xattrs
+
+    FileWriter::writeFile(path, "new");
+    CHECK(scratch.read("plain") == "new");
+    CHECK((fs::status(path).permissions() & fs::perms::all) == (fs::perms::owner_read | fs::perms::owner_write));
+    if (tagged) {
+        char value[8] = {};
+        CHECK(getxattr(path.c_str(), "user.tag", value, sizeof(value)) == 4);
+        CHECK(string(value) == "keep");
+    }
+}
+
+/**
+ * @brief Row of a listing by name (npos if absent)
+ */
+size_t rowOf(const FileInfoBatch& files, const string& name) {
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (files.name(i) == name) {
+            return i;
+        }
+    }
+    return string::npos;
+}
+
+void testCachedSubdirectoryTimes() {
+    Scratch scratch;
+    scratch.touch("sub/old.txt");
+    scratch.touch("file.txt");
+    string sub = scratch.root + "/sub";
+    struct timespec past[2] = {{1577836800, 0}, {1577836800, 0}};  // 2020-01-01
+    CHECK(utimensat(AT_FDCWD, sub.c_str(), past, 0) == 0);
+
+    DirectoryCache cache(LIST_ALL);
+    CHECK(cache.find(scratch.root) == nullptr);
+    FileInfoBatch listing(LIST_ALL, scratch.root);
+    DirectoryReader(LIST_ALL).read(scratch.root, [&](const FileInfoBatch& batch) { listing.append(batch); });
+    cache.insert(scratch.root, std::move(listing));
+
+    const FileInfoBatch* cached = cache.find(scratch.root);
+    CHECK(cached != nullptr);
+    CHECK(cached->modifiedTime(rowOf(*cached, "sub")) == 1577836800);
+
+    // Only the subdirectory's own contents change; the parent's watch hears nothing
+    scratch.touch("sub/new.txt");
+    cached = cache.find(scratch.root);
+    CHECK(cached != nullptr);
+    CHECK(cache.stats().hits == 2);
+    CHECK(cached->modifiedTime(rowOf(*cached, "sub")) > 1577836800);
+
+    // Entries of the directory itself still go through patch()
+    scratch.touch("added.txt");
+    cached = cache.find(scratch.root);
+    CHECK(cached != nullptr);
+    CHECK(rowOf(*cached, "added.txt") != string::npos);
+}
+
+/**
+ * @brief inotify watches held by this process, from /proc
+ */
+size_t inotifyWatchCount() {
+    size_t count = 0;
+    for (const auto& entry : fs::directory_iterator("/proc/self/fdinfo")) {
+        ifstream info(entry.path());
+        for (string line; getline(info, line);) {
+            count += line.rfind("inotify wd:", 0) == 0 ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Read a directory and hand the listing to the cache after a miss
+ */
+void cacheListing(DirectoryCache& cache, const string& dir) {
+    CHECK(cache.find(dir) == nullptr);
+    FileInfoBatch listing(LIST_ALL, dir);
+    DirectoryReader(LIST_ALL).read(dir, [&](const FileInfoBatch& batch) { listing.append(batch); });
+    cache.insert(dir, std::move(listing));
+}
+
+void testCacheHitsDoNotStatSubdirectories() {
+    Scratch scratch;
+    for (int i = 0; i < 50; ++i) {
+        scratch.touch("d" + to_string(i) + "/file");
+    }
+    DirectoryCache cache(LIST_ALL);
+    cacheListing(cache, scratch.root);
+
+    uint64_t before = Metrics::snapshot().syscalls[static_cast<size_t>(Syscall::Stat)];
+    for (int i = 0; i < 10; ++i) {
+        CHECK(cache.find(scratch.root) != nullptr);
+    }
+    CHECK(Metrics::snapshot().syscalls[static_cast<size_t>(Syscall::Stat)] == before);
+
+    // A subdirectory created after caching is watched as well
+    struct timespec past[2] = {{1577836800, 0}, {1577836800, 0}};  // 2020-01-01
+    fs::create_directory(scratch.root + "/late");
+    CHECK(utimensat(AT_FDCWD, (scratch.root + "/late").c_str(), past, 0) == 0);
+    const FileInfoBatch* cached = cache.find(scratch.root);
+    CHECK(cached != nullptr && cached->modifiedTime(rowOf(*cached, "late")) == 1577836800);
+    scratch.touch("late/inner");
+    cached = cache.find(scratch.root);
+    CHECK(cached != nullptr && cached->modifiedTime(rowOf(*cached, "late")) > 1577836800);
+}
+
+void testRenamedCachedDirectoryDropsWatch() {
+    Scratch scratch;
+    scratch.touch("d/file");
+    DirectoryCache cache(LIST_ALL);
+    size_t before = inotifyWatchCount();
+    cacheListing(cache, scratch.root + "/d");
+    CHECK(cache.stats().directories == 1);
+    size_t watched = inotifyWatchCount();
+    CHECK(watched > before);
+
+    // The kernel keeps watching a renamed directory; the cache must let go of it
+    fs::rename(scratch.root + "/d", scratch.root + "/e");
+    CHECK(cache.find(scratch.root) == nullptr);
+    CHECK(cache.stats().directories == 0);
+    CHECK(cache.stats().invalidations == 1);
+    CHECK(inotifyWatchCount() == before + 1);  // Only the watch of the miss just made
+}
+
+/**
+ * @brief Paths found by FileOperations::findFiles, relative to root and sorted
+ */
+vector<string> foundBelow(const FileOperations& ops, const string& pattern, const string& root) {
+    vector<string> found;
+    for (const string& path : ops.findFiles(pattern)) {
+        found.push_back(path.substr(root.size() + 1));
+    }
+    sort(found.begin(), found.end());
+    return found;
+}
+
+/**
+ * @brief Puts index files below a scratch directory, not the real cache, and messages nowhere
+ */
+struct IndexEnvironment {
+    string cache;
+    bool hadCache;
+    ostringstream sink;
+
+    explicit IndexEnvironment(const string& scratchCache) {
+        const char* previous = getenv("XDG_CACHE_HOME");
+        hadCache = previous != nullptr;
+        cache = previous ? previous : "";
+        setenv("XDG_CACHE_HOME", scratchCache.c_str(), 1);
+        FileOperations::setThreadOutput(&sink);
+    }
+
+    ~IndexEnvironment() {
+        FileOperations::setThreadOutput(nullptr);
+        if (hadCache) {
+            setenv("XDG_CACHE_HOME", cache.c_str(), 1);
+        } else {
+            unsetenv("XDG_CACHE_HOME");
+        }
+    }
+};
+
+void testStaleIndex() {
+    Scratch scratch;
+    scratch.touch("tree/a.log");
+    scratch.touch("tree/sub/b.log");
+    string root = scratch.root + "/tree";
+    IndexEnvironment environment(scratch.root + "/cache");
+
+    {
+        FileOperations ops(root);
+        ops.setInteractive(false);
+        ops.buildIndex();
+        CHECK((foundBelow(ops, "*.log", root) == vector<string>{"a.log", "sub/b.log"}));
+
+        // Created and deleted after the build: the next query must see both
+        scratch.touch("tree/sub/c.log");
+        fs::remove(root + "/a.log");
+        CHECK((foundBelow(ops, "*.log", root) == vector<string>{"sub/b.log", "sub/c.log"}));
+    }
+    {
+        // A corrupt index file means a live walk, not a failed find
+        ofstream(FileIndex::indexPathFor(root), ios::trunc) << "not an index";
+        FileOperations ops(root);
+        ops.setInteractive(false);
+        CHECK((foundBelow(ops, "*.log", root) == vector<string>{"sub/b.log", "sub/c.log"}));
+        CHECK(environment.sink.str().find("Ignoring index") != string::npos);
+    }
+}
+
+void testCorruptIndexRecords() {
+    Scratch scratch;
+    // More than one path restart point, and names in several directories
+    for (int i = 0; i < 20; ++i) {
+        scratch.touch("tree/dir" + to_string(i) + "/file" + to_string(i) + ".log");
+    }
+    string root = scratch.root + "/tree";
+    IndexEnvironment environment(scratch.root + "/cache");
+    FileIndex::build(root, 1);
+    string path = FileIndex::indexPathFor(root);
+    string original;
+    {
+        ifstream in(path, ios::binary);
+        original.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    CHECK(original.size() > 64);
+
+    // Every record field set out of range in turn (the magic excepted): the
+    // index must either be refused on load or answer queries without
+    // reading outside the file
+    size_t refused = 0;
+    for (size_t offset = 8; offset + 4 <= original.size(); offset += 4) {
+        string damaged = original;
+        memset(&damaged[offset], 0xff, 4);
+        ofstream(path, ios::binary | ios::trunc) << damaged;
+        unique_ptr<FileIndex> index;
+        try {
+            index = FileIndex::open(root);
+        } catch (const runtime_error&) {
+            refused++;
+            continue;
+        }
+        if (!index) {
+            continue;  // Root path no longer matches
+        }
+        auto ignore = [](string&&, unsigned char) {};
+        index->covers(root + "/dir7");
+        index->findSubstring(root, "file1", ignore);
+        index->findSubstring(root, "e", ignore);
+        index->findSubstring(root + "/dir3", "log", ignore);
+        index->changedDirectories(root, 1);
+    }
+    CHECK(refused > 0);
+}
+
+void testTreeDeleterRemovesRelativeToHandles() {
+    Scratch scratch;
+    // Wider than one unlink batch, and a few levels deep
+    for (int i = 0; i < 300; ++i) {
+        fs::create_directories(scratch.root + "/tree/wide/d" + to_string(i));
+    }
+    scratch.touch("tree/deep/a/b/c/d/file");
+    scratch.touch("outside/keep");
+    fs::create_directory_symlink(scratch.root + "/outside", scratch.root + "/tree/link");
+
+    DeleteStats stats = TreeDeleter(2).remove(scratch.root + "/tree");
+    CHECK(stats.errors == 0);
+    CHECK(stats.directories == 1 + 1 + 300 + 5);  // tree, wide and its children, deep/a/b/c/d
+    CHECK(stats.files == 2);                        // file and the symlink itself
+    CHECK(!scratch.exists("tree"));
+    CHECK(scratch.exists("outside/keep"));
+}
+
+void testTreeDeleterSplitsSubtrees() {
+    Scratch scratch;
+    // Uneven subtrees, so some are split further and some are handed out whole
+    size_t dirs = 1;
+    for (int i = 0; i < 12; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            scratch.touch("tree/s" + to_string(i) + "/t" + to_string(j) + "/u/file");
+            dirs += 2;
+        }
+        dirs += 1;
+    }
+    DeleteStats stats = TreeDeleter(4).remove(scratch.root + "/tree");
+    CHECK(stats.errors == 0);
+    CHECK(stats.directories == dirs);
+    CHECK(stats.files == 78);
+    CHECK(!scratch.exists("tree"));
+}
+
+void testTrashNeverReplaces() {
+    Scratch scratch;
+    scratch.touch("d/file", "new");
+    // Trash names are "<name>-<pid>-<counter>"; squat on the next ones this process may pick
+    string prefix = scratch.root + "/.trash-d-" + to_string(getpid()) + "-";
+    for (int i = 0; i < 80; ++i) {
+        scratch.touch(".trash-d-" + to_string(getpid()) + "-" + to_string(i) + "/file", "old");
+    }
+    string trash = TreeDeleter::moveToTrash(scratch.root + "/d");
+    CHECK(trash.compare(0, prefix.size(), prefix) == 0);
+    CHECK(stoi(trash.substr(prefix.size())) >= 80);
+    CHECK(scratch.read(trash.substr(scratch.root.size() + 1) + "/file") == "new");
+    for (int i = 0; i < 80; ++i) {
+        CHECK(scratch.read(".trash-d-" + to_string(getpid()) + "-" + to_string(i) + "/file") == "old");
+    }
+}
+
+/**
+ * @brief Threads of this process, from /proc
+ */
+size_t threadCount() {
+    size_t count = 0;
+    for (auto it = fs::directory_iterator("/proc/self/task"); it != fs::directory_iterator(); ++it) {
+        count++;
+    }
+    return count;
+}
+
+void testBackgroundDeletesShareOneWorker() {
+    Scratch scratch;
+    for (int i = 0; i < 40; ++i) {
+        scratch.touch("d" + to_string(i) + "/a/file");
+    }
+    ostringstream sink;
+    FileOperations::setThreadOutput(&sink);
+    size_t before = threadCount();
+    {
+        FileOperations ops(scratch.root);
+        ops.setInteractive(false);
+        ops.setSearchThreads(1);
+        for (int i = 0; i < 40; ++i) {
+            CHECK(ops.remove("d" + to_string(i), true));
+        }
+        // The worker, its walker and perhaps a lazily started I/O pool; not one thread per delete
+        CHECK(threadCount() < before + 20);
+    }
+    FileOperations::setThreadOutput(nullptr);
+    // The destructor waited for the queue, so nothing is left, trash included
+    CHECK(fs::is_empty(scratch.root));
+}
+
+void testWalkerReportsUnreadableDirectories() {
+    Scratch scratch;
+    scratch.touch("keep/file");
+    fs::create_directories(scratch.root + "/gone/below");
+
+    // Removing a directory between its visit and its opening fails the same
+    // way EACCES or EMFILE would, and works when the tests run as root
+    ParallelWalker walker(2);
+    size_t files = 0;
+    walker.walk(scratch.root, [&](const WalkEntry& entry) {
+        if (strcmp(entry.name, "gone") == 0) {
+            fs::remove_all(entry.path());
+        }
+        if (entry.type == DT_REG) {
+            walker.emit(entry.path());
+        }
+        return entry.type == DT_DIR;
+    }, [&](string&&) {
+        files++;
+    });
+    CHECK(files == 1);
+    CHECK(walker.unreadableDirectories() == 1);
+    CHECK(walker.firstError() == scratch.root + "/gone: " + strerror(ENOENT));
+
+    // A second walk starts from a clean slate
+    walker.walk(scratch.root, [](const WalkEntry& entry) { return entry.type == DT_DIR; });
+    CHECK(walker.unreadableDirectories() == 0);
+    CHECK(walker.firstError().empty());
+}
+
+void testWalkerResultHandlerThrows() {
+    Scratch scratch;
+    for (int i = 0; i < 200; ++i) {
+        scratch.touch("d" + to_string(i % 20) + "/f" + to_string(i));
+    }
+    ParallelWalker walker(4);
+    bool caught = false;
+    try {
+        walker.walk(scratch.root, [&](const WalkEntry& entry) {
+            if (entry.type == DT_REG) {
+                walker.emit(entry.path());
+            }
+            return entry.type == DT_DIR;
+        }, [](string&&) {
+            throw runtime_error("stop");
+        });
+    } catch (const runtime_error& e) {
+        caught = string(e.what()) == "stop";
+    }
+    // Getting here at all means the workers were joined rather than std::terminate()d
+    CHECK(caught);
+}
+
+void testContentSearchAcrossChunks() {
+    Scratch scratch;
+    // Files are read 1 MB at a time; lines longer than that are scanned piecewise
+    const size_t chunk = 1024 * 1024;
+    string text;
+    vector<pair<size_t, size_t>> expected;  // (line, offset) of every reported hit
+    size_t line = 1;
+    auto add = [&](const string& piece, size_t hit = string::npos) {
+        if (hit != string::npos) {
+            expected.emplace_back(line, text.size() + hit);
+        }
+        text += piece;
+        line += count(piece.begin(), piece.end(), '\n');
+    };
+    for (int i = 0; i < 60000; ++i) {
+        string piece = "line " + to_string(i) + (i % 7919 == 0 ? " needle here\n" : " nothing here\n");
+        add(piece, i % 7919 == 0 ? piece.find("needle") : string::npos);
+    }
+    // A long line whose hit straddles a read boundary, with a second hit that must not be reported
+    string longLine(3 * chunk - 3 - text.size(), 'x');
+    size_t straddling = longLine.size();
+    longLine += "needle" + string(chunk, 'y') + "needle\n";
+    add(longLine, straddling);
+    add("after the long line: needle\n", 21);
+    add(string(chunk + chunk / 2, 'z') + "needle\n", chunk + chunk / 2);
+    add("needle at the end", 0);
+    scratch.touch("big.log", text);
+
+    vector<ContentMatch> matches = ContentSearcher("needle", 2).searchTree(scratch.root, GlobMatcher("*"));
+    CHECK(matches.size() == expected.size());
+    for (size_t i = 0; i < matches.size(); ++i) {
+        CHECK(matches[i].line == expected[i].first);
+        CHECK(matches[i].offset == expected[i].second);
+    }
+}
+
+void testViewerSurvivesTruncation() {
+    Scratch scratch;
+    string path = scratch.touch("log", string(3 * 1024 * 1024, 'a'));
+    FileViewer viewer(path);
+    CHECK(truncate(path.c_str(), 100) == 0);
+
+    // Still believes the old size: a mapped window would have raised SIGBUS here
+    bool failed = false;
+    try {
+        viewer.read(2 * 1024 * 1024, 1024, [](string_view) {});
+    } catch (const runtime_error&) {
+        failed = true;
+    }
+    CHECK(failed);
+    CHECK(viewer.refresh());
+    CHECK(viewer.size() == 100);
+    CHECK(viewer.lineCount() == 1);
+}
+
+void testMoveExchangesWithDestination() {
+    Scratch scratch;
+    string source = scratch.touch("src/report", "new");
+    string destination = scratch.touch("dst/report", "old");
+
+    bool refused = false;
+    try {
+        FileMover().move(source, destination, false);
+    } catch (const runtime_error&) {
+        refused = true;
+    }
+    CHECK(refused);
+    CHECK(scratch.read("src/report") == "new");
+    CHECK(scratch.read("dst/report") == "old");
+
+    MoveResult result = FileMover().move(source, destination, true);
+    CHECK(result.strategy == MoveStrategy::Exchange);
+    CHECK(!scratch.exists("src/report"));
+    CHECK(scratch.read("dst/report") == "new");
+    // The old destination is parked, not deleted, and never left at the source's name
+    CHECK(!result.replaced.empty() && result.replaced != source);
+    CHECK(fs::path(result.replaced).filename().string()[0] == '.');
+    ifstream parked(result.replaced);
+    CHECK(string(istreambuf_iterator<char>(parked), istreambuf_iterator<char>()) == "old");
+
+    // A directory in the way is swapped out whole
+    scratch.touch("tree/a/one", "1");
+    scratch.touch("busy/b/two", "2");
+    result = FileMover().move(scratch.root + "/tree", scratch.root + "/busy", true);
+    CHECK(result.strategy == MoveStrategy::Exchange);
+    CHECK(scratch.read("busy/a/one") == "1");
+    CHECK(!scratch.exists("busy/b"));
+    CHECK(fs::exists(fs::path(result.replaced) / "b" / "two"));
+}
+
+void testMoveOntoItselfRefused() {
+    Scratch scratch;
+    string path = scratch.touch("data", "keep");
+    string link = scratch.root + "/alias";
+    CHECK(::link(path.c_str(), link.c_str()) == 0);
+
+    // Both names are one inode: exchanging and parking one would drop a name of the file
+    for (const string& destination : {path, link}) {
+        bool refused = false;
+        try {
+            FileMover().move(path, destination, true);
+        } catch (const runtime_error& e) {
+            refused = strstr(e.what(), "same file") != nullptr;
+        }
+        CHECK(refused);
+    }
+    CHECK(scratch.read("data") == "keep");
+    CHECK(scratch.read("alias") == "keep");
+    size_t entries = distance(fs::directory_iterator(scratch.root), fs::directory_iterator());
+    CHECK(entries == 2);
+}
+
+void testMoveAcrossFileSystems() {
+    // Needs a second file system; /dev/shm is tmpfs on most Linux systems
+    string pattern = "/dev/shm/fe-tests-XXXXXX";
+    if (!mkdtemp(pattern.data())) {
+        return;
+    }
+    Scratch scratch;
+    struct stat here, there;
+    bool crosses = stat(scratch.root.c_str(), &here) == 0 && stat(pattern.c_str(), &there) == 0 &&
+                   here.st_dev != there.st_dev;
+    try {
+        if (crosses) {
+            scratch.touch("tree/a/one", "1");
+            scratch.touch("tree/two", string(100000, 'x'));
+            string destination = pattern + "/tree";
+            MoveResult result = FileMover(TreeCopyOptions(), 2).move(scratch.root + "/tree", destination, false);
+            CHECK(result.strategy == MoveStrategy::Copy);
+            CHECK(result.files == 2);
+            CHECK(result.sourceErrors == 0);
+            CHECK(!scratch.exists("tree"));
+            CHECK(fs::file_size(destination + "/two") == 100000);
+            CHECK(fs::exists(destination + "/a/one"));
+            // Nothing staged is left next to the destination
+            size_t entries = distance(fs::directory_iterator(pattern), fs::directory_iterator());
+            CHECK(entries == 1);
+        }
+    } catch (...) {
+        error_code ec;
+        fs::remove_all(pattern, ec);
+        throw;
+    }
+    error_code ec;
+    fs::remove_all(pattern, ec);
+}
+
+/**
+ * @brief Names of a listing in the order a sorter puts them
+ */
+vector<string> sortedNames(const vector<string>& names, SortKey key, unsigned threads = 1) {
+    FileInfoBatch batch(LIST_NAME);
+    for (const string& name : names) {
+        batch.append(name, DT_REG);
+    }
+    vector<string> sorted;
+    for (uint32_t row : ListingSorter(SortOptions{key, false, threads}).order(batch)) {
+        sorted.emplace_back(batch.name(row));
+    }
+    return sorted;
+}
+
+/**
+ * @brief Distinct names that share prefixes at many depths, in random order
+ */
+vector<string> mixedNames(size_t count, unsigned seed) {
+    mt19937 random(seed);
+    const vector<string> stems = {"file", "File", "file.tar", "img_", "v", "report-2024-", "\xc3\xa9t\xc3\xa9",
+                                  ".hidden", "a", "0"};
+    set<string> names = {"file07", "file7", "file007", "file0", "file00", "file", "file.", "file.c"};
+    // Names agreeing on their first 240 bytes, and names whose natural keys
+    // agree past the 255 bytes a key keeps ("1a" grows to four key bytes)
+    string repeated;
+    for (int i = 0; i < 100; ++i) {
+        repeated += "1a";
+    }
+    for (size_t i = 0; i < 200; ++i) {
+        names.insert(string(240, 'x') + to_string(random() % 100000));
+        names.insert(repeated + string(random() % 3, '0') + to_string(random() % 100000));
+    }
+    while (names.size() < count) {
+        string name = stems[random() % stems.size()];
+        for (unsigned parts = random() % 5; parts > 0; --parts) {
+            switch (random() % 4) {
+            case 0: name += string(random() % 3, '0') + to_string(random() % 1000); break;
+            case 1: name += string(".") + "cghz"[random() % 4]; break;
+            case 2: name += static_cast<char>('a' + random() % 26); break;
+            default: name += static_cast<char>('0' + random() % 10); break;
+            }
+        }
+        names.insert(name);
+    }
+    vector<string> shuffled(names.begin(), names.end());
+    shuffle(shuffled.begin(), shuffled.end(), random);
+    return shuffled;
+}
+
+void testSorterMatchesComparisonSort() {
+    // A small listing, and one big enough to spread tie runs over threads
+    for (size_t count : {3000ul, ListingSorter::PARALLEL_THRESHOLD + 5000}) {
+        vector<string> names = mixedNames(count, static_cast<unsigned>(count));
+
+        vector<string> expected = names;
+        sort(expected.begin(), expected.end());
+        CHECK(sortedNames(names, SortKey::Name, 4) == expected);
+
+        sort(expected.begin(), expected.end(), [](const string& a, const string& b) {
+            return ListingSorter::compareNatural(a, b) < 0;
+        });
+        CHECK(sortedNames(names, SortKey::Version, 4) == expected);
+
+        auto extensionOf = [](const string& name) {
+            size_t dot = name.rfind('.');
+            return dot == string::npos ? string() : name.substr(dot + 1);
+        };
+        sort(expected.begin(), expected.end(), [&](const string& a, const string& b) {
+            int order = extensionOf(a).compare(extensionOf(b));
+            return order != 0 ? order < 0 : a < b;
+        });
+        CHECK(sortedNames(names, SortKey::Extension, 4) == expected);
+    }
+}
+
+void testNaturalOrderLeadingZeros() {
+    CHECK(ListingSorter::compareNatural("file9", "file10") < 0);
+    CHECK(ListingSorter::compareNatural("07", "7") < 0);
+    CHECK(ListingSorter::compareNatural("7", "07") > 0);
+    CHECK(ListingSorter::compareNatural("a07b", "a7a") > 0);  // Equal numbers, then the rest decides
+    CHECK(ListingSorter::compareNatural("7", "7") == 0);
+
+    // Equal as numbers means equal natural keys; the names' bytes break the tie,
+    // both in a small listing and in one long enough for the radix passes
+    vector<string> expected = {"file007", "file07", "file7", "file8", "file9", "file10"};
+    for (size_t filler : {0, 200}) {
+        vector<string> names(expected.rbegin(), expected.rend());
+        for (size_t i = 0; i < filler; ++i) {
+            names.push_back("g" + to_string(i));
+        }
+        vector<string> sorted = sortedNames(names, SortKey::Version);
+        CHECK(vector<string>(sorted.begin(), sorted.begin() + expected.size()) == expected);
+    }
+}
+
+struct TestCase {
+    const char* name;
+    function<void()> run;
+};
+
+const vector<TestCase> TESTS = {
+    {"quoted glob characters", testQuotedGlobCharacters},
+    {"bracketed file name", testBracketedFileName},
+    {"sources sharing a name are refused", testSameNameSourcesRefused},
+    {"glob below a bracketed directory", testGlobBelowBracketedDirectory},
+    {"** matches no directory", testGlobStarMatchesNoDirectory},
+    {"write through symlinks and hard links", testWriteThroughLinks},
+    {"write keeps mode and extended attributes", testWriteKeepsAttributes},
+    {"cached subdirectory times follow their contents", testCachedSubdirectoryTimes},
+    {"cache hits don't stat subdirectories", testCacheHitsDoNotStatSubdirectories},
+    {"a renamed cached directory gives up its watch", testRenamedCachedDirectoryDropsWatch},
+    {"find notices a stale or corrupt index", testStaleIndex},
+    {"index records out of range are refused", testCorruptIndexRecords},
+    {"tree delete works relative to directory handles", testTreeDeleterRemovesRelativeToHandles},
+    {"tree delete splits the tree across threads", testTreeDeleterSplitsSubtrees},
+    {"moving to trash never replaces an entry", testTrashNeverReplaces},
+    {"background deletes share one worker", testBackgroundDeletesShareOneWorker},
+    {"walker reports unreadable directories", testWalkerReportsUnreadableDirectories},
+    {"walker joins its workers when a result handler throws", testWalkerResultHandlerThrows},
+    {"content search across read chunks", testContentSearchAcrossChunks},
+    {"viewer survives a truncated file", testViewerSurvivesTruncation},
+    {"move exchanges with an existing destination", testMoveExchangesWithDestination},
+    {"move onto the same file is refused", testMoveOntoItselfRefused},
+    {"move across file systems copies, verifies and deletes", testMoveAcrossFileSystems},
+    {"sorter agrees with a comparison sort", testSorterMatchesComparisonSort},
+    {"natural order of leading zeros", testNaturalOrderLeadingZeros},
+};
+
+} // namespace
+
+int main() {
+    size_t failed = 0;
+    for (const TestCase& test : TESTS) {
+        try {
+            test.run();
+            cout << "PASS  " << test.name << "\n";
+        } catch (const exception& e) {
+            cout << "FAIL  " << test.name << ": " << e.what() << "\n";
+            failed++;
+        }
+    }
+    cout << (TESTS.size() - failed) << "/" << TESTS.size() << " tests passed\n";
+    return failed == 0 ? 0 : 1;
+}
\ No newline at end of file